@@ -35,6 +35,7 @@ along with Tremulous; if not, see <https://www.gnu.org/licenses/>
 #include "sys/sys_local.h"
 
 #include "cl_updates.h"
+#include "qcommon/scratch.h"
 #ifdef USE_MUMBLE
 #endif
 
@@ -4998,12 +4999,16 @@ static void CL_InitRef(void)
 #endif
     ri.Hunk_AllocateTempMemory = Hunk_AllocateTempMemory;
     ri.Hunk_FreeTempMemory = Hunk_FreeTempMemory;
+    ri.Scratch_Alloc = Scratch_Alloc;
+    ri.Scratch_Mark = Scratch_Mark;
+    ri.Scratch_Rewind = Scratch_Rewind;
 
     ri.CM_ClusterPVS = CM_ClusterPVS;
     ri.CM_DrawDebugSurface = CM_DrawDebugSurface;
 
     ri.FS_ReadFile = FS_ReadFile;
     ri.FS_FreeFile = FS_FreeFile;
+    ri.FS_ReadFileScratch = FS_ReadFileScratch;
     ri.FS_WriteFile = FS_WriteFile;
     ri.FS_FreeFileList = FS_FreeFileList;
     ri.FS_ListFiles = FS_ListFiles;
@@ -32,211 +32,298 @@ along with Tremulous; if not, see <https://www.gnu.org/licenses/>
 #endif
 
 #define  FREEMEMCOOKIE  ((int)0xDEADBE3F)  // Any unlikely to be used value
+#define  USEDMEMCOOKIE  ((int)0xA110CA7E)
 #define  ROUNDBITS    31          // Round to 32 bytes
 
+// Free blocks are kept on segregated lists, one per size class: exact
+// classes every 32 bytes below SMALLCLASSMAX, then one class per power
+// of two.  Blocks carry the size of their physical neighbour below so
+// a free merges both ways on the spot and the pool never needs a
+// separate defragment pass.
+#define  SMALLCLASSMAX  1024
+#define  NUMSMALLCLASSES  ( SMALLCLASSMAX / ( ROUNDBITS + 1 ) - 1 )
+#define  NUMCLASSES     ( NUMSMALLCLASSES + 11 )  // up to 1 MB blocks
+
+typedef struct memHeader_s
+{
+  int cookie;              // FREEMEMCOOKIE or USEDMEMCOOKIE
+  int size;                // Size includes header, multiple of ROUNDBITS + 1
+  int prevSize;            // Size of the block just below, 0 for the first
+  int request;             // Bytes asked for, 0 while free
+} memHeader_t;
+
 typedef struct freeMemNode_s
 {
-  // Size of ROUNDBITS
-  int cookie, size;        // Size includes node (obviously)
+  memHeader_t hdr;
   struct freeMemNode_s *prev, *next;
 } freeMemNode_t;
 
-static char           memoryPool[POOLSIZE];
-static freeMemNode_t  *freeHead;
-static int            freeMem;
+typedef struct
+{
+  int live, peak;          // Allocated blocks in this class
+  int bytes, request;      // Block and requested bytes of the live blocks
+  int allocs;              // Lifetime allocations
+} memClassStats_t;
+
+static char             memoryPool[POOLSIZE];
+static freeMemNode_t    *freeLists[NUMCLASSES];
+static memClassStats_t  classStats[NUMCLASSES];
+static int              freeMem, peakMem;
+
+/*
+===============
+BG_SizeClass
+
+Maps a block size to its free list
+===============
+*/
+static int BG_SizeClass( int size )
+{
+  int c;
+
+  if( size < SMALLCLASSMAX )
+    return size / ( ROUNDBITS + 1 ) - 1;
+
+  for( c = NUMSMALLCLASSES, size /= SMALLCLASSMAX; size > 1 && c < NUMCLASSES - 1; size >>= 1 )
+    c++;
+
+  return c;
+}
+
+/*
+===============
+BG_ClassSize
+
+Smallest block size that lands in a class
+===============
+*/
+static int BG_ClassSize( int c )
+{
+  if( c < NUMSMALLCLASSES )
+    return ( c + 1 ) * ( ROUNDBITS + 1 );
+
+  return SMALLCLASSMAX << ( c - NUMSMALLCLASSES );
+}
+
+static memHeader_t *BG_NextBlock( memHeader_t *hdr )
+{
+  char *next = (char *)hdr + hdr->size;
+
+  if( next >= memoryPool + POOLSIZE )
+    return NULL;
+
+  return (memHeader_t *)next;
+}
+
+static void BG_LinkFree( memHeader_t *hdr )
+{
+  freeMemNode_t *fmn = (freeMemNode_t *)hdr;
+  int c = BG_SizeClass( hdr->size );
+
+  hdr->cookie = FREEMEMCOOKIE;
+  hdr->request = 0;
+  fmn->prev = NULL;
+  fmn->next = freeLists[ c ];
+  if( fmn->next )
+    fmn->next->prev = fmn;
+  freeLists[ c ] = fmn;
+}
+
+static void BG_UnlinkFree( memHeader_t *hdr )
+{
+  freeMemNode_t *fmn = (freeMemNode_t *)hdr;
+
+  if( fmn->prev )
+    fmn->prev->next = fmn->next;
+  else
+    freeLists[ BG_SizeClass( hdr->size ) ] = fmn->next;
+  if( fmn->next )
+    fmn->next->prev = fmn->prev;
+}
+
+// Resize a block and tell its upper neighbour
+static void BG_SetBlockSize( memHeader_t *hdr, int size )
+{
+  memHeader_t *next;
+
+  hdr->size = size;
+  if( ( next = BG_NextBlock( hdr ) ) )
+    next->prevSize = size;
+}
 
 void *BG_Alloc( int size )
 {
-  // Find a free block and allocate.
-  // Does two passes, attempts to fill same-sized free slot first.
+  // Take the head of the first class that is big enough,
+  // and split off whatever is left over.
+
+  memHeader_t *hdr, *rest;
+  freeMemNode_t *fmn;
+  memClassStats_t *stats;
+  int allocsize, c;
 
-  freeMemNode_t *fmn, *prev, *next, *smallest;
-  int allocsize, smallestsize;
-  char *endptr;
-  int *ptr;
+  if( size < 0 || size > POOLSIZE - (int)sizeof( memHeader_t ) )
+    Com_Error( ERR_DROP, "BG_Alloc: failed on allocation of %i bytes", size );
 
-  allocsize = ( size + (int)sizeof(int) + ROUNDBITS ) & ~ROUNDBITS;    // Round to 32-byte boundary
-  ptr = NULL;
+  allocsize = ( size + (int)sizeof( memHeader_t ) + ROUNDBITS ) & ~ROUNDBITS;    // Round to 32-byte boundary
+  if( allocsize < (int)sizeof( freeMemNode_t ) )
+    allocsize = ( (int)sizeof( freeMemNode_t ) + ROUNDBITS ) & ~ROUNDBITS;
 
-  smallest = NULL;
-  smallestsize = POOLSIZE + 1;    // Guaranteed not to miss any slots :)
-  for( fmn = freeHead; fmn; fmn = fmn->next )
+  // the power of two classes hold a range of sizes, so only the
+  // head of the exact class is worth a look before moving up
+  c = BG_SizeClass( allocsize );
+  fmn = freeLists[ c ];
+  if( !fmn || fmn->hdr.size < allocsize )
   {
-    if( fmn->cookie != FREEMEMCOOKIE )
-      Com_Error( ERR_DROP, "BG_Alloc: Memory corruption detected!" );
+    for( c++; c < NUMCLASSES && !freeLists[ c ]; c++ );
 
-    if( fmn->size >= allocsize )
+    if( c < NUMCLASSES )
+      fmn = freeLists[ c ];
+    else
     {
-      // We've got a block
-      if( fmn->size == allocsize )
+      // nothing bigger is free, so fall back to walking the
+      // exact class for any block that fits.  This is linear in
+      // the length of the list, but only a nearly full pool gets here
+      for( ; fmn && fmn->hdr.size < allocsize; fmn = fmn->next )
       {
-        // Same size, just remove
-
-        prev = fmn->prev;
-        next = fmn->next;
-        if( prev )
-          prev->next = next;      // Point previous node to next
-        if( next )
-          next->prev = prev;      // Point next node to previous
-        if( fmn == freeHead )
-          freeHead = next;      // Set head pointer to next
-        ptr = (int *) fmn;
-        break;              // Stop the loop, this is fine
-      }
-      else
-      {
-        // Keep track of the smallest free slot
-        if( fmn->size < smallestsize )
-        {
-          smallest = fmn;
-          smallestsize = fmn->size;
-        }
+        if( fmn->hdr.cookie != FREEMEMCOOKIE )
+          Com_Error( ERR_DROP, "BG_Alloc: Memory corruption detected!" );
       }
     }
-  }
 
-  if( !ptr && smallest )
-  {
-    // We found a slot big enough
-    smallest->size -= allocsize;
-    endptr = (char *) smallest + smallest->size;
-    ptr = (int *) endptr;
+    if( !fmn )
+      Com_Error( ERR_DROP, "BG_Alloc: failed on allocation of %i bytes", size );
   }
 
-  if( ptr )
+  hdr = &fmn->hdr;
+  if( hdr->cookie != FREEMEMCOOKIE || hdr->size < allocsize )
+    Com_Error( ERR_DROP, "BG_Alloc: Memory corruption detected!" );
+
+  BG_UnlinkFree( hdr );
+
+  if( hdr->size > allocsize )
   {
-    freeMem -= allocsize;
-    memset( ptr, 0, allocsize );
-    *ptr++ = allocsize;        // Store a copy of size for deallocation
-    return( (void *) ptr );
+    rest = (memHeader_t *)( (char *)hdr + allocsize );
+    rest->prevSize = allocsize;
+    BG_SetBlockSize( rest, hdr->size - allocsize );
+    BG_LinkFree( rest );
+    hdr->size = allocsize;
   }
 
-  Com_Error( ERR_DROP, "BG_Alloc: failed on allocation of %i bytes", size );
-  return( NULL );
+  hdr->cookie = USEDMEMCOOKIE;
+  hdr->request = size;
+
+  stats = &classStats[ BG_SizeClass( allocsize ) ];
+  stats->allocs++;
+  stats->bytes += allocsize;
+  stats->request += size;
+  if( ++stats->live > stats->peak )
+    stats->peak = stats->live;
+
+  freeMem -= allocsize;
+  if( POOLSIZE - freeMem > peakMem )
+    peakMem = POOLSIZE - freeMem;
+
+  memset( hdr + 1, 0, allocsize - sizeof( memHeader_t ) );
+  return( (void *)( hdr + 1 ) );
 }
 
 void BG_Free( void *ptr )
 {
-  // Release allocated memory, add it to the free list.
+  // Release allocated memory, merging it with free neighbours
+  // before it goes back on a list.
 
-  freeMemNode_t *fmn;
-  char *freeend;
-  int *freeptr;
+  memHeader_t *hdr, *next, *prev;
+  memClassStats_t *stats;
 
-  freeptr = ptr;
-  freeptr--;
+  hdr = (memHeader_t *)ptr - 1;
 
-  freeMem += *freeptr;
+  if( (char *)hdr < memoryPool || (char *)hdr >= memoryPool + POOLSIZE )
+    Com_Error( ERR_DROP, "BG_Free: %p is not in the pool", ptr );
 
-  for( fmn = freeHead; fmn; fmn = fmn->next )
+  if( hdr->cookie != USEDMEMCOOKIE )
   {
-    freeend = ((char *) fmn) + fmn->size;
-    if( freeend == (char *) freeptr )
-    {
-      // Released block can be merged to an existing node
+    Com_Error( ERR_DROP, "BG_Free: %s", hdr->cookie == FREEMEMCOOKIE ?
+      "block freed twice" : "Memory corruption detected!" );
+  }
+
+  stats = &classStats[ BG_SizeClass( hdr->size ) ];
+  stats->live--;
+  stats->bytes -= hdr->size;
+  stats->request -= hdr->request;
+  freeMem += hdr->size;
+
+  if( ( next = BG_NextBlock( hdr ) ) && next->cookie == FREEMEMCOOKIE )
+  {
+    BG_UnlinkFree( next );
+    BG_SetBlockSize( hdr, hdr->size + next->size );
+  }
 
-      fmn->size += *freeptr;    // Add size of node.
-      return;
+  if( hdr->prevSize )
+  {
+    prev = (memHeader_t *)( (char *)hdr - hdr->prevSize );
+    if( prev->cookie == FREEMEMCOOKIE )
+    {
+      BG_UnlinkFree( prev );
+      BG_SetBlockSize( prev, prev->size + hdr->size );
+      hdr->cookie = FREEMEMCOOKIE;
+      hdr = prev;
     }
   }
-  // No merging, add to head of list
 
-  fmn = (freeMemNode_t *) freeptr;
-  fmn->size = *freeptr;        // Set this first to avoid corrupting *freeptr
-  fmn->cookie = FREEMEMCOOKIE;
-  fmn->prev = NULL;
-  fmn->next = freeHead;
-  freeHead->prev = fmn;
-  freeHead = fmn;
+  BG_LinkFree( hdr );
 }
 
 void BG_InitMemory( void )
 {
   // Set up the initial node
 
-  freeHead = (freeMemNode_t *)memoryPool;
-  freeHead->cookie = FREEMEMCOOKIE;
-  freeHead->size = POOLSIZE;
-  freeHead->next = NULL;
-  freeHead->prev = NULL;
-  freeMem = sizeof( memoryPool );
-}
-
-void BG_DefragmentMemory( void )
-{
-  // If there's a frenzy of deallocation and we want to
-  // allocate something big, this is useful. Otherwise...
-  // not much use.
-
-  freeMemNode_t *startfmn, *endfmn, *fmn;
-
-  for( startfmn = freeHead; startfmn; )
-  {
-    endfmn = (freeMemNode_t *)(((char *) startfmn) + startfmn->size);
-    for( fmn = freeHead; fmn; )
-    {
-      if( fmn->cookie != FREEMEMCOOKIE )
-        Com_Error( ERR_DROP, "BG_DefragmentMemory: Memory corruption detected!" );
+  memHeader_t *hdr = (memHeader_t *)memoryPool;
 
-      if( fmn == endfmn )
-      {
-        // We can add fmn onto startfmn.
-
-        if( fmn->prev )
-          fmn->prev->next = fmn->next;
-        if( fmn->next )
-        {
-          if( !(fmn->next->prev = fmn->prev) )
-            freeHead = fmn->next;  // We're removing the head node
-        }
-        startfmn->size += fmn->size;
-        memset( fmn, 0, sizeof(freeMemNode_t) );  // A redundant call, really.
-
-        startfmn = freeHead;
-        endfmn = fmn = NULL;        // Break out of current loop
-      }
-      else
-        fmn = fmn->next;
-    }
+  memset( freeLists, 0, sizeof( freeLists ) );
+  memset( classStats, 0, sizeof( classStats ) );
 
-    if( endfmn )
-      startfmn = startfmn->next;    // endfmn acts as a 'restart' flag here
-  }
+  hdr->size = POOLSIZE;
+  hdr->prevSize = 0;
+  BG_LinkFree( hdr );
+  freeMem = sizeof( memoryPool );
+  peakMem = 0;
 }
 
 void BG_MemoryInfo( void )
 {
-  // Give a breakdown of memory
+  // Give a breakdown of memory per size class
 
-  freeMemNode_t *fmn = (freeMemNode_t *)memoryPool;
-  int size, chunks;
-  freeMemNode_t *end = (freeMemNode_t *)( memoryPool + POOLSIZE );
-  void *p;
+  memClassStats_t *stats;
+  freeMemNode_t *fmn;
+  int c, chunks, size, largest, totalChunks;
 
-  Com_Printf( "%p-%p: %d out of %d bytes allocated\n",
-    fmn, end, POOLSIZE - freeMem, POOLSIZE );
+  Com_Printf( "%p-%p: %d out of %d bytes allocated, peak %d\n",
+    memoryPool, memoryPool + POOLSIZE, POOLSIZE - freeMem, POOLSIZE, peakMem );
+  Com_Printf( "class   size   live   peak   allocs    bytes  request   free   free bytes\n" );
 
-  while( fmn < end )
+  largest = totalChunks = 0;
+  for( c = 0; c < NUMCLASSES; c++ )
   {
-    size = chunks = 0;
-    p = fmn;
-    while( fmn < end && fmn->cookie == FREEMEMCOOKIE )
-    {
-      size += fmn->size;
-      chunks++;
-      fmn = (freeMemNode_t *)( (char *)fmn + fmn->size );
-    }
-    if( size )
-      Com_Printf( "  %p: %d bytes free (%d chunks)\n", p, size, chunks );
-    size = chunks = 0;
-    p = fmn;
-    while( fmn < end && fmn->cookie != FREEMEMCOOKIE )
+    stats = &classStats[ c ];
+
+    chunks = size = 0;
+    for( fmn = freeLists[ c ]; fmn; fmn = fmn->next )
     {
-      size += *(int *)fmn;
       chunks++;
-      fmn = (freeMemNode_t *)( (size_t)fmn + *(int *)fmn );
+      size += fmn->hdr.size;
+      if( fmn->hdr.size > largest )
+        largest = fmn->hdr.size;
     }
-    if( size )
-      Com_Printf( "  %p: %d bytes allocated (%d chunks)\n", p, size, chunks );
+    totalChunks += chunks;
+
+    if( !stats->allocs && !chunks )
+      continue;
+
+    Com_Printf( "%5d %6d%s %6d %6d %8d %8d %8d %6d %12d\n",
+      c, BG_ClassSize( c ), c < NUMSMALLCLASSES ? " " : "+",
+      stats->live, stats->peak, stats->allocs, stats->bytes, stats->request,
+      chunks, size );
   }
+
+  Com_Printf( "%d bytes free in %d chunks, largest %d\n", freeMem, totalChunks, largest );
 }
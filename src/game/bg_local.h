@@ -57,8 +57,20 @@ typedef struct
   int       previous_waterlevel;
 } pml_t;
 
-extern  pmove_t       *pm;
-extern  pml_t         pml;
+// the dedicated server's pmovebench runs Pmove on several threads at once,
+// the game and cgame always run it on one
+#if defined( DEDICATED ) && !defined( Q3_VM )
+#ifdef _MSC_VER
+#define PM_THREAD_LOCAL __declspec( thread )
+#else
+#define PM_THREAD_LOCAL __thread
+#endif
+#else
+#define PM_THREAD_LOCAL
+#endif
+
+extern  PM_THREAD_LOCAL pmove_t *pm;
+extern  PM_THREAD_LOCAL pml_t   pml;
 
 // movement parameters
 extern  float pm_stopspeed;
@@ -74,7 +86,7 @@ extern  float pm_waterfriction;
 extern  float pm_flightfriction;
 extern  float pm_spectatorfriction;
 
-extern  int   c_pmove;
+extern  PM_THREAD_LOCAL int c_pmove;
 
 void PM_ClipVelocity( vec3_t in, vec3_t normal, vec3_t out );
 void PM_AddTouchEnt( int entityNum );
@@ -29,8 +29,8 @@ along with Tremulous; if not, see <https://www.gnu.org/licenses/>
 #include "bg_public.h"
 #include "bg_local.h"
 
-pmove_t     *pm;
-pml_t       pml;
+PM_THREAD_LOCAL pmove_t *pm;
+PM_THREAD_LOCAL pml_t   pml;
 
 // movement parameters
 float pm_stopspeed = 100.0f;
@@ -46,7 +46,7 @@ float pm_waterfriction = 1.0f;
 float pm_flightfriction = 6.0f;
 float pm_spectatorfriction = 5.0f;
 
-int   c_pmove = 0;
+PM_THREAD_LOCAL int c_pmove = 0;
 
 /*
 ===============
@@ -3279,6 +3279,7 @@ static void PM_Weapon( void )
           PM_ForceLegsAnim( NSPA_ATTACK2 );
           PM_StartWeaponAnim( WANIM_ATTACK7 );
         }
+        // fall through
       case WP_ALEVEL2:
         if( attack1 )
         {
@@ -1247,7 +1247,6 @@ typedef enum
 void  *BG_Alloc( int size );
 void  BG_InitMemory( void );
 void  BG_Free( void *ptr );
-void  BG_DefragmentMemory( void );
 void  BG_MemoryInfo( void );
 
 void  BG_EvaluateTrajectory( const trajectory_t *tr, int atTime, vec3_t result );
@@ -3584,5 +3584,4 @@ void G_admin_cleanup( void )
     BG_Free( c );
   }
   g_admin_commands = NULL;
-  BG_DefragmentMemory( );
 }
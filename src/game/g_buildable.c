@@ -1157,6 +1157,54 @@ void ABarricade_Touch( gentity_t *self, gentity_t *other, trace_t *trace )
 
 
 
+/*
+================
+G_BuildableTraceTargets
+
+Traces from start towards every target in one batch, ignoring self.  With a
+range the trace runs that far along the direction to the target and has to
+hit it, otherwise it runs to the target's origin and only has to reach it.
+Returns the first target that passes, or NULL.
+================
+*/
+static gentity_t *G_BuildableTraceTargets( gentity_t *self, vec3_t start,
+                                           gentity_t **targets, int numTargets,
+                                           float range, int contentmask )
+{
+  static traceRequest_t requests[ MAX_CLIENTS ];
+  static trace_t        results[ MAX_CLIENTS ];
+  vec3_t    dir, end;
+  int       i;
+
+  for( i = 0; i < numTargets; i++ )
+  {
+    if( range > 0.0f )
+    {
+      VectorSubtract( targets[ i ]->s.pos.trBase, start, dir );
+      VectorNormalize( dir );
+      VectorMA( start, range, dir, end );
+    }
+    else
+      VectorCopy( targets[ i ]->s.pos.trBase, end );
+
+    G_TraceRequest( &requests[ i ], start, NULL, NULL, end,
+                    self->s.number, contentmask );
+  }
+
+  trap_TraceBatch( results, requests, numTargets );
+
+  for( i = 0; i < numTargets; i++ )
+  {
+    if( results[ i ].entityNum == targets[ i ] - g_entities )
+      return targets[ i ];
+
+    if( range <= 0.0f && results[ i ].fraction >= 1.0f )
+      return targets[ i ];
+  }
+
+  return NULL;
+}
+
 /*
 ================
 AAcidTube_Think
@@ -1167,9 +1215,10 @@ Think function for Alien Acid Tube
 void AAcidTube_Think( gentity_t *self )
 {
   int       entityList[ MAX_GENTITIES ];
+  gentity_t *targets[ MAX_CLIENTS ];
   vec3_t    range = { ACIDTUBE_RANGE, ACIDTUBE_RANGE, ACIDTUBE_RANGE };
   vec3_t    mins, maxs;
-  int       i, num;
+  int       i, num, numTargets;
   gentity_t *enemy;
 
   AGeneric_Think( self );
@@ -1181,31 +1230,32 @@ void AAcidTube_Think( gentity_t *self )
   if( self->spawned && self->health > 0 && self->powered )
   {
     num = trap_EntitiesInBox( mins, maxs, entityList, MAX_GENTITIES );
-    for( i = 0; i < num; i++ )
+    for( i = 0, numTargets = 0; i < num && numTargets < MAX_CLIENTS; i++ )
     {
       enemy = &g_entities[ entityList[ i ] ];
 
       if( enemy->flags & FL_NOTARGET )
         continue;
 
-      if( !G_Visible( self, enemy, CONTENTS_SOLID ) )
-        continue;
-
       if( enemy->client && enemy->client->ps.stats[ STAT_TEAM ] == TEAM_HUMANS )
-      {
-        // start the attack animation
-        if( level.time >= self->timestamp + ACIDTUBE_REPEAT_ANIM )
-        {
-          self->timestamp = level.time;
-          G_SetBuildableAnim( self, BANIM_ATTACK1, qfalse );
-          G_AddEvent( self, EV_ALIEN_ACIDTUBE, DirToByte( self->s.origin2 ) );
-        }
+        targets[ numTargets++ ] = enemy;
+    }
 
-        G_SelectiveRadiusDamage( self->s.pos.trBase, self, ACIDTUBE_DAMAGE,
-                                 ACIDTUBE_RANGE, self, MOD_ATUBE, TEAM_ALIENS );
-        self->nextthink = level.time + ACIDTUBE_REPEAT;
-        return;
+    if( numTargets &&
+        G_BuildableTraceTargets( self, self->s.pos.trBase, targets, numTargets,
+                                 0.0f, CONTENTS_SOLID ) )
+    {
+      // start the attack animation
+      if( level.time >= self->timestamp + ACIDTUBE_REPEAT_ANIM )
+      {
+        self->timestamp = level.time;
+        G_SetBuildableAnim( self, BANIM_ATTACK1, qfalse );
+        G_AddEvent( self, EV_ALIEN_ACIDTUBE, DirToByte( self->s.origin2 ) );
       }
+
+      G_SelectiveRadiusDamage( self->s.pos.trBase, self, ACIDTUBE_DAMAGE,
+                               ACIDTUBE_RANGE, self, MOD_ATUBE, TEAM_ALIENS );
+      self->nextthink = level.time + ACIDTUBE_REPEAT;
     }
   }
 }
@@ -1217,15 +1267,27 @@ void AAcidTube_Think( gentity_t *self )
 
 /*
 ================
-AHive_CheckTarget
+AHive_TipOrigin
 
-Returns true and fires the hive missile if the target is valid
+Where the hive looks for and fires at its targets from
 ================
 */
-static qboolean AHive_CheckTarget( gentity_t *self, gentity_t *enemy )
+static void AHive_TipOrigin( gentity_t *self, vec3_t tip_origin )
 {
-  trace_t trace;
-  vec3_t tip_origin, dirToTarget;
+  VectorMA( self->s.pos.trBase, self->r.maxs[ 2 ], self->s.origin2,
+            tip_origin );
+}
+
+/*
+================
+AHive_ValidTarget
+
+Returns true if the target is in range, before checking line of sight
+================
+*/
+static qboolean AHive_ValidTarget( gentity_t *self, gentity_t *enemy )
+{
+  vec3_t tip_origin;
 
   // Check if this is a valid target
   if( enemy->health <= 0 || !enemy->client ||
@@ -1235,16 +1297,20 @@ static qboolean AHive_CheckTarget( gentity_t *self, gentity_t *enemy )
   if( enemy->flags & FL_NOTARGET )
     return qfalse;
 
-  // Check if the tip of the hive can see the target
-  VectorMA( self->s.pos.trBase, self->r.maxs[ 2 ], self->s.origin2,
-            tip_origin );
-  if( Distance( tip_origin, enemy->r.currentOrigin ) > HIVE_SENSE_RANGE )
-    return qfalse;
+  AHive_TipOrigin( self, tip_origin );
+  return Distance( tip_origin, enemy->r.currentOrigin ) <= HIVE_SENSE_RANGE;
+}
 
-  trap_Trace( &trace, tip_origin, NULL, NULL, enemy->s.pos.trBase,
-              self->s.number, MASK_SHOT );
-  if( trace.fraction < 1.0f && trace.entityNum != enemy->s.number )
-    return qfalse;
+/*
+================
+AHive_Fire
+
+Fires the hive missile at a target that has been checked already
+================
+*/
+static void AHive_Fire( gentity_t *self, gentity_t *enemy )
+{
+  vec3_t dirToTarget;
 
   self->active = qtrue;
   self->target_ent = enemy;
@@ -1257,6 +1323,31 @@ static qboolean AHive_CheckTarget( gentity_t *self, gentity_t *enemy )
   // Fire at target
   FireWeapon( self );
   G_SetBuildableAnim( self, BANIM_ATTACK1, qfalse );
+}
+
+/*
+================
+AHive_CheckTarget
+
+Returns true and fires the hive missile if the target is valid
+================
+*/
+static qboolean AHive_CheckTarget( gentity_t *self, gentity_t *enemy )
+{
+  trace_t trace;
+  vec3_t tip_origin;
+
+  if( !AHive_ValidTarget( self, enemy ) )
+    return qfalse;
+
+  // Check if the tip of the hive can see the target
+  AHive_TipOrigin( self, tip_origin );
+  trap_Trace( &trace, tip_origin, NULL, NULL, enemy->s.pos.trBase,
+              self->s.number, MASK_SHOT );
+  if( trace.fraction < 1.0f && trace.entityNum != enemy->s.number )
+    return qfalse;
+
+  AHive_Fire( self, enemy );
   return qtrue;
 }
 
@@ -1280,8 +1371,9 @@ void AHive_Think( gentity_t *self )
   // Find a target to attack
   if( self->spawned && !self->active && self->powered )
   {
-    int i, num, entityList[ MAX_GENTITIES ];
-    vec3_t mins, maxs,
+    int i, num, numTargets, entityList[ MAX_GENTITIES ];
+    gentity_t *enemy, *targets[ MAX_CLIENTS ];
+    vec3_t mins, maxs, tip_origin,
            range = { HIVE_SENSE_RANGE, HIVE_SENSE_RANGE, HIVE_SENSE_RANGE };
 
     VectorAdd( self->r.currentOrigin, range, maxs );
@@ -1292,12 +1384,24 @@ void AHive_Think( gentity_t *self )
     if( num == 0 )
       return;
 
+    // check line of sight to every valid target at once, starting from a
+    // random one so the hive doesn't always pick the same
     start = rand( ) / ( RAND_MAX / num + 1 );
-    for( i = start; i < num + start; i++ )
+    for( i = start, numTargets = 0; i < num + start && numTargets < MAX_CLIENTS; i++ )
     {
-      if( AHive_CheckTarget( self, g_entities + entityList[ i % num ] ) )
-        return;
+      enemy = g_entities + entityList[ i % num ];
+      if( AHive_ValidTarget( self, enemy ) )
+        targets[ numTargets++ ] = enemy;
     }
+
+    if( numTargets == 0 )
+      return;
+
+    AHive_TipOrigin( self, tip_origin );
+    enemy = G_BuildableTraceTargets( self, tip_origin, targets, numTargets,
+                                     0.0f, MASK_SHOT );
+    if( enemy )
+      AHive_Fire( self, enemy );
   }
 }
 
@@ -2259,9 +2363,10 @@ Used by HMGTurret_Think to locate enemy gentities
 void HMGTurret_FindEnemy( gentity_t *self )
 {
   int       entityList[ MAX_GENTITIES ];
+  gentity_t *targets[ MAX_CLIENTS ];
   vec3_t    range;
   vec3_t    mins, maxs;
-  int       i, num;
+  int       i, num, numTargets;
   gentity_t *target;
   int       start;
 
@@ -2276,16 +2381,21 @@ void HMGTurret_FindEnemy( gentity_t *self )
   if( num == 0 )
     return;
 
+  // line-trace to every valid target at once and take the first one hit,
+  // starting from a random one so the turret doesn't always pick the same
   start = rand( ) / ( RAND_MAX / num + 1 );
-  for( i = start; i < num + start ; i++ )
+  for( i = start, numTargets = 0; i < num + start && numTargets < MAX_CLIENTS; i++ )
   {
     target = &g_entities[ entityList[ i % num ] ];
-    if( !HMGTurret_CheckTarget( self, target, qtrue ) )
-      continue;
+    if( HMGTurret_CheckTarget( self, target, qfalse ) )
+      targets[ numTargets++ ] = target;
+  }
 
-    self->enemy = target;
+  if( numTargets == 0 )
     return;
-  }
+
+  self->enemy = G_BuildableTraceTargets( self, self->s.pos.trBase, targets,
+                                         numTargets, MGTURRET_RANGE, MASK_SHOT );
 }
 
 /*
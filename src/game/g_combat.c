@@ -1177,6 +1177,94 @@ void G_Damage( gentity_t *targ, gentity_t *inflictor, gentity_t *attacker,
 }
 
 
+/*
+============
+G_CanDamageList
+
+Compacts entityList down to the entities that can be directly damaged from
+origin, keeping their order.  The line of sight traces for every entity are
+submitted together, so checking a whole explosion takes a couple of system
+calls instead of up to five per entity.
+============
+*/
+static int G_CanDamageList( int *entityList, int numEntities, vec3_t origin )
+{
+  static traceRequest_t requests[ MAX_TRACE_BATCH ];
+  static trace_t        results[ MAX_TRACE_BATCH ];
+  vec3_t    midpoints[ MAX_TRACE_BATCH / 4 ];
+  qboolean  visible[ MAX_TRACE_BATCH / 4 ];
+  int       blocked[ MAX_TRACE_BATCH / 4 ];
+  vec3_t    dest;
+  gentity_t *targ;
+  int       first, count, numBlocked, numVisible = 0;
+  int       i, j;
+
+  // each entity needs at most four more traces, so a chunk of entities always
+  // fits in a single second batch
+  for( first = 0; first < numEntities; first += count )
+  {
+    count = MIN( numEntities - first, MAX_TRACE_BATCH / 4 );
+
+    for( i = 0; i < count; i++ )
+    {
+      targ = &g_entities[ entityList[ first + i ] ];
+
+      // use the midpoint of the bounds instead of the origin, because
+      // bmodels may have their origin is 0,0,0
+      VectorAdd( targ->r.absmin, targ->r.absmax, midpoints[ i ] );
+      VectorScale( midpoints[ i ], 0.5, midpoints[ i ] );
+
+      G_TraceRequest( &requests[ i ], origin, NULL, NULL, midpoints[ i ],
+                      ENTITYNUM_NONE, MASK_SOLID );
+    }
+
+    trap_TraceBatch( results, requests, count );
+
+    for( i = 0, numBlocked = 0; i < count; i++ )
+    {
+      visible[ i ] = results[ i ].fraction == 1.0 ||
+                     results[ i ].entityNum == entityList[ first + i ];
+      if( visible[ i ] )
+        continue;
+
+      // this should probably check in the plane of projection,
+      // rather than in world coordinate, and also include Z
+      for( j = 0; j < 4; j++ )
+      {
+        VectorCopy( midpoints[ i ], dest );
+        dest[ 0 ] += ( j & 2 ) ? -15.0 : 15.0;
+        dest[ 1 ] += ( j & 1 ) ? -15.0 : 15.0;
+        G_TraceRequest( &requests[ numBlocked * 4 + j ], origin, NULL, NULL, dest,
+                        ENTITYNUM_NONE, MASK_SOLID );
+      }
+
+      blocked[ numBlocked++ ] = i;
+    }
+
+    if( numBlocked )
+    {
+      trap_TraceBatch( results, requests, numBlocked * 4 );
+
+      for( i = 0; i < numBlocked; i++ )
+      {
+        for( j = 0; j < 4; j++ )
+        {
+          if( results[ i * 4 + j ].fraction == 1.0 )
+            visible[ blocked[ i ] ] = qtrue;
+        }
+      }
+    }
+
+    for( i = 0; i < count; i++ )
+    {
+      if( visible[ i ] )
+        entityList[ numVisible++ ] = entityList[ first + i ];
+    }
+  }
+
+  return numVisible;
+}
+
 /*
 ============
 CanDamage
@@ -1187,51 +1275,34 @@ explosions and melee attacks.
 */
 qboolean CanDamage( gentity_t *targ, vec3_t origin )
 {
-  vec3_t  dest;
-  trace_t tr;
-  vec3_t  midpoint;
-
-  // use the midpoint of the bounds instead of the origin, because
-  // bmodels may have their origin is 0,0,0
-  VectorAdd( targ->r.absmin, targ->r.absmax, midpoint );
-  VectorScale( midpoint, 0.5, midpoint );
-
-  VectorCopy( midpoint, dest );
-  trap_Trace( &tr, origin, vec3_origin, vec3_origin, dest, ENTITYNUM_NONE, MASK_SOLID );
-  if( tr.fraction == 1.0  || tr.entityNum == targ->s.number )
-    return qtrue;
-
-  // this should probably check in the plane of projection,
-  // rather than in world coordinate, and also include Z
-  VectorCopy( midpoint, dest );
-  dest[ 0 ] += 15.0;
-  dest[ 1 ] += 15.0;
-  trap_Trace( &tr, origin, vec3_origin, vec3_origin, dest, ENTITYNUM_NONE, MASK_SOLID );
-  if( tr.fraction == 1.0 )
-    return qtrue;
-
-  VectorCopy( midpoint, dest );
-  dest[ 0 ] += 15.0;
-  dest[ 1 ] -= 15.0;
-  trap_Trace( &tr, origin, vec3_origin, vec3_origin, dest, ENTITYNUM_NONE, MASK_SOLID );
-  if( tr.fraction == 1.0 )
-    return qtrue;
-
-  VectorCopy( midpoint, dest );
-  dest[ 0 ] -= 15.0;
-  dest[ 1 ] += 15.0;
-  trap_Trace( &tr, origin, vec3_origin, vec3_origin, dest, ENTITYNUM_NONE, MASK_SOLID );
-  if( tr.fraction == 1.0 )
-    return qtrue;
-
-  VectorCopy( midpoint, dest );
-  dest[ 0 ] -= 15.0;
-  dest[ 1 ] -= 15.0;
-  trap_Trace( &tr, origin, vec3_origin, vec3_origin, dest, ENTITYNUM_NONE, MASK_SOLID );
-  if( tr.fraction == 1.0 )
-    return qtrue;
-
-  return qfalse;
+  int num = targ->s.number;
+
+  return G_CanDamageList( &num, 1, origin ) > 0;
+}
+
+/*
+============
+G_RadiusDistance
+
+Distance from origin to the edge of ent's bounding box
+============
+*/
+static float G_RadiusDistance( gentity_t *ent, vec3_t origin )
+{
+  vec3_t  v;
+  int     i;
+
+  for( i = 0; i < 3; i++ )
+  {
+    if( origin[ i ] < ent->r.absmin[ i ] )
+      v[ i ] = ent->r.absmin[ i ] - origin[ i ];
+    else if( origin[ i ] > ent->r.absmax[ i ] )
+      v[ i ] = origin[ i ] - ent->r.absmax[ i ];
+    else
+      v[ i ] = 0;
+  }
+
+  return VectorLength( v );
 }
 
 /*
@@ -1242,12 +1313,11 @@ G_SelectiveRadiusDamage
 qboolean G_SelectiveRadiusDamage( vec3_t origin, gentity_t *attacker, float damage,
                                   float radius, gentity_t *ignore, int mod, int team )
 {
-  float     points, dist;
+  float     points;
   gentity_t *ent;
   int       entityList[ MAX_GENTITIES ];
-  int       numListedEntities;
+  int       numListedEntities, numTargets;
   vec3_t    mins, maxs;
-  vec3_t    v;
   vec3_t    dir;
   int       i, e;
   qboolean  hitClient = qfalse;
@@ -1263,7 +1333,9 @@ qboolean G_SelectiveRadiusDamage( vec3_t origin, gentity_t *attacker, float dama
 
   numListedEntities = trap_EntitiesInBox( mins, maxs, entityList, MAX_GENTITIES );
 
-  for( e = 0; e < numListedEntities; e++ )
+  // narrow the list down to enemies in range, then check line of sight to
+  // all of them at once
+  for( e = 0, numTargets = 0; e < numListedEntities; e++ )
   {
     ent = &g_entities[ entityList[ e ] ];
 
@@ -1276,34 +1348,34 @@ qboolean G_SelectiveRadiusDamage( vec3_t origin, gentity_t *attacker, float dama
     if( ent->flags & FL_NOTARGET )
       continue;
 
-    // find the distance from the edge of the bounding box
-    for( i = 0 ; i < 3 ; i++ )
-    {
-      if( origin[ i ] < ent->r.absmin[ i ] )
-        v[ i ] = ent->r.absmin[ i ] - origin[ i ];
-      else if( origin[ i ] > ent->r.absmax[ i ] )
-        v[ i ] = origin[ i ] - ent->r.absmax[ i ];
-      else
-        v[ i ] = 0;
-    }
+    if( !ent->client || ent->client->ps.stats[ STAT_TEAM ] == team )
+      continue;
 
-    dist = VectorLength( v );
-    if( dist >= radius )
+    if( G_RadiusDistance( ent, origin ) >= radius )
       continue;
 
-    points = damage * ( 1.0 - dist / radius );
+    entityList[ numTargets++ ] = entityList[ e ];
+  }
 
-    if( CanDamage( ent, origin ) && ent->client &&
-        ent->client->ps.stats[ STAT_TEAM ] != team )
-    {
-      VectorSubtract( ent->r.currentOrigin, origin, dir );
-      // push the center of mass higher than the origin so players
-      // get knocked into the air more
-      dir[ 2 ] += 24;
-      hitClient = qtrue;
-      G_Damage( ent, NULL, attacker, dir, origin,
-          (int)points, DAMAGE_RADIUS|DAMAGE_NO_LOCDAMAGE, mod );
-    }
+  numTargets = G_CanDamageList( entityList, numTargets, origin );
+
+  for( e = 0; e < numTargets; e++ )
+  {
+    ent = &g_entities[ entityList[ e ] ];
+
+    // an earlier victim dying may have taken this one with it
+    if( !ent->takedamage )
+      continue;
+
+    points = damage * ( 1.0 - G_RadiusDistance( ent, origin ) / radius );
+
+    VectorSubtract( ent->r.currentOrigin, origin, dir );
+    // push the center of mass higher than the origin so players
+    // get knocked into the air more
+    dir[ 2 ] += 24;
+    hitClient = qtrue;
+    G_Damage( ent, NULL, attacker, dir, origin,
+        (int)points, DAMAGE_RADIUS|DAMAGE_NO_LOCDAMAGE, mod );
   }
 
   return hitClient;
@@ -1318,12 +1390,11 @@ G_RadiusDamage
 qboolean G_RadiusDamage( vec3_t origin, gentity_t *attacker, float damage,
                          float radius, gentity_t *ignore, int mod )
 {
-  float     points, dist;
+  float     points;
   gentity_t *ent;
   int       entityList[ MAX_GENTITIES ];
-  int       numListedEntities;
+  int       numListedEntities, numTargets;
   vec3_t    mins, maxs;
-  vec3_t    v;
   vec3_t    dir;
   int       i, e;
   qboolean  hitClient = qfalse;
@@ -1339,7 +1410,9 @@ qboolean G_RadiusDamage( vec3_t origin, gentity_t *attacker, float damage,
 
   numListedEntities = trap_EntitiesInBox( mins, maxs, entityList, MAX_GENTITIES );
 
-  for( e = 0; e < numListedEntities; e++ )
+  // narrow the list down to entities in range, then check line of sight to
+  // all of them at once
+  for( e = 0, numTargets = 0; e < numListedEntities; e++ )
   {
     ent = &g_entities[ entityList[ e ] ];
 
@@ -1349,33 +1422,31 @@ qboolean G_RadiusDamage( vec3_t origin, gentity_t *attacker, float damage,
     if( !ent->takedamage )
       continue;
 
-    // find the distance from the edge of the bounding box
-    for( i = 0; i < 3; i++ )
-    {
-      if( origin[ i ] < ent->r.absmin[ i ] )
-        v[ i ] = ent->r.absmin[ i ] - origin[ i ];
-      else if( origin[ i ] > ent->r.absmax[ i ] )
-        v[ i ] = origin[ i ] - ent->r.absmax[ i ];
-      else
-        v[ i ] = 0;
-    }
+    if( G_RadiusDistance( ent, origin ) >= radius )
+      continue;
 
-    dist = VectorLength( v );
-    if( dist >= radius )
+    entityList[ numTargets++ ] = entityList[ e ];
+  }
+
+  numTargets = G_CanDamageList( entityList, numTargets, origin );
+
+  for( e = 0; e < numTargets; e++ )
+  {
+    ent = &g_entities[ entityList[ e ] ];
+
+    // an earlier victim dying may have taken this one with it
+    if( !ent->takedamage )
       continue;
 
-    points = damage * ( 1.0 - dist / radius );
+    points = damage * ( 1.0 - G_RadiusDistance( ent, origin ) / radius );
 
-    if( CanDamage( ent, origin ) )
-    {
-      VectorSubtract( ent->r.currentOrigin, origin, dir );
-      // push the center of mass higher than the origin so players
-      // get knocked into the air more
-      dir[ 2 ] += 24;
-      hitClient = qtrue;
-      G_Damage( ent, NULL, attacker, dir, origin,
-          (int)points, DAMAGE_RADIUS|DAMAGE_NO_LOCDAMAGE, mod );
-    }
+    VectorSubtract( ent->r.currentOrigin, origin, dir );
+    // push the center of mass higher than the origin so players
+    // get knocked into the air more
+    dir[ 2 ] += 24;
+    hitClient = qtrue;
+    G_Damage( ent, NULL, attacker, dir, origin,
+        (int)points, DAMAGE_RADIUS|DAMAGE_NO_LOCDAMAGE, mod );
   }
 
   return hitClient;
@@ -126,6 +126,7 @@ struct gentity_s
   int               soundLoop;
   gentity_t         *parent;
   gentity_t         *nextTrain;
+  int               pvsLeaf;        // leaf of a target_location, for trap_LeafsInPVS
   vec3_t            pos1, pos2;
   float             rotatorAngle;
   gentity_t         *clipBrush;     // clipping brush for model doors
@@ -869,6 +870,9 @@ void        G_TriggerMenuArgs( int clientNum, dynMenu_t menu, int arg );
 void        G_CloseMenus( int clientNum );
 
 qboolean    G_Visible( gentity_t *ent1, gentity_t *ent2, int contents );
+void        G_TraceRequest( traceRequest_t *req, const vec3_t start, const vec3_t mins,
+                            const vec3_t maxs, const vec3_t end, int passEntityNum,
+                            int contentmask );
 gentity_t   *G_ClosestEnt( vec3_t origin, gentity_t **entities, int numEntities );
 
 //
@@ -1238,9 +1242,12 @@ void      trap_GetServerinfo( char *buffer, int bufferSize );
 void      trap_SetBrushModel( gentity_t *ent, const char *name );
 void      trap_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs,
                       const vec3_t end, int passEntityNum, int contentmask );
+void      trap_TraceBatch( trace_t *results, const traceRequest_t *requests, int numRequests );
 int       trap_PointContents( const vec3_t point, int passEntityNum );
 qboolean  trap_InPVS( const vec3_t p1, const vec3_t p2 );
 qboolean  trap_InPVSIgnorePortals( const vec3_t p1, const vec3_t p2 );
+int       trap_PointLeafnum( const vec3_t point );
+qboolean  trap_LeafsInPVS( int leaf1, int leaf2, qboolean ignorePortals );
 void      trap_AdjustAreaPortalState( gentity_t *ent, qboolean open );
 qboolean  trap_AreasConnected( int area1, int area2 );
 void      trap_LinkEntity( gentity_t *ent );
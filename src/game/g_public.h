@@ -92,6 +92,20 @@ typedef struct {
     entityShared_t r;  // shared by both the server system and game
 } sharedEntity_t;
 
+// one entry of a G_TRACE_BATCH request; everything is stored by value so the
+// array can be handed to the engine as a single block of VM memory
+#define MAX_TRACE_BATCH 128
+
+typedef struct {
+    vec3_t start;
+    vec3_t mins;  // zero mins and maxs make a point trace
+    vec3_t maxs;
+    vec3_t end;
+    int passEntityNum;
+    int contentmask;
+    int type;  // TT_AABB or TT_CAPSULE
+} traceRequest_t;
+
 //===============================================================
 
 //
@@ -229,7 +243,16 @@ typedef enum {
 
     G_ADDCOMMAND,
     G_REMOVECOMMAND,
-    G_FS_GETFILTEREDFILES
+    G_FS_GETFILTEREDFILES,
+
+    G_TRACE_BATCH,  // ( trace_t *results, const traceRequest_t *requests, int numRequests );
+    // runs up to MAX_TRACE_BATCH independent traces in one call
+
+    G_POINT_LEAFNUM,  // ( const vec3_t point );
+    // the BSP leaf of a point, which stays the same for the whole map
+
+    G_LEAFS_IN_PVS  // ( int leaf1, int leaf2, qboolean ignorePortals );
+    // G_IN_PVS / G_IN_PVS_IGNORE_PORTALS for leafs from G_POINT_LEAFNUM
 } gameImport_t;
 
 //
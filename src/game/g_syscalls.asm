@@ -55,6 +55,9 @@ equ trap_SendGameStat                 -49
 equ trap_AddCommand                   -50
 equ trap_RemoveCommand                -51
 equ trap_FS_GetFilteredFiles           -52
+equ trap_TraceBatch                   -53
+equ trap_PointLeafnum                 -54
+equ trap_LeafsInPVS                   -55
 
 equ memset                            -101
 equ memcpy                            -102
@@ -186,6 +186,17 @@ void trap_TraceCapsule( trace_t *results, const vec3_t start, const vec3_t mins,
   syscall( G_TRACECAPSULE, results, start, mins, maxs, end, passEntityNum, contentmask );
 }
 
+void trap_TraceBatch( trace_t *results, const traceRequest_t *requests, int numRequests )
+{
+  int i, count;
+
+  for( i = 0; i < numRequests; i += count )
+  {
+    count = MIN( numRequests - i, MAX_TRACE_BATCH );
+    syscall( G_TRACE_BATCH, results + i, requests + i, count );
+  }
+}
+
 int trap_PointContents( const vec3_t point, int passEntityNum )
 {
   return syscall( G_POINT_CONTENTS, point, passEntityNum );
@@ -202,6 +213,16 @@ qboolean trap_InPVSIgnorePortals( const vec3_t p1, const vec3_t p2 )
   return syscall( G_IN_PVS_IGNORE_PORTALS, p1, p2 );
 }
 
+int trap_PointLeafnum( const vec3_t point )
+{
+  return syscall( G_POINT_LEAFNUM, point );
+}
+
+qboolean trap_LeafsInPVS( int leaf1, int leaf2, qboolean ignorePortals )
+{
+  return syscall( G_LEAFS_IN_PVS, leaf1, leaf2, ignorePortals );
+}
+
 void trap_AdjustAreaPortalState( gentity_t *ent, qboolean open )
 {
   syscall( G_ADJUST_AREA_PORTAL_STATE, ent, open );
@@ -332,6 +332,9 @@ void SP_target_location( gentity_t *self )
   n++;
 
   G_SetOrigin( self, self->r.currentOrigin );
+
+  // locations never move, so Team_GetLocation can skip finding their leafs
+  self->pvsLeaf = trap_PointLeafnum( self->r.currentOrigin );
 }
 
 
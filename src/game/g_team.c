@@ -258,9 +258,11 @@ gentity_t *Team_GetLocation( gentity_t *ent )
 {
   gentity_t   *eloc, *best;
   float       bestlen, len;
+  int         leaf;
 
   best = NULL;
   bestlen = 3.0f * 8192.0f * 8192.0f;
+  leaf = trap_PointLeafnum( ent->r.currentOrigin );
 
   for( eloc = level.locationHead; eloc; eloc = eloc->nextTrain )
   {
@@ -269,7 +271,7 @@ gentity_t *Team_GetLocation( gentity_t *ent )
     if( len > bestlen )
       continue;
 
-    if( !trap_InPVS( ent->r.currentOrigin, eloc->r.currentOrigin ) )
+    if( !trap_LeafsInPVS( leaf, eloc->pvsLeaf, qfalse ) )
       continue;
 
     bestlen = len;
@@ -931,6 +931,35 @@ qboolean G_Visible( gentity_t *ent1, gentity_t *ent2, int contents )
   return trace.fraction >= 1.0f || trace.entityNum == ent2 - g_entities;
 }
 
+/*
+===============
+G_TraceRequest
+
+Fill in one entry of a trap_TraceBatch request, NULL mins/maxs are a point
+===============
+*/
+void G_TraceRequest( traceRequest_t *req, const vec3_t start, const vec3_t mins,
+                     const vec3_t maxs, const vec3_t end, int passEntityNum,
+                     int contentmask )
+{
+  VectorCopy( start, req->start );
+  VectorCopy( end, req->end );
+
+  if( mins )
+    VectorCopy( mins, req->mins );
+  else
+    VectorClear( req->mins );
+
+  if( maxs )
+    VectorCopy( maxs, req->maxs );
+  else
+    VectorClear( req->maxs );
+
+  req->passEntityNum = passEntityNum;
+  req->contentmask = contentmask;
+  req->type = TT_AABB;
+}
+
 /*
 ===============
 G_ClosestEnt
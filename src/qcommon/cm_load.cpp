@@ -24,8 +24,12 @@ along with Tremulous; if not, see <https://www.gnu.org/licenses/>
 // cmodel.c -- model loading
 
 #include "cm_local.h"
+#include "cm_patch.h"
 #include "files.h"
 #include "md4.h"
+#ifndef BSPC
+#include "scratch.h"
+#endif
 
 #ifdef BSPC
 
@@ -48,16 +52,14 @@ void SetPlaneSignbits (cplane_t *out) {
 // to allow boxes to be treated as brush models, we allocate
 // some extra indexes along with those needed by the map
 #define	BOX_BRUSHES		1
-#define	BOX_SIDES		6
 #define	BOX_LEAFS		2
-#define	BOX_PLANES		12
 
 #define	LL(x) x=LittleLong(x)
 
 
 clipMap_t	cm;
-int			c_pointcontents;
-int			c_traces, c_brush_traces, c_patch_traces;
+std::atomic<int>	c_pointcontents;
+std::atomic<int>	c_traces, c_brush_traces, c_patch_traces;
 
 
 byte		*cmod_base;
@@ -66,12 +68,20 @@ byte		*cmod_base;
 cvar_t		*cm_noAreas;
 cvar_t		*cm_noCurves;
 cvar_t		*cm_playerCurveClip;
+cvar_t		*cm_debugSurfaceUpdate;
+cvar_t		*cm_collisionCache;
 #endif
 
-cmodel_t	box_model;
-cplane_t	*box_planes;
-cbrush_t	*box_brush;
+// bumped whenever cm is cleared, so the thread contexts know to resize
+static int	cm_mapLoads;
+
+struct traceContextHolder_t {
+	traceContext_t	tc;
 
+	~traceContextHolder_t() { free( tc.brushChecks ); }
+};
+
+static thread_local traceContextHolder_t cm_traceContext;
 
 
 void	CM_InitBoxHull (void);
@@ -238,6 +248,8 @@ void CMod_LoadBrushes( lump_t *l ) {
 	dbrush_t	*in;
 	cbrush_t	*out;
 	int			count;
+	float		*sidePlanes;
+	int			numSidePlanes = 0;
 
 	in = (dbrush_t *)(cmod_base + l->fileofs);
 	if (l->filelen % sizeof(*in)) {
@@ -245,7 +257,7 @@ void CMod_LoadBrushes( lump_t *l ) {
 	}
 	count = l->filelen / sizeof(*in);
 
-	cm.brushes = (cbrush_t*)Hunk_Alloc( ( BOX_BRUSHES + count ) * sizeof( *cm.brushes ), h_high );
+	cm.brushes = (cbrush_t*)Hunk_Alloc( count * sizeof( *cm.brushes ), h_high );
 	cm.numBrushes = count;
 
 	out = cm.brushes;
@@ -261,8 +273,27 @@ void CMod_LoadBrushes( lump_t *l ) {
 		out->contents = cm.shaders[out->shaderNum].contentFlags;
 
 		CM_BoundBrush( out );
+		numSidePlanes += 4 * CM_SIDE_STRIDE( out->numsides );
 	}
 
+	// pack the side planes of every brush for the brush side kernels
+	sidePlanes = (float*)Hunk_Alloc( numSidePlanes * sizeof( *sidePlanes ), h_high );
+
+	out = cm.brushes;
+	for ( int i = 0 ; i<count ; i++, out++ ) {
+		int stride = CM_SIDE_STRIDE( out->numsides );
+
+		out->sidePlanes = sidePlanes;
+		for ( int j = 0 ; j<out->numsides ; j++ ) {
+			cplane_t *plane = out->sides[j].plane;
+
+			sidePlanes[j] = plane->normal[0];
+			sidePlanes[stride + j] = plane->normal[1];
+			sidePlanes[stride * 2 + j] = plane->normal[2];
+			sidePlanes[stride * 3 + j] = plane->dist;
+		}
+		sidePlanes += 4 * stride;
+	}
 }
 
 /*
@@ -305,6 +336,7 @@ void CMod_LoadLeafs (lump_t *l)
 
 	cm.areas = (cArea_t*)Hunk_Alloc( cm.numAreas * sizeof( *cm.areas ), h_high );
 	cm.areaPortals = (int*)Hunk_Alloc( cm.numAreas * cm.numAreas * sizeof( *cm.areaPortals ), h_high );
+	cm.floodAreaBits = (byte*)Hunk_Alloc( cm.numAreas * ( ( cm.numAreas + 7 ) >> 3 ), h_high );
 }
 
 /*
@@ -326,7 +358,7 @@ void CMod_LoadPlanes (lump_t *l)
 
 	if (count < 1)
 		Com_Error (ERR_DROP, "Map with no planes");
-	cm.planes = (cplane_t*)Hunk_Alloc( ( BOX_PLANES + count ) * sizeof( *cm.planes ), h_high );
+	cm.planes = (cplane_t*)Hunk_Alloc( count * sizeof( *cm.planes ), h_high );
 	cm.numPlanes = count;
 
 	out = cm.planes;	
@@ -420,7 +452,7 @@ void CMod_LoadBrushSides (lump_t *l)
 	}
 	count = l->filelen / sizeof(*in);
 
-	cm.brushsides = (cbrushside_t*)Hunk_Alloc( ( BOX_SIDES + count ) * sizeof( *cm.brushsides ), h_high );
+	cm.brushsides = (cbrushside_t*)Hunk_Alloc( count * sizeof( *cm.brushsides ), h_high );
 	cm.numBrushSides = count;
 
 	out = cm.brushsides;	
@@ -686,6 +718,353 @@ void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
 
 //==================================================================
 
+#ifndef BSPC
+
+/*
+===============================================================================
+
+COLLISION CACHE
+
+The patch facets and brush edges only depend on the bsp, but generating them
+is most of CM_LoadMap on a map with lots of curves.  They are saved to
+collision/<map>.cmc under the home path along with the checksum of the whole
+bsp, and read straight back into the hunk the next time the map loads.  The
+arrays are written as they are in memory, so a cache from a build with
+different struct layouts or byte order simply fails to match and is rebuilt.
+
+===============================================================================
+*/
+
+#define	CM_CACHE_IDENT		(('1'<<24)+('C'<<16)+('M'<<8)+'C')
+		// little-endian "CMC1"
+#define	CM_CACHE_VERSION	1
+
+typedef struct {
+	int			ident;
+	int			version;
+	unsigned	checksum;		// of the whole bsp file
+	int			planeSize;		// sizeof the structs in the data
+	int			facetSize;
+	int			edgeSize;
+	int			numSurfaces;
+	int			numBrushes;
+	int			numPatches;
+	int			numPlanes;		// totals of all the patches and brushes
+	int			numFacets;
+	int			numEdges;
+} cacheHeader_t;
+
+typedef struct {
+	int			surfaceNum;
+	vec3_t		bounds[2];
+	int			numPlanes;
+	int			numFacets;
+} cachePatch_t;
+
+// the header is followed by cachePatch_t[numPatches], the edge count of every
+// brush, and then the patchPlane_t, facet_t and cbrushedge_t arrays in order
+
+/*
+=================
+CM_CollisionCachePath
+=================
+*/
+static void CM_CollisionCachePath( const char *name, char *path, int size ) {
+	char	base[MAX_QPATH];
+
+	COM_StripExtension( COM_SkipPath( (char *)name ), base, sizeof( base ) );
+	Com_sprintf( path, size, "collision/%s.cmc", base );
+}
+
+/*
+=================
+CM_CheckCachedFacets
+
+The facets index the planes of their own patch during traces, so every
+index has to be in range before the cache can be trusted.
+=================
+*/
+static bool CM_CheckCachedFacets( const cachePatch_t *patches, int numPatches,
+	const patchPlane_t *planes, const facet_t *facets ) {
+	const facet_t	*facet;
+	int				i, j, k;
+
+	for ( i = 0 ; i < numPatches ; i++ ) {
+		for ( j = 0 ; j < patches[i].numPlanes ; j++ ) {
+			if ( planes[j].signbits < 0 || planes[j].signbits > 7 ) {
+				return false;
+			}
+		}
+
+		for ( j = 0, facet = facets ; j < patches[i].numFacets ; j++, facet++ ) {
+			if ( facet->surfacePlane < 0 || facet->surfacePlane >= patches[i].numPlanes
+				|| facet->numBorders < 0 || facet->numBorders > (int)ARRAY_LEN( facet->borderPlanes ) ) {
+				return false;
+			}
+			for ( k = 0 ; k < facet->numBorders ; k++ ) {
+				if ( facet->borderPlanes[k] < 0 || facet->borderPlanes[k] >= patches[i].numPlanes ) {
+					return false;
+				}
+			}
+		}
+
+		planes += patches[i].numPlanes;
+		facets += patches[i].numFacets;
+	}
+
+	return true;
+}
+
+/*
+=================
+CM_LoadCollisionCache
+
+Does the work of CMod_LoadPatches and CMod_CreateBrushSideWindings from
+the cache.  Returns false without touching cm if it doesn't match the map.
+=================
+*/
+static bool CM_LoadCollisionCache( const char *name, unsigned checksum, lump_t *surfs ) {
+	char			path[MAX_QPATH];
+	fileHandle_t	f;
+	long			length;
+	cacheHeader_t	header;
+	cachePatch_t	*patches;
+	int				*edgeCounts;
+	dsurface_t		*in;
+	int				numSurfaces;
+	int				i, j;
+	int				numPatches, numPlanes, numFacets, numEdges;
+	int64_t			size;
+	byte			*data;
+	patchPlane_t	*planes;
+	facet_t			*facets;
+	cbrushedge_t	*edges;
+	patchCollide_t	*pc;
+	cPatch_t		*patch;
+	int				shaderNum;
+	int				mark;
+	bool			valid;
+
+	if ( !cm_collisionCache->integer || surfs->filelen % sizeof( *in ) ) {
+		return false;
+	}
+
+	CM_CollisionCachePath( name, path, sizeof( path ) );
+	length = FS_SV_FOpenFileRead( path, &f );
+	if ( !f ) {
+		return false;
+	}
+
+	in = (dsurface_t *)(cmod_base + surfs->fileofs);
+	numSurfaces = surfs->filelen / sizeof( *in );
+
+	if ( length < (long)sizeof( header ) || FS_Read( &header, sizeof( header ), f ) != sizeof( header )
+		|| header.ident != CM_CACHE_IDENT || header.version != CM_CACHE_VERSION
+		|| header.checksum != checksum
+		|| header.planeSize != sizeof( patchPlane_t ) || header.facetSize != sizeof( facet_t )
+		|| header.edgeSize != sizeof( cbrushedge_t )
+		|| header.numSurfaces != numSurfaces || header.numBrushes != cm.numBrushes
+		|| header.numPatches < 0 || header.numPatches > numSurfaces
+		|| header.numPlanes < 0 || header.numFacets < 0 || header.numEdges < 0 ) {
+		FS_FCloseFile( f );
+		Com_DPrintf( "Collision cache %s is out of date\n", path );
+		return false;
+	}
+
+	size = (int64_t)header.numPlanes * sizeof( patchPlane_t )
+		+ (int64_t)header.numFacets * sizeof( facet_t )
+		+ (int64_t)header.numEdges * sizeof( cbrushedge_t );
+	if ( (int64_t)length != (int64_t)sizeof( header ) + header.numPatches * sizeof( cachePatch_t )
+		+ header.numBrushes * sizeof( int ) + size ) {
+		FS_FCloseFile( f );
+		Com_DPrintf( "Collision cache %s is truncated\n", path );
+		return false;
+	}
+
+	patches = (cachePatch_t *)Z_Malloc( header.numPatches * sizeof( *patches ) + header.numBrushes * sizeof( int ) );
+	edgeCounts = (int *)( patches + header.numPatches );
+	valid = FS_Read( patches, header.numPatches * sizeof( *patches ), f ) == (int)( header.numPatches * sizeof( *patches ) )
+		&& FS_Read( edgeCounts, header.numBrushes * sizeof( int ), f ) == (int)( header.numBrushes * sizeof( int ) );
+
+	// every patch surface of the map needs exactly one record, in order
+	numPatches = numPlanes = numFacets = numEdges = 0;
+	for ( i = 0 ; i < numSurfaces && valid ; i++ ) {
+		if ( LittleLong( in[i].surfaceType ) != MST_PATCH ) {
+			continue;
+		}
+		// checked against what is left of the totals, so the sums can't wrap
+		if ( numPatches == header.numPatches || patches[numPatches].surfaceNum != i
+			|| patches[numPatches].numPlanes < 0 || patches[numPatches].numPlanes > header.numPlanes - numPlanes
+			|| patches[numPatches].numFacets < 0 || patches[numPatches].numFacets > header.numFacets - numFacets ) {
+			valid = false;
+			break;
+		}
+		numPlanes += patches[numPatches].numPlanes;
+		numFacets += patches[numPatches].numFacets;
+		numPatches++;
+	}
+	for ( i = 0 ; i < header.numBrushes && valid ; i++ ) {
+		if ( edgeCounts[i] < 0 || edgeCounts[i] > header.numEdges - numEdges ) {
+			valid = false;
+			break;
+		}
+		numEdges += edgeCounts[i];
+	}
+	if ( !valid || numPatches != header.numPatches || numPlanes != header.numPlanes
+		|| numFacets != header.numFacets || numEdges != header.numEdges ) {
+		Z_Free( patches );
+		FS_FCloseFile( f );
+		Com_DPrintf( "Collision cache %s doesn't match the map\n", path );
+		return false;
+	}
+
+	// one read for all of the facet, plane and edge data, checked in
+	// scratch memory so that a bad cache leaves nothing in the hunk
+	mark = Scratch_Mark();
+	data = (byte *)Scratch_Alloc( (int)size );
+	valid = FS_Read( data, (int)size, f ) == size;
+	FS_FCloseFile( f );
+
+	planes = (patchPlane_t *)data;
+	facets = (facet_t *)( planes + header.numPlanes );
+	if ( !valid || !CM_CheckCachedFacets( patches, header.numPatches, planes, facets ) ) {
+		Scratch_Rewind( mark );
+		Z_Free( patches );
+		Com_DPrintf( "Collision cache %s is unreadable or corrupt\n", path );
+		return false;
+	}
+
+	data = (byte *)::memcpy( Hunk_Alloc( (int)size, h_high ), data, (size_t)size );
+	Scratch_Rewind( mark );
+
+	planes = (patchPlane_t *)data;
+	facets = (facet_t *)( planes + header.numPlanes );
+	edges = (cbrushedge_t *)( facets + header.numFacets );
+
+	cm.numSurfaces = numSurfaces;
+	cm.surfaces = (cPatch_t**)Hunk_Alloc( cm.numSurfaces * sizeof( cm.surfaces[0] ), h_high );
+	pc = (patchCollide_t *)Hunk_Alloc( header.numPatches * sizeof( *pc ), h_high );
+
+	for ( i = 0 ; i < header.numPatches ; i++, pc++ ) {
+		j = patches[i].surfaceNum;
+		cm.surfaces[ j ] = patch = (cPatch_t*)Hunk_Alloc( sizeof( *patch ), h_high );
+
+		shaderNum = LittleLong( in[j].shaderNum );
+		patch->contents = cm.shaders[shaderNum].contentFlags;
+		patch->surfaceFlags = cm.shaders[shaderNum].surfaceFlags;
+
+		VectorCopy( patches[i].bounds[0], pc->bounds[0] );
+		VectorCopy( patches[i].bounds[1], pc->bounds[1] );
+		pc->numPlanes = patches[i].numPlanes;
+		pc->planes = planes;
+		pc->numFacets = patches[i].numFacets;
+		pc->facets = facets;
+		planes += pc->numPlanes;
+		facets += pc->numFacets;
+
+		patch->pc = pc;
+	}
+
+	for ( i = 0 ; i < cm.numBrushes ; i++ ) {
+		cm.brushes[i].numEdges = edgeCounts[i];
+		cm.brushes[i].edges = edges;
+		edges += edgeCounts[i];
+	}
+
+	Z_Free( patches );
+
+	Com_DPrintf( "Loaded %d patches and %d brush edges from %s\n",
+		header.numPatches, header.numEdges, path );
+
+	return true;
+}
+
+/*
+=================
+CM_WriteCollisionCache
+
+Saves what CMod_LoadPatches and CMod_CreateBrushSideWindings generated
+=================
+*/
+static void CM_WriteCollisionCache( const char *name, unsigned checksum ) {
+	char			path[MAX_QPATH];
+	fileHandle_t	f;
+	cacheHeader_t	header;
+	cachePatch_t	patch;
+	patchCollide_t	*pc;
+	int				i;
+
+	if ( !cm_collisionCache->integer ) {
+		return;
+	}
+
+	::memset( &header, 0, sizeof( header ) );
+	header.ident = CM_CACHE_IDENT;
+	header.version = CM_CACHE_VERSION;
+	header.checksum = checksum;
+	header.planeSize = sizeof( patchPlane_t );
+	header.facetSize = sizeof( facet_t );
+	header.edgeSize = sizeof( cbrushedge_t );
+	header.numSurfaces = cm.numSurfaces;
+	header.numBrushes = cm.numBrushes;
+
+	for ( i = 0 ; i < cm.numSurfaces ; i++ ) {
+		if ( !cm.surfaces[i] ) {
+			continue;
+		}
+		header.numPatches++;
+		header.numPlanes += cm.surfaces[i]->pc->numPlanes;
+		header.numFacets += cm.surfaces[i]->pc->numFacets;
+	}
+	for ( i = 0 ; i < cm.numBrushes ; i++ ) {
+		header.numEdges += cm.brushes[i].numEdges;
+	}
+
+	CM_CollisionCachePath( name, path, sizeof( path ) );
+	f = FS_SV_FOpenFileWrite( path );
+	if ( !f ) {
+		Com_DPrintf( "Couldn't write collision cache %s\n", path );
+		return;
+	}
+
+	FS_Write( &header, sizeof( header ), f );
+	for ( i = 0 ; i < cm.numSurfaces ; i++ ) {
+		if ( !cm.surfaces[i] ) {
+			continue;
+		}
+		pc = cm.surfaces[i]->pc;
+		::memset( &patch, 0, sizeof( patch ) );
+		patch.surfaceNum = i;
+		VectorCopy( pc->bounds[0], patch.bounds[0] );
+		VectorCopy( pc->bounds[1], patch.bounds[1] );
+		patch.numPlanes = pc->numPlanes;
+		patch.numFacets = pc->numFacets;
+		FS_Write( &patch, sizeof( patch ), f );
+	}
+	for ( i = 0 ; i < cm.numBrushes ; i++ ) {
+		FS_Write( &cm.brushes[i].numEdges, sizeof( int ), f );
+	}
+	for ( i = 0 ; i < cm.numSurfaces ; i++ ) {
+		if ( cm.surfaces[i] ) {
+			FS_Write( cm.surfaces[i]->pc->planes, cm.surfaces[i]->pc->numPlanes * sizeof( patchPlane_t ), f );
+		}
+	}
+	for ( i = 0 ; i < cm.numSurfaces ; i++ ) {
+		if ( cm.surfaces[i] ) {
+			FS_Write( cm.surfaces[i]->pc->facets, cm.surfaces[i]->pc->numFacets * sizeof( facet_t ), f );
+		}
+	}
+	for ( i = 0 ; i < cm.numBrushes ; i++ ) {
+		FS_Write( cm.brushes[i].edges, cm.brushes[i].numEdges * sizeof( cbrushedge_t ), f );
+	}
+
+	FS_FCloseFile( f );
+}
+
+#endif
+
+//==================================================================
+
 unsigned CM_LumpChecksum(lump_t *lump) {
 	return LittleLong (Com_BlockChecksum (cmod_base + lump->fileofs, lump->filelen));
 }
@@ -721,7 +1100,11 @@ void CM_LoadMap( const char *name, bool clientload, int *checksum ) {
 	} buf;
 	dheader_t		header;
 	int				length;
+	bool			cached;
 	static unsigned	last_checksum;
+#ifndef BSPC
+	int				mark;
+#endif
 
 	if ( !name || !name[0] ) {
 		Com_Error( ERR_DROP, "CM_LoadMap: NULL name" );
@@ -731,6 +1114,8 @@ void CM_LoadMap( const char *name, bool clientload, int *checksum ) {
 	cm_noAreas = Cvar_Get ("cm_noAreas", "0", CVAR_CHEAT);
 	cm_noCurves = Cvar_Get ("cm_noCurves", "0", CVAR_CHEAT);
 	cm_playerCurveClip = Cvar_Get ("cm_playerCurveClip", "1", CVAR_ARCHIVE|CVAR_CHEAT );
+	cm_debugSurfaceUpdate = Cvar_Get ("r_debugSurfaceUpdate", "1", 0 );
+	cm_collisionCache = Cvar_Get ("cm_collisionCache", "1", CVAR_ARCHIVE );
 #endif
 	Com_DPrintf( "CM_LoadMap( %s, %i )\n", name, clientload );
 
@@ -742,6 +1127,7 @@ void CM_LoadMap( const char *name, bool clientload, int *checksum ) {
 	// free old stuff
 	::memset( &cm, 0, sizeof( cm ) );
 	CM_ClearLevelPatches();
+	cm_mapLoads++;
 
 	if ( !name[0] ) {
 		cm.numLeafs = 1;
@@ -756,7 +1142,8 @@ void CM_LoadMap( const char *name, bool clientload, int *checksum ) {
 	// load the file
 	//
 #ifndef BSPC
-	length = FS_ReadFile( name, &buf.v );
+	mark = Scratch_Mark();
+	length = FS_ReadFileScratch( name, &buf.v );
 #else
 	length = LoadQuakeFile((quakefile_t *) name, &buf.v);
 #endif
@@ -792,12 +1179,28 @@ void CM_LoadMap( const char *name, bool clientload, int *checksum ) {
 	CMod_LoadNodes (&header.lumps[LUMP_NODES]);
 	CMod_LoadEntityString (&header.lumps[LUMP_ENTITIES]);
 	CMod_LoadVisibility( &header.lumps[LUMP_VISIBILITY] );
-	CMod_LoadPatches( &header.lumps[LUMP_SURFACES], &header.lumps[LUMP_DRAWVERTS] );
+#ifndef BSPC
+	cached = CM_LoadCollisionCache( name, last_checksum, &header.lumps[LUMP_SURFACES] );
+#else
+	cached = false;
+#endif
+
+	if ( !cached ) {
+		CMod_LoadPatches( &header.lumps[LUMP_SURFACES], &header.lumps[LUMP_DRAWVERTS] );
 
-	CMod_CreateBrushSideWindings( );
+		CMod_CreateBrushSideWindings( );
 
-	// we are NOT freeing the file, because it is cached for the ref
+#ifndef BSPC
+		CM_WriteCollisionCache( name, last_checksum );
+#endif
+	}
+
+	// the lumps have all been copied out to the hunk
+#ifndef BSPC
+	Scratch_Rewind( mark );
+#else
 	FS_FreeFile (buf.v);
+#endif
 
 	CM_InitBoxHull ();
 
@@ -817,6 +1220,7 @@ CM_ClearMap
 void CM_ClearMap( void ) {
 	::memset( &cm, 0, sizeof( cm ) );
 	CM_ClearLevelPatches();
+	cm_mapLoads++;
 }
 
 /*
@@ -832,7 +1236,7 @@ cmodel_t	*CM_ClipHandleToModel( clipHandle_t handle ) {
 		return &cm.cmodels[handle];
 	}
 	if ( handle == BOX_MODEL_HANDLE ) {
-		return &box_model;
+		return &CM_ThreadTraceContext()->boxModel;
 	}
 	if ( handle < MAX_SUBMODELS ) {
 		Com_Error( ERR_DROP, "CM_ClipHandleToModel: bad handle %i < %i < %i", 
@@ -889,56 +1293,123 @@ int		CM_LeafArea( int leafnum ) {
 ===================
 CM_InitBoxHull
 
-Set up the planes and nodes so that the six floats of a bounding box
-can just be stored out and get a proper clipping hull structure.
+The temp box is referenced through a leaf brush one past the end of the
+map's brushes; each thread keeps the hull itself in its trace context.
 ===================
 */
 void CM_InitBoxHull (void)
 {
+	cm.leafbrushes[cm.numLeafBrushes] = cm.numBrushes;
+}
+
+/*
+===================
+CM_ResetTraceContext
+
+Sizes the marks for the current map and sets up the planes and sides so
+that the six floats of a bounding box can just be stored out and get a
+proper clipping hull structure.
+===================
+*/
+static void CM_ResetTraceContext( traceContext_t *tc ) {
 	int			i;
 	int			side;
 	cplane_t	*p;
 	cbrushside_t	*s;
 
-	box_planes = &cm.planes[cm.numPlanes];
+	// not the zone, this can run on any thread
+	free( tc->brushChecks );
+	tc->numBrushMarks = cm.numBrushes + BOX_BRUSHES;
+	tc->numPatchMarks = cm.numSurfaces;
+	tc->brushChecks = (int *)calloc( tc->numBrushMarks * 2 + tc->numPatchMarks, sizeof( int ) );
+	if ( !tc->brushChecks ) {
+		Com_Error( ERR_FATAL, "CM_ResetTraceContext: out of memory" );
+	}
+	tc->brushCollisions = tc->brushChecks + tc->numBrushMarks;
+	tc->patchChecks = tc->brushCollisions + tc->numBrushMarks;
+	tc->generation = 0;
+	tc->mapLoad = cm_mapLoads;
 
-	box_brush = &cm.brushes[cm.numBrushes];
-	box_brush->numsides = 6;
-	box_brush->sides = cm.brushsides + cm.numBrushSides;
-	box_brush->contents = CONTENTS_BODY;
-	box_brush->edges = (cbrushedge_t *)Hunk_Alloc(
-			sizeof( cbrushedge_t ) * 12, h_low );
-	box_brush->numEdges = 12;
+	tc->boxBrush.numsides = 6;
+	tc->boxBrush.sides = tc->boxSides;
+	tc->boxBrush.contents = CONTENTS_BODY;
+	tc->boxBrush.edges = tc->boxEdges;
+	tc->boxBrush.numEdges = 12;
+	tc->boxBrush.sidePlanes = tc->boxSidePlanes;
 
-	box_model.leaf.numLeafBrushes = 1;
-//	box_model.leaf.firstLeafBrush = cm.numBrushes;
-	box_model.leaf.firstLeafBrush = cm.numLeafBrushes;
-	cm.leafbrushes[cm.numLeafBrushes] = cm.numBrushes;
+	tc->boxModel.leaf.numLeafBrushes = 1;
+	tc->boxModel.leaf.firstLeafBrush = cm.numLeafBrushes;
 
 	for (i=0 ; i<6 ; i++)
 	{
 		side = i&1;
 
 		// brush sides
-		s = &cm.brushsides[cm.numBrushSides+i];
-		s->plane = 	cm.planes + (cm.numPlanes+i*2+side);
+		s = &tc->boxSides[i];
+		s->plane = &tc->boxPlanes[i*2+side];
 		s->surfaceFlags = 0;
 
 		// planes
-		p = &box_planes[i*2];
+		p = &tc->boxPlanes[i*2];
 		p->type = i>>1;
 		p->signbits = 0;
 		VectorClear (p->normal);
 		p->normal[i>>1] = 1;
 
-		p = &box_planes[i*2+1];
+		p = &tc->boxPlanes[i*2+1];
 		p->type = 3 + (i>>1);
 		p->signbits = 0;
 		VectorClear (p->normal);
 		p->normal[i>>1] = -1;
 
 		SetPlaneSignbits( p );
-	}	
+	}
+
+	// the dists are filled in by CM_TempBoxModel
+	::memset( tc->boxSidePlanes, 0, sizeof( tc->boxSidePlanes ) );
+	for (i=0 ; i<6 ; i++) {
+		p = tc->boxSides[i].plane;
+		tc->boxSidePlanes[i] = p->normal[0];
+		tc->boxSidePlanes[CM_SIDE_STRIDE( 6 ) + i] = p->normal[1];
+		tc->boxSidePlanes[CM_SIDE_STRIDE( 6 ) * 2 + i] = p->normal[2];
+	}
+}
+
+/*
+===================
+CM_ThreadTraceContext
+
+Returns the calling thread's context, resized if the map has changed
+since it was last used
+===================
+*/
+traceContext_t *CM_ThreadTraceContext( void ) {
+	traceContext_t	*tc = &cm_traceContext.tc;
+
+	if ( !tc->brushChecks || tc->mapLoad != cm_mapLoads ) {
+		CM_ResetTraceContext( tc );
+	}
+	return tc;
+}
+
+/*
+===================
+CM_BeginTrace
+
+Starts a new query generation, so every brush and patch counts as
+untested again
+===================
+*/
+traceContext_t *CM_BeginTrace( void ) {
+	traceContext_t	*tc = CM_ThreadTraceContext();
+
+	if ( tc->generation == INT_MAX ) {
+		::memset( tc->brushChecks, 0,
+			( tc->numBrushMarks * 2 + tc->numPatchMarks ) * sizeof( int ) );
+		tc->generation = 0;
+	}
+	tc->generation++;
+	return tc;
 }
 
 /*
@@ -951,9 +1422,12 @@ Capsules are handled differently though.
 ===================
 */
 clipHandle_t CM_TempBoxModel( const vec3_t mins, const vec3_t maxs, int capsule ) {
+	traceContext_t	*tc = CM_ThreadTraceContext();
+	cplane_t		*box_planes = tc->boxPlanes;
+	cbrush_t		*box_brush = &tc->boxBrush;
 
-	VectorCopy( mins, box_model.mins );
-	VectorCopy( maxs, box_model.maxs );
+	VectorCopy( mins, tc->boxModel.mins );
+	VectorCopy( maxs, tc->boxModel.maxs );
 
 	if ( capsule ) {
 		return CAPSULE_MODEL_HANDLE;
@@ -972,6 +1446,10 @@ clipHandle_t CM_TempBoxModel( const vec3_t mins, const vec3_t maxs, int capsule
 	box_planes[10].dist = mins[2];
 	box_planes[11].dist = -mins[2];
 
+	for ( int i = 0 ; i < 6 ; i++ ) {
+		tc->boxSidePlanes[CM_SIDE_STRIDE( 6 ) * 3 + i] = box_brush->sides[i].plane->dist;
+	}
+
 	// First side
 	VectorSet( box_brush->edges[ 0 ].p0,  mins[ 0 ], mins[ 1 ], mins[ 2 ] );
 	VectorSet( box_brush->edges[ 0 ].p1,  mins[ 0 ], maxs[ 1 ], mins[ 2 ] );
@@ -25,6 +25,8 @@ along with Tremulous; if not, see <https://www.gnu.org/licenses/>
 #ifndef CM_LOCAL_H
 #define CM_LOCAL_H 1
 
+#include <atomic>
+
 #include "cvar.h"
 #include "q_shared.h"
 #include "qcommon.h"
@@ -75,15 +77,19 @@ typedef struct {
 	vec3_t		bounds[2];
 	int			numsides;
 	cbrushside_t	*sides;
-	int			checkcount;		// to avoid repeated testings
-	bool	    collided; // marker for optimisation
 	cbrushedge_t	*edges;
 	int						numEdges;
+	float		*sidePlanes;	// normals and dists of the sides, see CM_SIDE_STRIDE
 } cbrush_t;
 
+// cbrush_t->sidePlanes holds four arrays of CM_SIDE_STRIDE( numsides ) floats:
+// normal[0], normal[1], normal[2] and dist of each side, padded with zeros so
+// the brush side kernels can always read a whole batch
+#define	CM_SIDE_BATCH			8
+#define	CM_SIDE_STRIDE(n)		( ( (n) + CM_SIDE_BATCH - 1 ) & ~( CM_SIDE_BATCH - 1 ) )
+
 
 typedef struct {
-	int			checkcount;				// to avoid repeated testings
 	int			surfaceFlags;
 	int			contents;
 	struct patchCollide_s	*pc;
@@ -136,25 +142,49 @@ typedef struct {
 	int			numAreas;
 	cArea_t		*areas;
 	int			*areaPortals;	// [ numAreas*numAreas ] reference counts
+	byte		*floodAreaBits;	// [ numAreas*areaBytes ] the areas in each flood
 
 	int			numSurfaces;
 	cPatch_t	**surfaces;			// non-patches will be NULL
 
 	int			floodvalid;
-	int			checkcount;					// incremented on each trace
 } clipMap_t;
 
+// Everything a collision query writes lives here rather than in clipMap_t,
+// so traces on different threads never touch the same memory.  Each thread
+// owns one context; the marks are stamped with the query generation instead
+// of being cleared, and are resized whenever a new map is loaded.
+typedef struct {
+	int			generation;			// bumped by every query
+	int			mapLoad;			// map the marks were sized for
+
+	int			numBrushMarks;
+	int			*brushChecks;		// generation a brush was last tested in
+	int			*brushCollisions;	// generation a brush last crossed a plane in
+	int			numPatchMarks;
+	int			*patchChecks;		// generation a patch was last tested in
+
+	// CM_TempBoxModel hull, see CM_LeafBrush
+	cmodel_t		boxModel;
+	cbrush_t		boxBrush;
+	cbrushside_t	boxSides[6];
+	cplane_t		boxPlanes[12];
+	cbrushedge_t	boxEdges[12];
+	float			boxSidePlanes[4 * CM_SIDE_STRIDE( 6 )];
+} traceContext_t;
+
 
 // keep 1/8 unit away to keep the position valid before network snapping
 // and to avoid various numeric issues
 #define	SURFACE_CLIP_EPSILON	(0.125)
 
 extern	clipMap_t	cm;
-extern	int			c_pointcontents;
-extern	int			c_traces, c_brush_traces, c_patch_traces;
+extern	std::atomic<int>	c_pointcontents;
+extern	std::atomic<int>	c_traces, c_brush_traces, c_patch_traces;
 extern	cvar_t		*cm_noAreas;
 extern	cvar_t		*cm_noCurves;
 extern	cvar_t		*cm_playerCurveClip;
+extern	cvar_t		*cm_debugSurfaceUpdate;
 
 // cm_test.c
 
@@ -188,6 +218,10 @@ typedef struct {
 	sphere_t		sphere;		// sphere for oriendted capsule collision
 	biSphere_t	biSphere;
 	bool		testLateralCollision; // whether or not to test for lateral collision
+	bool		collided;	// last CM_TraceThroughBrush crossed a plane
+	int			brushTraces;	// statistics, added to c_brush_traces
+	int			patchTraces;	// statistics, added to c_patch_traces
+	traceContext_t	*context;
 } traceWork_t;
 
 typedef struct leafList_s {
@@ -198,6 +232,7 @@ typedef struct leafList_s {
 	vec3_t	bounds[2];
 	int		lastLeaf;		// for overflows where each leaf can't be stored individually
 	void	(*storeLeafs)( struct leafList_s *ll, int nodenum );
+	traceContext_t	*context;	// only needed by CM_StoreBrushes
 } leafList_t;
 
 
@@ -209,9 +244,26 @@ void CM_StoreBrushes( leafList_t *ll, int nodenum );
 void CM_BoxLeafnums_r( leafList_t *ll, int nodenum );
 
 cmodel_t	*CM_ClipHandleToModel( clipHandle_t handle );
+traceContext_t	*CM_ThreadTraceContext( void );
+traceContext_t	*CM_BeginTrace( void );
 bool CM_BoundsIntersect( const vec3_t mins, const vec3_t maxs, const vec3_t mins2, const vec3_t maxs2 );
 bool CM_BoundsIntersectPoint( const vec3_t mins, const vec3_t maxs, const vec3_t point );
 
+/*
+==================
+CM_LeafBrush
+
+Leaf brush numbers index cm.brushes, except for the one past the end,
+which is the temp box of the calling thread
+==================
+*/
+static ID_INLINE cbrush_t *CM_LeafBrush( traceContext_t *tc, int brushnum ) {
+	if ( brushnum == cm.numBrushes ) {
+		return &tc->boxBrush;
+	}
+	return &cm.brushes[brushnum];
+}
+
 // cm_patch.c
 
 struct patchCollide_s	*CM_GeneratePatchCollide( int width, int height, vec3_t *points );
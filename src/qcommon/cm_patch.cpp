@@ -86,8 +86,9 @@ int	c_totalPatchBlocks;
 int	c_totalPatchSurfaces;
 int	c_totalPatchEdges;
 
-static const patchCollide_t	*debugPatchCollide;
-static const facet_t		*debugFacet;
+// written by whichever trace last hit a facet, so any thread may store them
+static std::atomic<const patchCollide_t *>	debugPatchCollide;
+static std::atomic<const facet_t *>		debugFacet;
 static bool		debugBlock;
 static vec3_t		debugBlockPoints[4];
 
@@ -1267,9 +1268,6 @@ void CM_TracePointThroughPatchCollide( traceWork_t *tw, const struct patchCollid
 	int			i, j, k;
 	float		offset;
 	float		d1, d2;
-#ifndef BSPC
-	static cvar_t *cv;
-#endif //BSPC
 
 #ifndef BSPC
 	if ( !cm_playerCurveClip->integer || !tw->isPoint ) {
@@ -1327,12 +1325,9 @@ void CM_TracePointThroughPatchCollide( traceWork_t *tw, const struct patchCollid
 		if ( j == facet->numBorders ) {
 			// we hit this facet
 #ifndef BSPC
-			if (!cv) {
-				cv = Cvar_Get( "r_debugSurfaceUpdate", "1", 0 );
-			}
-			if (cv->integer) {
-				debugPatchCollide = pc;
-				debugFacet = facet;
+			if (cm_debugSurfaceUpdate->integer) {
+				debugPatchCollide.store( pc, std::memory_order_relaxed );
+				debugFacet.store( facet, std::memory_order_relaxed );
 			}
 #endif //BSPC
 			planes = &pc->planes[facet->surfacePlane];
@@ -1411,9 +1406,6 @@ void CM_TraceThroughPatchCollide( traceWork_t *tw, const struct patchCollide_s *
 	facet_t	*facet;
 	float plane[4] = {0, 0, 0, 0}, bestplane[4] = {0, 0, 0, 0};
 	vec3_t startp, endp;
-#ifndef BSPC
-	static cvar_t *cv;
-#endif //BSPC
 
 	if ( !CM_BoundsIntersect( tw->bounds[0], tw->bounds[1],
 				pc->bounds[0], pc->bounds[1] ) ) {
@@ -1514,12 +1506,9 @@ void CM_TraceThroughPatchCollide( traceWork_t *tw, const struct patchCollide_s *
 					enterFrac = 0;
 				}
 #ifndef BSPC
-				if (!cv) {
-					cv = Cvar_Get( "r_debugSurfaceUpdate", "1", 0 );
-				}
-				if (cv && cv->integer) {
-					debugPatchCollide = pc;
-					debugFacet = facet;
+				if (cm_debugSurfaceUpdate->integer) {
+					debugPatchCollide.store( pc, std::memory_order_relaxed );
+					debugFacet.store( facet, std::memory_order_relaxed );
 				}
 #endif //BSPC
 
@@ -73,6 +73,22 @@ bool	CM_AreasConnected( int area1, int area2 );
 
 int			CM_WriteAreaBits( byte *buffer, int area );
 
+// cm_trace.c
+// brush side kernels for box traces, Com_DetectSSE tells which ones the
+// processor supports and com_simd picks one; they all give bit identical results
+typedef enum {
+	CMK_SCALAR,
+	CMK_SSE,
+	CMK_AVX,
+
+	CMK_NUM_KERNELS
+} cmKernel_t;
+
+void		CM_InitKernels( cmKernel_t supported );
+cmKernel_t	CM_SetKernel( cmKernel_t kernel );
+void		CM_KernelCheck_f( void );
+void		CM_ThreadCheck_f( void );
+
 // cm_patch.c
 void CM_DrawDebugSurface( void (*drawPoly)(int color, int numPoints, float *points) );
 
@@ -95,6 +95,7 @@ void CM_StoreBrushes( leafList_t *ll, int nodenum ) {
 	int			brushnum;
 	cLeaf_t		*leaf;
 	cbrush_t	*b;
+	traceContext_t	*tc = ll->context;
 
 	leafnum = -1 - nodenum;
 
@@ -102,11 +103,11 @@ void CM_StoreBrushes( leafList_t *ll, int nodenum ) {
 
 	for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
-		b = &cm.brushes[brushnum];
-		if ( b->checkcount == cm.checkcount ) {
+		if ( tc->brushChecks[brushnum] == tc->generation ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		tc->brushChecks[brushnum] = tc->generation;
+		b = &cm.brushes[brushnum];
 		for ( i = 0 ; i < 3 ; i++ ) {
 			if ( b->bounds[0][i] >= ll->bounds[1][i] || b->bounds[1][i] <= ll->bounds[0][i] ) {
 				break;
@@ -174,8 +175,6 @@ CM_BoxLeafnums
 int	CM_BoxLeafnums( const vec3_t mins, const vec3_t maxs, int *list, int listsize, int *lastLeaf) {
 	leafList_t	ll;
 
-	cm.checkcount++;
-
 	VectorCopy( mins, ll.bounds[0] );
 	VectorCopy( maxs, ll.bounds[1] );
 	ll.count = 0;
@@ -184,6 +183,7 @@ int	CM_BoxLeafnums( const vec3_t mins, const vec3_t maxs, int *list, int listsiz
 	ll.storeLeafs = CM_StoreLeafs;
 	ll.lastLeaf = 0;
 	ll.overflowed = false;
+	ll.context = NULL;
 
 	CM_BoxLeafnums_r( &ll, 0 );
 
@@ -199,8 +199,6 @@ CM_BoxBrushes
 int CM_BoxBrushes( const vec3_t mins, const vec3_t maxs, cbrush_t **list, int listsize ) {
 	leafList_t	ll;
 
-	cm.checkcount++;
-
 	VectorCopy( mins, ll.bounds[0] );
 	VectorCopy( maxs, ll.bounds[1] );
 	ll.count = 0;
@@ -209,6 +207,7 @@ int CM_BoxBrushes( const vec3_t mins, const vec3_t maxs, cbrush_t **list, int li
 	ll.storeLeafs = CM_StoreBrushes;
 	ll.lastLeaf = 0;
 	ll.overflowed = false;
+	ll.context = CM_BeginTrace();
 	
 	CM_BoxLeafnums_r( &ll, 0 );
 
@@ -234,11 +233,14 @@ int CM_PointContents( const vec3_t p, clipHandle_t model ) {
 	int			contents;
 	float		d;
 	cmodel_t	*clipm;
+	traceContext_t	*tc;
 
 	if (!cm.numNodes) {	// map not loaded
 		return 0;
 	}
 
+	tc = CM_ThreadTraceContext();
+
 	if ( model ) {
 		clipm = CM_ClipHandleToModel( model );
 		leaf = &clipm->leaf;
@@ -253,7 +255,7 @@ int CM_PointContents( const vec3_t p, clipHandle_t model ) {
 	contents = 0;
 	for (k=0 ; k<leaf->numLeafBrushes ; k++) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
-		b = &cm.brushes[brushnum];
+		b = CM_LeafBrush( tc, brushnum );
 
 		if ( !CM_BoundsIntersectPoint( b->bounds[0], b->bounds[1], p ) ) {
 			continue;
@@ -363,12 +365,16 @@ void CM_FloodArea_r( int areaNum, int floodnum) {
 ====================
 CM_FloodAreaConnections
 
+Also rebuilds the area bits of every flood, so CM_WriteAreaBits only has to
+copy them until the next portal change
 ====================
 */
 void	CM_FloodAreaConnections( void ) {
 	int		i;
 	cArea_t	*area;
 	int		floodnum;
+	int		bytes;
+	byte	*bits;
 
 	// all current floods are now invalid
 	cm.floodvalid++;
@@ -383,6 +389,12 @@ void	CM_FloodAreaConnections( void ) {
 		CM_FloodArea_r (i, floodnum);
 	}
 
+	bytes = (cm.numAreas+7)>>3;
+	::memset (cm.floodAreaBits, 0, floodnum * bytes);
+	for (i = 0 ; i < cm.numAreas ; i++) {
+		bits = cm.floodAreaBits + (cm.areas[i].floodnum - 1) * bytes;
+		bits[i>>3] |= 1<<(i&7);
+	}
 }
 
 /*
@@ -459,8 +471,8 @@ This is used to cull non-visible entities from snapshots
 int CM_WriteAreaBits (byte *buffer, int area)
 {
 	int		i;
-	int		floodnum;
 	int		bytes;
+	byte	*bits;
 
 	bytes = (cm.numAreas+7)>>3;
 
@@ -474,11 +486,10 @@ int CM_WriteAreaBits (byte *buffer, int area)
 	}
 	else
 	{
-		floodnum = cm.areas[area].floodnum;
-		for (i=0 ; i<cm.numAreas ; i++)
+		bits = cm.floodAreaBits + (cm.areas[area].floodnum - 1) * bytes;
+		for (i=0 ; i<bytes ; i++)
 		{
-			if (cm.areas[i].floodnum == floodnum || area == -1)
-				buffer[i>>3] |= 1<<(i&7);
+			buffer[i] |= bits[i];
 		}
 	}
 
@@ -23,6 +23,12 @@ along with Tremulous; if not, see <https://www.gnu.org/licenses/>
 */
 
 #include "cm_local.h"
+#include "cmd.h"
+#include "jobs.h"
+
+#if idx64
+#include <immintrin.h>
+#endif
 
 // always use bbox vs. bbox collision and never capsule vs. bbox or vice versa
 //#define ALWAYS_BBOX_VS_BBOX
@@ -148,6 +154,391 @@ float SquareRootFloat(float number) {
 }
 
 
+/*
+===============================================================================
+
+BRUSH SIDE KERNELS
+
+For box traces the distance of the start and end points from each side of a
+brush only depends on the side's plane and the size of the box, so it is
+worked out for CM_SIDE_BATCH sides at a time from cbrush_t->sidePlanes.  All
+kernels evaluate the same expression in the same order as the original
+per-plane loop, so they give bit identical results and client prediction
+can't drift from the server whichever one a machine picks.
+
+===============================================================================
+*/
+
+typedef void (*sideDistFunc_t)( const float *planes, int stride, const vec3_t size[2],
+	const vec3_t start, const vec3_t end, float *d1, float *d2 );
+
+/*
+================
+CM_SideDistances_Scalar
+
+d2 may be NULL for position tests
+================
+*/
+static void CM_SideDistances_Scalar( const float *planes, int stride, const vec3_t size[2],
+	const vec3_t start, const vec3_t end, float *d1, float *d2 ) {
+	int		i;
+	vec3_t	normal, offset;
+	float	dist;
+
+	for ( i = 0 ; i < CM_SIDE_BATCH ; i++ ) {
+		normal[0] = planes[i];
+		normal[1] = planes[stride + i];
+		normal[2] = planes[stride * 2 + i];
+
+		// same corner as tw->offsets[ plane->signbits ]
+		offset[0] = size[normal[0] < 0][0];
+		offset[1] = size[normal[1] < 0][1];
+		offset[2] = size[normal[2] < 0][2];
+
+		// adjust the plane distance apropriately for mins/maxs
+		dist = planes[stride * 3 + i] - DotProduct( offset, normal );
+
+		d1[i] = DotProduct( start, normal ) - dist;
+		if ( d2 ) {
+			d2[i] = DotProduct( end, normal ) - dist;
+		}
+	}
+}
+
+#if idx64
+/*
+================
+CM_SideDistances_SSE
+================
+*/
+static void CM_SideDistances_SSE( const float *planes, int stride, const vec3_t size[2],
+	const vec3_t start, const vec3_t end, float *d1, float *d2 ) {
+	const __m128	zero = _mm_setzero_ps();
+	__m128			nx, ny, nz, neg, ox, oy, oz, dist;
+	int				i;
+
+	for ( i = 0 ; i < CM_SIDE_BATCH ; i += 4 ) {
+		nx = _mm_loadu_ps( planes + i );
+		ny = _mm_loadu_ps( planes + stride + i );
+		nz = _mm_loadu_ps( planes + stride * 2 + i );
+
+		neg = _mm_cmplt_ps( nx, zero );
+		ox = _mm_or_ps( _mm_and_ps( neg, _mm_set1_ps( size[1][0] ) ),
+			_mm_andnot_ps( neg, _mm_set1_ps( size[0][0] ) ) );
+		neg = _mm_cmplt_ps( ny, zero );
+		oy = _mm_or_ps( _mm_and_ps( neg, _mm_set1_ps( size[1][1] ) ),
+			_mm_andnot_ps( neg, _mm_set1_ps( size[0][1] ) ) );
+		neg = _mm_cmplt_ps( nz, zero );
+		oz = _mm_or_ps( _mm_and_ps( neg, _mm_set1_ps( size[1][2] ) ),
+			_mm_andnot_ps( neg, _mm_set1_ps( size[0][2] ) ) );
+
+		dist = _mm_sub_ps( _mm_loadu_ps( planes + stride * 3 + i ),
+			_mm_add_ps( _mm_add_ps( _mm_mul_ps( ox, nx ), _mm_mul_ps( oy, ny ) ), _mm_mul_ps( oz, nz ) ) );
+
+		_mm_storeu_ps( d1 + i, _mm_sub_ps( _mm_add_ps( _mm_add_ps(
+			_mm_mul_ps( _mm_set1_ps( start[0] ), nx ), _mm_mul_ps( _mm_set1_ps( start[1] ), ny ) ),
+			_mm_mul_ps( _mm_set1_ps( start[2] ), nz ) ), dist ) );
+		if ( d2 ) {
+			_mm_storeu_ps( d2 + i, _mm_sub_ps( _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( _mm_set1_ps( end[0] ), nx ), _mm_mul_ps( _mm_set1_ps( end[1] ), ny ) ),
+				_mm_mul_ps( _mm_set1_ps( end[2] ), nz ) ), dist ) );
+		}
+	}
+}
+
+#if defined( __GNUC__ )
+/*
+================
+CM_SideDistances_AVX
+================
+*/
+__attribute__(( target( "avx" ) ))
+static void CM_SideDistances_AVX( const float *planes, int stride, const vec3_t size[2],
+	const vec3_t start, const vec3_t end, float *d1, float *d2 ) {
+	const __m256	zero = _mm256_setzero_ps();
+	__m256			nx, ny, nz, ox, oy, oz, dist;
+
+	nx = _mm256_loadu_ps( planes );
+	ny = _mm256_loadu_ps( planes + stride );
+	nz = _mm256_loadu_ps( planes + stride * 2 );
+
+	ox = _mm256_blendv_ps( _mm256_set1_ps( size[0][0] ), _mm256_set1_ps( size[1][0] ),
+		_mm256_cmp_ps( nx, zero, _CMP_LT_OQ ) );
+	oy = _mm256_blendv_ps( _mm256_set1_ps( size[0][1] ), _mm256_set1_ps( size[1][1] ),
+		_mm256_cmp_ps( ny, zero, _CMP_LT_OQ ) );
+	oz = _mm256_blendv_ps( _mm256_set1_ps( size[0][2] ), _mm256_set1_ps( size[1][2] ),
+		_mm256_cmp_ps( nz, zero, _CMP_LT_OQ ) );
+
+	dist = _mm256_sub_ps( _mm256_loadu_ps( planes + stride * 3 ),
+		_mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( ox, nx ), _mm256_mul_ps( oy, ny ) ), _mm256_mul_ps( oz, nz ) ) );
+
+	_mm256_storeu_ps( d1, _mm256_sub_ps( _mm256_add_ps( _mm256_add_ps(
+		_mm256_mul_ps( _mm256_set1_ps( start[0] ), nx ), _mm256_mul_ps( _mm256_set1_ps( start[1] ), ny ) ),
+		_mm256_mul_ps( _mm256_set1_ps( start[2] ), nz ) ), dist ) );
+	if ( d2 ) {
+		_mm256_storeu_ps( d2, _mm256_sub_ps( _mm256_add_ps( _mm256_add_ps(
+			_mm256_mul_ps( _mm256_set1_ps( end[0] ), nx ), _mm256_mul_ps( _mm256_set1_ps( end[1] ), ny ) ),
+			_mm256_mul_ps( _mm256_set1_ps( end[2] ), nz ) ), dist ) );
+	}
+}
+#endif
+#endif
+
+static const struct {
+	const char		*name;
+	sideDistFunc_t	func;
+} cm_kernels[CMK_NUM_KERNELS] = {
+	{ "scalar", CM_SideDistances_Scalar },
+#if idx64
+	{ "SSE", CM_SideDistances_SSE },
+#if defined( __GNUC__ )
+	{ "AVX", CM_SideDistances_AVX },
+#else
+	{ "AVX", NULL },
+#endif
+#else
+	{ "SSE", NULL },
+	{ "AVX", NULL },
+#endif
+};
+
+static sideDistFunc_t	cm_sideDistances = CM_SideDistances_Scalar;
+static cmKernel_t		cm_kernel = CMK_SCALAR;
+static cmKernel_t		cm_supportedKernel = CMK_SCALAR;
+
+/*
+================
+CM_InitKernels
+
+Sets the best brush side kernel the processor can run
+================
+*/
+void CM_InitKernels( cmKernel_t supported ) {
+	while ( supported > CMK_SCALAR && !cm_kernels[supported].func ) {
+		supported = (cmKernel_t)( supported - 1 );
+	}
+	cm_supportedKernel = supported;
+	CM_SetKernel( cm_kernel );
+}
+
+/*
+================
+CM_SetKernel
+
+Switches to the given brush side kernel, or the best supported one below it.
+Must not be called while traces are running on other threads.
+================
+*/
+cmKernel_t CM_SetKernel( cmKernel_t kernel ) {
+	if ( kernel < CMK_SCALAR ) {
+		kernel = CMK_SCALAR;
+	}
+	if ( kernel > cm_supportedKernel ) {
+		kernel = cm_supportedKernel;
+	}
+	cm_kernel = kernel;
+	cm_sideDistances = cm_kernels[kernel].func;
+	return kernel;
+}
+
+/*
+================
+CM_KernelCheck_f
+
+Traces random boxes through the loaded map with every brush side kernel the
+processor supports and reports any result that differs from the scalar one
+================
+*/
+void CM_KernelCheck_f( void ) {
+	trace_t		results[CMK_NUM_KERNELS];
+	vec3_t		start, end, mins, maxs, boxMins, boxMaxs;
+	vec3_t		worldMins, worldMaxs;
+	clipHandle_t	model;
+	int			count, mismatches[CMK_NUM_KERNELS];
+	int			seed = 0x1234;
+	int			i, j, k;
+
+	if ( !cm.numNodes ) {
+		Com_Printf( "No map loaded\n" );
+		return;
+	}
+
+	count = Cmd_Argc( ) > 1 ? atoi( Cmd_Argv( 1 ) ) : 10000;
+	CM_ModelBounds( 0, worldMins, worldMaxs );
+	::memset( mismatches, 0, sizeof( mismatches ) );
+
+	for ( i = 0 ; i < count ; i++ ) {
+		for ( j = 0 ; j < 3 ; j++ ) {
+			start[j] = worldMins[j] + ( worldMaxs[j] - worldMins[j] ) * Q_random( &seed );
+			end[j] = worldMins[j] + ( worldMaxs[j] - worldMins[j] ) * Q_random( &seed );
+			maxs[j] = ( i & 1 ) ? 0 : 48 * Q_random( &seed );
+			mins[j] = -maxs[j];
+		}
+		// stationary boxes go through CM_TestBoxInBrush
+		if ( ( i & 7 ) == 2 ) {
+			VectorCopy( start, end );
+		}
+
+		// every fourth query hits an entity box instead of the world
+		model = 0;
+		if ( ( i & 3 ) == 3 ) {
+			for ( j = 0 ; j < 3 ; j++ ) {
+				boxMins[j] = start[j] + ( end[j] - start[j] ) * Q_random( &seed ) - 32;
+				boxMaxs[j] = boxMins[j] + 64 * Q_random( &seed ) + 1;
+			}
+		}
+
+		for ( k = CMK_SCALAR ; k <= cm_supportedKernel ; k++ ) {
+			cm_sideDistances = cm_kernels[k].func;
+			if ( ( i & 3 ) == 3 ) {
+				model = CM_TempBoxModel( boxMins, boxMaxs, false );
+			}
+			::memset( &results[k], 0, sizeof( results[k] ) );
+			CM_BoxTrace( &results[k], start, end, mins, maxs, model, -1, TT_AABB );
+			if ( k != CMK_SCALAR && ::memcmp( &results[k], &results[CMK_SCALAR], sizeof( trace_t ) ) ) {
+				mismatches[k]++;
+			}
+		}
+	}
+	cm_sideDistances = cm_kernels[cm_kernel].func;
+
+	Com_Printf( "%i traces, using %s\n", count, cm_kernels[cm_kernel].name );
+	for ( k = CMK_SCALAR + 1 ; k <= cm_supportedKernel ; k++ ) {
+		Com_Printf( "%s: %i mismatches against scalar\n", cm_kernels[k].name, mismatches[k] );
+	}
+}
+
+typedef struct {
+	trace_t		*results;
+	int			*contents;
+} threadCheck_t;
+
+/*
+================
+CM_ThreadCheckQuery
+
+Runs query number index of cm_threadcheck.  Everything about a query comes
+from its index, so it gives the same result on whichever thread runs it.
+================
+*/
+static void CM_ThreadCheckQuery( threadCheck_t *check, int index ) {
+	trace_t		*trace = &check->results[index];
+	vec3_t		start, end, mins, maxs, origin, angles;
+	vec3_t		worldMins, worldMaxs, boxMins, boxMaxs;
+	clipHandle_t	model;
+	traceType_t	type;
+	int			seed = (int)( (unsigned)index * 0x9e3779b9u + 0x1234 );
+	int			j;
+
+	CM_ModelBounds( 0, worldMins, worldMaxs );
+	for ( j = 0 ; j < 3 ; j++ ) {
+		start[j] = worldMins[j] + ( worldMaxs[j] - worldMins[j] ) * Q_random( &seed );
+		end[j] = worldMins[j] + ( worldMaxs[j] - worldMins[j] ) * Q_random( &seed );
+		maxs[j] = ( index & 8 ) ? 0 : 48 * Q_random( &seed );
+		mins[j] = -maxs[j];
+		origin[j] = 64 * Q_crandom( &seed );
+		angles[j] = ( index & 16 ) ? 180 * Q_crandom( &seed ) : 0;
+		boxMins[j] = start[j] + ( end[j] - start[j] ) * Q_random( &seed ) - 32;
+		boxMaxs[j] = boxMins[j] + 64 * Q_random( &seed ) + 1;
+	}
+	type = ( index & 32 ) ? TT_CAPSULE : TT_AABB;
+
+	::memset( trace, 0, sizeof( *trace ) );
+	switch ( index % 6 ) {
+	case 0:
+		CM_BoxTrace( trace, start, end, mins, maxs, 0, -1, type );
+		break;
+	case 1:
+		// stationary boxes go through the position tests
+		CM_BoxTrace( trace, start, start, mins, maxs, 0, -1, type );
+		break;
+	case 2:
+		model = CM_InlineModel( index % CM_NumInlineModels( ) );
+		CM_TransformedBoxTrace( trace, start, end, mins, maxs, model, -1, origin, angles, type );
+		break;
+	case 3:
+		// each thread has its own box model
+		model = CM_TempBoxModel( boxMins, boxMaxs, false );
+		CM_TransformedBoxTrace( trace, start, end, mins, maxs, model, -1, origin, vec3_origin, type );
+		check->contents[index] = CM_TransformedPointContents( start, model, origin, vec3_origin );
+		break;
+	case 4:
+		CM_BiSphereTrace( trace, start, end, 8 + maxs[0], 8 + maxs[1], 0, -1 );
+		break;
+	default:
+		CM_BoxTrace( trace, start, end, mins, maxs, CM_InlineModel( index % CM_NumInlineModels( ) ), -1, type );
+		check->contents[index] = CM_PointContents( start, 0 );
+		break;
+	}
+}
+
+/*
+================
+CM_ThreadCheckJob
+================
+*/
+static void CM_ThreadCheckJob( void *data, int index, int thread ) {
+	CM_ThreadCheckQuery( (threadCheck_t *)data, index );
+}
+
+/*
+================
+CM_ThreadCheck_f
+
+Runs a mix of traces and content queries through the loaded map on one
+thread, then again spread over the job threads, and reports any query
+whose threaded result differs from the single threaded one
+================
+*/
+void CM_ThreadCheck_f( void ) {
+	threadCheck_t	serial, threaded;
+	int			count, threads, passes;
+	int			mismatches;
+	int			i, pass;
+
+	if ( !cm.numNodes ) {
+		Com_Printf( "No map loaded\n" );
+		return;
+	}
+
+	count = Cmd_Argc( ) > 1 ? atoi( Cmd_Argv( 1 ) ) : 20000;
+	threads = Cmd_Argc( ) > 2 ? atoi( Cmd_Argv( 2 ) ) : MAX_JOB_THREADS;
+	passes = Cmd_Argc( ) > 3 ? atoi( Cmd_Argv( 3 ) ) : 4;
+	if ( count < 1 ) {
+		count = 1;
+	}
+
+	serial.results = (trace_t *)Z_Malloc( count * 2 * sizeof( trace_t ) );
+	serial.contents = (int *)Z_Malloc( count * 2 * sizeof( int ) );
+	threaded.results = serial.results + count;
+	threaded.contents = serial.contents + count;
+
+	for ( i = 0 ; i < count ; i++ ) {
+		CM_ThreadCheckQuery( &serial, i );
+	}
+
+	// races only show up now and then, so go over the queries several times
+	mismatches = 0;
+	for ( pass = 0 ; pass < passes ; pass++ ) {
+		::memset( threaded.contents, 0, count * sizeof( int ) );
+		Jobs_ParallelFor( threads, count, CM_ThreadCheckJob, &threaded );
+
+		for ( i = 0 ; i < count ; i++ ) {
+			if ( ::memcmp( &threaded.results[i], &serial.results[i], sizeof( trace_t ) )
+				|| threaded.contents[i] != serial.contents[i] ) {
+				mismatches++;
+			}
+		}
+	}
+
+	Com_Printf( "%i queries, %i passes on %i threads: %i mismatches against one thread\n",
+		count, passes, threads, mismatches );
+
+	Z_Free( serial.contents );
+	Z_Free( serial.results );
+}
+
+
 /*
 ===============================================================================
 
@@ -169,6 +560,8 @@ void CM_TestBoxInBrush( traceWork_t *tw, cbrush_t *brush ) {
 	cbrushside_t	*side;
 	float		t;
 	vec3_t		startp;
+	int			stride;
+	float		d1s[CM_SIDE_BATCH];
 
 	if (!brush->numsides) {
 		return;
@@ -213,17 +606,15 @@ void CM_TestBoxInBrush( traceWork_t *tw, cbrush_t *brush ) {
 	} else {
 		// the first six planes are the axial planes, so we only
 		// need to test the remainder
+		stride = CM_SIDE_STRIDE( brush->numsides );
 		for ( i = 6 ; i < brush->numsides ; i++ ) {
-			side = brush->sides + i;
-			plane = side->plane;
-
-			// adjust the plane distance apropriately for mins/maxs
-			dist = plane->dist - DotProduct( tw->offsets[ plane->signbits ], plane->normal );
-
-			d1 = DotProduct( tw->start, plane->normal ) - dist;
+			if ( i == 6 || !( i & ( CM_SIDE_BATCH - 1 ) ) ) {
+				cm_sideDistances( brush->sidePlanes + ( i & ~( CM_SIDE_BATCH - 1 ) ), stride,
+					tw->size, tw->start, NULL, d1s, NULL );
+			}
 
 			// if completely in front of face, no intersection
-			if ( d1 > 0 ) {
+			if ( d1s[i & ( CM_SIDE_BATCH - 1 )] > 0 ) {
 				return;
 			}
 		}
@@ -245,17 +636,19 @@ CM_TestInLeaf
 void CM_TestInLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	int			k;
 	int			brushnum;
+	int			patchnum;
 	cbrush_t	*b;
 	cPatch_t	*patch;
+	traceContext_t	*tc = tw->context;
 
 	// test box position against all brushes in the leaf
 	for (k=0 ; k<leaf->numLeafBrushes ; k++) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
-		b = &cm.brushes[brushnum];
-		if (b->checkcount == cm.checkcount) {
+		if (tc->brushChecks[brushnum] == tc->generation) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		tc->brushChecks[brushnum] = tc->generation;
+		b = CM_LeafBrush( tc, brushnum );
 
 		if ( !(b->contents & tw->contents)) {
 			continue;
@@ -274,14 +667,15 @@ void CM_TestInLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	if ( !cm_noCurves->integer ) {
 #endif //BSPC
 		for ( k = 0 ; k < leaf->numLeafSurfaces ; k++ ) {
-			patch = cm.surfaces[ cm.leafsurfaces[ leaf->firstLeafSurface + k ] ];
+			patchnum = cm.leafsurfaces[ leaf->firstLeafSurface + k ];
+			patch = cm.surfaces[ patchnum ];
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == cm.checkcount ) {
+			if ( tc->patchChecks[patchnum] == tc->generation ) {
 				continue;	// already checked this brush in another leaf
 			}
-			patch->checkcount = cm.checkcount;
+			tc->patchChecks[patchnum] = tc->generation;
 
 			if ( !(patch->contents & tw->contents)) {
 				continue;
@@ -430,14 +824,10 @@ void CM_PositionTest( traceWork_t *tw ) {
 	ll.storeLeafs = CM_StoreLeafs;
 	ll.lastLeaf = 0;
 	ll.overflowed = false;
-
-	cm.checkcount++;
+	ll.context = tw->context;
 
 	CM_BoxLeafnums_r( &ll, 0 );
 
-
-	cm.checkcount++;
-
 	// test the contents of the leafs
 	for (i=0 ; i < ll.count ; i++) {
 		CM_TestInLeaf( tw, &cm.leafs[leafs[i]] );
@@ -464,7 +854,7 @@ CM_TraceThroughPatch
 void CM_TraceThroughPatch( traceWork_t *tw, cPatch_t *patch ) {
 	float		oldFrac;
 
-	c_patch_traces++;
+	tw->patchTraces++;
 
 	oldFrac = tw->trace.fraction;
 
@@ -493,6 +883,8 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 	float		t;
 	vec3_t		startp;
 	vec3_t		endp;
+	int			stride;
+	float		d1s[CM_SIDE_BATCH], d2s[CM_SIDE_BATCH];
 
 	enterFrac = -1.0;
 	leaveFrac = 1.0;
@@ -502,7 +894,7 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 		return;
 	}
 
-	c_brush_traces++;
+	tw->brushTraces++;
 
 	getout = false;
 	startout = false;
@@ -541,7 +933,7 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 			if( d1 <= 0 && d2 <= 0 )
 				continue;
 
-			brush->collided = true;
+			tw->collided = true;
 
 			// crosses face
 			if( d1 > d2 )
@@ -618,7 +1010,7 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 				continue;
 			}
 
-			brush->collided = true;
+			tw->collided = true;
 
 			// crosses face
 			if (d1 > d2) {	// enter
@@ -647,15 +1039,16 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 		// find the latest time the trace crosses a plane towards the interior
 		// and the earliest time the trace crosses a plane towards the exterior
 		//
+		stride = CM_SIDE_STRIDE( brush->numsides );
 		for (i = 0; i < brush->numsides; i++) {
+			if ( !( i & ( CM_SIDE_BATCH - 1 ) ) ) {
+				cm_sideDistances( brush->sidePlanes + i, stride, tw->size, tw->start, tw->end, d1s, d2s );
+			}
 			side = brush->sides + i;
 			plane = side->plane;
 
-			// adjust the plane distance apropriately for mins/maxs
-			dist = plane->dist - DotProduct( tw->offsets[ plane->signbits ], plane->normal );
-
-			d1 = DotProduct( tw->start, plane->normal ) - dist;
-			d2 = DotProduct( tw->end, plane->normal ) - dist;
+			d1 = d1s[i & ( CM_SIDE_BATCH - 1 )];
+			d2 = d2s[i & ( CM_SIDE_BATCH - 1 )];
 
 			if (d2 > 0) {
 				getout = true;	// endpoint is not in solid
@@ -674,7 +1067,7 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 				continue;
 			}
 
-			brush->collided = true;
+			tw->collided = true;
 
 			// crosses face
 			if (d1 > d2) {	// enter
@@ -753,8 +1146,10 @@ static void CM_ProximityToBrush( traceWork_t *tw, cbrush_t *brush )
 	VectorClear( tw2.sphere.offset );
 	VectorCopy( tw->start, tw2.start );
 	VectorCopy( tw->end, tw2.end );
+	tw2.context = tw->context;
 
 	CM_TraceThroughBrush( &tw2, brush );
+	tw->brushTraces += tw2.brushTraces;
 
 	if( tw2.trace.fraction == 1.0f && !tw2.trace.allsolid && !tw2.trace.startsolid )
 	{
@@ -812,8 +1207,10 @@ static void CM_ProximityToPatch( traceWork_t *tw, cPatch_t *patch )
 	VectorClear( tw2.sphere.offset );
 	VectorCopy( tw->start, tw2.start );
 	VectorCopy( tw->end, tw2.end );
+	tw2.context = tw->context;
 
 	CM_TraceThroughPatch( &tw2, patch );
+	tw->patchTraces += tw2.patchTraces;
 
 	if( tw2.trace.fraction == 1.0f && !tw2.trace.allsolid && !tw2.trace.startsolid )
 	{
@@ -831,31 +1228,35 @@ CM_TraceThroughLeaf
 void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	int			k;
 	int			brushnum;
+	int			patchnum;
 	cbrush_t	*b;
 	cPatch_t	*patch;
+	traceContext_t	*tc = tw->context;
 
 	// trace line against all brushes in the leaf
 	for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
 
-		b = &cm.brushes[brushnum];
-		if ( b->checkcount == cm.checkcount ) {
+		if ( tc->brushChecks[brushnum] == tc->generation ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		tc->brushChecks[brushnum] = tc->generation;
+		b = CM_LeafBrush( tc, brushnum );
 
 		if ( !(b->contents & tw->contents) ) {
 			continue;
 		}
 
-		b->collided = false;
-
 		if ( !CM_BoundsIntersect( tw->bounds[0], tw->bounds[1],
 					b->bounds[0], b->bounds[1] ) ) {
 			continue;
 		}
 
+		tw->collided = false;
 		CM_TraceThroughBrush( tw, b );
+		if ( tw->collided ) {
+			tc->brushCollisions[brushnum] = tc->generation;
+		}
 		if ( !tw->trace.fraction ) {
 			tw->trace.lateralFraction = 0.0f;
 			return;
@@ -869,14 +1270,15 @@ void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	if ( !cm_noCurves->integer ) {
 #endif
 		for ( k = 0 ; k < leaf->numLeafSurfaces ; k++ ) {
-			patch = cm.surfaces[ cm.leafsurfaces[ leaf->firstLeafSurface + k ] ];
+			patchnum = cm.leafsurfaces[ leaf->firstLeafSurface + k ];
+			patch = cm.surfaces[ patchnum ];
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == cm.checkcount ) {
+			if ( tc->patchChecks[patchnum] == tc->generation ) {
 				continue;	// already checked this patch in another leaf
 			}
-			patch->checkcount = cm.checkcount;
+			tc->patchChecks[patchnum] = tc->generation;
 
 			if ( !(patch->contents & tw->contents) ) {
 				continue;
@@ -897,12 +1299,12 @@ void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 		{
 			brushnum = cm.leafbrushes[ leaf->firstLeafBrush + k ];
 
-			b = &cm.brushes[ brushnum ];
-
 			// This brush never collided, so don't bother
-			if( !b->collided )
+			if( tc->brushCollisions[ brushnum ] != tc->generation )
 				continue;
 
+			b = CM_LeafBrush( tc, brushnum );
+
 			if( !( b->contents & tw->contents ) )
 				continue;
 
@@ -1359,8 +1761,6 @@ void CM_Trace( trace_t *results, const vec3_t start,
 
 	cmod = CM_ClipHandleToModel( model );
 
-	cm.checkcount++;		// for multi-check avoidance
-
 	c_traces++;				// for statistics, may be zeroed
 
 	// fill in a default trace
@@ -1368,6 +1768,7 @@ void CM_Trace( trace_t *results, const vec3_t start,
 	tw.trace.fraction = 1;	// assume it goes the entire distance until shown otherwise
 	VectorCopy(origin, tw.modelOrigin);
 	tw.type = type;
+	tw.context = CM_BeginTrace();	// for multi-check avoidance
 
 	if (!cm.numNodes) {
 		*results = tw.trace;
@@ -1561,6 +1962,9 @@ void CM_Trace( trace_t *results, const vec3_t start,
                tw.trace.fraction == 1.0 ||
                VectorLengthSquared(tw.trace.plane.normal) > 0.9999);
 	*results = tw.trace;
+
+	c_brush_traces += tw.brushTraces;
+	c_patch_traces += tw.patchTraces;
 }
 
 /*
@@ -1690,8 +2094,6 @@ void CM_BiSphereTrace( trace_t *results, const vec3_t start,
 
 	cmod = CM_ClipHandleToModel( model );
 
-	cm.checkcount++;		// for multi-check avoidance
-
 	c_traces++;				// for statistics, may be zeroed
 
 	// fill in a default trace
@@ -1699,6 +2101,7 @@ void CM_BiSphereTrace( trace_t *results, const vec3_t start,
 	tw.trace.fraction = 1.0f; // assume it goes the entire distance until shown otherwise
 	VectorCopy( vec3_origin, tw.modelOrigin );
 	tw.type = TT_BISPHERE;
+	tw.context = CM_BeginTrace();	// for multi-check avoidance
 	tw.testLateralCollision = true;
 	tw.trace.lateralFraction = 1.0f;
 
@@ -1767,6 +2170,9 @@ void CM_BiSphereTrace( trace_t *results, const vec3_t start,
 			VectorLengthSquared(tw.trace.plane.normal ) > 0.9999 );
 
 	*results = tw.trace;
+
+	c_brush_traces += tw.brushTraces;
+	c_patch_traces += tw.patchTraces;
 }
 
 /*
@@ -26,10 +26,23 @@ along with Tremulous; if not, see <https://www.gnu.org/licenses/>
 
 #include "qcommon.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <setjmp.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 #ifdef _WIN32
 #include <winsock.h>
 #else
+#include <dlfcn.h>
+#if defined( __GLIBC__ ) || defined( __APPLE__ )
+#include <execinfo.h>
+#endif
 #include <netinet/in.h>
 //#include <sys/stat.h> // umask
 #endif
@@ -40,10 +53,12 @@ along with Tremulous; if not, see <https://www.gnu.org/licenses/>
 #include "crypto.h"
 #include "cvar.h"
 #include "files.h"
+#include "jobs.h"
 #define JSON_IMPLEMENTATION
 #include "json.h"
 #include "msg.h"
 #include "q_shared.h"
+#include "scratch.h"
 #include "vm.h"
 
 int demo_protocols[] = { PROTOCOL_VERSION, 70, 69, 0 };
@@ -77,6 +92,7 @@ cvar_t *com_fixedtime;
 cvar_t *com_journal;
 cvar_t *com_maxfps;
 cvar_t *com_altivec;
+cvar_t *com_simd;
 cvar_t *com_timedemo;
 cvar_t *com_sv_running;
 cvar_t *com_cl_running;
@@ -92,6 +108,10 @@ cvar_t *cl_paused;
 cvar_t *sv_paused;
 cvar_t  *cl_packetdelay;
 cvar_t  *sv_packetdelay;
+cvar_t  *cl_packetjitter;
+cvar_t  *sv_packetjitter;
+cvar_t  *cl_packetloss;
+cvar_t  *sv_packetloss;
 cvar_t *com_cameraMode;
 cvar_t *com_ansiColor;
 cvar_t *com_unfocused;
@@ -299,6 +319,10 @@ void QDECL Com_Error( int code, const char *fmt, ... )
 
     com_errorEntered = true;
 
+    // the error may have left a send batch open, and everything sent
+    // from here on has to go straight out
+    NET_FlushSendBatch();
+
     Cvar_Set("com_errorCode", va("%i", code));
 
     // when we are running automated scripts, make sure we
@@ -335,6 +359,7 @@ void QDECL Com_Error( int code, const char *fmt, ... )
         VM_Forced_Unload_Done();
         // make sure we can get at our local stuff
         FS_PureServerSetLoadedPaks("", "");
+        Scratch_Rewind( 0 );
         com_errorEntered = false;
         longjmp (abortframe, -1);
     }
@@ -347,6 +372,7 @@ void QDECL Com_Error( int code, const char *fmt, ... )
         CL_FlushMemory( );
         VM_Forced_Unload_Done();
         FS_PureServerSetLoadedPaks("", "");
+        Scratch_Rewind( 0 );
         com_errorEntered = false;
 
         static int reconnectCount = 0;
@@ -892,12 +918,30 @@ The rover can be left pointing at a non-empty block
 
 The zone calls are pretty much only used for small strings and structures,
 all big things are allocated on the hunk.
+
+Blocks of up to SLAB_MAX_SIZE bytes, header included, come from slab pages
+instead of the rover.  A slab page is an ordinary zone block tagged
+TAG_SLAB that is cut into blocks of one size class, each with a memblock_t
+header of its own, so Z_Free, the trash tester and the tags work the same
+for both.  Allocating or freeing a slab block takes the first page of its
+class off the list and never walks the zone.  A class keeps its pages with
+free blocks ahead of the full ones, and gives a page back to the zone as
+soon as it is empty, unless it is the only page of the class.  Those kept
+pages can hold up to SLAB_CLASSES * SLAB_PAGE_SIZE of a zone while nothing
+uses them, which is a sixth of the small zone; meminfo shows how much.
 ==============================================================================
 */
 
 #define ZONEID 0x1d4a11
+#define SLABID 0x1d4a12
 #define MINFRAGMENT 64
 
+#define SLAB_PAGE_SIZE 8192
+#define SLAB_CLASSES 11
+#define SLAB_MAX_SIZE 512
+
+static const int slabSizes[SLAB_CLASSES] = {48, 64, 80, 96, 128, 160, 192, 256, 320, 384, 512};
+
 typedef struct zonedebug_s {
     const char *label;
     const char *file;
@@ -908,18 +952,39 @@ typedef struct zonedebug_s {
 typedef struct memblock_s {
     int size;           // including the header and possibly tiny fragments
     int tag;            // a tag of 0 is a free block
-    struct memblock_s       *next, *prev;
-    int id;          // should be ZONEID
+    struct memblock_s       *next;  // the next free block of a slab page
+    union {
+        struct memblock_s   *prev;
+        struct slabpage_s   *page;  // for slab blocks
+    };
+    int id;          // should be ZONEID, or SLABID in a slab page
 #ifdef ZONE_DEBUG
     zonedebug_t d;
 #endif
 } memblock_t;
 
+typedef struct slabpage_s {
+    struct slabpage_s *next, *prev;  // pages with free blocks come first
+    memblock_t *free;
+    int used;  // blocks handed out
+    int slabClass;
+} slabpage_t;
+
+typedef struct {
+    int size;   // of every block, including the header
+    int count;  // blocks in a page
+    int pages;
+    int used;
+    slabpage_t pageList;  // start / end cap for linked list
+} slabclass_t;
+
 typedef struct {
     int size;   // total bytes malloced, including header
     int used;   // total bytes used
     memblock_t blocklist; // start / end cap for linked list
     memblock_t *rover;
+    slabclass_t slabs[SLAB_CLASSES];
+    int slabTagBytes[TAG_SLAB];  // handed out from slab pages, by tag
 } memzone_t;
 
 // main zone for all "dynamic" memory allocation
@@ -928,7 +993,28 @@ memzone_t *mainzone;
 // fragment the main zone (think of cvar and cmd strings)
 memzone_t *smallzone;
 
+// cleared by zonereplay to time the zone on its own
+static bool z_useSlabs = true;
+
 void Z_CheckHeap( void );
+static void Z_CaptureAlloc( void *ptr, int size, int tag );
+static void Z_CaptureFree( void *ptr );
+static bool z_capturing;
+
+// zoneprofile marks the blocks it sampled in their id
+#define ZONE_SAMPLED 0x40000000
+
+static void Z_ProfileAlloc( memblock_t *block, int size, int tag, const char *label, const char *file, int line,
+    const void *caller );
+static void Z_ProfileFree( void *ptr );
+static int z_profileInterval;  // sample every this many allocations, 0 when off
+static int z_profileCountdown;
+
+#ifdef _MSC_VER
+#define Z_CALLER _ReturnAddress()
+#else
+#define Z_CALLER __builtin_return_address( 0 )
+#endif
 
 /*
 ========================
@@ -938,6 +1024,8 @@ Z_ClearZone
 void Z_ClearZone( memzone_t *zone, int size )
 {
     memblock_t *block;
+    slabclass_t *sc;
+    int i;
 
     // set the entire zone to one free block
 
@@ -954,6 +1042,15 @@ void Z_ClearZone( memzone_t *zone, int size )
     block->tag = 0; // free block
     block->id = ZONEID;
     block->size = size - sizeof(memzone_t);
+
+    for ( i = 0; i < SLAB_CLASSES; i++ ) {
+        sc = &zone->slabs[i];
+        sc->size = PAD( slabSizes[i], sizeof(intptr_t) );
+        sc->count = ( SLAB_PAGE_SIZE - sizeof(slabpage_t) ) / sc->size;
+        sc->pages = sc->used = 0;
+        sc->pageList.next = sc->pageList.prev = &sc->pageList;
+    }
+    ::memset( zone->slabTagBytes, 0, sizeof(zone->slabTagBytes) );
 }
 
 /*
@@ -976,6 +1073,120 @@ int Z_AvailableMemory( void )
     return Z_AvailableZoneMemory( mainzone );
 }
 
+/*
+========================
+Z_FreeBlock
+
+Gives a block back to the rover list of its zone
+========================
+*/
+static void Z_FreeBlock( memzone_t *zone, memblock_t *block )
+{
+    memblock_t *other;
+
+    zone->used -= block->size;
+    // set the block to something that should cause problems
+    // if it is referenced...
+    ::memset( block + 1, 0xaa, block->size - sizeof( *block ) );
+
+    block->tag = 0; // mark as free
+
+    other = block->prev;
+    if (!other->tag) {
+        // merge with previous free block
+        other->size += block->size;
+        other->next = block->next;
+        other->next->prev = other;
+        if (block == zone->rover) {
+            zone->rover = other;
+        }
+        block = other;
+    }
+
+    zone->rover = block;
+
+    other = block->next;
+    if ( !other->tag ) {
+        // merge the next free block onto the end
+        block->size += other->size;
+        block->next = other->next;
+        block->next->prev = block;
+    }
+}
+
+/*
+========================
+Z_SlabUnlink
+========================
+*/
+static void Z_SlabUnlink( slabpage_t *page )
+{
+    page->prev->next = page->next;
+    page->next->prev = page->prev;
+}
+
+/*
+========================
+Z_SlabLinkFirst
+========================
+*/
+static void Z_SlabLinkFirst( slabclass_t *sc, slabpage_t *page )
+{
+    page->prev = &sc->pageList;
+    page->next = sc->pageList.next;
+    page->next->prev = page;
+    sc->pageList.next = page;
+}
+
+/*
+========================
+Z_SlabLinkLast
+========================
+*/
+static void Z_SlabLinkLast( slabclass_t *sc, slabpage_t *page )
+{
+    page->next = &sc->pageList;
+    page->prev = sc->pageList.prev;
+    page->prev->next = page;
+    sc->pageList.prev = page;
+}
+
+/*
+========================
+Z_SlabFree
+
+Returns true if the page of the block went back to the zone with it
+========================
+*/
+static bool Z_SlabFree( memzone_t *zone, memblock_t *block )
+{
+    slabpage_t *page = block->page;
+    slabclass_t *sc = &zone->slabs[page->slabClass];
+
+    zone->slabTagBytes[block->tag] -= block->size;
+    ::memset( block + 1, 0xaa, block->size - sizeof( *block ) );
+    block->tag = 0;
+
+    // a full page sits behind the ones with free blocks
+    if ( !page->free ) {
+        Z_SlabUnlink( page );
+        Z_SlabLinkFirst( sc, page );
+    }
+    block->next = page->free;
+    page->free = block;
+    page->used--;
+    sc->used--;
+
+    if ( page->used || sc->pages == 1 ) {
+        return false;
+    }
+
+    Z_SlabUnlink( page );
+    sc->pages--;
+    Z_FreeBlock( zone, (memblock_t *)page - 1 );
+    return true;
+}
+
 /*
 ========================
 Z_Free
@@ -983,7 +1194,7 @@ Z_Free
 */
 void Z_Free( void *ptr )
 {
-    memblock_t *block, *other;
+    memblock_t *block;
     memzone_t *zone;
 
     if (!ptr) {
@@ -992,7 +1203,7 @@ void Z_Free( void *ptr )
     }
 
     block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
-    if (block->id != ZONEID) {
+    if ((block->id & ~ZONE_SAMPLED) != ZONEID && (block->id & ~ZONE_SAMPLED) != SLABID) {
         Com_Error( ERR_FATAL, "Z_Free: freed a pointer without ZONEID" );
     }
     if (block->tag == 0) {
@@ -1008,6 +1219,16 @@ void Z_Free( void *ptr )
         Com_Error( ERR_FATAL, "Z_Free: memory block wrote past end" );
     }
 
+    // only untrack once the block is known to be ours
+    if ( block->id & ZONE_SAMPLED ) {
+        Z_ProfileFree( ptr );
+        block->id &= ~ZONE_SAMPLED;
+    }
+
+    if ( z_capturing ) {
+        Z_CaptureFree( ptr );
+    }
+
     if (block->tag == TAG_SMALL) {
         zone = smallzone;
     }
@@ -1015,33 +1236,10 @@ void Z_Free( void *ptr )
         zone = mainzone;
     }
 
-    zone->used -= block->size;
-    // set the block to something that should cause problems
-    // if it is referenced...
-    ::memset( ptr, 0xaa, block->size - sizeof( *block ) );
-
-    block->tag = 0; // mark as free
-
-    other = block->prev;
-    if (!other->tag) {
-        // merge with previous free block
-        other->size += block->size;
-        other->next = block->next;
-        other->next->prev = other;
-        if (block == zone->rover) {
-            zone->rover = other;
-        }
-        block = other;
-    }
-
-    zone->rover = block;
-
-    other = block->next;
-    if ( !other->tag ) {
-        // merge the next free block onto the end
-        block->size += other->size;
-        block->next = other->next;
-        block->next->prev = block;
+    if ( block->id == SLABID ) {
+        Z_SlabFree( zone, block );
+    } else {
+        Z_FreeBlock( zone, block );
     }
 }
 
@@ -1054,6 +1252,10 @@ Z_FreeTags
 void Z_FreeTags( int tag )
 {
     memzone_t *zone;
+    slabclass_t *sc;
+    slabpage_t *page, *next;
+    memblock_t *block;
+    int i, j;
 
     if ( tag == TAG_SMALL )
     {
@@ -1063,6 +1265,31 @@ void Z_FreeTags( int tag )
     {
         zone = mainzone;
     }
+
+    // the slab blocks first, their pages are zone blocks of TAG_SLAB
+    for ( i = 0; i < SLAB_CLASSES; i++ ) {
+        sc = &zone->slabs[i];
+        for ( page = sc->pageList.next; page != &sc->pageList; page = next ) {
+            next = page->next;
+            for ( j = 0; j < sc->count; j++ ) {
+                block = (memblock_t *)( (byte *)( page + 1 ) + j * sc->size );
+                if ( block->tag != tag ) {
+                    continue;
+                }
+                if ( z_capturing ) {
+                    Z_CaptureFree( block + 1 );
+                }
+                if ( block->id & ZONE_SAMPLED ) {
+                    Z_ProfileFree( block + 1 );
+                    block->id &= ~ZONE_SAMPLED;
+                }
+                if ( Z_SlabFree( zone, block ) ) {
+                    break;
+                }
+            }
+        }
+    }
+
     // use the rover as our pointer, because
     // Z_Free automatically adjusts it
     zone->rover = zone->blocklist.next;
@@ -1075,41 +1302,22 @@ void Z_FreeTags( int tag )
     } while ( zone->rover != &zone->blocklist );
 }
 
-
 /*
 ================
-Z_TagMalloc
+Z_ZoneMalloc
+
+First fit from the rover.  size includes the header and the trash tester.
 ================
 */
-#ifdef ZONE_DEBUG
-void *Z_TagMallocDebug( int size, int tag, const char *label, const char *file, int line )
-#else
-void *Z_TagMalloc( int size, int tag )
-#endif
+static memblock_t *Z_ZoneMalloc( memzone_t *zone, int size, int tag, const char *label, const char *file, int line )
 {
     int extra;
     memblock_t *start, *rover, *_new, *base;
-    memzone_t *zone;
 
-    if (!tag)
-        Com_Error( ERR_FATAL, "Z_TagMalloc: tried to use a 0 tag" );
-
-    if ( tag == TAG_SMALL )
-        zone = smallzone;
-    else
-        zone = mainzone;
-
-#ifdef ZONE_DEBUG
-    int allocSize = size;
-#endif
     //
     // scan through the block list looking for the first free block
     // of sufficient size
     //
-    size += sizeof(memblock_t); // account for size of block header
-    size += 4;     // space for memory trash tester
-    size = PAD(size, sizeof(intptr_t)); // align to 32/64 bit boundary
-
     base = rover = zone->rover;
     start = base->prev;
 
@@ -1159,6 +1367,98 @@ void *Z_TagMalloc( int size, int tag )
 
     base->id = ZONEID;
 
+    return base;
+}
+
+/*
+================
+Z_SlabMalloc
+
+Takes a block from the first page of the class, which only has no free
+blocks if none of the pages have
+================
+*/
+static memblock_t *Z_SlabMalloc( memzone_t *zone, int slabClass, int tag, const char *label, const char *file, int line )
+{
+    slabclass_t *sc = &zone->slabs[slabClass];
+    slabpage_t *page;
+    memblock_t *block;
+    int i;
+
+    page = sc->pageList.next;
+    if ( page == &sc->pageList || !page->free ) {
+        block = Z_ZoneMalloc( zone, PAD( sizeof(memblock_t) + SLAB_PAGE_SIZE + 4, sizeof(intptr_t) ),
+            TAG_SLAB, label, file, line );
+        *(int *)( (byte *)block + block->size - 4 ) = ZONEID;
+        page = (slabpage_t *)( block + 1 );
+        page->slabClass = slabClass;
+        page->used = 0;
+        page->free = NULL;
+        for ( i = sc->count - 1; i >= 0; i-- ) {
+            block = (memblock_t *)( (byte *)( page + 1 ) + i * sc->size );
+            block->size = sc->size;
+            block->tag = 0;
+            block->page = page;
+            block->id = SLABID;
+            block->next = page->free;
+            page->free = block;
+        }
+        Z_SlabLinkFirst( sc, page );
+        sc->pages++;
+    }
+
+    block = page->free;
+    page->free = block->next;
+    page->used++;
+    sc->used++;
+
+    // full pages go behind the ones with free blocks
+    if ( !page->free ) {
+        Z_SlabUnlink( page );
+        Z_SlabLinkLast( sc, page );
+    }
+
+    block->tag = tag;
+    zone->slabTagBytes[tag] += block->size;
+
+    return block;
+}
+
+/*
+================
+Z_TagMallocSite
+
+caller is only used by zoneprofile when there is no ZONE_DEBUG label
+================
+*/
+static void *Z_TagMallocSite( int size, int tag, const char *label, const char *file, int line, const void *caller )
+{
+    memblock_t *base;
+    memzone_t *zone;
+    int i;
+
+    if (!tag)
+        Com_Error( ERR_FATAL, "Z_TagMalloc: tried to use a 0 tag" );
+
+    if ( tag == TAG_SMALL )
+        zone = smallzone;
+    else
+        zone = mainzone;
+
+    int allocSize = size;
+    size += sizeof(memblock_t); // account for size of block header
+    size += 4;     // space for memory trash tester
+    size = PAD(size, sizeof(intptr_t)); // align to 32/64 bit boundary
+
+    base = NULL;
+    if ( size <= SLAB_MAX_SIZE && tag > 0 && tag < TAG_SLAB && z_useSlabs ) {
+        for ( i = 0; zone->slabs[i].size < size; i++ ) {
+        }
+        base = Z_SlabMalloc( zone, i, tag, label, file, line );
+    } else {
+        base = Z_ZoneMalloc( zone, size, tag, label, file, line );
+    }
+
 #ifdef ZONE_DEBUG
     base->d.label = label;
     base->d.file = file;
@@ -1169,9 +1469,33 @@ void *Z_TagMalloc( int size, int tag )
     // marker for memory trash testing
     *(int *)((byte *)base + base->size - 4) = ZONEID;
 
+    if ( z_capturing ) {
+        Z_CaptureAlloc( base + 1, allocSize, tag );
+    }
+    if ( z_profileInterval && --z_profileCountdown <= 0 ) {
+        Z_ProfileAlloc( base, allocSize, tag, label, file, line, caller );
+    }
+
     return (void *) ((byte *)base + sizeof(memblock_t));
 }
 
+/*
+================
+Z_TagMalloc
+================
+*/
+#ifdef ZONE_DEBUG
+void *Z_TagMallocDebug( int size, int tag, const char *label, const char *file, int line )
+{
+    return Z_TagMallocSite( size, tag, label, file, line, NULL );
+}
+#else
+void *Z_TagMalloc( int size, int tag )
+{
+    return Z_TagMallocSite( size, tag, NULL, NULL, 0, Z_CALLER );
+}
+#endif
+
 /*
 ========================
 Z_Malloc
@@ -1188,9 +1512,9 @@ void *Z_Malloc( int size )
     //Z_CheckHeap(); // XXX DEBUG
 
 #ifdef ZONE_DEBUG
-    buf = Z_TagMallocDebug( size, TAG_GENERAL, label, file, line );
+    buf = Z_TagMallocSite( size, TAG_GENERAL, label, file, line, NULL );
 #else
-    buf = Z_TagMalloc( size, TAG_GENERAL );
+    buf = Z_TagMallocSite( size, TAG_GENERAL, NULL, NULL, 0, Z_CALLER );
 #endif
     ::memset( buf, 0, size );
 
@@ -1200,12 +1524,12 @@ void *Z_Malloc( int size )
 #ifdef ZONE_DEBUG
 void *S_MallocDebug( int size, const char *label, const char *file, int line )
 {
-    return Z_TagMallocDebug( size, TAG_SMALL, label, file, line );
+    return Z_TagMallocSite( size, TAG_SMALL, label, file, line, NULL );
 }
 #else
 void *S_Malloc( int size )
 {
-    return Z_TagMalloc( size, TAG_SMALL );
+    return Z_TagMallocSite( size, TAG_SMALL, NULL, NULL, 0, Z_CALLER );
 }
 #endif
 
@@ -1236,52 +1560,73 @@ void Z_CheckHeap( void )
 
 /*
 ========================
-Z_LogZoneHeap
+Z_LogBlock
 ========================
 */
-void Z_LogZoneHeap( memzone_t *zone, const char *name )
+static void Z_LogBlock( memblock_t *block, int *size, int *allocSize, int *numBlocks )
 {
 #ifdef ZONE_DEBUG
     char dump[32], *ptr;
     int  i, j;
+    char buf[4096];
+
+    ptr = ((char *) block) + sizeof(memblock_t);
+    j = 0;
+    for (i = 0; i < 20 && i < block->d.allocSize; i++)
+    {
+        if (ptr[i] >= 32 && ptr[i] < 127) {
+            dump[j++] = ptr[i];
+        }
+        else {
+            dump[j++] = '_';
+        }
+    }
+    dump[j] = '\0';
+    Com_sprintf(buf, sizeof(buf), "size = %8d: %s, line: %d (%s) [%s]\r\n", block->d.allocSize, block->d.file, block->d.line, block->d.label, dump);
+    FS_Write(buf, strlen(buf), logfile);
+    *allocSize += block->d.allocSize;
 #endif
-    memblock_t *block;
+    *size += block->size;
+    (*numBlocks)++;
+}
+
+/*
+========================
+Z_LogZoneHeap
+========================
+*/
+void Z_LogZoneHeap( memzone_t *zone, const char *name )
+{
+    memblock_t *block, *slab;
+    slabclass_t *sc;
     char buf[4096];
     int size, allocSize, numBlocks;
+    int i;
 
     if (!logfile || !FS_Initialized())
         return;
 
     size = numBlocks = 0;
-#ifdef ZONE_DEBUG
     allocSize = 0;
-#endif
     Com_sprintf(buf, sizeof(buf), "\r\n================\r\n%s log\r\n================\r\n", name);
     FS_Write(buf, strlen(buf), logfile);
 
     for (block = zone->blocklist.next ; block->next != &zone->blocklist; block = block->next)
     {
-        if (block->tag)
+        if (block->tag == TAG_SLAB)
         {
-#ifdef ZONE_DEBUG
-            ptr = ((char *) block) + sizeof(memblock_t);
-            j = 0;
-            for (i = 0; i < 20 && i < block->d.allocSize; i++)
+            // log the blocks of the page instead of the page itself
+            sc = &zone->slabs[((slabpage_t *)(block + 1))->slabClass];
+            for (i = 0; i < sc->count; i++)
             {
-                if (ptr[i] >= 32 && ptr[i] < 127) {
-                    dump[j++] = ptr[i];
-                }
-                else {
-                    dump[j++] = '_';
-                }
+                slab = (memblock_t *)((byte *)(block + 1) + sizeof(slabpage_t) + i * sc->size);
+                if (slab->tag)
+                    Z_LogBlock(slab, &size, &allocSize, &numBlocks);
             }
-            dump[j] = '\0';
-            Com_sprintf(buf, sizeof(buf), "size = %8d: %s, line: %d (%s) [%s]\r\n", block->d.allocSize, block->d.file, block->d.line, block->d.label, dump);
-            FS_Write(buf, strlen(buf), logfile);
-            allocSize += block->d.allocSize;
-#endif
-            size += block->size;
-            numBlocks++;
+        }
+        else if (block->tag)
+        {
+            Z_LogBlock(block, &size, &allocSize, &numBlocks);
         }
     }
 #ifdef ZONE_DEBUG
@@ -1331,188 +1676,1067 @@ memstatic_t numberstring[] = {
 };
 
 /*
-========================
-CopyString
+========================
+CopyString
+
+NOTE: never write over the memory CopyString returns because
+memory from a memstatic_t might be returned
+========================
+*/
+char *CopyString( const char *in )
+{
+    char *out;
+
+    if (!in[0]) {
+        return ((char *)&emptystring) + sizeof(memblock_t);
+    }
+    else if (!in[1]) {
+        if (in[0] >= '0' && in[0] <= '9') {
+            return ((char *)&numberstring[in[0]-'0']) + sizeof(memblock_t);
+        }
+    }
+    out = (char*)S_Malloc(strlen(in)+1);
+    strcpy (out, in);
+    return out;
+}
+
+/*
+==============================================================================
+
+Goals:
+    reproducable without history effects -- no out of memory errors on weird map to map changes
+    allow restarting of the client without fragmentation
+    minimize total pages in use at run time
+    minimize total pages needed during load time
+
+  Single block of memory with stack allocators coming from both ends towards the middle.
+
+  One side is designated the temporary memory allocator.
+
+  Temporary memory can be allocated and freed in any order.
+
+  A highwater mark is kept of the most in use at any time.
+
+  When there is no temporary memory allocated, the permanent and temp sides
+  can be switched, allowing the already touched temp memory to be used for
+  permanent storage.
+
+  Temp memory must never be allocated on two ends at once, or fragmentation
+  could occur.
+
+  If we have any in-use temp memory, additional temp allocations must come from
+  that side.
+
+  If not, we can choose to make either side the new temp side and push future
+  permanent allocations to the other side.  Permanent allocations should be
+  kept on the side that has the current greatest wasted highwater mark.
+
+==============================================================================
+*/
+
+
+#define HUNK_MAGIC      0x89537892
+#define HUNK_FREE_MAGIC 0x89537893
+
+typedef struct {
+    unsigned int magic;
+    unsigned int size;
+} hunkHeader_t;
+
+typedef struct {
+    int mark;
+    int permanent;
+    int temp;
+    int tempHighwater;
+} hunkUsed_t;
+
+typedef struct hunkblock_s {
+    int size;
+    byte printed;
+    struct hunkblock_s *next;
+    const char *label;
+    const char *file;
+    int line;
+} hunkblock_t;
+
+static hunkblock_t *hunkblocks;
+
+static hunkUsed_t hunk_low, hunk_high;
+static hunkUsed_t *hunk_permanent, *hunk_temp;
+
+static byte* s_hunkData = NULL;
+static int s_hunkTotal;
+
+// the hunk is reserved address space, committed from each end as the banks
+// grow into it, and handed back to the system by Hunk_Clear
+#define HUNK_COMMIT_CHUNK ( 2 * 1024 * 1024 )
+
+static int s_hunkCommitLow, s_hunkCommitHigh;
+
+// the most each map had in use, so that com_hunkMegs can be sized
+#define HUNK_HISTORY 8
+
+typedef struct {
+    char mapname[MAX_QPATH];
+    int low;    // permanent and temp in the low bank
+    int high;
+    int temp;   // temp in either bank
+    int total;  // both banks at once
+} hunkPeak_t;
+
+static hunkPeak_t s_hunkPeak;
+static hunkPeak_t s_hunkHistory[HUNK_HISTORY];
+static int s_hunkHistoryCount;
+
+/*
+=================
+Hunk_Commit
+
+Commits the hunk as far as the banks have grown, and keeps the
+high-water marks of the map
+=================
+*/
+static void Hunk_Commit( void )
+{
+    int low = MAX( hunk_low.permanent, hunk_low.temp );
+    int high = MAX( hunk_high.permanent, hunk_high.temp );
+    int end;
+
+    s_hunkPeak.low = MAX( s_hunkPeak.low, low );
+    s_hunkPeak.high = MAX( s_hunkPeak.high, high );
+    s_hunkPeak.temp = MAX( s_hunkPeak.temp, hunk_temp->temp - hunk_temp->permanent );
+    s_hunkPeak.total = MAX( s_hunkPeak.total, low + high );
+
+    if ( low > s_hunkCommitLow ) {
+        end = MIN( PAD( low, HUNK_COMMIT_CHUNK ), s_hunkTotal - s_hunkCommitHigh );
+        if ( !Sys_CommitMemory( s_hunkData + s_hunkCommitLow, end - s_hunkCommitLow ) ) {
+            Com_Error( ERR_FATAL, "Hunk_Commit: failed to commit %i bytes of the low bank", end - s_hunkCommitLow );
+        }
+        s_hunkCommitLow = end;
+    }
+    if ( high > s_hunkCommitHigh ) {
+        end = MIN( PAD( high, HUNK_COMMIT_CHUNK ), s_hunkTotal - s_hunkCommitLow );
+        if ( !Sys_CommitMemory( s_hunkData + s_hunkTotal - end, end - s_hunkCommitHigh ) ) {
+            Com_Error( ERR_FATAL, "Hunk_Commit: failed to commit %i bytes of the high bank", end - s_hunkCommitHigh );
+        }
+        s_hunkCommitHigh = end;
+    }
+}
+
+/*
+=================
+Hunk_EndMap
+
+Moves the high-water marks of the map that is being cleared into the
+history
+=================
+*/
+static void Hunk_EndMap( void )
+{
+    if ( !s_hunkPeak.total ) {
+        return;
+    }
+
+    Q_strncpyz( s_hunkPeak.mapname, Cvar_VariableString( "mapname" ), sizeof(s_hunkPeak.mapname) );
+    if ( !s_hunkPeak.mapname[0] ) {
+        Q_strncpyz( s_hunkPeak.mapname, "(no map)", sizeof(s_hunkPeak.mapname) );
+    }
+    Com_Printf( "Hunk_Clear: %s peaked at %i of %i bytes (%i low, %i high, %i temp)\n", s_hunkPeak.mapname,
+        s_hunkPeak.total, s_hunkTotal, s_hunkPeak.low, s_hunkPeak.high, s_hunkPeak.temp );
+
+    if ( s_hunkHistoryCount == HUNK_HISTORY ) {
+        ::memmove( s_hunkHistory, s_hunkHistory + 1, ( HUNK_HISTORY - 1 ) * sizeof(hunkPeak_t) );
+        s_hunkHistoryCount--;
+    }
+    s_hunkHistory[s_hunkHistoryCount++] = s_hunkPeak;
+    ::memset( &s_hunkPeak, 0, sizeof(s_hunkPeak) );
+}
+
+/*
+=================
+Hunk_PrintHistory
+=================
+*/
+static void Hunk_PrintHistory( void )
+{
+    hunkPeak_t *peak;
+    int most = s_hunkPeak.total;
+    int i;
+
+    Com_Printf( "hunk high-water marks by map:\n" );
+    Com_Printf( "     low     high     temp    total  map\n" );
+    for ( i = 0; i <= s_hunkHistoryCount; i++ ) {
+        peak = i < s_hunkHistoryCount ? &s_hunkHistory[i] : &s_hunkPeak;
+        Com_Printf( "%8i %8i %8i %8i  %s\n", peak->low, peak->high, peak->temp, peak->total,
+            i < s_hunkHistoryCount ? peak->mapname : "(current)" );
+        most = MAX( most, peak->total );
+    }
+    Com_Printf( "%8i most in use, com_hunkMegs %i would have held it\n", most,
+        ( most + 1024 * 1024 - 1 ) / ( 1024 * 1024 ) );
+}
+
+static int s_zoneTotal;
+static int s_smallZoneTotal;
+
+/*
+=================
+Z_SlabKeptBytes
+
+What the empty pages a class holds on to take from the zone.  Only the
+last page of a class is kept once it is empty, so this is at most one
+page per class.
+=================
+*/
+static int Z_SlabKeptBytes( const memzone_t *zone )
+{
+    int bytes = 0;
+    int i;
+
+    for ( i = 0; i < SLAB_CLASSES; i++ ) {
+        if ( !zone->slabs[i].used ) {
+            bytes += zone->slabs[i].pages * PAD( sizeof(memblock_t) + SLAB_PAGE_SIZE + 4, sizeof(intptr_t) );
+        }
+    }
+    return bytes;
+}
+
+/*
+=================
+Com_Meminfo_f
+=================
+*/
+void Com_Meminfo_f( void )
+{
+    memblock_t *block;
+    int zoneBytes, zoneBlocks;
+    int smallZoneBytes;
+    int botlibBytes, rendererBytes;
+    int slabBytes, slabUsedBytes;
+    int scratchUsed, scratchPeak, scratchCommitted;
+    int unused;
+    int i;
+
+    zoneBytes = 0;
+    slabBytes = 0;
+    botlibBytes = 0;
+    rendererBytes = 0;
+    zoneBlocks = 0;
+    for (block = mainzone->blocklist.next ; ; block = block->next) {
+        if ( Cmd_Argc() != 1 ) {
+            Com_Printf ("block:%p    size:%7i    tag:%3i\n",
+                    (void *)block, block->size, block->tag);
+        }
+        if ( block->tag ) {
+            zoneBytes += block->size;
+            zoneBlocks++;
+            if ( block->tag == TAG_SLAB ) {
+                slabBytes += block->size;
+            } else if ( block->tag == TAG_BOTLIB ) {
+                botlibBytes += block->size;
+            } else if ( block->tag == TAG_RENDERER ) {
+                rendererBytes += block->size;
+            }
+        }
+
+        if (block->next == &mainzone->blocklist) {
+            break; // all blocks have been hit
+        }
+        if ( (byte *)block + block->size != (byte *)block->next) {
+            Com_Printf ("ERROR: block size does not touch the next block\n");
+        }
+        if ( block->next->prev != block) {
+            Com_Printf ("ERROR: next block doesn't have proper back link\n");
+        }
+        if ( !block->tag && !block->next->tag ) {
+            Com_Printf ("ERROR: two consecutive free blocks\n");
+        }
+    }
+
+    smallZoneBytes = 0;
+    for (block = smallzone->blocklist.next ; ; block = block->next)
+    {
+        if ( block->tag )
+            smallZoneBytes += block->size;
+
+        if (block->next == &smallzone->blocklist)
+            break; // all blocks have been hit
+    }
+
+    // the slab pages count as zone blocks, their blocks go by tag
+    slabUsedBytes = 0;
+    for ( i = TAG_GENERAL; i < TAG_SLAB; i++ ) {
+        slabUsedBytes += mainzone->slabTagBytes[i];
+    }
+    botlibBytes += mainzone->slabTagBytes[TAG_BOTLIB];
+    rendererBytes += mainzone->slabTagBytes[TAG_RENDERER];
+
+    Com_Printf( "%8i bytes total hunk\n", s_hunkTotal );
+    Com_Printf( "%8i bytes total zone\n", s_zoneTotal );
+    Com_Printf( "\n" );
+    Com_Printf( "%8i low mark\n", hunk_low.mark );
+    Com_Printf( "%8i low permanent\n", hunk_low.permanent );
+    if ( hunk_low.temp != hunk_low.permanent ) {
+        Com_Printf( "%8i low temp\n", hunk_low.temp );
+    }
+    Com_Printf( "%8i low tempHighwater\n", hunk_low.tempHighwater );
+    Com_Printf( "\n" );
+    Com_Printf( "%8i high mark\n", hunk_high.mark );
+    Com_Printf( "%8i high permanent\n", hunk_high.permanent );
+    if ( hunk_high.temp != hunk_high.permanent ) {
+        Com_Printf( "%8i high temp\n", hunk_high.temp );
+    }
+    Com_Printf( "%8i high tempHighwater\n", hunk_high.tempHighwater );
+    Com_Printf( "\n" );
+    Com_Printf( "%8i total hunk in use\n", hunk_low.permanent + hunk_high.permanent );
+    unused = 0;
+    if ( hunk_low.tempHighwater > hunk_low.permanent ) {
+        unused += hunk_low.tempHighwater - hunk_low.permanent;
+    }
+    if ( hunk_high.tempHighwater > hunk_high.permanent ) {
+        unused += hunk_high.tempHighwater - hunk_high.permanent;
+    }
+    Com_Printf( "%8i unused highwater\n", unused );
+    Com_Printf( "%8i committed\n", s_hunkCommitLow + s_hunkCommitHigh );
+    Com_Printf( "\n" );
+    Scratch_Info( &scratchUsed, &scratchPeak, &scratchCommitted );
+    Com_Printf( "%8i scratch in use\n", scratchUsed );
+    Com_Printf( "%8i scratch peak\n", scratchPeak );
+    Com_Printf( "%8i scratch committed\n", scratchCommitted );
+    Com_Printf( "\n" );
+    Hunk_PrintHistory();
+    Com_Printf( "\n" );
+    Com_Printf( "%8i bytes in %i zone blocks\n", zoneBytes, zoneBlocks );
+    Com_Printf( "        %8i bytes in dynamic botlib\n", botlibBytes );
+    Com_Printf( "        %8i bytes in dynamic renderer\n", rendererBytes );
+    Com_Printf( "        %8i bytes in dynamic other\n", zoneBytes - slabBytes + slabUsedBytes - ( botlibBytes + rendererBytes ) );
+    Com_Printf( "        %8i bytes free in slab pages\n", slabBytes - slabUsedBytes );
+    Com_Printf( "        %8i bytes of that in empty pages kept by their class\n", Z_SlabKeptBytes( mainzone ) );
+    Com_Printf( "        %8i bytes in small Zone memory\n", smallZoneBytes );
+    Com_Printf( "        %8i bytes of that in empty pages kept by their class\n", Z_SlabKeptBytes( smallzone ) );
+    Com_Printf( "\n" );
+    Com_Printf( "slab  size   main pages      blocks  small pages      blocks\n" );
+    for ( i = 0; i < SLAB_CLASSES; i++ ) {
+        Com_Printf( "%4i  %4i   %10i %5i/%5i  %11i %5i/%5i\n", i, mainzone->slabs[i].size,
+            mainzone->slabs[i].pages, mainzone->slabs[i].used, mainzone->slabs[i].pages * mainzone->slabs[i].count,
+            smallzone->slabs[i].pages, smallzone->slabs[i].used, smallzone->slabs[i].pages * smallzone->slabs[i].count );
+    }
+}
+
+/*
+==============================================================================
+
+ZONE CAPTURE AND REPLAY
+
+zonecapture records every zone allocation and free to traces/<name>.ztr, so
+a real workload can later be replayed by zonereplay against the zone with
+and without the slab pages.  Only blocks allocated while capturing are
+tracked, frees of older blocks are left out of the trace.
+==============================================================================
+*/
+
+#define ZONETRACE_IDENT (('C'<<24)+('R'<<16)+('T'<<8)+'Z')
+#define ZONETRACE_VERSION 1
+#define ZONETRACE_FLUSH 4096
+
+typedef struct {
+    int free;   // 0 for an allocation
+    int id;
+    int size;   // as requested
+    int tag;
+} zoneTraceOp_t;
+
+static struct {
+    fileHandle_t file;
+    std::unordered_map<void *, int> *ids;
+    int nextId;
+    int numOps;
+    zoneTraceOp_t ops[ZONETRACE_FLUSH];
+    int pending;
+} z_capture;
+
+/*
+=================
+Z_CaptureFlush
+=================
+*/
+static void Z_CaptureFlush( void )
+{
+    if ( z_capture.pending ) {
+        // FS_Write may allocate itself
+        z_capturing = false;
+        FS_Write( z_capture.ops, z_capture.pending * sizeof(zoneTraceOp_t), z_capture.file );
+        z_capturing = true;
+        z_capture.pending = 0;
+    }
+}
+
+/*
+=================
+Z_CaptureOp
+=================
+*/
+static void Z_CaptureOp( int free, int id, int size, int tag )
+{
+    zoneTraceOp_t *op = &z_capture.ops[z_capture.pending++];
+
+    op->free = LittleLong( free );
+    op->id = LittleLong( id );
+    op->size = LittleLong( size );
+    op->tag = LittleLong( tag );
+    z_capture.numOps++;
+
+    if ( z_capture.pending == ZONETRACE_FLUSH ) {
+        Z_CaptureFlush();
+    }
+}
+
+/*
+=================
+Z_CaptureAlloc
+=================
+*/
+static void Z_CaptureAlloc( void *ptr, int size, int tag )
+{
+    (*z_capture.ids)[ptr] = z_capture.nextId;
+    Z_CaptureOp( 0, z_capture.nextId++, size, tag );
+}
+
+/*
+=================
+Z_CaptureFree
+=================
+*/
+static void Z_CaptureFree( void *ptr )
+{
+    auto it = z_capture.ids->find( ptr );
+
+    if ( it == z_capture.ids->end() ) {
+        return;
+    }
+    Z_CaptureOp( 1, it->second, 0, 0 );
+    z_capture.ids->erase( it );
+}
+
+/*
+=================
+Z_CaptureStop
+=================
+*/
+static void Z_CaptureStop( void )
+{
+    if ( !z_capturing ) {
+        return;
+    }
+    Z_CaptureFlush();
+    z_capturing = false;
+    FS_FCloseFile( z_capture.file );
+    delete z_capture.ids;
+    z_capture.ids = NULL;
+    Com_Printf( "zonecapture: %i operations on %i blocks\n", z_capture.numOps, z_capture.nextId );
+}
+
+/*
+=================
+Com_ZoneCapture_f
+=================
+*/
+static void Com_ZoneCapture_f( void )
+{
+    char name[MAX_QPATH];
+    int header[2];
+
+    if ( Cmd_Argc() != 2 ) {
+        Com_Printf( "usage: zonecapture <name|stop>\n" );
+        return;
+    }
+    if ( !Q_stricmp( Cmd_Argv( 1 ), "stop" ) ) {
+        Z_CaptureStop();
+        return;
+    }
+    if ( z_capturing ) {
+        Com_Printf( "zonecapture: already capturing\n" );
+        return;
+    }
+
+    Com_sprintf( name, sizeof(name), "traces/%s.ztr", Cmd_Argv( 1 ) );
+    z_capture.file = FS_FOpenFileWrite( name );
+    if ( !z_capture.file ) {
+        Com_Printf( "zonecapture: couldn't open %s\n", name );
+        return;
+    }
+    header[0] = LittleLong( ZONETRACE_IDENT );
+    header[1] = LittleLong( ZONETRACE_VERSION );
+    FS_Write( header, sizeof(header), z_capture.file );
+
+    z_capture.ids = new std::unordered_map<void *, int>;
+    z_capture.nextId = 0;
+    z_capture.numOps = 0;
+    z_capture.pending = 0;
+    z_capturing = true;
+    Com_Printf( "zonecapture: recording to %s\n", name );
+}
+
+/*
+=================
+Z_ReplaySize
+
+What an allocation takes from the zone without the slab pages
+=================
+*/
+static int Z_ReplaySize( int size )
+{
+    return PAD( size + sizeof(memblock_t) + 4, sizeof(intptr_t) );
+}
+
+/*
+=================
+Z_ReplayPass
+=================
+*/
+static void Z_ReplayPass( const std::vector<zoneTraceOp_t> &ops, int numIds, int passes, bool slabs )
+{
+    std::vector<void *> ptrs( numIds );
+    std::chrono::steady_clock::time_point start;
+    long long ns = 0;
+    int mainUsed = mainzone->used, smallUsed = smallzone->used;
+    int peakMain = 0, peakSmall = 0;
+    int freeBlocks[2], largest[2];
+    memzone_t *zone;
+    memblock_t *block;
+    int i;
+
+    z_useSlabs = slabs;
+    for ( int pass = 0; pass < passes; pass++ ) {
+        std::fill( ptrs.begin(), ptrs.end(), nullptr );
+
+        start = std::chrono::steady_clock::now();
+        for ( const zoneTraceOp_t &op : ops ) {
+            if ( !op.free ) {
+#ifdef ZONE_DEBUG
+                ptrs[op.id] = Z_TagMallocDebug( op.size, op.tag, "zonereplay", __FILE__, __LINE__ );
+#else
+                ptrs[op.id] = Z_TagMalloc( op.size, op.tag );
+#endif
+                peakMain = MAX( peakMain, mainzone->used - mainUsed );
+                peakSmall = MAX( peakSmall, smallzone->used - smallUsed );
+            } else if ( ptrs[op.id] ) {
+                Z_Free( ptrs[op.id] );
+                ptrs[op.id] = nullptr;
+            }
+        }
+        ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
+            .count();
+
+        // what the trace left behind shows how fragmented the zones got
+        for ( i = 0; i < 2; i++ ) {
+            zone = i ? smallzone : mainzone;
+            freeBlocks[i] = largest[i] = 0;
+            for ( block = zone->blocklist.next; block != &zone->blocklist; block = block->next ) {
+                if ( !block->tag ) {
+                    freeBlocks[i]++;
+                    largest[i] = MAX( largest[i], block->size );
+                }
+            }
+        }
+
+        for ( void *ptr : ptrs ) {
+            if ( ptr ) {
+                Z_Free( ptr );
+            }
+        }
+    }
+    z_useSlabs = true;
+
+    Z_CheckHeap();
+
+    Com_Printf( "%-6s %10.0f ops/sec %8.1f ns/op\n", slabs ? "slabs" : "zone",
+        ops.size() * passes * 1e9 / MAX( ns, 1LL ), (double)ns / MAX( ops.size() * passes, (size_t)1 ) );
+    Com_Printf( "       main:  peak %9i, %6i free blocks, largest %9i\n", peakMain, freeBlocks[0], largest[0] );
+    Com_Printf( "       small: peak %9i, %6i free blocks, largest %9i\n", peakSmall, freeBlocks[1], largest[1] );
+}
+
+/*
+=================
+Com_ZoneReplay_f
+=================
+*/
+static void Com_ZoneReplay_f( void )
+{
+    char name[MAX_QPATH];
+    union {
+        int *header;
+        void *v;
+    } buf;
+    std::vector<zoneTraceOp_t> ops;
+    zoneTraceOp_t *src;
+    long len;
+    int numIds, passes, i;
+    int live, peak, smallLive, smallPeak;
+    std::vector<int> sizes;
+
+    if ( Cmd_Argc() < 2 ) {
+        Com_Printf( "usage: zonereplay <name> [passes]\n" );
+        return;
+    }
+    if ( z_capturing ) {
+        Com_Printf( "zonereplay: stop zonecapture first\n" );
+        return;
+    }
+    passes = Cmd_Argc() > 2 ? MAX( atoi( Cmd_Argv( 2 ) ), 1 ) : 1;
+
+    Com_sprintf( name, sizeof(name), "traces/%s.ztr", Cmd_Argv( 1 ) );
+    len = FS_ReadFile( name, &buf.v );
+    if ( len < 0 ) {
+        Com_Printf( "zonereplay: couldn't load %s\n", name );
+        return;
+    }
+    if ( len < (long)( 2 * sizeof(int) ) || LittleLong( buf.header[0] ) != ZONETRACE_IDENT
+        || LittleLong( buf.header[1] ) != ZONETRACE_VERSION ) {
+        Com_Printf( "zonereplay: %s is not a version %i zone trace\n", name, ZONETRACE_VERSION );
+        FS_FreeFile( buf.v );
+        return;
+    }
+
+    // check the trace and work out the most it keeps alive at once
+    src = (zoneTraceOp_t *)( buf.header + 2 );
+    ops.resize( ( len - 2 * sizeof(int) ) / sizeof(zoneTraceOp_t) );
+    numIds = 0;
+    live = peak = smallLive = smallPeak = 0;
+    for ( i = 0; i < (int)ops.size(); i++ ) {
+        ops[i].free = LittleLong( src[i].free );
+        ops[i].id = LittleLong( src[i].id );
+        ops[i].size = LittleLong( src[i].size );
+        ops[i].tag = LittleLong( src[i].tag );
+
+        if ( ops[i].id < 0 || ( !ops[i].free && ops[i].id != numIds )
+            || ( ops[i].free && ops[i].id >= numIds ) || ops[i].size < 0
+            || ( !ops[i].free && ( ops[i].tag <= TAG_FREE || ops[i].tag >= TAG_STATIC ) ) ) {
+            Com_Printf( "zonereplay: %s is corrupt at operation %i\n", name, i );
+            FS_FreeFile( buf.v );
+            return;
+        }
+
+        if ( !ops[i].free ) {
+            sizes.push_back( ops[i].tag == TAG_SMALL ? -Z_ReplaySize( ops[i].size ) : Z_ReplaySize( ops[i].size ) );
+            numIds++;
+        }
+        int &size = sizes[ops[i].id];
+        if ( size < 0 ) {
+            smallLive += ops[i].free ? size : -size;
+            smallPeak = MAX( smallPeak, smallLive );
+        } else {
+            live += ops[i].free ? -size : size;
+            peak = MAX( peak, live );
+        }
+        if ( ops[i].free ) {
+            size = 0;
+        }
+    }
+    FS_FreeFile( buf.v );
+
+    // leave room for the slab pages and for fragmentation
+    if ( peak + peak / 4 + SLAB_CLASSES * SLAB_PAGE_SIZE > Z_AvailableZoneMemory( mainzone )
+        || smallPeak + smallPeak / 4 + SLAB_CLASSES * SLAB_PAGE_SIZE > Z_AvailableZoneMemory( smallzone ) ) {
+        Com_Printf( "zonereplay: %s needs %i main and %i small zone bytes, only %i and %i are free\n", name,
+            peak, smallPeak, Z_AvailableZoneMemory( mainzone ), Z_AvailableZoneMemory( smallzone ) );
+        return;
+    }
+
+    Com_Printf( "zonereplay: %s, %i operations on %i blocks, %i passes\n", name, (int)ops.size(), numIds, passes );
+    Z_ReplayPass( ops, numIds, passes, false );
+    Z_ReplayPass( ops, numIds, passes, true );
+}
+
+/*
+==============================================================================
+
+ZONE PROFILE
+
+zoneprofile samples one zone allocation out of every N and keeps live
+bytes, peak live bytes and allocation counts per call site, each sample
+standing in for N allocations.  A call site is the ZONE_DEBUG file, line
+and label, or the return address into the caller of Z_Malloc, S_Malloc or
+Z_TagMalloc in builds without ZONE_DEBUG.  Sampled allocations also keep
+their backtrace where the platform has one, so that the folded dump can
+tell apart the callers of shared helpers like CopyString.  Sampled blocks
+carry ZONE_SAMPLED in their id so that frees of the rest cost nothing.
+==============================================================================
+*/
+
+#define ZONEPROFILE_DEFAULT_INTERVAL 64
+#define ZONEPROFILE_FRAMES 12
+
+typedef struct {
+    const char *label;
+    const char *file;
+    int line;
+    const void *caller;
+    int tag;
+    long long allocs;     // estimated, like the byte counts
+    long long bytes;      // allocated in total
+    long long live;
+    long long peak;
+} zoneSite_t;
+
+typedef struct {
+    int site;
+    int numFrames;
+    void *frames[ZONEPROFILE_FRAMES];  // innermost first
+    long long bytes;
+    long long live;
+} zoneStack_t;
+
+typedef struct {
+    int site;
+    int stack;
+    int bytes;
+} zoneSample_t;
+
+struct zoneSiteKey {
+    const void *where;  // file or caller
+    int line;
+    int tag;
+    bool operator==( const zoneSiteKey &other ) const
+    {
+        return where == other.where && line == other.line && tag == other.tag;
+    }
+};
+
+struct zoneSiteHash {
+    size_t operator()( const zoneSiteKey &key ) const
+    {
+        return std::hash<const void *>()( key.where ) ^ ( (size_t)key.line << 8 ) ^ key.tag;
+    }
+};
+
+static struct {
+    std::vector<zoneSite_t> *sites;
+    std::unordered_map<zoneSiteKey, int, zoneSiteHash> *siteNums;
+    std::vector<zoneStack_t> *stacks;
+    std::unordered_map<size_t, std::vector<int>> *stackNums;  // by hash
+    std::unordered_map<void *, zoneSample_t> *samples;
+    int startTime;
+} z_profile;
+
+/*
+=================
+Z_ProfileBacktrace
+=================
+*/
+static int Z_ProfileBacktrace( void **frames, int max )
+{
+#if defined( _WIN32 )
+    return CaptureStackBackTrace( 2, max, frames, NULL );
+#elif defined( __GLIBC__ ) || defined( __APPLE__ )
+    void *all[ZONEPROFILE_FRAMES + 2];
+    int n;
+
+    // leave out this function and Z_ProfileAlloc
+    n = backtrace( all, max + 2 ) - 2;
+    if ( n <= 0 ) {
+        return 0;
+    }
+    ::memcpy( frames, all + 2, n * sizeof(void *) );
+    return n;
+#else
+    return 0;
+#endif
+}
 
-NOTE: never write over the memory CopyString returns because
-memory from a memstatic_t might be returned
-========================
+/*
+=================
+Z_ProfileStack
+=================
 */
-char *CopyString( const char *in )
+static int Z_ProfileStack( int site )
 {
-    char *out;
+    zoneStack_t stack;
+    size_t hash;
+    int i;
 
-    if (!in[0]) {
-        return ((char *)&emptystring) + sizeof(memblock_t);
+    stack.site = site;
+    stack.numFrames = Z_ProfileBacktrace( stack.frames, ZONEPROFILE_FRAMES );
+    stack.bytes = stack.live = 0;
+
+    hash = site;
+    for ( i = 0; i < stack.numFrames; i++ ) {
+        hash = hash * 31 + std::hash<void *>()( stack.frames[i] );
     }
-    else if (!in[1]) {
-        if (in[0] >= '0' && in[0] <= '9') {
-            return ((char *)&numberstring[in[0]-'0']) + sizeof(memblock_t);
+
+    std::vector<int> &nums = ( *z_profile.stackNums )[hash];
+    for ( int num : nums ) {
+        const zoneStack_t &other = ( *z_profile.stacks )[num];
+        if ( other.site == site && other.numFrames == stack.numFrames
+            && !::memcmp( other.frames, stack.frames, stack.numFrames * sizeof(void *) ) ) {
+            return num;
         }
     }
-    out = (char*)S_Malloc(strlen(in)+1);
-    strcpy (out, in);
-    return out;
+    nums.push_back( (int)z_profile.stacks->size() );
+    z_profile.stacks->push_back( stack );
+    return nums.back();
 }
 
 /*
-==============================================================================
-
-Goals:
-    reproducable without history effects -- no out of memory errors on weird map to map changes
-    allow restarting of the client without fragmentation
-    minimize total pages in use at run time
-    minimize total pages needed during load time
-
-  Single block of memory with stack allocators coming from both ends towards the middle.
+=================
+Z_ProfileAlloc
+=================
+*/
+static void Z_ProfileAlloc( memblock_t *block, int size, int tag, const char *label, const char *file, int line,
+    const void *caller )
+{
+    zoneSiteKey key = { file ? (const void *)file : caller, line, tag };
+    zoneSample_t sample;
+    zoneSite_t *site;
+    zoneStack_t *stack;
+
+    z_profileCountdown = z_profileInterval;
+
+    auto it = z_profile.siteNums->find( key );
+    if ( it == z_profile.siteNums->end() ) {
+        zoneSite_t newSite = { label, file, line, file ? NULL : caller, tag, 0, 0, 0, 0 };
+        it = z_profile.siteNums->emplace( key, (int)z_profile.sites->size() ).first;
+        z_profile.sites->push_back( newSite );
+    }
 
-  One side is designated the temporary memory allocator.
+    sample.site = it->second;
+    sample.stack = Z_ProfileStack( sample.site );
+    sample.bytes = size * z_profileInterval;
 
-  Temporary memory can be allocated and freed in any order.
+    site = &( *z_profile.sites )[sample.site];
+    site->allocs += z_profileInterval;
+    site->bytes += sample.bytes;
+    site->live += sample.bytes;
+    site->peak = MAX( site->peak, site->live );
 
-  A highwater mark is kept of the most in use at any time.
+    stack = &( *z_profile.stacks )[sample.stack];
+    stack->bytes += sample.bytes;
+    stack->live += sample.bytes;
 
-  When there is no temporary memory allocated, the permanent and temp sides
-  can be switched, allowing the already touched temp memory to be used for
-  permanent storage.
+    ( *z_profile.samples )[block + 1] = sample;
+    block->id |= ZONE_SAMPLED;
+}
 
-  Temp memory must never be allocated on two ends at once, or fragmentation
-  could occur.
+/*
+=================
+Z_ProfileFree
+=================
+*/
+static void Z_ProfileFree( void *ptr )
+{
+    auto it = z_profile.samples->find( ptr );
 
-  If we have any in-use temp memory, additional temp allocations must come from
-  that side.
+    if ( it == z_profile.samples->end() ) {
+        return;
+    }
+    ( *z_profile.sites )[it->second.site].live -= it->second.bytes;
+    ( *z_profile.stacks )[it->second.stack].live -= it->second.bytes;
+    z_profile.samples->erase( it );
+}
 
-  If not, we can choose to make either side the new temp side and push future
-  permanent allocations to the other side.  Permanent allocations should be
-  kept on the side that has the current greatest wasted highwater mark.
+/*
+=================
+Z_ProfileAddress
 
-==============================================================================
+An offset into the module, which works with addr2line.  The engine goes
+by "engine", the path dladdr has for it is argv[0] which
+Sys_SetBinaryPath cuts down to a directory.
+=================
 */
+static void Z_ProfileAddress( const void *address, char *name, int size )
+{
+#ifndef _WIN32
+    static Dl_info engine;
+    Dl_info info;
 
+    if ( !engine.dli_fbase ) {
+        dladdr( (void *)Z_ProfileAddress, &engine );
+    }
+    if ( dladdr( address, &info ) && info.dli_fname ) {
+        Com_sprintf( name, size, "%s+0x%lx",
+            info.dli_fbase == engine.dli_fbase ? "engine" : COM_SkipPath( (char *)info.dli_fname ),
+            (unsigned long)( (const byte *)address - (const byte *)info.dli_fbase ) );
+        return;
+    }
+#endif
+    Com_sprintf( name, size, "%p", address );
+}
 
-#define HUNK_MAGIC      0x89537892
-#define HUNK_FREE_MAGIC 0x89537893
-
-typedef struct {
-    unsigned int magic;
-    unsigned int size;
-} hunkHeader_t;
-
-typedef struct {
-    int mark;
-    int permanent;
-    int temp;
-    int tempHighwater;
-} hunkUsed_t;
+/*
+=================
+Z_ProfileSiteName
+=================
+*/
+static void Z_ProfileSiteName( const zoneSite_t *site, char *name, int size )
+{
+    if ( site->file ) {
+        Com_sprintf( name, size, "%s:%i (%s)", site->file, site->line, site->label );
+    } else {
+        Z_ProfileAddress( site->caller, name, size );
+    }
+}
 
-typedef struct hunkblock_s {
-    int size;
-    byte printed;
-    struct hunkblock_s *next;
-    const char *label;
-    const char *file;
-    int line;
-} hunkblock_t;
+/*
+=================
+Z_ProfileTagName
+=================
+*/
+static const char *Z_ProfileTagName( int tag )
+{
+    switch ( tag ) {
+    case TAG_GENERAL:
+        return "general";
+    case TAG_BOTLIB:
+        return "botlib";
+    case TAG_RENDERER:
+        return "renderer";
+    case TAG_SMALL:
+        return "small";
+    default:
+        return va( "tag%i", tag );
+    }
+}
 
-static hunkblock_t *hunkblocks;
+/*
+=================
+Z_ProfileReset
+=================
+*/
+static void Z_ProfileReset( void )
+{
+    memblock_t *block;
 
-static hunkUsed_t hunk_low, hunk_high;
-static hunkUsed_t *hunk_permanent, *hunk_temp;
+    for ( auto &sample : *z_profile.samples ) {
+        block = (memblock_t *)sample.first - 1;
+        block->id &= ~ZONE_SAMPLED;
+    }
+    z_profile.samples->clear();
+    z_profile.sites->clear();
+    z_profile.siteNums->clear();
+    z_profile.stacks->clear();
+    z_profile.stackNums->clear();
+    z_profile.startTime = Sys_Milliseconds();
+    z_profileCountdown = z_profileInterval;
+}
 
-static byte* s_hunkData = NULL;
-static int s_hunkTotal;
+/*
+=================
+Z_ProfileList
+=================
+*/
+static void Z_ProfileList( int count )
+{
+    std::vector<int> order( z_profile.sites->size() );
+    const std::vector<zoneSite_t> &sites = *z_profile.sites;
+    char name[MAX_OSPATH];
+    float seconds;
+    long long live = 0;
+    int i;
 
-static int s_zoneTotal;
-static int s_smallZoneTotal;
+    for ( i = 0; i < (int)order.size(); i++ ) {
+        order[i] = i;
+        live += sites[i].live;
+    }
+    std::sort( order.begin(), order.end(), [&sites]( int a, int b ) { return sites[a].live > sites[b].live; } );
+
+    seconds = MAX( Sys_Milliseconds() - z_profile.startTime, 1 ) / 1000.0f;
+    Com_Printf( "zoneprofile: %s, sampling 1/%i, %i sites, %.1f seconds, %lld bytes live\n",
+        z_profileInterval ? "on" : "off", z_profileInterval ? z_profileInterval : ZONEPROFILE_DEFAULT_INTERVAL,
+        (int)order.size(), seconds, live );
+    Com_Printf( "      live       peak   allocs/s    bytes/s  tag       site\n" );
+    for ( i = 0; i < (int)order.size() && i < count; i++ ) {
+        const zoneSite_t &site = sites[order[i]];
+        Z_ProfileSiteName( &site, name, sizeof(name) );
+        Com_Printf( "%10lld %10lld %10.0f %10.0f  %-8s  %s\n", site.live, site.peak, site.allocs / seconds,
+            site.bytes / seconds, Z_ProfileTagName( site.tag ), name );
+    }
+}
 
 /*
 =================
-Com_Meminfo_f
+Z_ProfileDump
+
+One line per stack in the folded format of flamegraph.pl, weighted by
+live bytes, or by allocated bytes to show the churn.  The call site ends
+every stack, so it still reads by label where there are no backtraces.
 =================
 */
-void Com_Meminfo_f( void )
+static void Z_ProfileDump( const char *base, bool churn )
 {
-    memblock_t *block;
-    int zoneBytes, zoneBlocks;
-    int smallZoneBytes;
-    int botlibBytes, rendererBytes;
-    int unused;
+    char name[MAX_QPATH], frame[MAX_OSPATH];
+    std::string line;
+    fileHandle_t f;
+    long long weight;
+    int i;
 
-    zoneBytes = 0;
-    botlibBytes = 0;
-    rendererBytes = 0;
-    zoneBlocks = 0;
-    for (block = mainzone->blocklist.next ; ; block = block->next) {
-        if ( Cmd_Argc() != 1 ) {
-            Com_Printf ("block:%p    size:%7i    tag:%3i\n",
-                    (void *)block, block->size, block->tag);
-        }
-        if ( block->tag ) {
-            zoneBytes += block->size;
-            zoneBlocks++;
-            if ( block->tag == TAG_BOTLIB ) {
-                botlibBytes += block->size;
-            } else if ( block->tag == TAG_RENDERER ) {
-                rendererBytes += block->size;
-            }
-        }
+    Com_sprintf( name, sizeof(name), "profiles/%s.folded", base );
+    f = FS_FOpenFileWrite( name );
+    if ( !f ) {
+        Com_Printf( "zoneprofile: couldn't open %s\n", name );
+        return;
+    }
 
-        if (block->next == &mainzone->blocklist) {
-            break; // all blocks have been hit
-        }
-        if ( (byte *)block + block->size != (byte *)block->next) {
-            Com_Printf ("ERROR: block size does not touch the next block\n");
+    for ( const zoneStack_t &stack : *z_profile.stacks ) {
+        weight = churn ? stack.bytes : stack.live;
+        if ( weight <= 0 ) {
+            continue;
         }
-        if ( block->next->prev != block) {
-            Com_Printf ("ERROR: next block doesn't have proper back link\n");
+        const zoneSite_t &site = ( *z_profile.sites )[stack.site];
+
+        line = "zone;";
+        line += Z_ProfileTagName( site.tag );
+        // outermost first, the innermost frames are the zone itself
+        for ( i = stack.numFrames - 1; i >= 0; i-- ) {
+            Z_ProfileAddress( stack.frames[i], frame, sizeof(frame) );
+            line += ';';
+            line += frame;
         }
-        if ( !block->tag && !block->next->tag ) {
-            Com_Printf ("ERROR: two consecutive free blocks\n");
+        Z_ProfileSiteName( &site, frame, sizeof(frame) );
+        line += ';';
+        // ';' separates the frames
+        for ( char *c = frame; *c; c++ ) {
+            line += *c == ';' ? ':' : *c;
         }
+        line += va( " %lld\n", weight );
+        FS_Write( line.c_str(), line.size(), f );
     }
+    FS_FCloseFile( f );
+    Com_Printf( "zoneprofile: wrote %s\n", name );
+}
 
-    smallZoneBytes = 0;
-    for (block = smallzone->blocklist.next ; ; block = block->next)
-    {
-        if ( block->tag )
-            smallZoneBytes += block->size;
-
-        if (block->next == &smallzone->blocklist)
-            break; // all blocks have been hit
+/*
+=================
+Com_ZoneProfile_f
+=================
+*/
+static void Com_ZoneProfile_f( void )
+{
+    const char *cmd = Cmd_Argc() > 1 ? Cmd_Argv( 1 ) : "list";
+
+    if ( !z_profile.sites ) {
+        z_profile.sites = new std::vector<zoneSite_t>;
+        z_profile.siteNums = new std::unordered_map<zoneSiteKey, int, zoneSiteHash>;
+        z_profile.stacks = new std::vector<zoneStack_t>;
+        z_profile.stackNums = new std::unordered_map<size_t, std::vector<int>>;
+        z_profile.samples = new std::unordered_map<void *, zoneSample_t>;
+        z_profile.startTime = Sys_Milliseconds();
     }
 
-    Com_Printf( "%8i bytes total hunk\n", s_hunkTotal );
-    Com_Printf( "%8i bytes total zone\n", s_zoneTotal );
-    Com_Printf( "\n" );
-    Com_Printf( "%8i low mark\n", hunk_low.mark );
-    Com_Printf( "%8i low permanent\n", hunk_low.permanent );
-    if ( hunk_low.temp != hunk_low.permanent ) {
-        Com_Printf( "%8i low temp\n", hunk_low.temp );
-    }
-    Com_Printf( "%8i low tempHighwater\n", hunk_low.tempHighwater );
-    Com_Printf( "\n" );
-    Com_Printf( "%8i high mark\n", hunk_high.mark );
-    Com_Printf( "%8i high permanent\n", hunk_high.permanent );
-    if ( hunk_high.temp != hunk_high.permanent ) {
-        Com_Printf( "%8i high temp\n", hunk_high.temp );
-    }
-    Com_Printf( "%8i high tempHighwater\n", hunk_high.tempHighwater );
-    Com_Printf( "\n" );
-    Com_Printf( "%8i total hunk in use\n", hunk_low.permanent + hunk_high.permanent );
-    unused = 0;
-    if ( hunk_low.tempHighwater > hunk_low.permanent ) {
-        unused += hunk_low.tempHighwater - hunk_low.permanent;
-    }
-    if ( hunk_high.tempHighwater > hunk_high.permanent ) {
-        unused += hunk_high.tempHighwater - hunk_high.permanent;
+    if ( !Q_stricmp( cmd, "start" ) ) {
+        z_profileInterval = Cmd_Argc() > 2 ? MAX( atoi( Cmd_Argv( 2 ) ), 1 ) : ZONEPROFILE_DEFAULT_INTERVAL;
+        Z_ProfileReset();
+        Com_Printf( "zoneprofile: sampling 1 of every %i allocations\n", z_profileInterval );
+    } else if ( !Q_stricmp( cmd, "stop" ) ) {
+        // sampled blocks still count down as they are freed
+        z_profileInterval = 0;
+    } else if ( !Q_stricmp( cmd, "reset" ) ) {
+        Z_ProfileReset();
+    } else if ( !Q_stricmp( cmd, "list" ) ) {
+        Z_ProfileList( Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 20 );
+    } else if ( !Q_stricmp( cmd, "dump" ) && Cmd_Argc() > 2 ) {
+        Z_ProfileDump( Cmd_Argv( 2 ), Cmd_Argc() > 3 && !Q_stricmp( Cmd_Argv( 3 ), "churn" ) );
+    } else {
+        Com_Printf( "usage: zoneprofile start [interval] | stop | reset | list [count] | dump <name> [churn]\n" );
     }
-    Com_Printf( "%8i unused highwater\n", unused );
-    Com_Printf( "\n" );
-    Com_Printf( "%8i bytes in %i zone blocks\n", zoneBytes, zoneBlocks );
-    Com_Printf( "        %8i bytes in dynamic botlib\n", botlibBytes );
-    Com_Printf( "        %8i bytes in dynamic renderer\n", rendererBytes );
-    Com_Printf( "        %8i bytes in dynamic other\n", zoneBytes - ( botlibBytes + rendererBytes ) );
-    Com_Printf( "        %8i bytes in small Zone memory\n", smallZoneBytes );
 }
 
 /*
@@ -1736,16 +2960,29 @@ void Com_InitHunkMemory( void )
         s_hunkTotal = cv->integer * 1024 * 1024;
     }
 
-    s_hunkData = (byte*)calloc( s_hunkTotal + 31, 1 );
+    cv = Cvar_Get( "com_hunkHugePages", "0", CVAR_LATCH | CVAR_ARCHIVE );
+    Cvar_SetDescription(cv, "Back the hunk with huge pages, 1 for transparent and 2 for explicit ones");
+
+    // both banks commit and release whole chunks from their end of the
+    // hunk, which huge pages only accept on huge page boundaries
+    if ( cv->integer )
+    {
+        s_hunkTotal = PAD( s_hunkTotal, HUNK_COMMIT_CHUNK );
+    }
+
+    // only reserved, Hunk_Commit backs it with memory as it is used
+    s_hunkData = (byte*)Sys_ReserveMemory( s_hunkTotal, cv->integer );
     if ( !s_hunkData )
     {
-        Com_Error( ERR_FATAL, "Hunk data failed to allocate %i megs", s_hunkTotal / (1024*1024) );
+        Com_Error( ERR_FATAL, "Hunk data failed to reserve %i megs", s_hunkTotal / (1024*1024) );
     }
-    // cacheline align
-    s_hunkData = (byte *) ( ( (intptr_t)s_hunkData + 31 ) & ~31 );
+    s_hunkCommitLow = s_hunkCommitHigh = 0;
     Hunk_Clear();
 
     Cmd_AddCommand( "meminfo", Com_Meminfo_f );
+    Cmd_AddCommand( "zonecapture", Com_ZoneCapture_f );
+    Cmd_AddCommand( "zonereplay", Com_ZoneReplay_f );
+    Cmd_AddCommand( "zoneprofile", Com_ZoneProfile_f );
 #ifdef ZONE_DEBUG
     Cmd_AddCommand( "zonelog", Z_LogHeap );
 #endif
@@ -1844,6 +3081,13 @@ void Hunk_Clear( void )
 #ifdef HUNK_DEBUG
     hunkblocks = NULL;
 #endif
+
+    // nothing may look at the old contents from here on
+    if ( s_hunkData ) {
+        Hunk_EndMap();
+        Sys_ReleaseMemory( s_hunkData, s_hunkCommitLow );
+        Sys_ReleaseMemory( s_hunkData + s_hunkTotal - s_hunkCommitHigh, s_hunkCommitHigh );
+    }
 }
 
 static void Hunk_SwapBanks( void )
@@ -1923,6 +3167,7 @@ void *Hunk_Alloc( int size, ha_pref preference )
     }
 
     hunk_permanent->temp = hunk_permanent->permanent;
+    Hunk_Commit();
 
     ::memset( buf, 0, size );
 
@@ -1984,6 +3229,7 @@ void *Hunk_AllocateTempMemory( int size )
 
     if ( hunk_temp->temp > hunk_temp->tempHighwater )
         hunk_temp->tempHighwater = hunk_temp->temp;
+    Hunk_Commit();
 
     hdr = (hunkHeader_t *)buf;
     buf = (void *)(hdr+1);
@@ -2661,8 +3907,8 @@ Find out whether we have SSE support
 #if id386 || idx64
 static void Com_DetectSSE(void)
 {
-#if !idx64
     cpuFeatures_t feat = Sys_GetProcessorFeatures();
+#if !idx64
     if(feat & CF_SSE)
     {
         if(feat & CF_SSE2)
@@ -2680,6 +3926,15 @@ static void Com_DetectSSE(void)
         Com_Printf("No SSE support on this machine\n");
     }
 #endif
+
+    // the collision kernels are only built for x86_64, where SSE2 is a given
+    if(feat & CF_AVX)
+    {
+        Com_Printf("Have AVX support\n");
+        CM_InitKernels(CMK_AVX);
+    }
+    else
+        CM_InitKernels(CMK_SSE);
 }
 
 #else
@@ -2688,6 +3943,21 @@ static void Com_DetectSSE(void)
 
 #endif
 
+/*
+=================
+Com_SelectSIMD
+Point the collision code at the kernel com_simd asks for, or the best one
+this machine has below it
+=================
+*/
+static void Com_SelectSIMD(void)
+{
+    int kernel = CM_SetKernel((cmKernel_t)com_simd->integer);
+
+    if (kernel != com_simd->integer)
+        Cvar_Set("com_simd", va("%i", kernel));  // we don't have it!
+}
+
 /*
 =================
 Com_InitRand
@@ -2733,6 +4003,9 @@ static void Com_Init_after_FS_InitFilesystem( cb_context_t *context, int status
     Cmd_AddCommand ("quit", Com_Quit_f);
     Cmd_AddCommand ("colors", Com_Colors_f);
     Cmd_AddCommand ("changeVectors", MSG_ReportChangeVectors_f );
+    Cmd_AddCommand ("msg_huffcheck", MSG_HuffCheck_f );
+    Cmd_AddCommand ("cm_kernelcheck", CM_KernelCheck_f );
+    Cmd_AddCommand ("cm_threadcheck", CM_ThreadCheck_f );
     Cmd_AddCommand ("writeconfig", Com_WriteConfig_f );
     Cmd_SetCommandCompletionFunc( "writeconfig", Cmd_CompleteCfgName );
     Cmd_AddCommand("game_restart", Com_GameRestart_f);
@@ -2752,6 +4025,7 @@ static void Com_Init_after_FS_InitFilesystem( cb_context_t *context, int status
 #endif
     // allocate the stack based hunk allocator
     Com_InitHunkMemory();
+    Scratch_Init();
 
     // if any archived cvars are modified after this, we will trigger a writing
     // of the config file
@@ -2761,6 +4035,7 @@ static void Com_Init_after_FS_InitFilesystem( cb_context_t *context, int status
     // init commands and vars
     //
     com_altivec = Cvar_Get ("com_altivec", "1", CVAR_ARCHIVE);
+    com_simd = Cvar_Get ("com_simd", "1", CVAR_ARCHIVE);
     com_maxfps = Cvar_Get ("com_maxfps", "85", CVAR_ARCHIVE);
 
     com_logfile = Cvar_Get ("logfile", "0", CVAR_TEMP );
@@ -2776,6 +4051,10 @@ static void Com_Init_after_FS_InitFilesystem( cb_context_t *context, int status
     sv_paused = Cvar_Get ("sv_paused", "0", CVAR_ROM);
     cl_packetdelay = Cvar_Get ("cl_packetdelay", "0", CVAR_CHEAT);
     sv_packetdelay = Cvar_Get ("sv_packetdelay", "0", CVAR_CHEAT);
+    cl_packetjitter = Cvar_Get ("cl_packetjitter", "0", CVAR_CHEAT);
+    sv_packetjitter = Cvar_Get ("sv_packetjitter", "0", CVAR_CHEAT);
+    cl_packetloss = Cvar_Get ("cl_packetloss", "0", CVAR_CHEAT);
+    sv_packetloss = Cvar_Get ("sv_packetloss", "0", CVAR_CHEAT);
     com_sv_running = Cvar_Get ("sv_running", "0", CVAR_ROM);
     com_cl_running = Cvar_Get ("cl_running", "0", CVAR_ROM);
     com_buildScript = Cvar_Get( "com_buildScript", "0", 0 );
@@ -2829,6 +4108,8 @@ static void Com_Init_after_FS_InitFilesystem( cb_context_t *context, int status
 
     com_fullyInitialized = true;
 
+    Com_SelectSIMD();
+
     // always set the cvar, but only print the info if it makes sense.
     Com_DetectAltivec();
 #if idppc
@@ -3196,6 +4477,12 @@ void Com_Frame( void )
         com_altivec->modified = false;
     }
 
+    if ( com_simd->modified )
+    {
+        Com_SelectSIMD();
+        com_simd->modified = false;
+    }
+
     // mess with msec if needed
     msec = Com_ModifyMsec(msec);
 
@@ -3281,11 +4568,11 @@ void Com_Frame( void )
     //
     if ( com_showtrace->integer )
     {
-        extern int c_traces, c_brush_traces, c_patch_traces;
-        extern int c_pointcontents;
+        extern std::atomic<int> c_traces, c_brush_traces, c_patch_traces;
+        extern std::atomic<int> c_pointcontents;
 
         Com_Printf("%4i traces  (%ib %ip) %4i points\n",
-                c_traces, c_brush_traces, c_patch_traces, c_pointcontents);
+                c_traces.load(), c_brush_traces.load(), c_patch_traces.load(), c_pointcontents.load());
 
         c_traces = 0;
         c_brush_traces = 0;
@@ -3305,6 +4592,8 @@ Com_Shutdown
 */
 void Com_Shutdown(void)
 {
+    Jobs_Shutdown();
+
     if (logfile)
     {
         FS_FCloseFile (logfile);
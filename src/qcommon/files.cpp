@@ -47,6 +47,7 @@
 #include "q_platform.h"
 #include "q_shared.h"
 #include "qcommon.h"
+#include "scratch.h"
 #include "unzip.h"
 #include "vm.h"
 
@@ -1926,6 +1927,51 @@ long FS_ReadFile(const char *qpath, void **buffer)
 {
     return FS_ReadFileDir(qpath, nullptr, false, buffer);
 }
+/*
+============
+FS_ReadFileScratch
+
+Loads into the scratch arena of the calling thread instead of hunk temp
+memory, so there is nothing to free: the caller rewinds to a mark it took
+before.  Not for .cfg files, which skip the journal this way.
+============
+*/
+long FS_ReadFileScratch(const char *qpath, void **buffer)
+{
+    fileHandle_t h;
+    byte *buf;
+    long len;
+
+    if (!fs_searchpaths)
+    {
+        Com_Error(ERR_FATAL, "Filesystem call made without initialization");
+    }
+
+    if (!qpath || !qpath[0])
+    {
+        Com_Error(ERR_FATAL, "FS_ReadFileScratch with empty name");
+    }
+
+    *buffer = nullptr;
+    len = FS_FOpenFileRead(qpath, &h, false);
+    if (h == 0)
+    {
+        return -1;
+    }
+
+    fs_loadCount++;
+
+    buf = static_cast<byte *>(Scratch_Alloc(len + 1));
+    *buffer = buf;
+
+    FS_Read(buf, len, h);
+
+    // guarantee that it will have a trailing 0 for string operations
+    buf[len] = 0;
+    FS_FCloseFile(h);
+    return len;
+}
+
 /*
 =============
 FS_FreeFile
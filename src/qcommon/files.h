@@ -229,6 +229,7 @@ bool     FS_CompareZipChecksum (const char* zipfile);
 void         FS_WriteFile (const char* qpath, const void* buffer, int size);
 void         FS_FreeFile (void* buffer);
 long         FS_ReadFile (const char* qpath, void** buffer);
+long         FS_ReadFileScratch (const char* qpath, void** buffer);
 void         FS_Flush (fileHandle_t f);
 long         FS_ReadFileDir (const char* qpath, void* searchPath, bool unpure, void** buffer);
 int          FS_FileIsInPAK_A(bool alternate, const char *filename, int *pChecksum);
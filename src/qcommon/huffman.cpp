@@ -34,7 +34,8 @@ along with Tremulous; if not, see <https://www.gnu.org/licenses/>
 #include "q_shared.h"
 #include "qcommon.h"
 
-static int bloc = 0;
+// per thread, so snapshots can be encoded on the job pool
+static thread_local int bloc = 0;
 
 void Huff_putBit(int bit, uint8_t *fout, int *offset)
 {
@@ -433,6 +434,142 @@ void Huff_offsetTransmit(huff_t *huff, int ch, uint8_t *fout, int *offset, int m
     *offset = bloc;
 }
 
+/* Fill the lookup entries of every leaf within HUFF_LOOKUP_BITS of the root */
+static void Huff_fillLookup(huffTable_t *table, node_t *node, int prefix, int depth)
+{
+    int i;
+
+    if (!node)
+    {
+        return;
+    }
+
+    if (node->symbol != INTERNAL_NODE)
+    {
+        if (node->symbol == NYT)
+        {
+            return;
+        }
+        for (i = prefix; i < (1 << HUFF_LOOKUP_BITS); i += 1 << depth)
+        {
+            table->lookup[i] = node->symbol | (depth << 8);
+        }
+        return;
+    }
+
+    if (depth == HUFF_LOOKUP_BITS)
+    {
+        return;
+    }
+
+    Huff_fillLookup(table, node->left, prefix, depth + 1);
+    Huff_fillLookup(table, node->right, prefix | (1 << depth), depth + 1);
+}
+
+/* Flatten a finished tree into code and lookup tables */
+void Huff_BuildTable(huffTable_t *table, huff_t *encoder, node_t *decoder)
+{
+    node_t *node;
+    uint64_t code;
+    int ch, len;
+
+    memset(table, 0, sizeof(*table));
+    table->huff = encoder;
+    table->tree = decoder;
+
+    for (ch = 0; ch < HMAX; ch++)
+    {
+        // walk up from the leaf, so the last bit sent is found first
+        code = 0;
+        len = 0;
+        for (node = encoder->loc[ch]; node && node->parent; node = node->parent)
+        {
+            code = (code << 1) | (node->parent->right == node);
+            len++;
+        }
+
+        if (!node || len > 32)
+        {
+            continue;
+        }
+
+        table->code[ch] = (uint32_t)code;
+        table->length[ch] = len;
+    }
+
+    Huff_fillLookup(table, decoder, 0, 0);
+}
+
+/* Send a symbol, same output as Huff_offsetTransmit */
+void Huff_tableTransmit(const huffTable_t *table, int ch, uint8_t *fout, int *offset, int maxoffset)
+{
+    uint64_t bits;
+    uint8_t *out;
+    int len, shift, numBytes, i;
+
+    len = table->length[ch];
+    if (!len || *offset + len > maxoffset)
+    {
+        // the tree walk stops at maxoffset exactly the way callers expect
+        Huff_offsetTransmit(table->huff, ch, fout, offset, maxoffset);
+        return;
+    }
+
+    out = fout + (*offset >> 3);
+    shift = *offset & 7;
+    bits = (uint64_t)table->code[ch] << shift;
+    numBytes = (shift + len + 7) >> 3;
+
+    // a byte is cleared when its first bit is written, as add_bit does
+    out[0] = (shift ? out[0] : 0) | (uint8_t)bits;
+    for (i = 1; i < numBytes; i++)
+    {
+        out[i] = (uint8_t)(bits >> (i * 8));
+    }
+
+    *offset += len;
+}
+
+/* Get a symbol, same result as Huff_offsetReceive */
+void Huff_tableReceive(const huffTable_t *table, int *ch, uint8_t *fin, int *offset, int maxoffset)
+{
+    const uint8_t *in;
+    uint32_t window;
+    int entry, len, numBytes;
+
+    if (*offset >= maxoffset)
+    {
+        Huff_offsetReceive(table->tree, ch, fin, offset, maxoffset);
+        return;
+    }
+
+    // never touch bytes past maxoffset, they may be past the buffer
+    in = fin + (*offset >> 3);
+    numBytes = ((maxoffset + 7) >> 3) - (*offset >> 3);
+    window = in[0];
+    if (numBytes > 1)
+    {
+        window |= (uint32_t)in[1] << 8;
+    }
+    if (numBytes > 2)
+    {
+        window |= (uint32_t)in[2] << 16;
+    }
+    window >>= *offset & 7;
+
+    entry = table->lookup[window & ((1 << HUFF_LOOKUP_BITS) - 1)];
+    len = entry >> 8;
+    if (!len || *offset + len > maxoffset)
+    {
+        // long code, or one running into maxoffset
+        Huff_offsetReceive(table->tree, ch, fin, offset, maxoffset);
+        return;
+    }
+
+    *ch = entry & 0xff;
+    *offset += len;
+}
+
 void Huff_Decompress(struct msg_t *mbuf, int offset)
 {
     int ch, cch, i, j, size;
@@ -492,7 +629,6 @@ void Huff_Decompress(struct msg_t *mbuf, int offset)
     memcpy(mbuf->data + offset, seq, cch);
 }
 
-extern int oldsize;
 
 void Huff_Compress(struct msg_t *mbuf, int offset)
 {
@@ -39,6 +39,20 @@ typedef struct {
     huff_t decompressor;
 } huffman_t;
 
+/* Static code tables for a tree that is no longer being updated, such as the
+ * one built from msg_hData.  Codes are stored in transmission order with the
+ * first bit lowest, which is also the order bits are packed into bytes. */
+
+#define HUFF_LOOKUP_BITS 11
+
+typedef struct {
+    huff_t *huff; /* tree the codes were taken from, for the slow path */
+    node_t *tree; /* decoding tree, for codes longer than HUFF_LOOKUP_BITS */
+    uint32_t code[HMAX];
+    uint8_t length[HMAX]; /* 0 if the code needs more than 32 bits */
+    uint16_t lookup[1 << HUFF_LOOKUP_BITS]; /* symbol | length << 8, 0 for longer codes */
+} huffTable_t;
+
 void Huff_Compress(struct msg_t *buf, int offset);
 void Huff_Decompress(struct msg_t *buf, int offset);
 void Huff_Init(huffman_t *huff);
@@ -50,6 +64,10 @@ void Huff_offsetTransmit(huff_t *huff, int ch, uint8_t *fout, int *offset, int m
 void Huff_putBit(int bit, uint8_t *fout, int *offset);
 int Huff_getBit(uint8_t *fout, int *offset);
 
+void Huff_BuildTable(huffTable_t *table, huff_t *encoder, node_t *decoder);
+void Huff_tableTransmit(const huffTable_t *table, int ch, uint8_t *fout, int *offset, int maxoffset);
+void Huff_tableReceive(const huffTable_t *table, int *ch, uint8_t *fin, int *offset, int maxoffset);
+
 // don't use if you don't know what you're doing.
 int Huff_getBloc(void);
 void Huff_setBloc(int _bloc);
@@ -0,0 +1,223 @@
+/*
+===========================================================================
+Copyright (C) 2015-2019 GrangerHub
+
+This file is part of Tremulous.
+
+Tremulous is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 3 of the License,
+or (at your option) any later version.
+
+Tremulous is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Tremulous; if not, see <https://www.gnu.org/licenses/>
+
+===========================================================================
+*/
+
+#include "jobs.h"
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+#ifndef EMSCRIPTEN
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+/*
+=============================================================================
+
+Workers are started on first use and sleep on a condition variable between
+batches.  Every batch bumps jobGeneration; each worker checks in exactly once
+per generation, so the caller can return as soon as jobPending drops to zero.
+
+=============================================================================
+*/
+
+#ifndef EMSCRIPTEN
+
+struct jobBatch_t {
+    jobFunc_t func;
+    void *data;
+    int count;
+    int numWorkers;  // pool workers taking part, not counting the caller
+    std::atomic<int> next;
+};
+
+// none of the pool is destroyed at exit: Sys_Exit from a signal or Sys_Error
+// skips Jobs_Shutdown, and destroying a condition variable idle workers still
+// wait on blocks forever, just as a joinable std::thread would std::terminate
+static std::mutex &jobMutex = *new std::mutex;
+static std::condition_variable &jobWake = *new std::condition_variable;
+static std::condition_variable &jobDone = *new std::condition_variable;
+
+static std::thread *jobThreads[MAX_JOB_THREADS];
+static int jobNumThreads;
+
+static jobBatch_t jobBatch;
+static int jobGeneration;
+static int jobPending;
+static bool jobQuit;
+
+static thread_local bool jobInside;
+
+/*
+==================
+Jobs_RunBatch
+==================
+*/
+static void Jobs_RunBatch(jobBatch_t *batch, int thread)
+{
+    int index;
+
+    jobInside = true;
+    while ((index = batch->next.fetch_add(1)) < batch->count)
+    {
+        batch->func(batch->data, index, thread);
+    }
+    jobInside = false;
+}
+
+/*
+==================
+Jobs_Worker
+==================
+*/
+static void Jobs_Worker(int workerNum, int generation)
+{
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobWake.wait(lock, [&] { return jobQuit || jobGeneration != generation; });
+            if (jobQuit)
+            {
+                return;
+            }
+            generation = jobGeneration;
+        }
+
+        if (workerNum < jobBatch.numWorkers)
+        {
+            Jobs_RunBatch(&jobBatch, workerNum + 1);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            if (--jobPending == 0)
+            {
+                jobDone.notify_one();
+            }
+        }
+    }
+}
+
+/*
+==================
+Jobs_ParallelFor
+==================
+*/
+void Jobs_ParallelFor(int numThreads, int count, jobFunc_t func, void *data)
+{
+    int i;
+
+    if (numThreads > count)
+    {
+        numThreads = count;
+    }
+    if (numThreads > MAX_JOB_THREADS + 1)
+    {
+        numThreads = MAX_JOB_THREADS + 1;
+    }
+
+    if (numThreads <= 1 || jobInside)
+    {
+        for (i = 0; i < count; i++)
+        {
+            func(data, i, 0);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+
+        // grow the pool, new workers start out waiting for the next generation
+        while (jobNumThreads < numThreads - 1)
+        {
+            jobThreads[jobNumThreads] = new std::thread(Jobs_Worker, jobNumThreads, jobGeneration);
+            jobNumThreads++;
+        }
+
+        jobBatch.func = func;
+        jobBatch.data = data;
+        jobBatch.count = count;
+        jobBatch.numWorkers = numThreads - 1;
+        jobBatch.next = 0;
+        jobPending = jobNumThreads;
+        jobGeneration++;
+    }
+    jobWake.notify_all();
+
+    Jobs_RunBatch(&jobBatch, 0);
+
+    std::unique_lock<std::mutex> lock(jobMutex);
+    jobDone.wait(lock, [] { return jobPending == 0; });
+}
+
+/*
+==================
+Jobs_NumWorkers
+==================
+*/
+int Jobs_NumWorkers(void) { return jobNumThreads; }
+
+/*
+==================
+Jobs_Shutdown
+==================
+*/
+void Jobs_Shutdown(void)
+{
+    int i;
+
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        jobQuit = true;
+    }
+    jobWake.notify_all();
+
+    for (i = 0; i < jobNumThreads; i++)
+    {
+        jobThreads[i]->join();
+        delete jobThreads[i];
+        jobThreads[i] = NULL;
+    }
+    jobNumThreads = 0;
+    jobQuit = false;
+}
+
+#else
+
+void Jobs_ParallelFor(int numThreads, int count, jobFunc_t func, void *data)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        func(data, i, 0);
+    }
+}
+
+int Jobs_NumWorkers(void) { return 0; }
+void Jobs_Shutdown(void) {}
+
+#endif
@@ -0,0 +1,45 @@
+/*
+===========================================================================
+Copyright (C) 2015-2019 GrangerHub
+
+This file is part of Tremulous.
+
+Tremulous is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 3 of the License,
+or (at your option) any later version.
+
+Tremulous is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Tremulous; if not, see <https://www.gnu.org/licenses/>
+
+===========================================================================
+*/
+
+#ifndef QCOMMON_JOBS_H
+#define QCOMMON_JOBS_H 1
+
+//
+// jobs.cpp -- a small fork/join worker pool
+//
+// Jobs_ParallelFor calls func( data, index, thread ) once for every index
+// in [0, count) spread over up to numThreads threads, and returns when all
+// of them have finished.  thread is 0 for the calling thread and
+// 1..numThreads-1 for pool workers, so callers can keep per-thread scratch
+// space.  Job functions must not call Com_Printf, Com_Error or the zone
+// allocator.  Nested calls from inside a job run serially.
+//
+
+#define MAX_JOB_THREADS 32
+
+typedef void (*jobFunc_t)(void *data, int index, int thread);
+
+void Jobs_ParallelFor(int numThreads, int count, jobFunc_t func, void *data);
+int Jobs_NumWorkers(void);
+void Jobs_Shutdown(void);
+
+#endif
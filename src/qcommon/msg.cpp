@@ -25,12 +25,15 @@ along with Tremulous; if not, see <https://www.gnu.org/licenses/>
 #include "msg.h"
 
 #include "alternatePlayerstate.h"
+#include "cmd.h"
 #include "cvar.h"
 #include "huffman.h"
+#include "net.h"
 #include "q_shared.h"
 #include "qcommon.h"
 
 static huffman_t msgHuff;
+static huffTable_t msgHuffTable;
 
 static bool msgInit = false;
 
@@ -45,7 +48,7 @@ Handles uint8_t ordering and avoids alignment errors
 ==============================================================================
 */
 
-int oldsize = 0;
+static thread_local int oldsize = 0;
 
 void MSG_initHuffman(void);
 
@@ -113,7 +116,7 @@ bit functions
 =============================================================================
 */
 
-int overflows;
+static thread_local int overflows;
 
 // negative bit values include signs
 void MSG_WriteBits(msg_t *msg, int value, int bits)
@@ -214,7 +217,7 @@ void MSG_WriteBits(msg_t *msg, int value, int bits)
         {
             for (i = 0; i < bits; i += 8)
             {
-                Huff_offsetTransmit(&msgHuff.compressor, (value & 0xff), msg->data, &msg->bit, msg->maxsize << 3);
+                Huff_tableTransmit(&msgHuffTable, (value & 0xff), msg->data, &msg->bit, msg->maxsize << 3);
                 value = (value >> 8);
 
                 if (msg->bit > msg->maxsize << 3)
@@ -228,6 +231,61 @@ void MSG_WriteBits(msg_t *msg, int value, int bits)
     }
 }
 
+/*
+============
+MSG_WriteEncodedBits
+
+Appends bits that were already written to the start of another bitstream
+message.  Huffman codes don't depend on where they start, so this gives the
+same result as repeating the writes.  Bits past numBits in the last byte of
+data must be zero, as they are in any message written from the start.
+============
+*/
+void MSG_WriteEncodedBits(msg_t *msg, const uint8_t *data, int numBits)
+{
+    uint8_t *out;
+    int shift;
+    int numBytes, outBytes;
+    int i;
+
+    if (msg->overflowed || !numBits)
+    {
+        return;
+    }
+
+    if (msg->bit + numBits > msg->maxsize << 3)
+    {
+        msg->overflowed = true;
+        return;
+    }
+
+    out = msg->data + (msg->bit >> 3);
+    shift = msg->bit & 7;
+    numBytes = (numBits + 7) >> 3;
+
+    if (!shift)
+    {
+        ::memcpy(out, data, numBytes);
+    }
+    else
+    {
+        outBytes = ((msg->bit + numBits + 7) >> 3) - (msg->bit >> 3);
+
+        out[0] &= (1 << shift) - 1;
+        for (i = 0; i < numBytes; i++)
+        {
+            out[i] |= data[i] << shift;
+            if (i + 1 < outBytes)
+            {
+                out[i + 1] = data[i] >> (8 - shift);
+            }
+        }
+    }
+
+    msg->bit += numBits;
+    msg->cursize = (msg->bit >> 3) + 1;
+}
+
 int MSG_ReadBits(msg_t *msg, int bits)
 {
     int value;
@@ -305,7 +363,7 @@ int MSG_ReadBits(msg_t *msg, int bits)
         {
             for (int i = 0; i < bits; i += 8)
             {
-                Huff_offsetReceive(msgHuff.decompressor.tree, &get, msg->data, &msg->bit, msg->cursize << 3);
+                Huff_tableReceive(&msgHuffTable, &get, msg->data, &msg->bit, msg->cursize << 3);
                 value |= (get << (i + nbits));
 
                 if (msg->bit > msg->cursize << 3)
@@ -2208,6 +2266,147 @@ void MSG_initHuffman(void)
             Huff_addRef(&msgHuff.decompressor, (uint8_t)i);  // Do update
         }
     }
+
+    // the tree never changes from here on, so code it through tables
+    Huff_BuildTable(&msgHuffTable, &msgHuff.compressor, msgHuff.decompressor.tree);
+}
+
+/*
+=================
+MSG_HuffCheck_f
+
+Codes random and edge case byte streams through the static Huffman tables and
+through the msg_hData tree walk, and reports any stream where they disagree
+=================
+*/
+void MSG_HuffCheck_f(void)
+{
+    static uint8_t symbols[MAX_MSGLEN];
+    static uint8_t treeBuf[MAX_MSGLEN], tableBuf[MAX_MSGLEN];
+    int seed = 0x1234;
+    int count, streams, numSymbols, mismatches, roundTrips;
+    int i, j, len, start, maxoffset;
+    int treeOffset, tableOffset, treeCh, tableCh;
+    bool overflowed;
+
+    if (!msgInit)
+    {
+        MSG_initHuffman();
+    }
+
+    count = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : 1000;
+    streams = numSymbols = mismatches = roundTrips = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        // empty, all zero, all 0xff and full length streams, then random ones
+        switch (i & 7)
+        {
+            case 0:
+                len = 0;
+                break;
+            case 3:
+                len = MAX_MSGLEN;
+                break;
+            default:
+                len = 1 + (int)(Q_random(&seed) * 1399);
+                break;
+        }
+        for (j = 0; j < len; j++)
+        {
+            if ((i & 7) == 1)
+            {
+                symbols[j] = 0;
+            }
+            else if ((i & 7) == 2)
+            {
+                symbols[j] = 0xff;
+            }
+            else
+            {
+                symbols[j] = (int)(Q_random(&seed) * 256) & 0xff;
+            }
+        }
+
+        // odd start bits, and a limit that is often hit part way through
+        start = (int)(Q_random(&seed) * 64);
+        maxoffset = MAX_MSGLEN << 3;
+        if ((i & 8) && start + len * 10 < maxoffset)
+        {
+            maxoffset = start + (int)(Q_random(&seed) * len * 10);
+        }
+
+        // the coders must leave untouched bytes alone, so start from the same
+        // noise; like a message being written, nothing is set from start on
+        for (j = 0; j < MAX_MSGLEN; j++)
+        {
+            treeBuf[j] = tableBuf[j] = (int)(Q_random(&seed) * 256) & 0xff;
+        }
+        treeBuf[start >> 3] &= (1 << (start & 7)) - 1;
+        tableBuf[start >> 3] = treeBuf[start >> 3];
+
+        streams++;
+        overflowed = false;
+        treeOffset = tableOffset = start;
+        for (j = 0; j < len && !overflowed; j++)
+        {
+            Huff_offsetTransmit(&msgHuff.compressor, symbols[j], treeBuf, &treeOffset, maxoffset);
+            Huff_tableTransmit(&msgHuffTable, symbols[j], tableBuf, &tableOffset, maxoffset);
+            if (treeOffset != tableOffset)
+            {
+                break;
+            }
+            // MSG_WriteBits gives up on the message at this point
+            overflowed = treeOffset > maxoffset;
+        }
+        if (treeOffset != tableOffset || ::memcmp(treeBuf, tableBuf, sizeof(treeBuf)))
+        {
+            mismatches++;
+            continue;
+        }
+
+        // read it back, stopping where the writer stopped
+        len = j;
+        treeOffset = tableOffset = start;
+        for (j = 0; j < len; j++)
+        {
+            Huff_offsetReceive(msgHuff.decompressor.tree, &treeCh, treeBuf, &treeOffset, maxoffset);
+            Huff_tableReceive(&msgHuffTable, &tableCh, treeBuf, &tableOffset, maxoffset);
+            numSymbols++;
+            if (treeCh != tableCh || treeOffset != tableOffset)
+            {
+                mismatches++;
+                break;
+            }
+            if (treeOffset <= maxoffset && treeCh != symbols[j])
+            {
+                roundTrips++;
+                break;
+            }
+        }
+
+        // and decode the noise past it as if it were a corrupt message
+        maxoffset = tableOffset + (int)(Q_random(&seed) * 4096);
+        if (maxoffset > MAX_MSGLEN << 3)
+        {
+            maxoffset = MAX_MSGLEN << 3;
+        }
+        treeOffset = tableOffset;
+        while (treeOffset < maxoffset)
+        {
+            Huff_offsetReceive(msgHuff.decompressor.tree, &treeCh, tableBuf, &treeOffset, maxoffset);
+            Huff_tableReceive(&msgHuffTable, &tableCh, tableBuf, &tableOffset, maxoffset);
+            numSymbols++;
+            if (treeCh != tableCh || treeOffset != tableOffset)
+            {
+                mismatches++;
+                break;
+            }
+        }
+    }
+
+    Com_Printf("%i streams, %i symbols decoded\n", streams, numSymbols);
+    Com_Printf("%i mismatches against the tree walk, %i round trip failures\n", mismatches, roundTrips);
 }
 
 /*
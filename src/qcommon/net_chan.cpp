@@ -476,61 +476,217 @@ void NET_SendLoopPacket(netsrc_t sock, int length, const void *data, netadr_t to
 
 //=============================================================================
 
-typedef struct packetQueue_s {
-    struct packetQueue_s *next;
+/*
+=============================================================================
+
+Simulated latency (cl_packetdelay / sv_packetdelay, plus *_packetjitter and
+*_packetloss).  Delayed packets are copied into a fixed pool and hung off a
+timing wheel with one slot per millisecond, so queueing and releasing are
+O(1) no matter how many clients are being lagged.
+
+=============================================================================
+*/
+
+#define PACKET_QUEUE_SIZE 1024
+#define PACKET_WHEEL_SIZE 1024  // must be a power of two, longer than any delay
+
+typedef struct {
+    int next;  // next packet in the same wheel slot or the free list, -1 ends
+    int release;
     int length;
-    byte *data;
+    byte *data;  // buffer, or a zone block for packets too big for it
     netadr_t to;
-    int release;
-} packetQueue_t;
+    byte buffer[MAX_PACKETLEN];
+} queuedPacket_t;
+
+static queuedPacket_t packetPool[PACKET_QUEUE_SIZE];
+static int packetFree = -1;
+static bool packetPoolInit = false;
+
+static int packetWheelHead[PACKET_WHEEL_SIZE];
+static int packetWheelTail[PACKET_WHEEL_SIZE];
+static int packetWheelTime;  // every slot before this has been released
+static int packetsQueued;
+
+/*
+===============
+NET_InitPacketQueue
+===============
+*/
+static void NET_InitPacketQueue(void)
+{
+    int i;
+
+    for (i = 0; i < PACKET_QUEUE_SIZE; i++)
+    {
+        packetPool[i].next = i + 1 < PACKET_QUEUE_SIZE ? i + 1 : -1;
+    }
+    packetFree = 0;
+
+    for (i = 0; i < PACKET_WHEEL_SIZE; i++)
+    {
+        packetWheelHead[i] = packetWheelTail[i] = -1;
+    }
+    packetsQueued = 0;
+    packetPoolInit = true;
+}
 
-packetQueue_t *packetQueue = NULL;
+/*
+===============
+NET_QueuePacket
 
-static void NET_QueuePacket(int length, const void *data, netadr_t to, int offset)
+Returns false if the packet was not queued and should be sent right away
+===============
+*/
+static bool NET_QueuePacket(int length, const void *data, netadr_t to, int offset, int jitter, float loss)
 {
-    packetQueue_t *_new, *next = packetQueue;
+    queuedPacket_t *packet;
+    int now, delay;
+    int index, slot;
+
+    if (loss > 0.0f && random() * 100.0f < loss)
+    {
+        return true;
+    }
 
     if (offset > 999) offset = 999;
+    if (jitter > 0)
+    {
+        if (jitter > 999) jitter = 999;
+        offset += rand() % (jitter + 1);
+    }
 
-    _new = (packetQueue_t *)S_Malloc(sizeof(packetQueue_t));
-    _new->data = (byte *)S_Malloc(length);
-    ::memcpy(_new->data, data, length);
-    _new->length = length;
-    _new->to = to;
-    _new->release = Sys_Milliseconds() + (int)((float)offset / com_timescale->value);
-    _new->next = NULL;
+    if (offset <= 0)
+    {
+        return false;
+    }
 
-    if (!packetQueue)
+    if (!packetPoolInit)
     {
-        packetQueue = _new;
-        return;
+        NET_InitPacketQueue();
     }
-    while (next)
+
+    if (packetFree < 0)
     {
-        if (!next->next)
-        {
-            next->next = _new;
-            return;
-        }
-        next = next->next;
+        return false;
+    }
+
+    delay = (int)((float)offset / com_timescale->value);
+    if (delay >= PACKET_WHEEL_SIZE)
+    {
+        delay = PACKET_WHEEL_SIZE - 1;
+    }
+
+    now = Sys_Milliseconds();
+    if (!packetsQueued)
+    {
+        // the wheel is empty, so it can jump straight to the present
+        packetWheelTime = now;
     }
+
+    index = packetFree;
+    packet = &packetPool[index];
+    packetFree = packet->next;
+
+    if (length <= MAX_PACKETLEN)
+    {
+        packet->data = packet->buffer;
+    }
+    else
+    {
+        packet->data = (byte *)Z_Malloc(length);
+    }
+    ::memcpy(packet->data, data, length);
+    packet->length = length;
+    packet->to = to;
+    packet->release = now + delay;
+    packet->next = -1;
+
+    // sent once the clock is past release, like the list this replaces
+    slot = (packet->release + 1) & (PACKET_WHEEL_SIZE - 1);
+    if (packetWheelTail[slot] < 0)
+    {
+        packetWheelHead[slot] = index;
+    }
+    else
+    {
+        packetPool[packetWheelTail[slot]].next = index;
+    }
+    packetWheelTail[slot] = index;
+    packetsQueued++;
+
+    return true;
 }
 
+/*
+===============
+NET_FlushPacketQueue
+===============
+*/
 void NET_FlushPacketQueue(void)
 {
-    packetQueue_t *last;
-    int now;
+    queuedPacket_t *packet;
+    int now, time, end;
+    int slot, index, next, tail;
+
+    if (!packetsQueued)
+    {
+        return;
+    }
 
-    while (packetQueue)
+    now = Sys_Milliseconds();
+    time = packetWheelTime;
+
+    // after a long stall one turn of the wheel visits every slot
+    end = now;
+    if (end - time >= PACKET_WHEEL_SIZE)
     {
-        now = Sys_Milliseconds();
-        if (packetQueue->release >= now) break;
-        Sys_SendPacket(packetQueue->length, packetQueue->data, packetQueue->to);
-        last = packetQueue;
-        packetQueue = packetQueue->next;
-        Z_Free(last->data);
-        Z_Free(last);
+        time = end - PACKET_WHEEL_SIZE + 1;
     }
+
+    NET_BeginSendBatch();
+    for (; time <= end && packetsQueued; time++)
+    {
+        slot = time & (PACKET_WHEEL_SIZE - 1);
+        index = packetWheelHead[slot];
+        packetWheelHead[slot] = packetWheelTail[slot] = -1;
+
+        for (; index >= 0; index = next)
+        {
+            packet = &packetPool[index];
+            next = packet->next;
+
+            // a packet from a later turn of the wheel stays where it is
+            if (packet->release >= now)
+            {
+                packet->next = -1;
+                tail = packetWheelTail[slot];
+                if (tail < 0)
+                {
+                    packetWheelHead[slot] = index;
+                }
+                else
+                {
+                    packetPool[tail].next = index;
+                }
+                packetWheelTail[slot] = index;
+                continue;
+            }
+
+            Sys_SendPacket(packet->length, packet->data, packet->to);
+            if (packet->data != packet->buffer)
+            {
+                Z_Free(packet->data);
+            }
+
+            packet->next = packetFree;
+            packetFree = index;
+            packetsQueued--;
+        }
+    }
+    NET_FlushSendBatch();
+
+    packetWheelTime = now + 1;
 }
 
 void NET_SendPacket(netsrc_t sock, int length, const void *data, netadr_t to)
@@ -551,18 +707,26 @@ void NET_SendPacket(netsrc_t sock, int length, const void *data, netadr_t to)
         return;
     }
 
-    if (sock == NS_CLIENT && cl_packetdelay->integer > 0)
-    {
-        NET_QueuePacket(length, data, to, cl_packetdelay->integer);
-    }
-    else if (sock == NS_SERVER && sv_packetdelay->integer > 0)
+    if (sock == NS_CLIENT && (cl_packetdelay->integer > 0 || cl_packetjitter->integer > 0 ||
+                                 cl_packetloss->value > 0.0f))
     {
-        NET_QueuePacket(length, data, to, sv_packetdelay->integer);
+        if (NET_QueuePacket(length, data, to, cl_packetdelay->integer, cl_packetjitter->integer,
+                            cl_packetloss->value))
+        {
+            return;
+        }
     }
-    else
+    else if (sock == NS_SERVER && (sv_packetdelay->integer > 0 || sv_packetjitter->integer > 0 ||
+                                      sv_packetloss->value > 0.0f))
     {
-        Sys_SendPacket(length, data, to);
+        if (NET_QueuePacket(length, data, to, sv_packetdelay->integer, sv_packetjitter->integer,
+                            sv_packetloss->value))
+        {
+            return;
+        }
     }
+
+    Sys_SendPacket(length, data, to);
 }
 
 /*
@@ -89,6 +89,12 @@ static bool winsockInitialized = false;
 #include <sys/filio.h>
 #endif
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#define NET_EPOLL 1
+#define NET_SENDMMSG 1
+#endif
+
 typedef int SOCKET;
 #define INVALID_SOCKET -1
 #define SOCKET_ERROR -1
@@ -156,6 +162,44 @@ typedef struct {
 static nip_localaddr_t localIP[MAX_IPS];
 static int numIP;
 
+// counters for net_stats
+typedef struct {
+    int waits;  // select / epoll_wait calls
+    int recvCalls;  // recvfrom / recvmmsg calls
+    int recvPackets;
+    int sendCalls;  // sendto / sendmmsg calls
+    int sendPackets;
+} netStats_t;
+
+static netStats_t netStats;
+
+#ifdef NET_EPOLL
+#define NET_RECV_BATCH 32
+
+static int epollFd = -1;
+
+static uint8_t recvData[NET_RECV_BATCH][MAX_MSGLEN + 1];
+static struct sockaddr_storage recvAddrs[NET_RECV_BATCH];
+static struct iovec recvIovecs[NET_RECV_BATCH];
+static struct mmsghdr recvMsgs[NET_RECV_BATCH];
+#endif
+
+#ifdef NET_SENDMMSG
+#define NET_SEND_BATCH 64
+#define NET_SEND_BYTES 0x20000
+
+static bool sendBatching;
+static int numSendQueued;
+static int sendBytesUsed;
+
+static uint8_t sendData[NET_SEND_BYTES];
+static SOCKET sendSockets[NET_SEND_BATCH];
+static netadrtype_t sendTypes[NET_SEND_BATCH];
+static struct sockaddr_storage sendAddrs[NET_SEND_BATCH];
+static struct iovec sendIovecs[NET_SEND_BATCH];
+static struct mmsghdr sendMsgs[NET_SEND_BATCH];
+#endif
+
 //=============================================================================
 
 /*
@@ -552,6 +596,56 @@ bool NET_CompareAdr(netadr_t a, netadr_t b)
 bool NET_IsLocalAddress(netadr_t adr) { return (bool)(adr.type == NA_LOOPBACK); }
 //=============================================================================
 
+/*
+==================
+NET_ParsePacket
+
+Fills in the sender and message size for a datagram of ret bytes that was
+received into net_message->data.  Returns false if it should be dropped.
+==================
+*/
+static bool NET_ParsePacket(
+    int alternateProtocol, struct sockaddr_storage *from, socklen_t fromlen, int ret, netadr_t *net_from, msg_t *net_message)
+{
+    if (from->ss_family == AF_INET)
+    {
+        memset(((struct sockaddr_in *)from)->sin_zero, 0, 8);
+    }
+
+    //SOCKS
+    if (usingSocks && from->ss_family == AF_INET && memcmp(from, &socksRelayAddr, fromlen) == 0)
+    {
+        if (ret < 10 || net_message->data[0] != 0 || net_message->data[1] != 0 ||
+            net_message->data[2] != 0 || net_message->data[3] != 1)
+        {
+            return false;
+        }
+        net_from->type = NA_IP;
+        net_from->ip[0] = net_message->data[4];
+        net_from->ip[1] = net_message->data[5];
+        net_from->ip[2] = net_message->data[6];
+        net_from->ip[3] = net_message->data[7];
+        net_from->port = *(short *)&net_message->data[8];
+        net_message->readcount = 10;
+    }
+    else
+    {
+        SockadrToNetadr((struct sockaddr *)from, net_from);
+        net_message->readcount = 0;
+    }
+
+    net_from->alternateProtocol = alternateProtocol;
+
+    if (ret >= net_message->maxsize)
+    {
+        Com_Printf("Oversize packet from %s\n", NET_AdrToString(*net_from));
+        return false;
+    }
+
+    net_message->cursize = ret;
+    return true;
+}
+
 /*
 ==================
 NET_GetPacket
@@ -575,6 +669,7 @@ bool NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
             fromlen = sizeof(from);
             ret = recvfrom(
                 ip_sockets[a], (char *)net_message->data, net_message->maxsize, 0, (struct sockaddr *)&from, &fromlen);
+            netStats.recvCalls++;
 
             if (ret == SOCKET_ERROR)
             {
@@ -584,40 +679,8 @@ bool NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
             }
             else
             {
-                memset(((struct sockaddr_in *)&from)->sin_zero, 0, 8);
-
-                //SOCKS
-                if (usingSocks && memcmp(&from, &socksRelayAddr, fromlen) == 0)
-                {
-                    if (ret < 10 || net_message->data[0] != 0 || net_message->data[1] != 0 ||
-                        net_message->data[2] != 0 || net_message->data[3] != 1)
-                    {
-                        return false;
-                    }
-                    net_from->type = NA_IP;
-                    net_from->ip[0] = net_message->data[4];
-                    net_from->ip[1] = net_message->data[5];
-                    net_from->ip[2] = net_message->data[6];
-                    net_from->ip[3] = net_message->data[7];
-                    net_from->port = *(short *)&net_message->data[8];
-                    net_message->readcount = 10;
-                }
-                else
-                {
-                    SockadrToNetadr((struct sockaddr *)&from, net_from);
-                    net_message->readcount = 0;
-                }
-
-                net_from->alternateProtocol = a;
-
-                if (ret >= net_message->maxsize)
-                {
-                    Com_Printf("Oversize packet from %s\n", NET_AdrToString(*net_from));
-                    return false;
-                }
-
-                net_message->cursize = ret;
-                return true;
+                netStats.recvPackets++;
+                return NET_ParsePacket(a, &from, fromlen, ret, net_from, net_message);
             }
         }
 
@@ -626,6 +689,7 @@ bool NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
             fromlen = sizeof(from);
             ret = recvfrom(
                 ip6_sockets[a], (char *)net_message->data, net_message->maxsize, 0, (struct sockaddr *)&from, &fromlen);
+            netStats.recvCalls++;
 
             if (ret == SOCKET_ERROR)
             {
@@ -635,19 +699,8 @@ bool NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
             }
             else
             {
-                SockadrToNetadr((struct sockaddr *)&from, net_from);
-                net_message->readcount = 0;
-
-                net_from->alternateProtocol = a;
-
-                if (ret >= net_message->maxsize)
-                {
-                    Com_Printf("Oversize packet from %s\n", NET_AdrToString(*net_from));
-                    return false;
-                }
-
-                net_message->cursize = ret;
-                return true;
+                netStats.recvPackets++;
+                return NET_ParsePacket(a, &from, fromlen, ret, net_from, net_message);
             }
         }
 
@@ -690,6 +743,137 @@ bool NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 
 static char socksBuf[4096];
 
+/*
+==================
+NET_SendError
+
+Reports a failed send, unless the failure is expected
+==================
+*/
+static void NET_SendError(int err, netadrtype_t type)
+{
+    // wouldblock is silent
+    if (err == EAGAIN)
+    {
+        return;
+    }
+
+    // some PPP links do not allow broadcasts and return an error
+    if ((err == EADDRNOTAVAIL) && ((type == NA_BROADCAST)))
+    {
+        return;
+    }
+
+    Com_Printf("Sys_SendPacket: %s\n", NET_ErrorString());
+}
+
+#ifdef NET_SENDMMSG
+/*
+==================
+NET_SendQueued
+
+Sends everything queued since NET_BeginSendBatch, one sendmmsg per run of
+datagrams going out of the same socket.
+==================
+*/
+static void NET_SendQueued(void)
+{
+    int start, count;
+    int ret;
+
+    for (start = 0; start < numSendQueued; )
+    {
+        for (count = 1; start + count < numSendQueued; count++)
+        {
+            if (sendSockets[start + count] != sendSockets[start])
+            {
+                break;
+            }
+        }
+
+        ret = sendmmsg(sendSockets[start], &sendMsgs[start], count, 0);
+        netStats.sendCalls++;
+
+        if (ret == SOCKET_ERROR)
+        {
+            // skip the datagram that failed and carry on with the rest
+            NET_SendError(socketError, sendTypes[start]);
+            start++;
+            continue;
+        }
+
+        netStats.sendPackets += ret;
+        start += ret;
+    }
+
+    numSendQueued = 0;
+    sendBytesUsed = 0;
+}
+
+/*
+==================
+NET_QueueSend
+==================
+*/
+static void NET_QueueSend(
+    SOCKET sock, const void *data, int length, struct sockaddr *addr, socklen_t addrlen, netadrtype_t type)
+{
+    int i;
+
+    if (numSendQueued == NET_SEND_BATCH || sendBytesUsed + length > NET_SEND_BYTES)
+    {
+        NET_SendQueued();
+    }
+
+    i = numSendQueued++;
+
+    memcpy(sendData + sendBytesUsed, data, length);
+    memcpy(&sendAddrs[i], addr, addrlen);
+
+    sendSockets[i] = sock;
+    sendTypes[i] = type;
+
+    sendIovecs[i].iov_base = sendData + sendBytesUsed;
+    sendIovecs[i].iov_len = length;
+
+    memset(&sendMsgs[i], 0, sizeof(sendMsgs[i]));
+    sendMsgs[i].msg_hdr.msg_name = &sendAddrs[i];
+    sendMsgs[i].msg_hdr.msg_namelen = addrlen;
+    sendMsgs[i].msg_hdr.msg_iov = &sendIovecs[i];
+    sendMsgs[i].msg_hdr.msg_iovlen = 1;
+
+    sendBytesUsed += length;
+}
+#endif
+
+/*
+==================
+NET_BeginSendBatch
+
+Until the next NET_FlushSendBatch, datagrams passed to Sys_SendPacket are
+queued and then sent with as few syscalls as possible
+==================
+*/
+void NET_BeginSendBatch(void)
+{
+#ifdef NET_SENDMMSG
+    sendBatching = true;
+#endif
+}
+
+/*
+==================
+NET_FlushSendBatch
+==================
+*/
+void NET_FlushSendBatch(void)
+{
+#ifdef NET_SENDMMSG
+    NET_SendQueued();
+    sendBatching = false;
+#endif
+}
+
 /*
 ==================
 Sys_SendPacket
@@ -699,6 +883,8 @@ void Sys_SendPacket(int length, const void *data, netadr_t to)
 {
     int ret = SOCKET_ERROR;
     struct sockaddr_storage addr;
+    SOCKET sock;
+    socklen_t addrlen;
 
     if (to.type != NA_BROADCAST && to.type != NA_IP && to.type != NA_IP6 && to.type != NA_MULTICAST6)
     {
@@ -727,35 +913,46 @@ void Sys_SendPacket(int length, const void *data, netadr_t to)
         *(int *)&socksBuf[4] = ((struct sockaddr_in *)&addr)->sin_addr.s_addr;
         *(short *)&socksBuf[8] = ((struct sockaddr_in *)&addr)->sin_port;
         memcpy(&socksBuf[10], data, length);
-        ret = sendto(ip_sockets[to.alternateProtocol], (const char *)socksBuf, length + 10, 0, &socksRelayAddr,
-            sizeof(socksRelayAddr));
+
+        sock = ip_sockets[to.alternateProtocol];
+        data = socksBuf;
+        length += 10;
+        memcpy(&addr, &socksRelayAddr, sizeof(socksRelayAddr));
+        addrlen = sizeof(socksRelayAddr);
     }
-    else
+    else if (addr.ss_family == AF_INET)
     {
-        if (addr.ss_family == AF_INET)
-            ret = sendto(ip_sockets[to.alternateProtocol], (const char *)data, length, 0, (struct sockaddr *)&addr,
-                sizeof(struct sockaddr_in));
-        else if (addr.ss_family == AF_INET6)
-            ret = sendto(ip6_sockets[to.alternateProtocol], (const char *)data, length, 0, (struct sockaddr *)&addr,
-                sizeof(struct sockaddr_in6));
+        sock = ip_sockets[to.alternateProtocol];
+        addrlen = sizeof(struct sockaddr_in);
     }
-    if (ret == SOCKET_ERROR)
+    else if (addr.ss_family == AF_INET6)
+    {
+        sock = ip6_sockets[to.alternateProtocol];
+        addrlen = sizeof(struct sockaddr_in6);
+    }
+    else
     {
-        int err = socketError;
+        return;
+    }
 
-        // wouldblock is silent
-        if (err == EAGAIN)
-        {
-            return;
-        }
+#ifdef NET_SENDMMSG
+    if (sendBatching)
+    {
+        NET_QueueSend(sock, data, length, (struct sockaddr *)&addr, addrlen, to.type);
+        return;
+    }
+#endif
 
-        // some PPP links do not allow broadcasts and return an error
-        if ((err == EADDRNOTAVAIL) && ((to.type == NA_BROADCAST)))
-        {
-            return;
-        }
+    ret = sendto(sock, (const char *)data, length, 0, (struct sockaddr *)&addr, addrlen);
+    netStats.sendCalls++;
 
-        Com_Printf("Sys_SendPacket: %s\n", NET_ErrorString());
+    if (ret == SOCKET_ERROR)
+    {
+        NET_SendError(socketError, to.type);
+    }
+    else
+    {
+        netStats.sendPackets++;
     }
 }
 
@@ -1520,6 +1717,70 @@ void NET_OpenIP(void)
     }
 }
 
+#ifdef NET_EPOLL
+/*
+====================
+NET_CloseEpoll
+====================
+*/
+static void NET_CloseEpoll(void)
+{
+    if (epollFd != -1)
+    {
+        close(epollFd);
+        epollFd = -1;
+    }
+}
+
+/*
+====================
+NET_OpenEpoll
+
+Registers the game sockets with a new epoll instance.  On failure NET_Sleep
+keeps using select().
+====================
+*/
+static void NET_OpenEpoll(void)
+{
+    struct epoll_event ev;
+    int a, v6;
+    SOCKET sock;
+
+    NET_CloseEpoll();
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1)
+    {
+        Com_Printf("WARNING: epoll_create1: %s, falling back to select()\n", NET_ErrorString());
+        return;
+    }
+
+    for (a = 0; a < 3; ++a)
+    {
+        for (v6 = 0; v6 < 2; v6++)
+        {
+            sock = v6 ? ip6_sockets[a] : ip_sockets[a];
+            if (sock == INVALID_SOCKET)
+            {
+                continue;
+            }
+
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.u32 = (a << 1) | v6;
+
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, sock, &ev) == -1)
+            {
+                Com_Printf("WARNING: epoll_ctl: %s, falling back to select()\n", NET_ErrorString());
+                NET_CloseEpoll();
+                return;
+            }
+        }
+    }
+}
+
+#endif
+
 //===================================================================
 
 /*
@@ -1662,6 +1923,13 @@ void NET_Config(bool enableNetworking)
 
     if (stop)
     {
+#ifdef NET_EPOLL
+        NET_CloseEpoll();
+#endif
+#ifdef NET_SENDMMSG
+        NET_SendQueued();
+#endif
+
         for (a = 0; a < 3; ++a)
         {
             if (ip_sockets[a] != INVALID_SOCKET)
@@ -1700,10 +1968,44 @@ void NET_Config(bool enableNetworking)
         {
             NET_OpenIP();
             NET_SetMulticast6();
+#ifdef NET_EPOLL
+            NET_OpenEpoll();
+#endif
         }
     }
 }
 
+/*
+====================
+NET_Stats_f
+====================
+*/
+static void NET_Stats_f(void)
+{
+#ifdef NET_EPOLL
+    Com_Printf("receive path : %s\n", epollFd != -1 ? "epoll + recvmmsg" : "select + recvfrom");
+#else
+    Com_Printf("receive path : select + recvfrom\n");
+#endif
+    Com_Printf("waits        : %i\n", netStats.waits);
+    Com_Printf("recv calls   : %i\n", netStats.recvCalls);
+    Com_Printf("recv packets : %i (%.2f per call)\n", netStats.recvPackets,
+        netStats.recvCalls ? (float)netStats.recvPackets / netStats.recvCalls : 0.0f);
+#ifdef NET_SENDMMSG
+    Com_Printf("send path    : sendmmsg\n");
+#else
+    Com_Printf("send path    : sendto\n");
+#endif
+    Com_Printf("send calls   : %i\n", netStats.sendCalls);
+    Com_Printf("send packets : %i (%.2f per call)\n", netStats.sendPackets,
+        netStats.sendCalls ? (float)netStats.sendPackets / netStats.sendCalls : 0.0f);
+
+    if (Cmd_Argc() > 1 && !Q_stricmp(Cmd_Argv(1), "reset"))
+    {
+        memset(&netStats, 0, sizeof(netStats));
+    }
+}
+
 /*
 ====================
 NET_Init
@@ -1728,6 +2030,7 @@ void NET_Init(void)
     NET_Config(true);
 
     Cmd_AddCommand("net_restart", NET_Restart_f);
+    Cmd_AddCommand("net_stats", NET_Stats_f);
 }
 
 /*
@@ -1750,6 +2053,26 @@ void NET_Shutdown(void)
 #endif
 }
 
+/*
+====================
+NET_DeliverPacket
+====================
+*/
+static void NET_DeliverPacket(netadr_t *from, msg_t *netmsg)
+{
+    if (net_dropsim->value > 0.0f && net_dropsim->value <= 100.0f)
+    {
+        // com_dropsim->value percent of incoming packets get dropped.
+        if (rand() < (int)(((double)RAND_MAX) / 100.0 * (double)net_dropsim->value))
+            return;  // drop this packet
+    }
+
+    if (com_sv_running->integer)
+        Com_RunAndTimeServerPacket(from, netmsg);
+    else
+        CL_PacketEvent(*from, netmsg);
+}
+
 /*
 ====================
 NET_Event
@@ -1771,24 +2094,110 @@ void NET_Event(fd_set *fdr)
         MSG_Init(&netmsg, bufData, sizeof(bufData));
 
         if (NET_GetPacket(&from, &netmsg, fdr))
+            NET_DeliverPacket(&from, &netmsg);
+        else
+            break;
+    }
+}
+
+#ifdef NET_EPOLL
+/*
+====================
+NET_ReceiveBatch
+
+Drains a socket with recvmmsg, NET_RECV_BATCH datagrams per call.
+====================
+*/
+static void NET_ReceiveBatch(int alternateProtocol, bool v6)
+{
+    netadr_t from;
+    msg_t netmsg;
+    SOCKET sock;
+    int ret;
+    int err;
+    int i;
+
+    for (;;)
+    {
+        // a packet may have restarted networking
+        sock = v6 ? ip6_sockets[alternateProtocol] : ip_sockets[alternateProtocol];
+        if (sock == INVALID_SOCKET)
+        {
+            return;
+        }
+
+        for (i = 0; i < NET_RECV_BATCH; i++)
+        {
+            recvIovecs[i].iov_base = recvData[i];
+            recvIovecs[i].iov_len = sizeof(recvData[i]);
+            memset(&recvMsgs[i], 0, sizeof(recvMsgs[i]));
+            recvMsgs[i].msg_hdr.msg_name = &recvAddrs[i];
+            recvMsgs[i].msg_hdr.msg_namelen = sizeof(recvAddrs[i]);
+            recvMsgs[i].msg_hdr.msg_iov = &recvIovecs[i];
+            recvMsgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        ret = recvmmsg(sock, recvMsgs, NET_RECV_BATCH, MSG_DONTWAIT, NULL);
+        netStats.recvCalls++;
+
+        if (ret == SOCKET_ERROR)
         {
-            if (net_dropsim->value > 0.0f && net_dropsim->value <= 100.0f)
+            err = socketError;
+
+            if (err != EAGAIN && err != ECONNRESET && err != EINTR) Com_Printf("NET_ReceiveBatch: %s\n", NET_ErrorString());
+            return;
+        }
+
+        netStats.recvPackets += ret;
+
+        for (i = 0; i < ret; i++)
+        {
+            memset(&from, 0, sizeof(from));
+            MSG_Init(&netmsg, recvData[i], sizeof(recvData[i]));
+
+            if ((recvMsgs[i].msg_hdr.msg_flags & MSG_TRUNC) ||
+                !NET_ParsePacket(alternateProtocol, &recvAddrs[i], recvMsgs[i].msg_hdr.msg_namelen, recvMsgs[i].msg_len,
+                    &from, &netmsg))
             {
-                // com_dropsim->value percent of incoming packets get dropped.
-                if (rand() < (int)(((double)RAND_MAX) / 100.0 * (double)net_dropsim->value))
-                    continue;  // drop this packet
+                continue;
             }
 
-            if (com_sv_running->integer)
-                Com_RunAndTimeServerPacket(&from, &netmsg);
-            else
-                CL_PacketEvent(from, &netmsg);
+            NET_DeliverPacket(&from, &netmsg);
+        }
+
+        if (ret < NET_RECV_BATCH)
+        {
+            return;
         }
-        else
-            break;
     }
 }
 
+/*
+====================
+NET_EpollSleep
+====================
+*/
+static void NET_EpollSleep(int msec)
+{
+    struct epoll_event events[6];
+    int n, i;
+
+    n = epoll_wait(epollFd, events, ARRAY_LEN(events), msec);
+    netStats.waits++;
+
+    if (n == -1)
+    {
+        if (errno != EINTR) Com_Printf("Warning: epoll_wait() syscall failed: %s\n", NET_ErrorString());
+        return;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        NET_ReceiveBatch(events[i].data.u32 >> 1, events[i].data.u32 & 1);
+    }
+}
+#endif
+
 /*
 ====================
 NET_Sleep
@@ -1806,6 +2215,14 @@ void NET_Sleep(int msec)
 
     if (msec < 0) msec = 0;
 
+#ifdef NET_EPOLL
+    if (epollFd != -1)
+    {
+        NET_EpollSleep(msec);
+        return;
+    }
+#endif
+
     FD_ZERO(&fdr);
 
     for (a = 0; a < 3; ++a)
@@ -1837,6 +2254,7 @@ void NET_Sleep(int msec)
     timeout.tv_usec = (msec % 1000) * 1000;
 
     retval = select(highestfd + 1, &fdr, NULL, NULL, &timeout);
+    netStats.waits++;
 
     if (retval == SOCKET_ERROR)
         Com_Printf("Warning: select() syscall failed: %s\n", NET_ErrorString());
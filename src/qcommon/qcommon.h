@@ -251,6 +251,7 @@ extern	cvar_t	*com_maxfpsUnfocused;
 extern	cvar_t	*com_minimized;
 extern	cvar_t	*com_maxfpsMinimized;
 extern	cvar_t	*com_altivec;
+extern	cvar_t	*com_simd;
 extern	cvar_t	*com_homepath;
 
 // both client and server must agree to pause
@@ -259,6 +260,10 @@ extern	cvar_t	*sv_paused;
 
 extern	cvar_t	*cl_packetdelay;
 extern	cvar_t	*sv_packetdelay;
+extern	cvar_t	*cl_packetjitter;
+extern	cvar_t	*sv_packetjitter;
+extern	cvar_t	*cl_packetloss;
+extern	cvar_t	*sv_packetloss;
 
 extern	cvar_t	*com_gamename;
 
@@ -281,7 +286,8 @@ typedef enum {
 	TAG_BOTLIB,
 	TAG_RENDERER,
 	TAG_SMALL,
-	TAG_STATIC
+	TAG_STATIC,
+	TAG_SLAB			// zone blocks that hold slab pages
 } memtag_t;
 
 /*
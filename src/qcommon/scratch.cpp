@@ -0,0 +1,160 @@
+/*
+===========================================================================
+Copyright (C) 2015-2019 GrangerHub
+
+This file is part of Tremulous.
+
+Tremulous is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 3 of the License,
+or (at your option) any later version.
+
+Tremulous is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Tremulous; if not, see <https://www.gnu.org/licenses/>
+
+===========================================================================
+*/
+
+
+#include "scratch.h"
+
+#include "q_shared.h"
+#include "qcommon.h"
+#include "cvar.h"
+
+#include "../sys/sys_shared.h"
+
+/*
+=============================================================================
+
+Every thread reserves its own arena the first time it allocates.  The
+arena commits in SCRATCH_COMMIT_CHUNK steps as it grows, and gives all but
+SCRATCH_KEEP bytes back to the system whenever it is rewound to empty,
+which is the end of a map load.
+
+=============================================================================
+*/
+
+#define SCRATCH_COMMIT_CHUNK ( 1024 * 1024 )
+#define SCRATCH_KEEP ( 1024 * 1024 )
+#ifdef EMSCRIPTEN
+// there is no reserving there, the whole arena is allocated up front
+#define SCRATCH_DEFAULT_MEGS 32
+#else
+#define SCRATCH_DEFAULT_MEGS 128
+#endif
+
+struct scratchArena_t {
+    byte *base;
+    int size;
+    int used;
+    int committed;
+    int touched;  // since the pages above SCRATCH_KEEP were last released
+    int peak;
+};
+
+static thread_local scratchArena_t scratch;
+
+static int scratchSize = SCRATCH_DEFAULT_MEGS * 1024 * 1024;
+
+/*
+=================
+Scratch_Init
+=================
+*/
+void Scratch_Init( void )
+{
+    cvar_t *cv;
+
+    cv = Cvar_Get( "com_scratchMegs", XSTRING( SCRATCH_DEFAULT_MEGS ), CVAR_LATCH | CVAR_ARCHIVE );
+    Cvar_SetDescription( cv, "The size of the per-thread scratch arena for load-time buffers" );
+    Cvar_CheckRange( cv, 8, 1024, true );
+    scratchSize = cv->integer * 1024 * 1024;
+}
+
+/*
+=================
+Scratch_Alloc
+=================
+*/
+void *Scratch_Alloc( int size )
+{
+    byte *buf;
+    int end;
+
+    if ( !scratch.base ) {
+        scratch.base = (byte *)Sys_ReserveMemory( scratchSize, 0 );
+        if ( !scratch.base ) {
+            Com_Error( ERR_FATAL, "Scratch_Alloc: failed to reserve %i megs", scratchSize / ( 1024 * 1024 ) );
+        }
+        scratch.size = scratchSize;
+    }
+
+    size = PAD( size, SCRATCH_ALIGN );
+    if ( size < 0 || size > scratch.size - scratch.used ) {
+        Com_Error( ERR_DROP, "Scratch_Alloc: failed on %i, %i of %i in use", size, scratch.used, scratch.size );
+    }
+
+    buf = scratch.base + scratch.used;
+    scratch.used += size;
+    scratch.touched = MAX( scratch.touched, scratch.used );
+    scratch.peak = MAX( scratch.peak, scratch.used );
+
+    if ( scratch.used > scratch.committed ) {
+        end = MIN( PAD( scratch.used, SCRATCH_COMMIT_CHUNK ), scratch.size );
+        if ( !Sys_CommitMemory( scratch.base + scratch.committed, end - scratch.committed ) ) {
+            Com_Error( ERR_FATAL, "Scratch_Alloc: failed to commit %i bytes", end - scratch.committed );
+        }
+        scratch.committed = end;
+    }
+    return buf;
+}
+
+/*
+=================
+Scratch_Mark
+=================
+*/
+int Scratch_Mark( void )
+{
+    return scratch.used;
+}
+
+/*
+=================
+Scratch_Rewind
+=================
+*/
+void Scratch_Rewind( int mark )
+{
+    if ( mark < 0 || mark > scratch.used ) {
+        Com_Error( ERR_FATAL, "Scratch_Rewind: bad mark %i, %i in use", mark, scratch.used );
+    }
+    scratch.used = mark;
+
+    // stays committed, only the pages go back
+    if ( !mark && scratch.touched > SCRATCH_KEEP ) {
+        Sys_ReleaseMemory( scratch.base + SCRATCH_KEEP,
+            MIN( PAD( scratch.touched, SCRATCH_COMMIT_CHUNK ), scratch.committed ) - SCRATCH_KEEP );
+        scratch.touched = 0;
+    }
+}
+
+/*
+=================
+Scratch_Info
+
+For the calling thread
+=================
+*/
+void Scratch_Info( int *used, int *peak, int *committed )
+{
+    *used = scratch.used;
+    *peak = scratch.peak;
+    *committed = scratch.committed;
+}
@@ -0,0 +1,61 @@
+/*
+===========================================================================
+Copyright (C) 2015-2019 GrangerHub
+
+This file is part of Tremulous.
+
+Tremulous is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 3 of the License,
+or (at your option) any later version.
+
+Tremulous is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Tremulous; if not, see <https://www.gnu.org/licenses/>
+
+===========================================================================
+*/
+
+
+#ifndef QCOMMON_SCRATCH_H
+#define QCOMMON_SCRATCH_H 1
+
+//
+// scratch.cpp -- per-thread linear allocator for load-time transients
+//
+// Scratch_Alloc hands out memory from an arena that belongs to the calling
+// thread and lives outside the hunk, so it never moves the hunk banks or
+// their high-water marks.  Nothing is freed on its own: take a Scratch_Mark
+// before a load and Scratch_Rewind to it afterwards, which drops everything
+// allocated since in any order.  Marks nest like a stack.  Scratch memory
+// is not cleared, and Com_Error rewinds the arena of the main thread.
+//
+// The arena is reserved address space of com_scratchMegs, committed as it
+// grows and handed back to the system once it is rewound to empty.
+//
+
+#define SCRATCH_ALIGN 16
+
+void Scratch_Init(void);
+void *Scratch_Alloc(int size);
+int Scratch_Mark(void);
+void Scratch_Rewind(int mark);
+void Scratch_Info(int *used, int *peak, int *committed);
+
+#ifdef __cplusplus
+// rewinds when it goes out of scope, but not through a Com_Error longjmp
+struct scratchScope_t {
+    int mark;
+
+    scratchScope_t() : mark(Scratch_Mark()) {}
+    ~scratchScope_t() { Scratch_Rewind(mark); }
+    scratchScope_t(const scratchScope_t &) = delete;
+    scratchScope_t &operator=(const scratchScope_t &) = delete;
+};
+#endif
+
+#endif
@@ -142,6 +142,8 @@ IMAGE LOADERS
 =============================================================
 */
 
+// the decoded pic is allocated from the scratch arena, so callers
+// take a ri.Scratch_Mark() before loading and rewind to it when done
 void R_LoadBMP( const char *name, byte **pic, int *width, int *height );
 void R_LoadJPG( const char *name, byte **pic, int *width, int *height );
 void R_LoadPCX( const char *name, byte **pic, int *width, int *height );
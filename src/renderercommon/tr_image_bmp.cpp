@@ -180,7 +180,7 @@ void R_LoadBMP( const char *name, byte **pic, int *width, int *height )
 	if ( height )
 		*height = rows;
 
-	bmpRGBA = (byte*)ri.Malloc( numPixels * 4 );
+	bmpRGBA = (byte*)ri.Scratch_Alloc( numPixels * 4 );
 	*pic = bmpRGBA;
 
 
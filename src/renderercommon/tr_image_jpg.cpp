@@ -206,7 +206,7 @@ void R_LoadJPG(const char *filename, unsigned char **pic, int *width, int *heigh
   memcount = pixelcount * 4;
   row_stride = cinfo.output_width * cinfo.output_components;
 
-  out = (byte*)ri.Malloc(memcount);
+  out = (byte*)ri.Scratch_Alloc(memcount);
 
   *width = cinfo.output_width;
   *height = cinfo.output_height;
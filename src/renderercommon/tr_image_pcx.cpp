@@ -142,6 +142,7 @@ void R_LoadPCX ( const char *filename, byte **pic, int *width, int *height)
 		ri.Printf (PRINT_ALL, "PCX file truncated: %s\n", filename);
 		ri.FS_FreeFile (pcx);
 		ri.Free (pic8);
+		return;
 	}
 
 	if (raw.b-(byte*)pcx >= end - (byte*)769 || end[-769] != 0x0c)
@@ -154,7 +155,7 @@ void R_LoadPCX ( const char *filename, byte **pic, int *width, int *height)
 
 	palette = end-768;
 
-	pix = out = (byte*)ri.Malloc(4 * size );
+	pix = out = (byte*)ri.Scratch_Alloc(4 * size );
 	for (i = 0 ; i < size ; i++)
 	{
 		unsigned char p = pic8[i];
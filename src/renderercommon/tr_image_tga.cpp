@@ -128,7 +128,7 @@ void R_LoadTGA ( const char *name, byte **pic, int *width, int *height)
 	}
 
 
-	targa_rgba = (byte*)ri.Malloc (numPixels);
+	targa_rgba = (byte*)ri.Scratch_Alloc (numPixels);
 
 	if (targa_header.id_length != 0)
 	{
@@ -26,7 +26,7 @@ along with Tremulous; if not, see <https://www.gnu.org/licenses/>
 
 #include "tr_types.h"
 
-#define	REF_API_VERSION		8
+#define	REF_API_VERSION		9
 
 // AVI files have the start of pixel lines 4 byte-aligned
 #define AVI_LINE_PADDING 4
@@ -131,6 +131,12 @@ typedef struct {
 	void	*(*Hunk_AllocateTempMemory)( int size );
 	void	(*Hunk_FreeTempMemory)( void *block );
 
+	// per-thread scratch arena for load-time transients, released
+	// by rewinding to a mark taken before the allocations
+	void	*(*Scratch_Alloc)( int size );
+	int		(*Scratch_Mark)( void );
+	void	(*Scratch_Rewind)( int mark );
+
 	// dynamic memory allocator for things that need to be freed
 	void	*(*Malloc)( int bytes );
 	void	(*Free)( void *buf );
@@ -161,6 +167,7 @@ typedef struct {
 	int		(*FS_FileIsInPAK)( const char *name, int *pCheckSum );
 	long		(*FS_ReadFile)( const char *name, void **buf );
 	void	(*FS_FreeFile)( void *buf );
+	long	(*FS_ReadFileScratch)( const char *name, void **buf );
 	char **	(*FS_ListFiles)( const char *name, const char *extension, int *numfilesfound );
 	void	(*FS_FreeFileList)( char **filelist );
 	void	(*FS_WriteFile)( const char *qpath, const void *buffer, int size );
@@ -137,7 +137,8 @@ R_LoadLightmaps
 static	void R_LoadLightmaps( lump_t *l ) {
 	byte		*buf, *buf_p;
 	int			len;
-	byte		image[LIGHTMAP_SIZE*LIGHTMAP_SIZE*4];
+	byte		*image;
+	int			mark;
 	int			i, j;
 	float maxIntensity = 0;
 	double sumIntensity = 0;
@@ -165,6 +166,8 @@ static	void R_LoadLightmaps( lump_t *l ) {
 	}
 
 	tr.lightmaps = (image_t**)ri.Hunk_Alloc( tr.numLightmaps * sizeof(image_t *), h_low );
+	mark = ri.Scratch_Mark();
+	image = (byte*)ri.Scratch_Alloc( LIGHTMAP_SIZE * LIGHTMAP_SIZE * 4 );
 	for ( i = 0 ; i < tr.numLightmaps ; i++ ) {
 		// expand the 24 bit on-disk to 32 bit
 		buf_p = buf + i * LIGHTMAP_SIZE*LIGHTMAP_SIZE * 3;
@@ -208,6 +211,7 @@ static	void R_LoadLightmaps( lump_t *l ) {
 			LIGHTMAP_SIZE, LIGHTMAP_SIZE, IMGTYPE_COLORALPHA,
 			IMGFLAG_NOLIGHTSCALE | IMGFLAG_NO_COMPRESSION | IMGFLAG_CLAMPTOEDGE, 0 );
 	}
+	ri.Scratch_Rewind( mark );
 
 	if ( r_lightmap->integer == 2 )	{
 		ri.Printf( PRINT_ALL, "Brightest lightmap value: %d\n", ( int ) ( maxIntensity * 255 ) );
@@ -1799,6 +1803,7 @@ void RE_LoadWorldMap( const char *name ) {
 		void *v;
 	} buffer;
 	byte		*startMarker;
+	int			mark;
 
 	if ( tr.worldMapLoaded ) {
 		ri.Error( ERR_DROP, "ERROR: attempted to redundantly load world map" );
@@ -1815,7 +1820,8 @@ void RE_LoadWorldMap( const char *name ) {
 	tr.worldMapLoaded = true;
 
 	// load it
-    ri.FS_ReadFile( name, &buffer.v );
+	mark = ri.Scratch_Mark();
+    ri.FS_ReadFileScratch( name, &buffer.v );
 	if ( !buffer.b ) {
 		ri.Error (ERR_DROP, "RE_LoadWorldMap: %s not found", name);
 	}
@@ -1865,5 +1871,5 @@ void RE_LoadWorldMap( const char *name ) {
 	// only set tr.world now that we know the entire level has loaded properly
 	tr.world = &s_worldData;
 
-    ri.FS_FreeFile( buffer.v );
+    ri.Scratch_Rewind( mark );
 }
@@ -1036,6 +1036,7 @@ image_t	*R_FindImageFile( const char *name, imgType_t type, int /*imgFlags_t*/ f
 	int		width, height;
 	byte	*pic;
 	long	hash;
+	int		mark;
 
 	if (!name) {
 		return NULL;
@@ -1061,13 +1062,15 @@ image_t	*R_FindImageFile( const char *name, imgType_t type, int /*imgFlags_t*/ f
 	//
 	// load the pic from disk
 	//
+	mark = ri.Scratch_Mark();
 	R_LoadImage( name, &pic, &width, &height );
 	if ( pic == NULL ) {
+		ri.Scratch_Rewind( mark );
 		return NULL;
 	}
 
 	image = R_CreateImage( ( char * ) name, pic, width, height, type, flags, 0 );
-	ri.Free( pic );
+	ri.Scratch_Rewind( mark );
 	return image;
 }
 
@@ -229,6 +229,7 @@ static	void R_LoadLightmaps( lump_t *l, lump_t *surfs ) {
 	dsurface_t  *surf;
 	int			len;
 	byte		*image;
+	int			mark;
 	int			i, j, numLightmaps, textureInternalFormat = 0;
 	int			numLightmapsPerPage = 16;
 	float maxIntensity = 0;
@@ -265,7 +266,8 @@ static	void R_LoadLightmaps( lump_t *l, lump_t *surfs ) {
 		}
 	}
 
-	image = (byte*)ri.Malloc(tr.lightmapSize * tr.lightmapSize * 4 * 2);
+	mark = ri.Scratch_Mark();
+	image = (byte*)ri.Scratch_Alloc(tr.lightmapSize * tr.lightmapSize * 4 * 2);
 
 	if (tr.worldDeluxeMapping)
 		numLightmaps >>= 1;
@@ -344,6 +346,7 @@ static	void R_LoadLightmaps( lump_t *l, lump_t *surfs ) {
 			char filename[MAX_QPATH];
 			byte *hdrLightmap = NULL;
 			int size = 0;
+			int hdrMark = ri.Scratch_Mark();
 
 			// look for hdr lightmaps
 			if (textureInternalFormat == GL_RGBA16)
@@ -351,7 +354,7 @@ static	void R_LoadLightmaps( lump_t *l, lump_t *surfs ) {
 				Com_sprintf( filename, sizeof( filename ), "maps/%s/lm_%04d.hdr", s_worldData.baseName, i * (tr.worldDeluxeMapping ? 2 : 1) );
 				//ri.Printf(PRINT_ALL, "looking for %s\n", filename);
 
-				size = ri.FS_ReadFile(filename, (void **)&hdrLightmap);
+				size = ri.FS_ReadFileScratch(filename, (void **)&hdrLightmap);
 			}
 
 			if (hdrLightmap)
@@ -482,8 +485,7 @@ static	void R_LoadLightmaps( lump_t *l, lump_t *surfs ) {
 			else
 				tr.lightmaps[i] = R_CreateImage(va("*lightmap%d", i), image, tr.lightmapSize, tr.lightmapSize, IMGTYPE_COLORALPHA, imgFlags, textureInternalFormat );
 
-			if (hdrLightmap)
-				ri.FS_FreeFile(hdrLightmap);
+			ri.Scratch_Rewind(hdrMark);
 		}
 
 		if (tr.worldDeluxeMapping)
@@ -517,7 +519,7 @@ static	void R_LoadLightmaps( lump_t *l, lump_t *surfs ) {
 		ri.Printf( PRINT_ALL, "Brightest lightmap value: %d\n", ( int ) ( maxIntensity * 255 ) );
 	}
 
-	ri.Free(image);
+	ri.Scratch_Rewind(mark);
 }
 
 
@@ -2732,6 +2734,7 @@ void RE_LoadWorldMap( const char *name ) {
 		void *v;
 	} buffer;
 	byte		*startMarker;
+	int			mark;
 
 	if ( tr.worldMapLoaded ) {
 		ri.Error( ERR_DROP, "ERROR: attempted to redundantly load world map" );
@@ -2763,7 +2766,8 @@ void RE_LoadWorldMap( const char *name ) {
 	tr.worldMapLoaded = true;
 
 	// load it
-    ri.FS_ReadFile( name, &buffer.v );
+	mark = ri.Scratch_Mark();
+    ri.FS_ReadFileScratch( name, &buffer.v );
 	if ( !buffer.b ) {
 		ri.Error (ERR_DROP, "RE_LoadWorldMap: %s not found", name);
 	}
@@ -3042,5 +3046,5 @@ void RE_LoadWorldMap( const char *name ) {
 		R_RenderMissingCubemaps();
 	}
 
-    ri.FS_FreeFile( buffer.v );
+    ri.Scratch_Rewind( mark );
 }
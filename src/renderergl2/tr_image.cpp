@@ -2414,6 +2414,7 @@ image_t	*R_FindImageFile( const char *name, imgType_t type, int/*imgFlags_t*/ fl
 	GLenum  picFormat;
 	int picNumMips;
 	long	hash;
+	int		mark;
 	int/*imgFlags_t*/ checkFlagsTrue, checkFlagsFalse;
 
 	if (!name) {
@@ -2440,8 +2441,10 @@ image_t	*R_FindImageFile( const char *name, imgType_t type, int/*imgFlags_t*/ fl
 	//
 	// load the pic from disk
 	//
+	mark = ri.Scratch_Mark();
 	R_LoadImage( name, &pic, &width, &height, &picFormat, &picNumMips );
 	if ( pic == NULL ) {
+		ri.Scratch_Rewind( mark );
 		return NULL;
 	}
 
@@ -2471,7 +2474,7 @@ image_t	*R_FindImageFile( const char *name, imgType_t type, int/*imgFlags_t*/ fl
 
 			normalWidth = width;
 			normalHeight = height;
-			normalPic = (byte*)ri.Malloc(width * height * 4);
+			normalPic = (byte*)ri.Scratch_Alloc(width * height * 4);
 			RGBAtoNormal(pic, normalPic, width, height, flags & IMGFLAG_CLAMPTOEDGE);
 
 #if 1
@@ -2547,7 +2550,6 @@ image_t	*R_FindImageFile( const char *name, imgType_t type, int/*imgFlags_t*/ fl
 #endif
 
 			R_CreateImage( normalName, normalPic, normalWidth, normalHeight, IMGTYPE_NORMAL, normalFlags, 0 );
-			ri.Free( normalPic );	
 		}
 	}
 
@@ -2566,7 +2568,7 @@ image_t	*R_FindImageFile( const char *name, imgType_t type, int/*imgFlags_t*/ fl
 	}
 
 	image = R_CreateImage2( ( char * ) name, pic, width, height, picFormat, picNumMips, type, flags, 0 );
-	ri.Free( pic );
+	ri.Scratch_Rewind( mark );
 	return image;
 }
 
@@ -447,7 +447,7 @@ void R_LoadDDS ( const char *filename, byte **pic, int *width, int *height, GLen
 		}
 	}
 
-	*pic = (byte*)ri.Malloc(len);
+	*pic = (byte*)ri.Scratch_Alloc(len);
 	Com_Memcpy(*pic, data, len);
 
 	ri.FS_FreeFile(buffer.v);
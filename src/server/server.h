@@ -33,6 +33,7 @@ along with Tremulous; if not, see <https://www.gnu.org/licenses/>
 #include "../qcommon/cvar.h"
 #include "../qcommon/files.h"
 #include "../qcommon/huffman.h"
+#include "../qcommon/jobs.h"
 #include "../qcommon/msg.h"
 #include "../qcommon/net.h"
 #include "../qcommon/q_shared.h"
@@ -65,16 +66,29 @@ struct voipServerPacket_t {
 };
 #endif // USE_VOIP
 
+// one entry in a per-cluster list of linked entities, see SV_LinkEntity
+struct clusterLink_t {
+    clusterLink_t *next;
+    clusterLink_t **prevNext;
+    int entityNum;
+};
+
 struct svEntity_t {
-    struct worldSector_t *worldSector;
-    svEntity_t *nextEntityInWorldSector;
+    struct worldNode_t *worldNode;  // leaf in the entity tree, NULL if not linked
+
+    // absmin / absmax the leafs below were found for, padded to four floats
+    // for the SSE box tests, the fourth is always 0
+    alignas(16) float linkMins[4];
+    alignas(16) float linkMaxs[4];
 
     entityState_t baseline;  // for delta compression of initial sighting
     int numClusters;  // if -1, use headnode instead
     int clusternums[MAX_ENT_CLUSTERS];
     int lastCluster;  // if all the clusters don't fit in clusternums
     int areanum, areanum2;
-    int snapshotCounter;  // used to prevent double adding from portal views
+
+    int numClusterLinks;
+    clusterLink_t clusterLinks[MAX_ENT_CLUSTERS];  // into sv.clusterEntities
 };
 
 enum serverState_t {
@@ -98,11 +112,19 @@ struct server_t {
     // https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=475
     // the serverId associated with the current checksumFeed (always <= serverId)
     int checksumFeedServerId;
-    int snapshotCounter;  // incremented for each snapshot built
     int timeResidual;  // <= 1000 / sv_frame->value
     int nextFrameTime;  // when time > nextFrameTime, process world
     configString_t configstrings[MAX_CONFIGSTRINGS];
     svEntity_t svEntities[MAX_GENTITIES];
+    byte linkedEntities[MAX_GENTITIES / 8];  // set by SV_LinkEntity, so per-frame scans skip the rest
+
+    int numClusters;
+    clusterLink_t **clusterEntities;  // linked entities touching each cluster
+
+    // rebuilt every frame before snapshots, entities that have to be checked
+    // by every snapshot because the cluster lists can't cull them
+    int numUnculledEntities;
+    int unculledEntities[MAX_GENTITIES];
 
     char *entityParsePoint;  // used during game VM init
 
@@ -126,6 +148,7 @@ struct clientSnapshot_t {
     playerState_t ps;
     int num_entities;
     int first_entity;  // into the circular sv_packet_entities[]
+    int snapshotFrame;  // svs.snapshotFrame the entities were captured in
     // the entities MUST be in increasing state number
     // order, otherwise the delta compression will fail
     int messageSent;  // time the message was transmitted
@@ -237,6 +260,18 @@ struct svstats_t {
 
     float cpu;
     float avg;
+
+    int deltaHits;  // entity deltas spliced from the per-frame cache
+    int deltaMisses;
+    int latched_deltaHits;
+    int latched_deltaMisses;
+
+    int queryHits;  // getstatus/getinfo answered from the response cache
+    int queryMisses;
+    int queryDrops;  // getstatus/getinfo dropped by rate limiting
+    int latched_queryHits;
+    int latched_queryMisses;
+    int latched_queryDrops;
 };
 
 // MAX_CHALLENGES is made large to prevent a denial
@@ -305,9 +340,11 @@ struct serverStatic_t {
     int numSnapshotEntities;  // sv_maxclients->integer*PACKET_BACKUP*MAX_SNAPSHOT_ENTITIES
     int nextSnapshotEntities;  // next snapshotEntities to use
     entityState_t *snapshotEntities;  // [numSnapshotEntities]
+    int snapshotFrame;  // bumped every time entity states are captured
     int nextHeartbeatTime;
     challenge_t challenges[MAX_CHALLENGES];  // to prevent invalid IPs from connecting
-    receipt_t   infoReceipts[MAX_INFO_RECEIPTS];
+    receipt_t   infoReceipts[MAX_INFO_RECEIPTS];  // ring, oldest at nextInfoReceipt
+    int nextInfoReceipt;
     netadr_t redirectAddress;  // for rcon return messages
 
     netadr_t authorizeAddress;  // for rcon return messages
@@ -350,6 +387,9 @@ extern cvar_t *sv_minPing;
 extern cvar_t *sv_maxPing;
 extern cvar_t *sv_pure;
 extern cvar_t *sv_lanForceRate;
+extern cvar_t *sv_snapshotThreads;
+extern cvar_t *sv_snapshotCheck;
+extern cvar_t *sv_traceThreads;
 extern cvar_t *sv_banFile;
 
 extern	cvar_t *sv_protect;
@@ -368,25 +408,17 @@ extern cvar_t *sv_rsaAuth;
 // sv_main.c
 //
 struct leakyBucket_t {
-    netadrtype_t type;
-
-    union {
-        byte _4[4];
-        byte _6[16];
-    } ipv;
+    uint64_t key;  // hash of the address, 0 if free or not in the table
 
     int lastTime;
-    signed char burst;
-
-    long hash;
-
-    leakyBucket_t *prev, *next;
+    int burst;
 };
 
 extern leakyBucket_t outboundLeakyBucket;
 
 bool SVC_RateLimit(leakyBucket_t *bucket, int burst, int period);
 bool SVC_RateLimitAddress(netadr_t from, int burst, int period);
+void SV_InvalidateQueryResponses(void);
 
 void SV_FinalMessage(const char *message);
 void QDECL SV_SendServerCommand(client_t *cl, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
@@ -424,6 +456,7 @@ void SV_WriteAttackLog(const char *log);
 void SV_GetChallenge(netadr_t from);
 
 void SV_DirectConnect(netadr_t from);
+void SV_InvalidateGamestate(void);
 
 void SV_ExecuteClientMessage(client_t *cl, msg_t *msg);
 void SV_UserinfoChanged(client_t *cl);
@@ -453,6 +486,8 @@ void SV_WriteFrameToClient(client_t *client, msg_t *msg);
 void SV_SendMessageToClient(msg_t *msg, client_t *client);
 void SV_SendClientMessages(void);
 void SV_SendClientSnapshot(client_t *client);
+void SV_PrepareSnapshotEntities(void);
+int SV_ReplaySnapshot(const playerState_t *ps, int *entityNums);
 
 //
 // sv_game.c
@@ -475,6 +510,9 @@ bool SV_inPVS(const vec3_t p1, const vec3_t p2);
 void SV_ClearWorld(void);
 // called after the world model has been loaded, before linking any entities
 
+void SV_ResetWorld(void);
+// empties the world of a map that SV_ClearWorld has already set up
+
 void SV_UnlinkEntity(sharedEntity_t *ent);
 // call before removing an entity, and before trying to move one,
 // so it doesn't clip against itself
@@ -489,6 +527,7 @@ void SV_LinkEntity(sharedEntity_t *ent);
 clipHandle_t SV_ClipHandleForEntity(const sharedEntity_t *ent);
 
 void SV_SectorList_f(void);
+void SV_WorldFrame(void);
 
 int SV_AreaEntities(const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount);
 // fills in a table of entity numbers with entities that have bounding boxes
@@ -513,10 +552,32 @@ void SV_Trace(trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, co
 
 // passEntityNum is explicitly excluded from clipping checks (normally ENTITYNUM_NONE)
 
+void SV_TraceBatch(trace_t *results, const traceRequest_t *requests, int numRequests);
+// runs SV_Trace for every request, spread over sv_traceThreads threads
+
 void SV_ClipToEntity(trace_t *trace, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end,
     int entityNum, int contentmask, traceType_t type);
 // clip to a specific entity
 
+//
+// sv_capture.cpp
+//
+bool SV_Capturing(void);
+void SV_CaptureTrace(const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end,
+    int passEntityNum, int contentmask, traceType_t type);
+void SV_CaptureLink(sharedEntity_t *gEnt);
+void SV_CaptureUnlink(sharedEntity_t *gEnt);
+void SV_CaptureUsercmd(int clientNum, const usercmd_t *cmd);
+void SV_CaptureFrame(void);
+void SV_StopCapture(void);
+void SV_TraceCapture_f(void);
+void SV_TraceReplay_f(void);
+void SV_AreaReplay_f(void);
+void SV_SnapshotReplay_f(void);
+#ifdef DEDICATED
+void SV_PmoveBench_f(void);
+#endif
+
 //
 // sv_net_chan.c
 //
@@ -0,0 +1,1610 @@
+/*
+===========================================================================
+Copyright (C) 2015-2019 GrangerHub
+
+This file is part of Tremulous.
+
+Tremulous is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 3 of the License,
+or (at your option) any later version.
+
+Tremulous is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Tremulous; if not, see <https://www.gnu.org/licenses/>
+
+===========================================================================
+*/
+
+// sv_capture.cpp -- trace workload capture and replay
+
+// bg_public.h clashes with a few defines of server.h that are only there
+// for the server's own use, so it has to come first
+extern "C" {
+#include "../game/bg_public.h"
+}
+
+#include "server.h"
+
+#include <chrono>
+#include <thread>
+
+#if idx64 || id386
+#include <emmintrin.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+===============================================================================
+
+"tracecapture <name>" records every SV_Trace of a running game, together
+with every link and unlink, to traces/<name>.trc.  Recording the links in
+the order they happen means a replay sees exactly the entity positions each
+trace saw, even for traces made in the middle of a game frame.
+
+"tracereplay <name> [passes]" loads the map of a capture with no server
+running, feeds the links back through SV_LinkEntity and times each trace,
+so collision changes can be measured against the load of a real game.  It
+also prints a hash of the results, which has to stay the same for a change
+that isn't meant to alter collision.  "areareplay <name> [passes]" does the
+same but only runs the SV_AreaEntities query each trace starts with, over the
+bounds of its move, to time the entity tree on its own.  With "cold" after
+the passes it flushes the entity data out of the cache before every query,
+which is closer to a query made after the game has run over everything else.
+"snapshotreplay <name> [clients] [passes] [cold]" builds the snapshot entity
+lists of synthetic clients at the end of every captured frame instead.  On
+Linux these two also count the cycles and cache misses of what they time,
+when the kernel hands out the hardware counters.
+
+A capture also holds every usercmd the game was given, each with the
+playerState_t the game had before thinking with it.  "pmovebench <name>
+[threads] [passes]" replays the links the same way and runs Pmove from that
+state for every usercmd, so each one is an independent move.  The usercmds
+of a frame run together against the world as it is linked at the end of
+the frame, once on this thread, timed per class, and once spread over
+[threads] threads.  Both runs have to end in the same player states.  The
+bg code is only linked into the dedicated server, so that is the only
+place pmovebench exists.
+
+===============================================================================
+*/
+
+#define CAPTURE_IDENT (('1' << 24) + ('C' << 16) + ('R' << 8) + 'T')  // little-endian "TRC1"
+#define CAPTURE_VERSION 3  // 1 had no usercmds, 2 no gentitySize
+#define CAPTURE_BUFFER 65536
+
+// the latency histogram has CAPTURE_STEPS buckets for every power of two
+// nanoseconds, which keeps the percentiles within about 6%
+#define CAPTURE_STEPS 16
+#define CAPTURE_BUCKETS (32 * CAPTURE_STEPS)
+
+typedef enum {
+    CAP_FRAME,    // int time
+    CAP_LINK,     // captureEntity_t
+    CAP_UNLINK,   // int number
+    CAP_TRACE,    // captureTrace_t
+    CAP_USERCMD   // captureUsercmd_t
+} captureType_t;
+
+struct captureHeader_t {
+    int ident;
+    int version;
+    char mapname[MAX_QPATH];
+    int checksum;  // of the bsp, as in sv_mapChecksum
+    int gentitySize;  // the game's, so a replay has the same stride
+};
+
+struct captureEntity_t {
+    int number;
+    int bmodel;
+    int modelindex;
+    int svFlags;
+    int contents;
+    int ownerNum;
+    vec3_t origin;
+    vec3_t angles;
+    vec3_t mins;
+    vec3_t maxs;
+};
+
+struct captureTrace_t {
+    vec3_t start;
+    vec3_t end;
+    vec3_t mins;
+    vec3_t maxs;
+    int passEntityNum;
+    int contentmask;
+    int type;
+};
+
+struct captureUsercmd_t {
+    int clientNum;
+    usercmd_t cmd;
+    playerState_t ps;  // before the game thought with cmd
+};
+
+struct capture_t {
+    bool active;
+    fileHandle_t file;
+    char name[MAX_QPATH];
+    int used;
+    int frames, links, traces, usercmds;
+    byte buffer[CAPTURE_BUFFER];
+};
+
+static capture_t sv_capture;
+
+/*
+==================
+SV_CaptureFlush
+==================
+*/
+static void SV_CaptureFlush(void)
+{
+    if (sv_capture.used)
+    {
+        FS_Write(sv_capture.buffer, sv_capture.used, sv_capture.file);
+        sv_capture.used = 0;
+    }
+}
+
+/*
+==================
+SV_CaptureWrite
+==================
+*/
+static void SV_CaptureWrite(captureType_t type, const void *data, int size)
+{
+    int t = type;
+
+    if (sv_capture.used + (int)sizeof(t) + size > CAPTURE_BUFFER)
+    {
+        SV_CaptureFlush();
+    }
+
+    ::memcpy(sv_capture.buffer + sv_capture.used, &t, sizeof(t));
+    ::memcpy(sv_capture.buffer + sv_capture.used + sizeof(t), data, size);
+    sv_capture.used += sizeof(t) + size;
+}
+
+/*
+==================
+SV_Capturing
+==================
+*/
+bool SV_Capturing(void) { return sv_capture.active; }
+
+/*
+==================
+SV_CaptureTrace
+
+Only called from the main thread, SV_TraceBatch records its requests before
+handing them to the job pool.
+==================
+*/
+void SV_CaptureTrace(const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end,
+    int passEntityNum, int contentmask, traceType_t type)
+{
+    captureTrace_t trace;
+
+    VectorCopy(start, trace.start);
+    VectorCopy(end, trace.end);
+    VectorCopy(mins ? mins : vec3_origin, trace.mins);
+    VectorCopy(maxs ? maxs : vec3_origin, trace.maxs);
+    trace.passEntityNum = passEntityNum;
+    trace.contentmask = contentmask;
+    trace.type = type;
+
+    SV_CaptureWrite(CAP_TRACE, &trace, sizeof(trace));
+    sv_capture.traces++;
+}
+
+/*
+==================
+SV_CaptureLink
+==================
+*/
+void SV_CaptureLink(sharedEntity_t *gEnt)
+{
+    captureEntity_t ent;
+
+    ent.number = SV_NumForGentity(gEnt);
+    ent.bmodel = gEnt->r.bmodel;
+    ent.modelindex = gEnt->s.modelindex;
+    ent.svFlags = gEnt->r.svFlags;
+    ent.contents = gEnt->r.contents;
+    ent.ownerNum = gEnt->r.ownerNum;
+    VectorCopy(gEnt->r.currentOrigin, ent.origin);
+    VectorCopy(gEnt->r.currentAngles, ent.angles);
+    VectorCopy(gEnt->r.mins, ent.mins);
+    VectorCopy(gEnt->r.maxs, ent.maxs);
+
+    SV_CaptureWrite(CAP_LINK, &ent, sizeof(ent));
+    sv_capture.links++;
+}
+
+/*
+==================
+SV_CaptureUnlink
+==================
+*/
+void SV_CaptureUnlink(sharedEntity_t *gEnt)
+{
+    int number = SV_NumForGentity(gEnt);
+
+    SV_CaptureWrite(CAP_UNLINK, &number, sizeof(number));
+}
+
+/*
+==================
+SV_CaptureUsercmd
+
+Called before the game thinks with cmd, so the client's playerState_t is
+still the one the Pmove of cmd starts from
+==================
+*/
+void SV_CaptureUsercmd(int clientNum, const usercmd_t *cmd)
+{
+    captureUsercmd_t usercmd;
+
+    usercmd.clientNum = clientNum;
+    usercmd.cmd = *cmd;
+    usercmd.ps = *SV_GameClientNum(clientNum);
+
+    SV_CaptureWrite(CAP_USERCMD, &usercmd, sizeof(usercmd));
+    sv_capture.usercmds++;
+}
+
+/*
+==================
+SV_CaptureFrame
+==================
+*/
+void SV_CaptureFrame(void)
+{
+    SV_CaptureWrite(CAP_FRAME, &sv.time, sizeof(sv.time));
+    sv_capture.frames++;
+}
+
+/*
+==================
+SV_StopCapture
+==================
+*/
+void SV_StopCapture(void)
+{
+    if (!sv_capture.active)
+    {
+        return;
+    }
+
+    SV_CaptureFlush();
+    FS_FCloseFile(sv_capture.file);
+    sv_capture.active = false;
+
+    Com_Printf("Stopped trace capture %s: %i frames, %i links, %i traces, %i usercmds\n", sv_capture.name,
+        sv_capture.frames, sv_capture.links, sv_capture.traces, sv_capture.usercmds);
+}
+
+/*
+==================
+SV_TraceCapture_f
+
+tracecapture <name> | stop
+==================
+*/
+void SV_TraceCapture_f(void)
+{
+    captureHeader_t header;
+    sharedEntity_t *gEnt;
+    int i;
+
+    if (Cmd_Argc() != 2)
+    {
+        Com_Printf("usage: tracecapture <name> | stop\n");
+        return;
+    }
+
+    if (!Q_stricmp(Cmd_Argv(1), "stop"))
+    {
+        SV_StopCapture();
+        return;
+    }
+
+    if (!com_sv_running->integer || sv.state != SS_GAME)
+    {
+        Com_Printf("Server is not running.\n");
+        return;
+    }
+
+    SV_StopCapture();
+
+    Com_sprintf(sv_capture.name, sizeof(sv_capture.name), "traces/%s.trc", Cmd_Argv(1));
+    sv_capture.file = FS_FOpenFileWrite(sv_capture.name);
+    if (!sv_capture.file)
+    {
+        Com_Printf("Couldn't open %s for writing.\n", sv_capture.name);
+        return;
+    }
+
+    ::memset(&header, 0, sizeof(header));
+    header.ident = CAPTURE_IDENT;
+    header.version = CAPTURE_VERSION;
+    Q_strncpyz(header.mapname, Cvar_VariableString("mapname"), sizeof(header.mapname));
+    header.checksum = Cvar_VariableIntegerValue("sv_mapChecksum");
+    header.gentitySize = sv.gentitySize;
+    FS_Write(&header, sizeof(header), sv_capture.file);
+
+    sv_capture.active = true;
+    sv_capture.used = 0;
+    sv_capture.frames = sv_capture.links = sv_capture.traces = sv_capture.usercmds = 0;
+
+    // start from everything that is already in the world
+    for (i = 0; i < sv.num_entities; i++)
+    {
+        gEnt = SV_GentityNum(i);
+        if (gEnt->r.linked)
+        {
+            SV_CaptureLink(gEnt);
+        }
+    }
+
+    Com_Printf("Capturing traces to %s\n", sv_capture.name);
+}
+
+/*
+==================
+SV_ReplayRead
+==================
+*/
+static bool SV_ReplayRead(fileHandle_t f, void *data, int size) { return FS_Read(data, size, f) == size; }
+
+/*
+==================
+SV_ReplayReadHeader
+==================
+*/
+static bool SV_ReplayReadHeader(fileHandle_t f, captureHeader_t *header)
+{
+    if (!SV_ReplayRead(f, header, offsetof(captureHeader_t, gentitySize)) || header->ident != CAPTURE_IDENT ||
+        header->version < 1 || header->version > CAPTURE_VERSION)
+    {
+        return false;
+    }
+
+    if (header->version < 3)
+    {
+        header->gentitySize = sizeof(sharedEntity_t);
+        return true;
+    }
+
+    return SV_ReplayRead(f, &header->gentitySize, sizeof(header->gentitySize)) &&
+           header->gentitySize >= (int)sizeof(sharedEntity_t);
+}
+
+/*
+==================
+SV_ReplayBucket
+
+Below CAPTURE_STEPS every nanosecond has its own bucket, above that ns is
+shifted down into [CAPTURE_STEPS, 2 * CAPTURE_STEPS) and the shift picks the
+row of buckets.
+==================
+*/
+static int SV_ReplayBucket(int64_t ns)
+{
+    int shift;
+
+    if (ns < CAPTURE_STEPS)
+    {
+        return ns < 0 ? 0 : (int)ns;
+    }
+
+    for (shift = 0; (ns >> shift) >= 2 * CAPTURE_STEPS; shift++)
+    {
+    }
+
+    return MIN(shift * CAPTURE_STEPS + (int)(ns >> shift), CAPTURE_BUCKETS - 1);
+}
+
+/*
+==================
+SV_ReplayBucketTime
+
+The upper bound of a bucket in microseconds
+==================
+*/
+static float SV_ReplayBucketTime(int bucket)
+{
+    int shift;
+
+    if (bucket < CAPTURE_STEPS)
+    {
+        return (bucket + 1) * 0.001f;
+    }
+
+    shift = bucket / CAPTURE_STEPS - 1;
+    return (float)((int64_t)(bucket % CAPTURE_STEPS + CAPTURE_STEPS + 1) << shift) * 0.001f;
+}
+
+/*
+==================
+SV_ReplayPercentile
+==================
+*/
+static float SV_ReplayPercentile(const int64_t *histogram, int64_t count, float fraction)
+{
+    int64_t target, seen;
+    int i;
+
+    target = (int64_t)(count * fraction);
+    seen = 0;
+    for (i = 0; i < CAPTURE_BUCKETS; i++)
+    {
+        seen += histogram[i];
+        if (seen > target)
+        {
+            break;
+        }
+    }
+
+    return SV_ReplayBucketTime(MIN(i, CAPTURE_BUCKETS - 1));
+}
+
+/*
+==================
+SV_ReplayHash
+
+Folds in the parts of a trace result that a collision change must not alter,
+so two builds can be checked against each other with the same capture.
+==================
+*/
+static unsigned SV_ReplayHash(unsigned hash, const trace_t *trace)
+{
+    int values[12];
+    const byte *b;
+    size_t i;
+
+    ::memcpy(&values[0], &trace->fraction, sizeof(float));
+    ::memcpy(&values[1], trace->endpos, 3 * sizeof(float));
+    ::memcpy(&values[4], trace->plane.normal, 3 * sizeof(float));
+    ::memcpy(&values[7], &trace->plane.dist, sizeof(float));
+    values[8] = trace->entityNum;
+    values[9] = trace->startsolid | (trace->allsolid << 1);
+    values[10] = trace->contents;
+    values[11] = trace->surfaceFlags;
+
+    b = (const byte *)values;
+    for (i = 0; i < sizeof(values); i++)
+    {
+        hash = (hash ^ b[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+/*
+==================
+SV_ReplayBegin
+
+Opens the capture only to check it, loads its map the same way as
+SV_SpawnServer, and points sv.gentities at entities of our own, as far
+apart as the game's were
+==================
+*/
+static bool SV_ReplayBegin(const char *capture, char *name, int nameSize, captureHeader_t *header)
+{
+    fileHandle_t f;
+    int checksum;
+
+    Com_sprintf(name, nameSize, "traces/%s.trc", capture);
+    if (FS_FOpenFileRead(name, &f, true) <= 0 || !f)
+    {
+        Com_Printf("Couldn't open %s.\n", name);
+        return false;
+    }
+    if (!SV_ReplayReadHeader(f, header))
+    {
+        FS_FCloseFile(f);
+        Com_Printf("%s is not a trace capture.\n", name);
+        return false;
+    }
+    FS_FCloseFile(f);
+    header->mapname[sizeof(header->mapname) - 1] = '\0';
+
+    Hunk_Clear();
+    CM_ClearMap();
+
+    CM_LoadMap(va("maps/%s.bsp", header->mapname), false, &checksum);
+    if (checksum != header->checksum)
+    {
+        Com_Printf(S_COLOR_YELLOW "WARNING: maps/%s.bsp has changed since %s was captured\n", header->mapname, name);
+    }
+
+    sv.gentitySize = header->gentitySize;
+    sv.gentities = (sharedEntity_t *)Hunk_Alloc(MAX_GENTITIES * sv.gentitySize, h_high);
+    sv.num_entities = MAX_GENTITIES;
+    SV_ClearWorld();
+
+    return true;
+}
+
+/*
+==================
+SV_ReplayRestart
+
+Empties the world and reopens the capture past its header
+==================
+*/
+static fileHandle_t SV_ReplayRestart(const char *name)
+{
+    captureHeader_t header;
+    fileHandle_t f;
+
+    ::memset(sv.gentities, 0, MAX_GENTITIES * sv.gentitySize);
+    ::memset(sv.svEntities, 0, sizeof(sv.svEntities));
+    SV_ResetWorld();
+
+    FS_FOpenFileRead(name, &f, true);
+    SV_ReplayReadHeader(f, &header);
+
+    return f;
+}
+
+/*
+==================
+SV_ReplayLink
+==================
+*/
+static bool SV_ReplayLink(fileHandle_t f)
+{
+    captureEntity_t capEnt;
+    sharedEntity_t *gEnt;
+
+    if (!SV_ReplayRead(f, &capEnt, sizeof(capEnt)) || capEnt.number < 0 || capEnt.number >= MAX_GENTITIES)
+    {
+        return false;
+    }
+
+    gEnt = SV_GentityNum(capEnt.number);
+    gEnt->s.number = capEnt.number;
+    gEnt->s.modelindex = capEnt.modelindex;
+    gEnt->r.bmodel = (qboolean)capEnt.bmodel;
+    gEnt->r.svFlags = capEnt.svFlags;
+    gEnt->r.contents = capEnt.contents;
+    gEnt->r.ownerNum = capEnt.ownerNum;
+    VectorCopy(capEnt.origin, gEnt->r.currentOrigin);
+    VectorCopy(capEnt.angles, gEnt->r.currentAngles);
+    VectorCopy(capEnt.mins, gEnt->r.mins);
+    VectorCopy(capEnt.maxs, gEnt->r.maxs);
+    SV_LinkEntity(gEnt);
+
+    return true;
+}
+
+/*
+==================
+SV_ReplayUnlink
+==================
+*/
+static bool SV_ReplayUnlink(fileHandle_t f)
+{
+    int number;
+
+    if (!SV_ReplayRead(f, &number, sizeof(number)) || number < 0 || number >= MAX_GENTITIES)
+    {
+        return false;
+    }
+
+    SV_UnlinkEntity(SV_GentityNum(number));
+
+    return true;
+}
+
+/*
+==================
+SV_ReplayEnd
+
+Leaves nothing behind for the next map
+==================
+*/
+static void SV_ReplayEnd(void)
+{
+    ::memset(&sv, 0, sizeof(sv));
+    Hunk_Clear();
+    CM_ClearMap();
+}
+
+/*
+==================
+SV_TraceReplay_f
+
+tracereplay <name> [passes]
+
+Only runs on a dedicated server with no map loaded, since it loads the map
+of the capture and uses the server's world and entities for itself:
+    tremded +tracereplay <name> 10 +quit
+==================
+*/
+void SV_TraceReplay_f(void)
+{
+    static int64_t histogram[CAPTURE_BUCKETS];
+    char name[MAX_QPATH];
+    fileHandle_t f;
+    captureHeader_t header;
+    captureTrace_t capTrace;
+    captureUsercmd_t usercmd;
+    trace_t trace;
+    int type, time;
+    int pass, passes;
+    unsigned hash;
+    int64_t frames, links, traces, ns, totalNs, maxNs;
+    std::chrono::steady_clock::time_point start;
+
+    if (Cmd_Argc() < 2)
+    {
+        Com_Printf("usage: tracereplay <name> [passes]\n");
+        return;
+    }
+
+    if (!com_dedicated->integer || com_sv_running->integer)
+    {
+        Com_Printf("tracereplay only runs on a dedicated server with no map loaded.\n");
+        return;
+    }
+
+    passes = Cmd_Argc() > 2 ? MAX(atoi(Cmd_Argv(2)), 1) : 1;
+
+    if (!SV_ReplayBegin(Cmd_Argv(1), name, sizeof(name), &header))
+    {
+        return;
+    }
+
+    ::memset(histogram, 0, sizeof(histogram));
+    frames = links = traces = totalNs = maxNs = 0;
+    hash = 0;
+
+    for (pass = 0; pass < passes; pass++)
+    {
+        hash = 2166136261u;
+        f = SV_ReplayRestart(name);
+
+        while (SV_ReplayRead(f, &type, sizeof(type)))
+        {
+            if (type == CAP_FRAME)
+            {
+                if (!SV_ReplayRead(f, &time, sizeof(time)))
+                {
+                    break;
+                }
+                sv.time = time;
+                frames++;
+            }
+            else if (type == CAP_LINK)
+            {
+                if (!SV_ReplayLink(f))
+                {
+                    break;
+                }
+                links++;
+            }
+            else if (type == CAP_UNLINK)
+            {
+                if (!SV_ReplayUnlink(f))
+                {
+                    break;
+                }
+            }
+            else if (type == CAP_TRACE)
+            {
+                if (!SV_ReplayRead(f, &capTrace, sizeof(capTrace)))
+                {
+                    break;
+                }
+
+                start = std::chrono::steady_clock::now();
+                SV_Trace(&trace, capTrace.start, capTrace.mins, capTrace.maxs, capTrace.end, capTrace.passEntityNum,
+                    capTrace.contentmask, capTrace.type == TT_CAPSULE ? TT_CAPSULE : TT_AABB);
+                ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
+                         .count();
+
+                hash = SV_ReplayHash(hash, &trace);
+                histogram[SV_ReplayBucket(ns)]++;
+                totalNs += ns;
+                maxNs = MAX(maxNs, ns);
+                traces++;
+            }
+            else if (type == CAP_USERCMD)
+            {
+                if (!SV_ReplayRead(f, &usercmd, sizeof(usercmd)))
+                {
+                    break;
+                }
+            }
+            else
+            {
+                Com_Printf(S_COLOR_YELLOW "WARNING: %s has a bad record type %i\n", name, type);
+                break;
+            }
+        }
+
+        FS_FCloseFile(f);
+    }
+
+    Com_Printf("%s on %s: %i passes, %lli frames, %lli links, %lli traces, results %08x\n", name, header.mapname,
+        passes, (long long)frames, (long long)links, (long long)traces, hash);
+    if (traces)
+    {
+        Com_Printf("%.0f traces/sec, mean %.2fus\n", traces * 1e9 / MAX(totalNs, 1), totalNs * 0.001 / traces);
+        Com_Printf("p50 %.2fus, p90 %.2fus, p99 %.2fus, p99.9 %.2fus, max %.2fus\n",
+            SV_ReplayPercentile(histogram, traces, 0.5f), SV_ReplayPercentile(histogram, traces, 0.9f),
+            SV_ReplayPercentile(histogram, traces, 0.99f), SV_ReplayPercentile(histogram, traces, 0.999f),
+            maxNs * 0.001);
+    }
+
+    SV_ReplayEnd();
+}
+
+/*
+==================
+SV_ReplayEvict
+
+Flushes the gentities and everything the server keeps per entity out of
+the cache
+==================
+*/
+static void SV_ReplayEvict(void)
+{
+#if idx64 || id386
+    const byte *regions[2] = {(const byte *)sv.gentities, (const byte *)sv.svEntities};
+    size_t sizes[2] = {(size_t)MAX_GENTITIES * sv.gentitySize, sizeof(sv.svEntities)};
+    size_t i, j;
+
+    for (i = 0; i < ARRAY_LEN(regions); i++)
+    {
+        for (j = 0; j < sizes[i]; j += 64)
+        {
+            _mm_clflush(regions[i] + j);
+        }
+    }
+    _mm_mfence();
+#endif
+}
+
+/*
+==================
+SV_ReplayCompareInts
+==================
+*/
+static int QDECL SV_ReplayCompareInts(const void *a, const void *b) { return *(const int *)a - *(const int *)b; }
+
+struct replayCounters_t {
+    int group;  // the cycle counter leads the group, -1 if there is none
+    int misses;
+    int64_t cycles, cacheMisses;
+};
+
+#ifdef __linux__
+/*
+==================
+SV_ReplayOpenCounter
+==================
+*/
+static int SV_ReplayOpenCounter(unsigned long long config, int group)
+{
+    struct perf_event_attr attr;
+
+    ::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif
+
+/*
+==================
+SV_ReplayOpenCounters
+
+Counts the cycles and cache misses of this thread in user space, where the
+kernel lets us have the hardware counters
+==================
+*/
+static void SV_ReplayOpenCounters(replayCounters_t *counters)
+{
+    counters->cycles = counters->cacheMisses = 0;
+    counters->group = counters->misses = -1;
+
+#ifdef __linux__
+    counters->group = SV_ReplayOpenCounter(PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (counters->group < 0)
+    {
+        return;
+    }
+
+    counters->misses = SV_ReplayOpenCounter(PERF_COUNT_HW_CACHE_MISSES, counters->group);
+    if (counters->misses < 0)
+    {
+        close(counters->group);
+        counters->group = -1;
+    }
+#endif
+}
+
+/*
+==================
+SV_ReplayReadCounters
+
+Fills values with the cycles and the cache misses so far
+==================
+*/
+static void SV_ReplayReadCounters(const replayCounters_t *counters, int64_t *values)
+{
+    values[0] = values[1] = 0;
+
+#ifdef __linux__
+    uint64_t group[3];  // the number of counters, then their values
+
+    if (counters->group >= 0 && read(counters->group, group, sizeof(group)) == (ssize_t)sizeof(group))
+    {
+        values[0] = (int64_t)group[1];
+        values[1] = (int64_t)group[2];
+    }
+#endif
+}
+
+/*
+==================
+SV_ReplayAddCounters
+
+Adds what was counted since start was read
+==================
+*/
+static void SV_ReplayAddCounters(replayCounters_t *counters, const int64_t *start)
+{
+    int64_t values[2];
+
+    SV_ReplayReadCounters(counters, values);
+    counters->cycles += values[0] - start[0];
+    counters->cacheMisses += values[1] - start[1];
+}
+
+/*
+==================
+SV_ReplayPrintCounters
+==================
+*/
+static void SV_ReplayPrintCounters(const replayCounters_t *counters, int64_t count, const char *per)
+{
+    if (counters->group < 0)
+    {
+        Com_Printf("cycles and cache misses unavailable\n");
+        return;
+    }
+
+    Com_Printf("%.0f cycles, %.2f cache misses per %s\n", (double)counters->cycles / MAX(count, 1),
+        (double)counters->cacheMisses / MAX(count, 1), per);
+}
+
+/*
+==================
+SV_ReplayCloseCounters
+==================
+*/
+static void SV_ReplayCloseCounters(replayCounters_t *counters)
+{
+#ifdef __linux__
+    if (counters->group >= 0)
+    {
+        close(counters->misses);
+        close(counters->group);
+    }
+#endif
+}
+
+/*
+==================
+SV_AreaReplay_f
+
+areareplay <name> [passes] [cold]
+
+Like tracereplay, but every trace is replaced by the SV_AreaEntities query
+over the bounds of its move.  The hash is of the sorted entity lists, so it
+doesn't depend on the order a tree hands entities out in.
+==================
+*/
+void SV_AreaReplay_f(void)
+{
+    static int64_t histogram[CAPTURE_BUCKETS];
+    static int entityList[MAX_GENTITIES];
+    char name[MAX_QPATH];
+    fileHandle_t f;
+    captureHeader_t header;
+    captureTrace_t capTrace;
+    captureUsercmd_t usercmd;
+    replayCounters_t counters;
+    vec3_t mins, maxs;
+    int type, time;
+    int i, pass, passes, count;
+    bool cold;
+    unsigned hash;
+    int64_t frames, queries, found, ns, totalNs, maxNs;
+    int64_t counted[2];
+    std::chrono::steady_clock::time_point start;
+
+    if (Cmd_Argc() < 2)
+    {
+        Com_Printf("usage: areareplay <name> [passes] [cold]\n");
+        return;
+    }
+
+    if (!com_dedicated->integer || com_sv_running->integer)
+    {
+        Com_Printf("areareplay only runs on a dedicated server with no map loaded.\n");
+        return;
+    }
+
+    passes = Cmd_Argc() > 2 ? MAX(atoi(Cmd_Argv(2)), 1) : 1;
+    cold = !Q_stricmp(Cmd_Argv(3), "cold");
+#if !idx64 && !id386
+    if (cold)
+    {
+        Com_Printf(S_COLOR_YELLOW "WARNING: areareplay can only flush the cache on x86\n");
+    }
+#endif
+
+    if (!SV_ReplayBegin(Cmd_Argv(1), name, sizeof(name), &header))
+    {
+        return;
+    }
+
+    SV_ReplayOpenCounters(&counters);
+
+    ::memset(histogram, 0, sizeof(histogram));
+    frames = queries = found = totalNs = maxNs = 0;
+    hash = 0;
+
+    for (pass = 0; pass < passes; pass++)
+    {
+        hash = 2166136261u;
+        f = SV_ReplayRestart(name);
+
+        while (SV_ReplayRead(f, &type, sizeof(type)))
+        {
+            if (type == CAP_FRAME)
+            {
+                if (!SV_ReplayRead(f, &time, sizeof(time)))
+                {
+                    break;
+                }
+                sv.time = time;
+                frames++;
+            }
+            else if (type == CAP_LINK)
+            {
+                if (!SV_ReplayLink(f))
+                {
+                    break;
+                }
+            }
+            else if (type == CAP_UNLINK)
+            {
+                if (!SV_ReplayUnlink(f))
+                {
+                    break;
+                }
+            }
+            else if (type == CAP_TRACE)
+            {
+                if (!SV_ReplayRead(f, &capTrace, sizeof(capTrace)))
+                {
+                    break;
+                }
+
+                // the same box SV_Trace asks for
+                for (i = 0; i < 3; i++)
+                {
+                    mins[i] = MIN(capTrace.start[i], capTrace.end[i]) + capTrace.mins[i] - 1;
+                    maxs[i] = MAX(capTrace.start[i], capTrace.end[i]) + capTrace.maxs[i] + 1;
+                }
+
+                if (cold)
+                {
+                    SV_ReplayEvict();
+                }
+
+                SV_ReplayReadCounters(&counters, counted);
+                start = std::chrono::steady_clock::now();
+                count = SV_AreaEntities(mins, maxs, entityList, MAX_GENTITIES);
+                ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
+                         .count();
+                SV_ReplayAddCounters(&counters, counted);
+
+                qsort(entityList, count, sizeof(entityList[0]), SV_ReplayCompareInts);
+                for (i = 0; i < count; i++)
+                {
+                    hash = (hash ^ entityList[i]) * 16777619u;
+                }
+                hash = (hash ^ 0xff) * 16777619u;
+
+                histogram[SV_ReplayBucket(ns)]++;
+                totalNs += ns;
+                maxNs = MAX(maxNs, ns);
+                found += count;
+                queries++;
+            }
+            else if (type == CAP_USERCMD)
+            {
+                if (!SV_ReplayRead(f, &usercmd, sizeof(usercmd)))
+                {
+                    break;
+                }
+            }
+            else
+            {
+                Com_Printf(S_COLOR_YELLOW "WARNING: %s has a bad record type %i\n", name, type);
+                break;
+            }
+        }
+
+        FS_FCloseFile(f);
+    }
+
+    Com_Printf("%s on %s%s: %i passes, %lli frames, %lli queries, %.1f entities found per query, results %08x\n",
+        name, header.mapname, cold ? ", cold" : "", passes, (long long)frames, (long long)queries, (double)found / MAX(queries, 1), hash);
+    if (queries)
+    {
+        Com_Printf("%.0f queries/sec, mean %.3fus\n", queries * 1e9 / MAX(totalNs, 1), totalNs * 0.001 / queries);
+        Com_Printf("p50 %.2fus, p90 %.2fus, p99 %.2fus, p99.9 %.2fus, max %.2fus\n",
+            SV_ReplayPercentile(histogram, queries, 0.5f), SV_ReplayPercentile(histogram, queries, 0.9f),
+            SV_ReplayPercentile(histogram, queries, 0.99f), SV_ReplayPercentile(histogram, queries, 0.999f),
+            maxNs * 0.001);
+        SV_ReplayPrintCounters(&counters, queries, "query");
+    }
+
+    SV_ReplayCloseCounters(&counters);
+    SV_ReplayEnd();
+}
+
+/*
+==================
+SV_SnapshotReplay_f
+
+snapshotreplay <name> [clients] [passes] [cold]
+
+Like tracereplay, but at the end of every captured frame it builds the
+entity lists of [clients] synthetic clients the way SV_SendClientMessages
+does, after the SV_PrepareSnapshotEntities of the frame, which is timed on
+its own.  The clients look through the last playerstate of each client the
+capture has usercmds for.  With more clients than that, the extra ones
+reuse those viewpoints under their own client numbers.  Without [clients]
+there is one for each client in the capture.
+==================
+*/
+void SV_SnapshotReplay_f(void)
+{
+    static int64_t histogram[CAPTURE_BUCKETS];
+    static int entityList[MAX_SNAPSHOT_ENTITIES];
+    static playerState_t viewers[MAX_CLIENTS];
+    char name[MAX_QPATH];
+    fileHandle_t f;
+    captureHeader_t header;
+    captureTrace_t capTrace;
+    captureUsercmd_t usercmd;
+    replayCounters_t counters;
+    playerState_t ps;
+    int viewerNums[MAX_CLIENTS];
+    bool seen[MAX_CLIENTS];
+    int type, time;
+    int i, j, pass, passes, clients, numViewers, count;
+    bool cold;
+    unsigned hash;
+    int64_t frames, prepared, snapshots, found, ns, totalNs, maxNs, prepareNs;
+    int64_t counted[2];
+    std::chrono::steady_clock::time_point start;
+
+    if (Cmd_Argc() < 2)
+    {
+        Com_Printf("usage: snapshotreplay <name> [clients] [passes] [cold]\n");
+        return;
+    }
+
+    if (!com_dedicated->integer || com_sv_running->integer)
+    {
+        Com_Printf("snapshotreplay only runs on a dedicated server with no map loaded.\n");
+        return;
+    }
+
+    clients = Cmd_Argc() > 2 ? Com_Clamp(0, MAX_CLIENTS, atoi(Cmd_Argv(2))) : 0;
+    passes = Cmd_Argc() > 3 ? MAX(atoi(Cmd_Argv(3)), 1) : 1;
+    cold = !Q_stricmp(Cmd_Argv(4), "cold");
+#if !idx64 && !id386
+    if (cold)
+    {
+        Com_Printf(S_COLOR_YELLOW "WARNING: snapshotreplay can only flush the cache on x86\n");
+    }
+#endif
+
+    if (!SV_ReplayBegin(Cmd_Argv(1), name, sizeof(name), &header))
+    {
+        return;
+    }
+
+    // the snapshot code does nothing without a running game
+    sv.state = SS_GAME;
+
+    SV_ReplayOpenCounters(&counters);
+
+    ::memset(histogram, 0, sizeof(histogram));
+    frames = prepared = snapshots = found = totalNs = maxNs = prepareNs = 0;
+    hash = 0;
+
+    for (pass = 0; pass < passes; pass++)
+    {
+        hash = 2166136261u;
+        numViewers = 0;
+        ::memset(seen, 0, sizeof(seen));
+        f = SV_ReplayRestart(name);
+
+        while (SV_ReplayRead(f, &type, sizeof(type)))
+        {
+            if (type == CAP_FRAME)
+            {
+                if (!SV_ReplayRead(f, &time, sizeof(time)))
+                {
+                    break;
+                }
+                sv.time = time;
+                frames++;
+
+                if (!numViewers)
+                {
+                    continue;
+                }
+
+                if (cold)
+                {
+                    SV_ReplayEvict();
+                }
+
+                start = std::chrono::steady_clock::now();
+                SV_PrepareSnapshotEntities();
+                ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
+                         .count();
+                prepareNs += ns;
+                prepared++;
+
+                for (i = 0; i < (clients ? clients : numViewers); i++)
+                {
+                    ps = viewers[viewerNums[i % numViewers]];
+                    if (i >= numViewers)
+                    {
+                        ps.clientNum = i;
+                    }
+
+                    if (cold)
+                    {
+                        SV_ReplayEvict();
+                    }
+
+                    SV_ReplayReadCounters(&counters, counted);
+                    start = std::chrono::steady_clock::now();
+                    count = SV_ReplaySnapshot(&ps, entityList);
+                    ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count();
+                    SV_ReplayAddCounters(&counters, counted);
+
+                    hash = (hash ^ ps.clientNum) * 16777619u;
+                    for (j = 0; j < count; j++)
+                    {
+                        hash = (hash ^ entityList[j]) * 16777619u;
+                    }
+                    hash = (hash ^ 0xff) * 16777619u;
+
+                    histogram[SV_ReplayBucket(ns)]++;
+                    totalNs += ns;
+                    maxNs = MAX(maxNs, ns);
+                    found += count;
+                    snapshots++;
+                }
+            }
+            else if (type == CAP_LINK)
+            {
+                if (!SV_ReplayLink(f))
+                {
+                    break;
+                }
+            }
+            else if (type == CAP_UNLINK)
+            {
+                if (!SV_ReplayUnlink(f))
+                {
+                    break;
+                }
+            }
+            else if (type == CAP_TRACE)
+            {
+                if (!SV_ReplayRead(f, &capTrace, sizeof(capTrace)))
+                {
+                    break;
+                }
+            }
+            else if (type == CAP_USERCMD)
+            {
+                if (!SV_ReplayRead(f, &usercmd, sizeof(usercmd)))
+                {
+                    break;
+                }
+                if (usercmd.clientNum < 0 || usercmd.clientNum >= MAX_CLIENTS)
+                {
+                    continue;
+                }
+
+                if (!seen[usercmd.clientNum])
+                {
+                    seen[usercmd.clientNum] = true;
+                    viewerNums[numViewers++] = usercmd.clientNum;
+                }
+                viewers[usercmd.clientNum] = usercmd.ps;
+            }
+            else
+            {
+                Com_Printf(S_COLOR_YELLOW "WARNING: %s has a bad record type %i\n", name, type);
+                break;
+            }
+        }
+
+        FS_FCloseFile(f);
+    }
+
+    Com_Printf("%s on %s%s: %i passes, %lli frames, %lli snapshots, %.1f entities per snapshot, results %08x\n",
+        name, header.mapname, cold ? ", cold" : "", passes, (long long)frames, (long long)snapshots,
+        (double)found / MAX(snapshots, 1), hash);
+    if (snapshots)
+    {
+        Com_Printf("%.2fus per frame preparing the entities\n", prepareNs * 0.001 / MAX(prepared, 1));
+        Com_Printf("%.0f snapshots/sec, mean %.3fus\n", snapshots * 1e9 / MAX(totalNs, 1),
+            totalNs * 0.001 / snapshots);
+        Com_Printf("p50 %.2fus, p90 %.2fus, p99 %.2fus, p99.9 %.2fus, max %.2fus\n",
+            SV_ReplayPercentile(histogram, snapshots, 0.5f), SV_ReplayPercentile(histogram, snapshots, 0.9f),
+            SV_ReplayPercentile(histogram, snapshots, 0.99f), SV_ReplayPercentile(histogram, snapshots, 0.999f),
+            maxNs * 0.001);
+        SV_ReplayPrintCounters(&counters, snapshots, "snapshot");
+    }
+
+    SV_ReplayCloseCounters(&counters);
+    SV_ReplayEnd();
+}
+
+#ifdef DEDICATED
+
+/*
+===============================================================================
+
+PMOVE BENCHMARK
+
+===============================================================================
+*/
+
+#define PMOVE_BATCH 1024  // usercmds run together, a frame with more is split
+
+struct pmoveBench_t {
+    const captureUsercmd_t *usercmds;
+    playerState_t *results;
+    int pmoveFixed;
+    int pmoveMsec;
+};
+
+// the few game system calls the bg code makes, for bg_misc.c and bg_pmove.c
+extern "C" {
+
+int trap_FS_FOpenFile(const char *qpath, fileHandle_t *f, enum FS_Mode mode)
+{
+    return FS_FOpenFileByMode(qpath, f, mode);
+}
+
+void trap_FS_Read(void *buffer, int len, fileHandle_t f) { FS_Read(buffer, len, f); }
+
+void trap_FS_FCloseFile(fileHandle_t f) { FS_FCloseFile(f); }
+
+int trap_FS_GetFileList(const char *path, const char *extension, char *listbuf, int bufsize)
+{
+    return FS_GetFileList(path, extension, listbuf, bufsize);
+}
+
+void trap_Cvar_VariableStringBuffer(const char *var_name, char *buffer, int bufsize)
+{
+    Cvar_VariableStringBuffer(var_name, buffer, bufsize);
+}
+
+void trap_SnapVector(float *v) { Q_SnapVector(v); }
+}
+
+/*
+==================
+SV_PmoveTrace
+==================
+*/
+static void SV_PmoveTrace(trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs,
+    const vec3_t end, int passEntityNum, int contentMask)
+{
+    SV_Trace(results, start, (float *)mins, (float *)maxs, end, passEntityNum, contentMask, TT_AABB);
+}
+
+/*
+==================
+SV_PmoveBenchMove
+
+Sets up the pmove_t the way ClientThink_real does, for what the server can
+see of it.  pmoveExt_t is private to the game and starts out empty.
+==================
+*/
+static void SV_PmoveBenchMove(pmoveBench_t *bench, int index)
+{
+    const captureUsercmd_t *usercmd = &bench->usercmds[index];
+    playerState_t *ps = &bench->results[index];
+    pmoveExt_t pmext;
+    pmove_t pmove;
+
+    *ps = usercmd->ps;
+    ::memset(&pmext, 0, sizeof(pmext));
+    ::memset(&pmove, 0, sizeof(pmove));
+
+    pmove.ps = ps;
+    pmove.pmext = &pmext;
+    pmove.cmd = usercmd->cmd;
+    pmove.tracemask = ps->pm_type == PM_DEAD || ps->pm_type == PM_SPECTATOR ? MASK_DEADSOLID : MASK_PLAYERSOLID;
+    pmove.trace = SV_PmoveTrace;
+    pmove.pointcontents = SV_PointContents;
+    pmove.pmove_fixed = bench->pmoveFixed;
+    pmove.pmove_msec = bench->pmoveMsec;
+
+    Pmove(&pmove);
+}
+
+/*
+==================
+SV_PmoveBenchJob
+==================
+*/
+static void SV_PmoveBenchJob(void *data, int index, int thread) { SV_PmoveBenchMove((pmoveBench_t *)data, index); }
+
+/*
+==================
+SV_PmoveBenchHash
+
+Chaingun recoil changes delta_angles with rand(), which is shared by all
+threads, so those are left out
+==================
+*/
+static unsigned SV_PmoveBenchHash(unsigned hash, const playerState_t *results, int count)
+{
+    playerState_t ps;
+    const byte *b;
+    size_t i;
+
+    while (count--)
+    {
+        ps = *results++;
+        VectorClear(ps.delta_angles);
+
+        b = (const byte *)&ps;
+        for (i = 0; i < sizeof(ps); i++)
+        {
+            hash = (hash ^ b[i]) * 16777619u;
+        }
+    }
+
+    return hash;
+}
+
+/*
+==================
+SV_PmoveBench_f
+
+pmovebench <name> [threads] [passes]
+
+Like tracereplay, only runs on a dedicated server with no map loaded:
+    tremded +pmovebench <name> 8 10 +quit
+==================
+*/
+void SV_PmoveBench_f(void)
+{
+    char name[MAX_QPATH];
+    fileHandle_t f;
+    captureHeader_t header;
+    captureTrace_t capTrace;
+    captureUsercmd_t *usercmds;
+    pmoveBench_t bench;
+    int64_t classNs[PCL_NUM_CLASSES], classCmds[PCL_NUM_CLASSES];
+    int64_t ns, serialNs, parallelNs, serialCmds, parallelCmds;
+    int type, time;
+    int numUsercmds;
+    int pass, passes, run;
+    int threads;
+    int i, pclass;
+    unsigned hash[2];
+    std::chrono::steady_clock::time_point start;
+
+    if (Cmd_Argc() < 2)
+    {
+        Com_Printf("usage: pmovebench <name> [threads] [passes]\n");
+        return;
+    }
+
+    if (!com_dedicated->integer || com_sv_running->integer)
+    {
+        Com_Printf("pmovebench only runs on a dedicated server with no map loaded.\n");
+        return;
+    }
+
+    threads = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : (int)std::thread::hardware_concurrency();
+    threads = MAX(1, MIN(threads, MAX_JOB_THREADS + 1));
+    passes = Cmd_Argc() > 3 ? MAX(atoi(Cmd_Argv(3)), 1) : 1;
+
+    if (!SV_ReplayBegin(Cmd_Argv(1), name, sizeof(name), &header))
+    {
+        return;
+    }
+
+    BG_InitClassConfigs();
+
+    usercmds = (captureUsercmd_t *)Hunk_Alloc(PMOVE_BATCH * sizeof(*usercmds), h_high);
+    bench.usercmds = usercmds;
+    bench.results = (playerState_t *)Hunk_Alloc(PMOVE_BATCH * sizeof(*bench.results), h_high);
+    bench.pmoveFixed = Cvar_VariableIntegerValue("pmove_fixed");
+    bench.pmoveMsec = Cvar_VariableIntegerValue("pmove_msec");
+
+    ::memset(classNs, 0, sizeof(classNs));
+    ::memset(classCmds, 0, sizeof(classCmds));
+    serialNs = parallelNs = serialCmds = parallelCmds = 0;
+    hash[0] = hash[1] = 2166136261u;
+
+    for (pass = 0; pass < passes; pass++)
+    {
+        // run 0 is serial, run 1 is spread over the threads
+        for (run = 0; run < 2; run++)
+        {
+            hash[run] = 2166136261u;
+            f = SV_ReplayRestart(name);
+            numUsercmds = 0;
+
+            for (;;)
+            {
+                if (!SV_ReplayRead(f, &type, sizeof(type)))
+                {
+                    type = -1;
+                }
+
+                // all the usercmds of a frame see the world as it is at its end
+                if (numUsercmds && (type == CAP_FRAME || type == -1 || numUsercmds == PMOVE_BATCH))
+                {
+                    if (run == 0)
+                    {
+                        for (i = 0; i < numUsercmds; i++)
+                        {
+                            start = std::chrono::steady_clock::now();
+                            SV_PmoveBenchMove(&bench, i);
+                            ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - start)
+                                     .count();
+
+                            pclass = usercmds[i].ps.stats[STAT_CLASS];
+                            if (pclass < 0 || pclass >= PCL_NUM_CLASSES)
+                            {
+                                pclass = PCL_NONE;
+                            }
+                            classNs[pclass] += ns;
+                            classCmds[pclass]++;
+                            serialNs += ns;
+                        }
+                        serialCmds += numUsercmds;
+                    }
+                    else
+                    {
+                        start = std::chrono::steady_clock::now();
+                        Jobs_ParallelFor(threads, numUsercmds, SV_PmoveBenchJob, &bench);
+                        parallelNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - start)
+                                          .count();
+                        parallelCmds += numUsercmds;
+                    }
+
+                    hash[run] = SV_PmoveBenchHash(hash[run], bench.results, numUsercmds);
+                    numUsercmds = 0;
+                }
+
+                if (type == -1)
+                {
+                    break;
+                }
+                else if (type == CAP_FRAME)
+                {
+                    if (!SV_ReplayRead(f, &time, sizeof(time)))
+                    {
+                        break;
+                    }
+                    sv.time = time;
+                }
+                else if (type == CAP_LINK)
+                {
+                    if (!SV_ReplayLink(f))
+                    {
+                        break;
+                    }
+                }
+                else if (type == CAP_UNLINK)
+                {
+                    if (!SV_ReplayUnlink(f))
+                    {
+                        break;
+                    }
+                }
+                else if (type == CAP_TRACE)
+                {
+                    if (!SV_ReplayRead(f, &capTrace, sizeof(capTrace)))
+                    {
+                        break;
+                    }
+                }
+                else if (type == CAP_USERCMD)
+                {
+                    if (!SV_ReplayRead(f, &usercmds[numUsercmds], sizeof(*usercmds)))
+                    {
+                        break;
+                    }
+                    numUsercmds++;
+                }
+                else
+                {
+                    Com_Printf(S_COLOR_YELLOW "WARNING: %s has a bad record type %i\n", name, type);
+                    break;
+                }
+            }
+
+            FS_FCloseFile(f);
+        }
+    }
+
+    Com_Printf("%s on %s: %i passes, %lli usercmds\n", name, header.mapname, passes, (long long)serialCmds);
+    if (serialCmds)
+    {
+        Com_Printf("serial: %.0f usercmds/sec, mean %.2fus\n", serialCmds * 1e9 / MAX(serialNs, 1),
+            serialNs * 0.001 / serialCmds);
+        Com_Printf("%i threads: %.0f usercmds/sec, %.2fx\n", threads, parallelCmds * 1e9 / MAX(parallelNs, 1),
+            (double)serialNs / MAX(parallelNs, 1));
+        for (i = 0; i < PCL_NUM_CLASSES; i++)
+        {
+            if (classCmds[i])
+            {
+                Com_Printf("  %-12s %9lli usercmds, %.0f usercmds/sec\n", BG_Class((class_t)i)->name, (long long)classCmds[i],
+                    classCmds[i] * 1e9 / MAX(classNs[i], 1));
+            }
+        }
+        if (hash[0] == hash[1])
+        {
+            Com_Printf("results %08x, the same on every thread count\n", hash[0]);
+        }
+        else
+        {
+            Com_Printf(S_COLOR_RED "results %08x serial, %08x on %i threads\n", hash[0], hash[1], threads);
+        }
+    }
+
+    SV_ReplayEnd();
+}
+
+#endif
@@ -263,6 +263,8 @@ static void SV_Status_f(void) {
 
 	Com_Printf("cpu server utilization: %i %%\n"
 	           "avg response time     : %i ms\n"
+	           "entity delta cache    : %i hits, %i misses\n"
+	           "query response cache  : %i hits, %i misses, %i rate limited\n"
 	           "server time           : %i\n"
 	           "internal time         : %i\n"
 	           "map                   : %s\n\n"
@@ -270,6 +272,11 @@ static void SV_Status_f(void) {
 	           "--- ----- ---- ----------------------------------- ------- --------------------- ----- ----- ---------------\n",
 	           ( int ) svs.stats.cpu,
 	           ( int ) svs.stats.avg,
+	           svs.stats.latched_deltaHits,
+	           svs.stats.latched_deltaMisses,
+	           svs.stats.latched_queryHits,
+	           svs.stats.latched_queryMisses,
+	           svs.stats.latched_queryDrops,
 	           svs.time,
 	           Sys_Milliseconds(),
 	           sv_mapname->string);
@@ -391,6 +398,13 @@ void SV_AddOperatorCommands( void ) {
 	Cmd_AddCommand ("systeminfo", SV_Systeminfo_f);
 	Cmd_AddCommand ("map_restart", SV_MapRestart_f);
 	Cmd_AddCommand ("sectorlist", SV_SectorList_f);
+	Cmd_AddCommand ("tracecapture", SV_TraceCapture_f);
+	Cmd_AddCommand ("tracereplay", SV_TraceReplay_f);
+	Cmd_AddCommand ("areareplay", SV_AreaReplay_f);
+	Cmd_AddCommand ("snapshotreplay", SV_SnapshotReplay_f);
+#ifdef DEDICATED
+	Cmd_AddCommand ("pmovebench", SV_PmoveBench_f);
+#endif
 	Cmd_AddCommand ("map", SV_Map_f);
 	Cmd_SetCommandCompletionFunc( "map", SV_CompleteMapName );
 	Cmd_AddCommand ("devmap", SV_Map_f);
@@ -596,6 +596,72 @@ void SV_DropClient( client_t *drop, const char *reason ) {
 
 extern char alternateInfos[2][2][BIG_INFO_STRING];
 
+/*
+The configstrings and baselines in a gamestate are the same for every
+client on the same alternateProtocol.  They are encoded once and spliced
+into each gamestate message until a configstring or baseline changes, so
+a wave of reconnecting clients after a map change doesn't re-encode them.
+*/
+typedef struct {
+	bool	valid;
+	int		generation;
+	int		numBits;
+	byte	data[MAX_MSGLEN];
+} gamestateCache_t;
+
+static gamestateCache_t gamestateCaches[3];
+static int gamestateGeneration;
+
+/*
+================
+SV_InvalidateGamestate
+
+Called whenever a configstring or entity baseline changes
+================
+*/
+void SV_InvalidateGamestate( void ) {
+	gamestateGeneration++;
+}
+
+/*
+================
+SV_WriteGamestateEntries
+
+Writes the configstrings and baselines of a gamestate
+================
+*/
+static void SV_WriteGamestateEntries( msg_t *msg, int alternateProtocol ) {
+	int			start;
+	entityState_t	*base, nullstate;
+	const char	*configstring;
+
+	// write the configstrings
+	for ( start = 0 ; start < MAX_CONFIGSTRINGS ; start++ ) {
+		if ( start <= CS_SYSTEMINFO && alternateProtocol != 0 ) {
+			configstring = alternateInfos[start][ alternateProtocol - 1 ];
+		} else {
+			configstring = sv.configstrings[start].s;
+		}
+
+		if (configstring[0]) {
+			MSG_WriteByte( msg, svc_configstring );
+			MSG_WriteShort( msg, start );
+			MSG_WriteBigString( msg, configstring );
+		}
+	}
+
+	// write the baselines
+	::memset( &nullstate, 0, sizeof( nullstate ) );
+	for ( start = 0 ; start < MAX_GENTITIES; start++ ) {
+		base = &sv.svEntities[start].baseline;
+		if ( !base->number ) {
+			continue;
+		}
+		MSG_WriteByte( msg, svc_baseline );
+		MSG_WriteDeltaEntity( alternateProtocol, msg, &nullstate, base, true );
+	}
+}
+
 /*
 ================
 SV_SendClientGameState
@@ -608,11 +674,9 @@ the wrong gamestate.
 ================
 */
 static void SV_SendClientGameState( client_t *client ) {
-	int			start;
-	entityState_t	*base, nullstate;
 	msg_t		msg;
 	byte		msgBuffer[MAX_MSGLEN];
-	const char	*configstring;
+	gamestateCache_t	*cache;
 
  	Com_DPrintf ("SV_SendClientGameState() for %s\n", client->name);
 	Com_DPrintf( "Going from CS_CONNECTED to CS_PRIMED for %s\n", client->name );
@@ -641,30 +705,22 @@ static void SV_SendClientGameState( client_t *client ) {
 	MSG_WriteByte( &msg, svc_gamestate );
 	MSG_WriteLong( &msg, client->reliableSequence );
 
-	// write the configstrings
-	for ( start = 0 ; start < MAX_CONFIGSTRINGS ; start++ ) {
-		if ( start <= CS_SYSTEMINFO && client->netchan.alternateProtocol != 0 ) {
-			configstring = alternateInfos[start][ client->netchan.alternateProtocol - 1 ];
-		} else {
-			configstring = sv.configstrings[start].s;
-		}
+	cache = &gamestateCaches[ client->netchan.alternateProtocol ];
+	if ( cache->generation != gamestateGeneration || !cache->valid ) {
+		msg_t	cacheMsg;
 
-		if (configstring[0]) {
-			MSG_WriteByte( &msg, svc_configstring );
-			MSG_WriteShort( &msg, start );
-			MSG_WriteBigString( &msg, configstring );
-		}
+		MSG_Init( &cacheMsg, cache->data, sizeof( cache->data ) );
+		SV_WriteGamestateEntries( &cacheMsg, client->netchan.alternateProtocol );
+
+		cache->numBits = cacheMsg.bit;
+		cache->generation = gamestateGeneration;
+		cache->valid = !cacheMsg.overflowed;
 	}
 
-	// write the baselines
-	::memset( &nullstate, 0, sizeof( nullstate ) );
-	for ( start = 0 ; start < MAX_GENTITIES; start++ ) {
-		base = &sv.svEntities[start].baseline;
-		if ( !base->number ) {
-			continue;
-		}
-		MSG_WriteByte( &msg, svc_baseline );
-		MSG_WriteDeltaEntity( client->netchan.alternateProtocol, &msg, &nullstate, base, true );
+	if ( cache->valid ) {
+		MSG_WriteEncodedBits( &msg, cache->data, cache->numBits );
+	} else {
+		SV_WriteGamestateEntries( &msg, client->netchan.alternateProtocol );
 	}
 
 	MSG_WriteByte( &msg, svc_EOF );
@@ -1283,6 +1339,7 @@ void SV_UserinfoChanged( client_t *cl ) {
 	//color codes
 	Q_ApproxStrHexColors(
 		cl->name, cl->name_ansi, sizeof(cl->name), sizeof(cl->name_ansi));
+	SV_InvalidateQueryResponses();
 
 	// rate command
 
@@ -1548,6 +1605,10 @@ void SV_ClientThink (client_t *cl, usercmd_t *cmd) {
 		return;		// may have been kicked during the last usercmd
 	}
 
+	if ( SV_Capturing() ) {
+		SV_CaptureUsercmd( cl - svs.clients, cmd );
+	}
+
 	VM_Call( sv.gvm, GAME_CLIENT_THINK, cl - svs.clients );
 }
 
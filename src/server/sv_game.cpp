@@ -136,31 +136,25 @@ void SV_SetBrushModel( sharedEntity_t *ent, const char *name ) {
 
 /*
 =================
-SV_inPVS
+SV_LeafsInPVS
 
-Also checks portalareas so that doors block sight
+The PVS rows and area floods are precomputed, so once the leafs are known
+this is only a few lookups.  The game can keep the leaf of a point that
+doesn't move from G_POINT_LEAFNUM instead of finding it again every time.
 =================
 */
-bool SV_inPVS (const vec3_t p1, const vec3_t p2)
+static bool SV_LeafsInPVS (int leaf1, int leaf2, bool ignorePortals)
 {
-	int		leafnum;
 	int		cluster;
-	int		area1, area2;
 	byte	*mask;
 
-	leafnum = CM_PointLeafnum (p1);
-	cluster = CM_LeafCluster (leafnum);
-	area1 = CM_LeafArea (leafnum);
-	mask = CM_ClusterPVS (cluster);
-
-	leafnum = CM_PointLeafnum (p2);
-	cluster = CM_LeafCluster (leafnum);
-	area2 = CM_LeafArea (leafnum);
+	mask = CM_ClusterPVS (CM_LeafCluster (leaf1));
+	cluster = CM_LeafCluster (leaf2);
 
 	if ( mask && !(mask[cluster>>3] & (1<<(cluster&7))) )
 		return false;
 
-	if (!CM_AreasConnected (area1, area2))
+	if ( !ignorePortals && !CM_AreasConnected (CM_LeafArea (leaf1), CM_LeafArea (leaf2)) )
 		return false;		// a door blocks sight
 
 	return true;
@@ -169,28 +163,27 @@ bool SV_inPVS (const vec3_t p1, const vec3_t p2)
 
 /*
 =================
-SV_inPVSIgnorePortals
+SV_inPVS
 
-Does NOT check portalareas
+Also checks portalareas so that doors block sight
 =================
 */
-bool SV_inPVSIgnorePortals( const vec3_t p1, const vec3_t p2)
+bool SV_inPVS (const vec3_t p1, const vec3_t p2)
 {
-	int		leafnum;
-	int		cluster;
-	byte	*mask;
-
-	leafnum = CM_PointLeafnum (p1);
-	cluster = CM_LeafCluster (leafnum);
-	mask = CM_ClusterPVS (cluster);
+	return SV_LeafsInPVS (CM_PointLeafnum (p1), CM_PointLeafnum (p2), false);
+}
 
-	leafnum = CM_PointLeafnum (p2);
-	cluster = CM_LeafCluster (leafnum);
 
-	if ( mask && (!(mask[cluster>>3] & (1<<(cluster&7)) ) ) )
-		return false;
+/*
+=================
+SV_inPVSIgnorePortals
 
-	return true;
+Does NOT check portalareas
+=================
+*/
+bool SV_inPVSIgnorePortals( const vec3_t p1, const vec3_t p2)
+{
+	return SV_LeafsInPVS (CM_PointLeafnum (p1), CM_PointLeafnum (p2), true);
 }
 
 
@@ -368,6 +361,9 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
         case G_TRACECAPSULE:
             SV_Trace( (trace_t*)VMA(1), (const vec_t*)VMA(2), (vec_t*)VMA(3), (vec_t*)VMA(4), (const vec_t*)VMA(5), args[6], args[7], TT_CAPSULE );
             return 0;
+        case G_TRACE_BATCH:
+            SV_TraceBatch( (trace_t*)VMA(1), (const traceRequest_t*)VMA(2), args[3] );
+            return 0;
         case G_POINT_CONTENTS:
             return SV_PointContents( (const vec_t*)VMA(1), args[2] );
         case G_SET_BRUSH_MODEL:
@@ -401,6 +397,10 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
             return 0;
         case G_AREAS_CONNECTED:
             return CM_AreasConnected( args[1], args[2] );
+        case G_POINT_LEAFNUM:
+            return CM_PointLeafnum( (const vec_t*)VMA(1) );
+        case G_LEAFS_IN_PVS:
+            return SV_LeafsInPVS( args[1], args[2], args[3] );
 
         case G_GET_USERCMD:
             SV_GetUsercmd( args[1], (usercmd_t*)VMA(2) );
@@ -195,6 +195,8 @@ void SV_SetConfigstring(int idx, const char *val)
         {
             return;
         }
+
+        SV_InvalidateQueryResponses();
     }
     else
     {
@@ -209,6 +211,8 @@ void SV_SetConfigstring(int idx, const char *val)
         sv.configstrings[idx].s = CopyString(val);
     }
 
+    SV_InvalidateGamestate();
+
     // send it to all the clients if we aren't
     // spawning a new server
     if (sv.state == SS_GAME || sv.restarting)
@@ -362,6 +366,8 @@ static void SV_CreateBaseline(void)
         //
         sv.svEntities[entnum].baseline = svent->s;
     }
+
+    SV_InvalidateGamestate();
 }
 
 /*
@@ -515,6 +521,9 @@ static void SV_ClearServer(void)
 {
     int i;
 
+    // a capture only makes sense for one map
+    SV_StopCapture();
+
     for (i = 0; i < MAX_CONFIGSTRINGS; i++)
     {
         if (i <= CS_SYSTEMINFO)
@@ -786,6 +795,7 @@ void SV_SpawnServer(char *server, cb_context_t *after)
         sv.configstrings[i].restricted = false;
         ::memset(&sv.configstrings[i].clientList, 0, sizeof(clientList_t));
     }
+    SV_InvalidateGamestate();
 
     // make sure we are not paused
     Cvar_Set("cl_paused", "0");
@@ -939,6 +949,9 @@ void SV_Init(void)
     sv_killserver = Cvar_Get("sv_killserver", "0", 0);
     sv_mapChecksum = Cvar_Get("sv_mapChecksum", "", CVAR_ROM);
     sv_lanForceRate = Cvar_Get("sv_lanForceRate", "1", CVAR_ARCHIVE);
+    sv_snapshotThreads = Cvar_Get("sv_snapshotThreads", "0", CVAR_ARCHIVE);
+    sv_snapshotCheck = Cvar_Get("sv_snapshotCheck", "0", 0);
+    sv_traceThreads = Cvar_Get("sv_traceThreads", "0", CVAR_ARCHIVE);
     sv_rsaAuth = Cvar_Get("sv_rsaAuth", "1", CVAR_INIT | CVAR_PROTECTED);
 }
 
@@ -60,6 +60,9 @@ cvar_t	*sv_minPing;
 cvar_t	*sv_maxPing;
 cvar_t	*sv_pure;
 cvar_t	*sv_lanForceRate; // dedicated 1 (LAN) server forces local client rates to 99999 (bug #491)
+cvar_t	*sv_snapshotThreads;	// threads used to build and encode snapshots
+cvar_t	*sv_snapshotCheck;	// compare every snapshot message against a serial rebuild
+cvar_t	*sv_traceThreads;	// threads used to run batched game traces
 cvar_t	*sv_banFile;
 
 cvar_t  *sv_rsaAuth;
@@ -380,39 +383,84 @@ CONNECTIONLESS COMMANDS
 ==============================================================================
 */
 
-// This is deliberately quite large to make it more of an effort to DoS
-#define MAX_BUCKETS			16384
-#define MAX_HASHES			1024
+/*
+Per address buckets live in an open addressing table of cache line sized
+groups, keyed by a seeded 64 bit hash of the address.  A lookup touches at
+most BUCKET_PROBES lines.  A bucket that has leaked dry is as good as a new
+one, so it is reused in place instead of being unlinked; when every probed
+slot is live the least recently used one is taken over.
+
+Aggregate limits per /24 (IPv4) or /64 (IPv6) use count-min sketches over
+two rotating time windows, so spoofed floods spread over many addresses of
+one network are still caught in constant time.
+*/
+
+#define BUCKETS_PER_LINE	4
+#define BUCKET_LINES		16384	// must be a power of two
+#define BUCKET_PROBES		4
 
-static leakyBucket_t buckets[ MAX_BUCKETS ];
-static leakyBucket_t *bucketHashes[ MAX_HASHES ];
+struct bucketLine_t {
+	alignas( 64 ) leakyBucket_t buckets[ BUCKETS_PER_LINE ];
+};
+
+static bucketLine_t bucketLines[ BUCKET_LINES ];
+static uint64_t addressSeed;
 leakyBucket_t outboundLeakyBucket;
 
+#define SKETCH_DEPTH		4
+#define SKETCH_WIDTH		4096	// must be a power of two, at most 65536
+
+struct prefixSketch_t {
+	int			window;		// msec covered by each set of counters
+	int			windowStart;
+	int			current;	// counts[ current ] is being added to
+	uint16_t	counts[ 2 ][ SKETCH_DEPTH ][ SKETCH_WIDTH ];
+};
+
+// rate limited addresses in one network may take this many times the
+// burst of a single address between them
+#define PREFIX_BURST_SCALE	16
+
+static prefixSketch_t prefixRequests = { 1000 };
+static prefixSketch_t prefixReceipts = { 2000 };
+
 /*
 ================
-SVC_HashForAddress
+SVC_HashAddress
+
+Seeded so addresses that collide can't be picked from outside.  The prefix
+version drops the host part of the address first.
 ================
 */
-static long SVC_HashForAddress( netadr_t address ) {
-	byte 		*ip = NULL;
-	size_t	size = 0;
-	int			i;
-	long		hash = 0;
+static uint64_t SVC_HashAddress( netadr_t address, bool prefix ) {
+	const byte	*ip;
+	size_t		size;
+	size_t		i;
+	uint64_t	hash;
+
+	if ( !addressSeed ) {
+		addressSeed = ( (uint64_t)rand() << 32 ) ^ ( (uint64_t)rand() << 16 ) ^ (uint64_t)Sys_Milliseconds() ^ 1;
+	}
 
 	switch ( address.type ) {
-		case NA_IP:  ip = address.ip;  size = 4; break;
-		case NA_IP6: ip = address.ip6; size = 16; break;
-		default: break;
+		case NA_IP:  ip = address.ip;  size = prefix ? 3 : 4; break;
+		case NA_IP6: ip = address.ip6; size = prefix ? 8 : 16; break;
+		default:     ip = NULL;        size = 0; break;
 	}
 
+	// FNV-1a, then a splitmix64 finalizer to spread the bits
+	hash = addressSeed ^ 0xcbf29ce484222325ULL ^ ( (uint64_t)address.type << 56 );
 	for ( i = 0; i < size; i++ ) {
-		hash += (long)( ip[ i ] ) * ( i + 119 );
+		hash = ( hash ^ ip[ i ] ) * 0x100000001b3ULL;
 	}
-
-	hash = ( hash ^ ( hash >> 10 ) ^ ( hash >> 20 ) );
-	hash &= ( MAX_HASHES - 1 );
-
-	return hash;
+	hash ^= hash >> 30;
+	hash *= 0xbf58476d1ce4e5b9ULL;
+	hash ^= hash >> 27;
+	hash *= 0x94d049bb133111ebULL;
+	hash ^= hash >> 31;
+
+	// 0 marks a free bucket
+	return hash ? hash : 1;
 }
 
 /*
@@ -423,82 +471,125 @@ Find or allocate a bucket for an address
 ================
 */
 static leakyBucket_t *SVC_BucketForAddress( netadr_t address, int burst, int period ) {
-	leakyBucket_t *bucket = NULL;
-	long hash = SVC_HashForAddress( address );
-	int now = Sys_Milliseconds();
+	uint64_t		key = SVC_HashAddress( address, false );
+	int				now = Sys_Milliseconds();
+	leakyBucket_t	*bucket;
+	leakyBucket_t	*reuse = NULL;
+	bool			reuseLive = true;
+	bool			sawFree = false;
+	int				line, i, j;
+
+	for ( i = 0; i < BUCKET_PROBES && !sawFree; i++ ) {
+		line = ( (int)key + i ) & ( BUCKET_LINES - 1 );
+
+		for ( j = 0; j < BUCKETS_PER_LINE; j++ ) {
+			int interval;
+
+			bucket = &bucketLines[ line ].buckets[ j ];
+			if ( bucket->key == key ) {
+				return bucket;
+			}
 
-	for ( bucket = bucketHashes[ hash ]; bucket; bucket = bucket->next )
-    {
-		switch ( bucket->type )
-        {
-			case NA_IP:
-				if ( ::memcmp( bucket->ipv._4, address.ip, 4 ) == 0 )
-					return bucket;
+			// nothing is ever inserted past a free bucket
+			if ( !bucket->key ) {
+				if ( reuseLive ) {
+					reuse = bucket;
+				}
+				sawFree = true;
 				break;
+			}
 
-			case NA_IP6:
-				if ( ::memcmp( bucket->ipv._6, address.ip6, 16 ) == 0 )
-					return bucket;
-				break;
+			if ( !reuseLive ) {
+				continue;
+			}
 
-			default:
-				break;
+			// expired buckets are reclaimed lazily
+			interval = now - bucket->lastTime;
+			if ( interval > burst * period || interval < 0 ) {
+				reuse = bucket;
+				reuseLive = false;
+			} else if ( !reuse || bucket->lastTime < reuse->lastTime ) {
+				reuse = bucket;
+			}
 		}
 	}
 
-	for ( int i = 0; i < MAX_BUCKETS; i++ )
-    {
-		int interval;
+	if ( reuseLive && reuse->key ) {
+		SV_WriteAttackLogD(va("SVC_BucketForAddress: bucket table full, reusing a live bucket for %s\n", NET_AdrToString(address)));
+	}
 
-		bucket = &buckets[ i ];
-		interval = now - bucket->lastTime;
+	reuse->key = key;
+	reuse->lastTime = now;
+	reuse->burst = 0;
 
-		// Reclaim expired buckets
-		if ( bucket->lastTime > 0 && ( interval > ( burst * period ) ||
-					interval < 0 ) ) {
-			if ( bucket->prev != NULL ) {
-				bucket->prev->next = bucket->next;
-			} else {
-				bucketHashes[ bucket->hash ] = bucket->next;
-			}
-			
-			if ( bucket->next != NULL ) {
-				bucket->next->prev = bucket->prev;
-			}
+	return reuse;
+}
 
-			::memset( bucket, 0, sizeof( leakyBucket_t ) );
-		}
+/*
+================
+SVC_SketchAdvance
 
-		if ( bucket->type == NA_BAD ) {
-			bucket->type = address.type;
-			switch ( address.type ) {
-                case NA_IP:  ::memcpy( bucket->ipv._4, address.ip, 4 ); break;
-                case NA_IP6: ::memcpy( bucket->ipv._6, address.ip6, 16 ); break;
-				default: break;
-			}
+Moves the sketch on to the window holding now
+================
+*/
+static void SVC_SketchAdvance( prefixSketch_t *sketch, int now ) {
+	int elapsed = now - sketch->windowStart;
 
-			bucket->lastTime = now;
-			bucket->burst = 0;
-			bucket->hash = hash;
+	if ( elapsed >= 0 && elapsed < sketch->window ) {
+		return;
+	}
 
-			// Add to the head of the relevant hash chain
-			bucket->next = bucketHashes[ hash ];
-			if ( bucketHashes[ hash ] != NULL ) {
-				bucketHashes[ hash ]->prev = bucket;
-			}
+	if ( elapsed < 0 || elapsed >= sketch->window * 2 ) {
+		::memset( sketch->counts, 0, sizeof( sketch->counts ) );
+		sketch->windowStart = now;
+		return;
+	}
 
-			bucket->prev = NULL;
-			bucketHashes[ hash ] = bucket;
+	sketch->current ^= 1;
+	::memset( sketch->counts[ sketch->current ], 0, sizeof( sketch->counts[ 0 ] ) );
+	sketch->windowStart += sketch->window;
+}
 
-			return bucket;
-		}
+/*
+================
+SVC_SketchCount
+
+Estimated hits for a prefix over the last one to two windows, never low
+================
+*/
+static int SVC_SketchCount( prefixSketch_t *sketch, uint64_t key, int now ) {
+	int	i;
+	int	best[ 2 ] = { 0xffff, 0xffff };
+
+	SVC_SketchAdvance( sketch, now );
+
+	for ( i = 0; i < SKETCH_DEPTH; i++ ) {
+		int cell = ( key >> ( i * 16 ) ) & ( SKETCH_WIDTH - 1 );
+
+		best[ 0 ] = MIN( best[ 0 ], sketch->counts[ 0 ][ i ][ cell ] );
+		best[ 1 ] = MIN( best[ 1 ], sketch->counts[ 1 ][ i ][ cell ] );
 	}
 
-	// Couldn't allocate a bucket for this address
-	// Write the info to the attack log since this is relevant information as the system is malfunctioning
-	SV_WriteAttackLogD(va("SVC_BucketForAddress: Could not allocate a bucket for client from %s\n", NET_AdrToString(address)));
+	return best[ 0 ] + best[ 1 ];
+}
+
+/*
+================
+SVC_SketchAdd
+================
+*/
+static void SVC_SketchAdd( prefixSketch_t *sketch, uint64_t key, int now ) {
+	int i;
+
+	SVC_SketchAdvance( sketch, now );
 
-	return NULL;
+	for ( i = 0; i < SKETCH_DEPTH; i++ ) {
+		uint16_t *counter = &sketch->counts[ sketch->current ][ i ][ ( key >> ( i * 16 ) ) & ( SKETCH_WIDTH - 1 ) ];
+
+		if ( *counter < 0xffff ) {
+			( *counter )++;
+		}
+	}
 }
 
 /*
@@ -557,33 +648,251 @@ Rate limit for a particular address
 bool SVC_RateLimitAddress( netadr_t from, int burst, int period )
 {
 	leakyBucket_t *bucket = SVC_BucketForAddress( from, burst, period );
-	return SVC_RateLimit( bucket, burst, period );
+	uint64_t prefix;
+	int now;
+
+	if ( SVC_RateLimit( bucket, burst, period ) ) {
+		return true;
+	}
+
+	prefix = SVC_HashAddress( from, true );
+	now = Sys_Milliseconds();
+	if ( SVC_SketchCount( &prefixRequests, prefix, now ) >= burst * PREFIX_BURST_SCALE ) {
+		SV_WriteAttackLogD(va("SVC_RateLimitAddress: limit exceeded for the network of %s\n", NET_AdrToString(from)));
+		return true;
+	}
+
+	SVC_SketchAdd( &prefixRequests, prefix, now );
+	return false;
+}
+
+/*
+=============================================================================
+
+Connectionless query responses
+
+getstatus and getinfo replies only differ by the challenge that is echoed
+back, so each one is built once per alternateProtocol and kept until the
+serverinfo, a userinfo, or a player's score or ping changes.  A cached
+reply is sent by splicing the challenge between its two halves.
+
+=============================================================================
+*/
+
+#define QUERY_CHALLENGE_KEY "\\challenge\\"
+
+typedef struct {
+	bool	valid;
+	int		generation;
+	int		maxclients;
+	int		count;					// getinfo: public clients connected
+	bool	connected[MAX_CLIENTS];	// getstatus: what the player list shows
+	int		scores[MAX_CLIENTS];
+	int		pings[MAX_CLIENTS];
+	int		infoLength;				// length the challenge is checked against
+	int		headLength;				// data is head, then challenge, then tail
+	int		length;
+	char	data[MAX_INFO_STRING + MAX_MSGLEN];
+} queryResponse_t;
+
+static queryResponse_t statusResponses[3];
+static queryResponse_t infoResponses[3];
+static int queryGeneration;
+
+/*
+================
+SV_InvalidateQueryResponses
+
+Called when anything but a score or ping shown to server browsers changes
+================
+*/
+void SV_InvalidateQueryResponses( void ) {
+	queryGeneration++;
 }
 
 /*
 ================
-SVC_Status
+SV_QueryResponseCurrent
+================
+*/
+static bool SV_QueryResponseCurrent( const queryResponse_t *response ) {
+	// serverinfo cvars reach the configstrings once per frame
+	if ( !response->valid || response->generation != queryGeneration ||
+			( cvar_modifiedFlags & ( CVAR_SERVERINFO | CVAR_SYSTEMINFO ) ) ) {
+		return false;
+	}
 
-Responds with all the info that qplug or qspy can see about the server
-and all connected players.  Used for getting detailed information after
-the simple info query.
+	return response->maxclients == sv_maxclients->integer;
+}
+
+/*
+================
+SV_SendQueryResponse
+
+Splices the challenge into a cached response and sends it.  Returns false
+if Info_SetValueForKey would not have stored this challenge as is, so the
+caller has to build the response the long way.
 ================
 */
-static void SVC_Status( netadr_t from ) {
+static bool SV_SendQueryResponse( const queryResponse_t *response, netadr_t from, const char *challenge ) {
+	char	packet[MAX_MSGLEN];
+	int		challengeLength;
+	int		length, copy;
+
+	challengeLength = strlen( challenge );
+	if ( !challengeLength || strpbrk( challenge, "\\;\"" ) ||
+			response->infoLength + (int)strlen( QUERY_CHALLENGE_KEY ) + challengeLength >= MAX_INFO_STRING ) {
+		return false;
+	}
+
+	// same layout and truncation as NET_OutOfBandPrint
+	::memset( packet, 0xff, 4 );
+	length = 4;
+
+	::memcpy( packet + length, response->data, response->headLength );
+	length += response->headLength;
+
+	::memcpy( packet + length, challenge, challengeLength );
+	length += challengeLength;
+
+	copy = response->length - response->headLength;
+	if ( copy > (int)sizeof( packet ) - 1 - length ) {
+		copy = sizeof( packet ) - 1 - length;
+	}
+	::memcpy( packet + length, response->data + response->headLength, copy );
+	length += copy;
+
+	NET_SendPacket( NS_SERVER, length, packet, from );
+	return true;
+}
+
+/*
+================
+SV_StatusPlayers
+
+Fills in the player list the way getstatus shows it
+================
+*/
+static int SV_StatusPlayers( char *status, int size ) {
 	char	player[1024];
-	char	status[MAX_MSGLEN];
 	int		i;
 	client_t	*cl;
 	playerState_t	*ps;
 	int		statusLength;
 	int		playerLength;
+
+	status[0] = 0;
+	statusLength = 0;
+
+	for (i=0 ; i < sv_maxclients->integer ; i++) {
+		cl = &svs.clients[i];
+		if ( cl->state >= CS_CONNECTED ) {
+			ps = SV_GameClientNum( i );
+			Com_sprintf (player, sizeof(player), "%i %i \"%s\"\n", 
+				ps->persistant[PERS_SCORE], cl->ping, cl->name_ansi);
+			playerLength = strlen(player);
+			if (statusLength + playerLength >= size ) {
+				break;		// can't hold any more
+			}
+			strcpy (status + statusLength, player);
+			statusLength += playerLength;
+		}
+	}
+
+	return statusLength;
+}
+
+/*
+================
+SV_StatusResponseCurrent
+================
+*/
+static bool SV_StatusResponseCurrent( const queryResponse_t *response ) {
+	int		i;
+	bool	connected;
+
+	if ( !SV_QueryResponseCurrent( response ) ) {
+		return false;
+	}
+
+	for ( i = 0 ; i < sv_maxclients->integer ; i++ ) {
+		connected = svs.clients[i].state >= CS_CONNECTED;
+		if ( connected != response->connected[i] ) {
+			return false;
+		}
+		if ( connected && ( svs.clients[i].ping != response->pings[i] ||
+				SV_GameClientNum( i )->persistant[PERS_SCORE] != response->scores[i] ) ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+================
+SV_BuildStatusResponse
+================
+*/
+static void SV_BuildStatusResponse( queryResponse_t *response, int alternateProtocol ) {
+	char	infostring[MAX_INFO_STRING];
+	char	status[MAX_MSGLEN];
+	int		i;
+
+	Q_strncpyz( infostring, Cvar_InfoString( CVAR_SERVERINFO ), sizeof( infostring ) );
+
+	// the challenge and protocol keys are prepended by Info_SetValueForKey
+	Info_RemoveKey( infostring, "challenge" );
+	response->infoLength = strlen( infostring );
+	if ( alternateProtocol != 0 ) {
+		Info_RemoveKey( infostring, "protocol" );
+		response->infoLength += strlen( "\\protocol\\69" );
+	}
+
+	SV_StatusPlayers( status, sizeof( status ) );
+
+	Com_sprintf( response->data, sizeof( response->data ), "statusResponse\n%s" QUERY_CHALLENGE_KEY,
+		alternateProtocol == 0 ? "" : alternateProtocol == 2 ? "\\protocol\\69" : "\\protocol\\70" );
+	response->headLength = strlen( response->data );
+
+	Q_strcat( response->data, sizeof( response->data ), infostring );
+	Q_strcat( response->data, sizeof( response->data ), "\n" );
+	Q_strcat( response->data, sizeof( response->data ), status );
+	response->length = strlen( response->data );
+
+	response->maxclients = sv_maxclients->integer;
+	for ( i = 0 ; i < sv_maxclients->integer ; i++ ) {
+		response->connected[i] = svs.clients[i].state >= CS_CONNECTED;
+		if ( response->connected[i] ) {
+			response->pings[i] = svs.clients[i].ping;
+			response->scores[i] = SV_GameClientNum( i )->persistant[PERS_SCORE];
+		}
+	}
+
+	response->generation = queryGeneration;
+	response->valid = true;
+}
+
+/*
+================
+SVC_Status
+
+Responds with all the info that qplug or qspy can see about the server
+and all connected players.  Used for getting detailed information after
+the simple info query.
+================
+*/
+static void SVC_Status( netadr_t from ) {
+	char	status[MAX_MSGLEN];
 	char	infostring[MAX_INFO_STRING];
+	queryResponse_t	*response;
 
 	if (sv_protect->integer & SVP_IOQ3) {
 		// Prevent using getstatus as an amplifier
 		if (SVC_RateLimitAddress(from, 10, 1000)) {
 			SV_WriteAttackLog(va("SVC_Status: rate limit from %s exceeded, dropping request\n",
 			                     NET_AdrToString(from)));
+			svs.stats.queryDrops++;
 			return;
 		}
 
@@ -591,6 +900,7 @@ static void SVC_Status( netadr_t from ) {
 		// excess outbound bandwidth usage when being flooded inbound
 		if (SVC_RateLimit(&outboundLeakyBucket, 10, 100)) {
 			SV_WriteAttackLog("SVC_Status: rate limit exceeded, dropping request\n");
+			svs.stats.queryDrops++;
 			return;
 		}
 	}
@@ -601,6 +911,21 @@ static void SVC_Status( netadr_t from ) {
 		return;
 	}
 
+	response = &statusResponses[from.alternateProtocol];
+	if ( SV_StatusResponseCurrent( response ) ) {
+		if ( SV_SendQueryResponse( response, from, Cmd_Argv(1) ) ) {
+			svs.stats.queryHits++;
+			return;
+		}
+	} else {
+		SV_BuildStatusResponse( response, from.alternateProtocol );
+		if ( SV_SendQueryResponse( response, from, Cmd_Argv(1) ) ) {
+			svs.stats.queryMisses++;
+			return;
+		}
+	}
+	svs.stats.queryMisses++;
+
 	strcpy( infostring, Cvar_InfoString( CVAR_SERVERINFO ) );
 
 	// echo back the parameter to status. so master servers can use it as a challenge
@@ -610,25 +935,65 @@ static void SVC_Status( netadr_t from ) {
 	if ( from.alternateProtocol != 0 )
 		Info_SetValueForKey( infostring, "protocol", from.alternateProtocol == 2 ? "69" : "70" );
 
-	status[0] = 0;
-	statusLength = 0;
+	SV_StatusPlayers( status, sizeof( status ) );
 
-	for (i=0 ; i < sv_maxclients->integer ; i++) {
-		cl = &svs.clients[i];
-		if ( cl->state >= CS_CONNECTED ) {
-			ps = SV_GameClientNum( i );
-			Com_sprintf (player, sizeof(player), "%i %i \"%s\"\n", 
-				ps->persistant[PERS_SCORE], cl->ping, cl->name_ansi);
-			playerLength = strlen(player);
-			if (statusLength + playerLength >= sizeof(status) ) {
-				break;		// can't hold any more
-			}
-			strcpy (status + statusLength, player);
-			statusLength += playerLength;
+	NET_OutOfBandPrint( NS_SERVER, from, "statusResponse\n%s\n%s", infostring, status );
+}
+
+/*
+================
+SV_PublicClientCount
+================
+*/
+static int SV_PublicClientCount( void ) {
+	int		i, count;
+
+	// don't count privateclients
+	count = 0;
+	for ( i = sv_privateClients->integer ; i < sv_maxclients->integer ; i++ ) {
+		if ( svs.clients[i].state >= CS_CONNECTED ) {
+			count++;
 		}
 	}
 
-	NET_OutOfBandPrint( NS_SERVER, from, "statusResponse\n%s\n%s", infostring, status );
+	return count;
+}
+
+/*
+================
+SV_InfoString
+
+Everything in the getinfo response except the challenge
+================
+*/
+static void SV_InfoString( char *infostring, int alternateProtocol ) {
+	const char *gamedir;
+
+	Info_SetValueForKey( infostring, "protocol", va("%i", alternateProtocol == 2 ? 69 : alternateProtocol == 1 ? 70 : PROTOCOL_VERSION) );
+	Info_SetValueForKey( infostring, "gamename", com_gamename->string );
+	Info_SetValueForKey( infostring, "hostname", sv_hostname->string );
+	Info_SetValueForKey( infostring, "mapname", sv_mapname->string );
+	Info_SetValueForKey( infostring, "clients", va("%i", SV_PublicClientCount()) );
+	Info_SetValueForKey( infostring, "sv_maxclients", 
+		va("%i", sv_maxclients->integer - sv_privateClients->integer ) );
+	Info_SetValueForKey( infostring, "pure", va("%i", sv_pure->integer ) );
+
+#ifdef USE_VOIP
+	if (sv_voipProtocol->string && *sv_voipProtocol->string) {
+		Info_SetValueForKey( infostring, "voip", sv_voipProtocol->string );
+	}
+#endif
+
+	if( sv_minPing->integer ) {
+		Info_SetValueForKey( infostring, "minPing", va("%i", sv_minPing->integer) );
+	}
+	if( sv_maxPing->integer ) {
+		Info_SetValueForKey( infostring, "maxPing", va("%i", sv_maxPing->integer) );
+	}
+	gamedir = Cvar_VariableString( "fs_game" );
+	if( *gamedir ) {
+		Info_SetValueForKey( infostring, "game", gamedir );
+	}
 }
 
 /*
@@ -640,15 +1005,15 @@ if a user is interested in a server to do a full status
 ================
 */
 void SVC_Info( netadr_t from ) {
-	int		i, count;
-	const char *gamedir;
 	char	infostring[MAX_INFO_STRING];
+	queryResponse_t	*response;
 
 	if (sv_protect->integer & SVP_IOQ3) {
 		// Prevent using getinfo as an amplifier
 		if (SVC_RateLimitAddress(from, 10, 1000)) {
 			SV_WriteAttackLog(va("SVC_Info: rate limit from %s exceeded, dropping request\n",
 			                     NET_AdrToString(from)));
+			svs.stats.queryDrops++;
 			return;
 		}
 
@@ -656,6 +1021,7 @@ void SVC_Info( netadr_t from ) {
 		// excess outbound bandwidth usage when being flooded inbound
 		if (SVC_RateLimit(&outboundLeakyBucket, 10, 100)) {
 			SV_WriteAttackLog("SVC_Info: rate limit exceeded, dropping request\n");
+			svs.stats.queryDrops++;
 			return;
 		}
 	}
@@ -668,13 +1034,31 @@ void SVC_Info( netadr_t from ) {
 		return;
 	}
 
-	// don't count privateclients
-	count = 0;
-	for ( i = sv_privateClients->integer ; i < sv_maxclients->integer ; i++ ) {
-		if ( svs.clients[i].state >= CS_CONNECTED ) {
-			count++;
+	response = &infoResponses[from.alternateProtocol];
+	if ( SV_QueryResponseCurrent( response ) && response->count == SV_PublicClientCount() ) {
+		if ( SV_SendQueryResponse( response, from, Cmd_Argv(1) ) ) {
+			svs.stats.queryHits++;
+			return;
+		}
+	} else {
+		// the challenge is set first, so every other key ends up in front of it
+		infostring[0] = 0;
+		SV_InfoString( infostring, from.alternateProtocol );
+
+		Com_sprintf( response->data, sizeof( response->data ), "infoResponse\n%s" QUERY_CHALLENGE_KEY, infostring );
+		response->headLength = response->length = strlen( response->data );
+		response->infoLength = strlen( infostring );
+		response->count = SV_PublicClientCount();
+		response->maxclients = sv_maxclients->integer;
+		response->generation = queryGeneration;
+		response->valid = true;
+
+		if ( SV_SendQueryResponse( response, from, Cmd_Argv(1) ) ) {
+			svs.stats.queryMisses++;
+			return;
 		}
 	}
+	svs.stats.queryMisses++;
 
 	infostring[0] = 0;
 
@@ -682,31 +1066,7 @@ void SVC_Info( netadr_t from ) {
 	// to prevent timed spoofed reply packets that add ghost servers
 	Info_SetValueForKey( infostring, "challenge", Cmd_Argv(1) );
 
-	Info_SetValueForKey( infostring, "protocol", va("%i", from.alternateProtocol == 2 ? 69 : from.alternateProtocol == 1 ? 70 : PROTOCOL_VERSION) );
-	Info_SetValueForKey( infostring, "gamename", com_gamename->string );
-	Info_SetValueForKey( infostring, "hostname", sv_hostname->string );
-	Info_SetValueForKey( infostring, "mapname", sv_mapname->string );
-	Info_SetValueForKey( infostring, "clients", va("%i", count) );
-	Info_SetValueForKey( infostring, "sv_maxclients", 
-		va("%i", sv_maxclients->integer - sv_privateClients->integer ) );
-	Info_SetValueForKey( infostring, "pure", va("%i", sv_pure->integer ) );
-
-#ifdef USE_VOIP
-	if (sv_voipProtocol->string && *sv_voipProtocol->string) {
-		Info_SetValueForKey( infostring, "voip", sv_voipProtocol->string );
-	}
-#endif
-
-	if( sv_minPing->integer ) {
-		Info_SetValueForKey( infostring, "minPing", va("%i", sv_minPing->integer) );
-	}
-	if( sv_maxPing->integer ) {
-		Info_SetValueForKey( infostring, "maxPing", va("%i", sv_maxPing->integer) );
-	}
-	gamedir = Cvar_VariableString( "fs_game" );
-	if( *gamedir ) {
-		Info_SetValueForKey( infostring, "game", gamedir );
-	}
+	SV_InfoString( infostring, from.alternateProtocol );
 
 	NET_OutOfBandPrint( NS_SERVER, from, "infoResponse\n%s", infostring );
 }
@@ -734,13 +1094,9 @@ static void SV_FlushRedirect( char *outputbuf ) {
  */
 bool SV_CheckDRDoS(netadr_t from) {
 	int        i;
-	int        globalCount;
-	int        specificCount;
 	int        timeNow;
 	receipt_t  *receipt;
-	netadr_t   exactFrom;
-	int        oldest;
-	int        oldestTime;
+	uint64_t   prefix;
 	static int lastGlobalLogTime   = 0;
 	static int lastSpecificLogTime = 0;
 
@@ -753,7 +1109,6 @@ bool SV_CheckDRDoS(netadr_t from) {
 	}
 
 	timeNow   = svs.time;
-	exactFrom = from;
 
 	// Time has wrapped
 	if (lastGlobalLogTime > timeNow || lastSpecificLogTime > timeNow) {
@@ -768,40 +1123,16 @@ bool SV_CheckDRDoS(netadr_t from) {
 		}
 	}
 
-	if (from.type == NA_IP) {
-		from.ip[3] = 0; // xx.xx.xx.0
-	} else {
-		from.ip6[15] = 0;
-	}
-
-	// Count receipts in last 2 seconds.
-	globalCount   = 0;
-	specificCount = 0;
-	receipt       = &svs.infoReceipts[0];
-	oldest        = 0;
-	oldestTime    = 0x7fffffff;
-	for (i = 0; i < MAX_INFO_RECEIPTS; i++, receipt++) {
-		if (receipt->time + 2000 > timeNow) {
-			if (receipt->time) {
-				// When the server starts, all receipt times are at zero.  Furthermore,
-				// svs.time is close to zero.  We check that the receipt time is already
-				// set so that during the first two seconds after server starts, queries
-				// from the master servers don't get ignored.  As a consequence a potentially
-				// unlimited number of getinfo+getstatus responses may be sent during the
-				// first frame of a server's life.
-				globalCount++;
-			}
-			if (NET_CompareBaseAdr(from, receipt->adr)) {
-				specificCount++;
-			}
-		}
-		if (receipt->time < oldestTime) {
-			oldestTime = receipt->time;
-			oldest     = i;
-		}
-	}
-
-	if (globalCount == MAX_INFO_RECEIPTS) { // All receipts happened in last 2 seconds.
+	// The receipts are a ring, so the next one to be replaced is the oldest.
+	// If even that one is from the last 2 seconds, all of them are.
+	receipt = &svs.infoReceipts[svs.nextInfoReceipt];
+	if (receipt->time && receipt->time + 2000 > timeNow) {
+		// When the server starts, all receipt times are at zero.  Furthermore,
+		// svs.time is close to zero.  We check that the receipt time is already
+		// set so that during the first two seconds after server starts, queries
+		// from the master servers don't get ignored.  As a consequence a potentially
+		// unlimited number of getinfo+getstatus responses may be sent during the
+		// first frame of a server's life.
 		if (lastGlobalLogTime + 1000 <= timeNow) { // Limit one log every second.
 			SV_WriteAttackLog("Detected flood of getinfo/getstatus connectionless packets\n");
 			lastGlobalLogTime = timeNow;
@@ -809,19 +1140,23 @@ bool SV_CheckDRDoS(netadr_t from) {
 
 		return true;
 	}
-	if (specificCount >= 3) { // Already sent 3 to this IP in last 2 seconds.
+
+	// Responses per /24 or /64, over the last 2 to 4 seconds
+	prefix = SVC_HashAddress(from, true);
+	if (SVC_SketchCount(&prefixReceipts, prefix, timeNow) >= 3) { // Already sent 3 to this network.
 		if (lastSpecificLogTime + 1000 <= timeNow) { // Limit one log every second.
 			SV_WriteAttackLog(va("Possible DRDoS attack to address %s, ignoring getinfo/getstatus connectionless packet\n",
-			                     NET_AdrToString(exactFrom)));
+			                     NET_AdrToString(from)));
 			lastSpecificLogTime = timeNow;
 		}
 
 		return true;
 	}
 
-	receipt       = &svs.infoReceipts[oldest];
+	SVC_SketchAdd(&prefixReceipts, prefix, timeNow);
 	receipt->adr  = from;
 	receipt->time = timeNow;
+	svs.nextInfoReceipt = (svs.nextInfoReceipt + 1) % MAX_INFO_RECEIPTS;
 	return false;
 }
 
@@ -931,12 +1266,14 @@ static void SV_ConnectionlessPacket( netadr_t from, msg_t *msg ) {
 
 	if (!Q_stricmp(c, "getstatus")) {
 		if ((sv_protect->integer & SVP_OWOLF) && SV_CheckDRDoS(from)) {
+			svs.stats.queryDrops++;
 			return;
 		}
 
 		SVC_Status( from );
   } else if (!Q_stricmp(c, "getinfo")) {
 		if ((sv_protect->integer & SVP_OWOLF) && SV_CheckDRDoS(from)) {
+			svs.stats.queryDrops++;
 			return;
 		}
 
@@ -1290,12 +1627,16 @@ void SV_Frame( int msec ) {
 
 		// let everything in the world think and move
 		VM_Call (sv.gvm, GAME_RUN_FRAME, sv.time);
+		SV_WorldFrame();
 	}
 
 	if ( com_speeds->integer ) {
 		time_game = Sys_Milliseconds () - startTime;
 	}
 
+	// everything sent from here on goes out in one batch
+	NET_BeginSendBatch();
+
 	// check timeouts
 	SV_CheckTimeouts();
 
@@ -1305,6 +1646,8 @@ void SV_Frame( int msec ) {
 	// send a heartbeat to the master if needed
 	SV_MasterHeartbeat(HEARTBEAT_FOR_MASTER);
 
+	NET_FlushSendBatch();
+
 	if (com_dedicated->integer)
 	{
 		int frameEndTime = Sys_Milliseconds();
@@ -1370,6 +1713,18 @@ void SV_Frame( int msec ) {
 		svs.stats.idle           = 0;
 		svs.stats.count          = 0;
 
+		svs.stats.latched_deltaHits   = svs.stats.deltaHits;
+		svs.stats.latched_deltaMisses = svs.stats.deltaMisses;
+		svs.stats.deltaHits           = 0;
+		svs.stats.deltaMisses         = 0;
+
+		svs.stats.latched_queryHits   = svs.stats.queryHits;
+		svs.stats.latched_queryMisses = svs.stats.queryMisses;
+		svs.stats.latched_queryDrops  = svs.stats.queryDrops;
+		svs.stats.queryHits           = 0;
+		svs.stats.queryMisses         = 0;
+		svs.stats.queryDrops          = 0;
+
 		svs.stats.cpu = svs.stats.latched_active + svs.stats.latched_idle;
 
 		if (svs.stats.cpu != 0.f)
@@ -1463,6 +1818,8 @@ int SV_SendQueuedPackets()
 	static int dlNextRound = 0;
 	int timeVal = INT_MAX;
 
+	NET_BeginSendBatch();
+
 	// Send out fragmented packets now that we're idle
 	delayT = SV_SendQueuedMessages();
 	if(delayT >= 0)
@@ -1523,5 +1880,7 @@ int SV_SendQueuedPackets()
 			timeVal = 0;
 	}
 
+	NET_FlushSendBatch();
+
 	return timeVal;
 }
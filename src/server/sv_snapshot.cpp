@@ -24,6 +24,8 @@ along with Tremulous; if not, see <https://www.gnu.org/licenses/>
 
 #include "server.h"
 
+#include <atomic>
+
 /*
 =============================================================================
 
@@ -46,6 +48,143 @@ A normal server packet will look like:
 =============================================================================
 */
 
+/*
+=============================================================================
+
+Delta entity cache
+
+Within one batch of snapshots, every client that deltas an entity from a
+state captured in the same earlier batch writes exactly the same bits, so
+the delta is encoded once and spliced into the other messages.  Entries are
+claimed with an atomic state so the snapshot jobs can share the cache.
+
+=============================================================================
+*/
+
+#define DELTA_CACHE_WAYS 4  // source states kept per entity
+#define DELTA_CACHE_BYTES 0x40000
+#define DELTA_MAX_BYTES 1024  // larger deltas aren't cached
+
+enum deltaCacheState_t {
+    DELTA_EMPTY,
+    DELTA_WRITING,
+    DELTA_READY
+};
+
+struct deltaCacheEntry_t {
+    std::atomic<int> state;
+    int fromFrame;  // -1 for the baseline
+    int alternateProtocol;
+    int numBits;
+    int offset;  // into deltaCacheData
+};
+
+static deltaCacheEntry_t deltaCache[MAX_GENTITIES][DELTA_CACHE_WAYS];
+static byte deltaCacheData[DELTA_CACHE_BYTES];
+static std::atomic<int> deltaCacheUsed;
+static bool deltaCacheEnabled;
+
+static thread_local int deltaCacheHits;
+static thread_local int deltaCacheMisses;
+
+/*
+=============
+SV_ClearDeltaCache
+=============
+*/
+static void SV_ClearDeltaCache(void)
+{
+    int i, j;
+
+    for (i = 0; i < MAX_GENTITIES; i++)
+    {
+        for (j = 0; j < DELTA_CACHE_WAYS; j++)
+        {
+            deltaCache[i][j].state.store(DELTA_EMPTY, std::memory_order_relaxed);
+        }
+    }
+    deltaCacheUsed = 0;
+}
+
+/*
+=============
+SV_WriteDeltaEntity
+
+MSG_WriteDeltaEntity through the cache.  fromFrame is the snapshotFrame the
+from state was captured in, or -1 for the baseline.
+=============
+*/
+static void SV_WriteDeltaEntity(
+    int alternateProtocol, msg_t *msg, entityState_t *from, int fromFrame, entityState_t *to, bool force)
+{
+    deltaCacheEntry_t *entry, *slot;
+    byte buf[DELTA_MAX_BYTES];
+    msg_t scratch;
+    int state;
+    int offset;
+    int i;
+
+    if (!deltaCacheEnabled)
+    {
+        MSG_WriteDeltaEntity(alternateProtocol, msg, from, to, force);
+        return;
+    }
+
+    slot = NULL;
+    for (i = 0; i < DELTA_CACHE_WAYS; i++)
+    {
+        entry = &deltaCache[to->number][i];
+        state = entry->state.load(std::memory_order_acquire);
+
+        if (state == DELTA_READY)
+        {
+            if (entry->fromFrame == fromFrame && entry->alternateProtocol == alternateProtocol)
+            {
+                MSG_WriteEncodedBits(msg, deltaCacheData + entry->offset, entry->numBits);
+                deltaCacheHits++;
+                return;
+            }
+        }
+        else if (state == DELTA_EMPTY && !slot)
+        {
+            if (entry->state.compare_exchange_strong(state, DELTA_WRITING))
+            {
+                slot = entry;
+                break;
+            }
+        }
+    }
+
+    deltaCacheMisses++;
+
+    if (!slot)
+    {
+        MSG_WriteDeltaEntity(alternateProtocol, msg, from, to, force);
+        return;
+    }
+
+    MSG_Init(&scratch, buf, sizeof(buf));
+    scratch.allowoverflow = true;
+    MSG_WriteDeltaEntity(alternateProtocol, &scratch, from, to, force);
+
+    offset = deltaCacheUsed.fetch_add(scratch.cursize);
+    if (scratch.overflowed || offset + scratch.cursize > DELTA_CACHE_BYTES)
+    {
+        slot->state.store(DELTA_EMPTY, std::memory_order_release);
+        MSG_WriteDeltaEntity(alternateProtocol, msg, from, to, force);
+        return;
+    }
+
+    ::memcpy(deltaCacheData + offset, buf, scratch.cursize);
+    slot->fromFrame = fromFrame;
+    slot->alternateProtocol = alternateProtocol;
+    slot->numBits = scratch.bit;
+    slot->offset = offset;
+    slot->state.store(DELTA_READY, std::memory_order_release);
+
+    MSG_WriteEncodedBits(msg, buf, scratch.bit);
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -101,7 +240,7 @@ static void SV_EmitPacketEntities(int alternateProtocol, clientSnapshot_t *from,
             // delta update from old position
             // because the force parm is false, this will not result
             // in any bytes being emited if the entity has not changed at all
-            MSG_WriteDeltaEntity(alternateProtocol, msg, oldent, newent, false);
+            SV_WriteDeltaEntity(alternateProtocol, msg, oldent, from->snapshotFrame, newent, false);
             oldindex++;
             newindex++;
             continue;
@@ -110,7 +249,7 @@ static void SV_EmitPacketEntities(int alternateProtocol, clientSnapshot_t *from,
         if (newnum < oldnum)
         {
             // this is a new entity, send it from the baseline
-            MSG_WriteDeltaEntity(alternateProtocol, msg, &sv.svEntities[newnum].baseline, newent, true);
+            SV_WriteDeltaEntity(alternateProtocol, msg, &sv.svEntities[newnum].baseline, -1, newent, true);
             newindex++;
             continue;
         }
@@ -129,48 +268,63 @@ static void SV_EmitPacketEntities(int alternateProtocol, clientSnapshot_t *from,
 
 /*
 ==================
-SV_WriteSnapshotToClient
+SV_SelectDeltaFrame
+
+Picks the previous frame to delta compress the new snapshot against.
+Must be called after every snapshot of this server frame has reserved its
+entities, since those reservations can push old frames off the buffer.
 ==================
 */
-static void SV_WriteSnapshotToClient(client_t *client, msg_t *msg)
+static clientSnapshot_t *SV_SelectDeltaFrame(client_t *client, int *lastframe)
 {
-    clientSnapshot_t *frame, *oldframe;
-    int lastframe;
-    int i;
-    int snapFlags;
-
-    // this is the snapshot we are creating
-    frame = &client->frames[client->netchan.outgoingSequence & PACKET_MASK];
+    clientSnapshot_t *oldframe;
 
     // try to use a previous frame as the source for delta compressing the snapshot
     if (client->deltaMessage <= 0 || client->state != CS_ACTIVE)
     {
         // client is asking for a retransmit
         oldframe = NULL;
-        lastframe = 0;
+        *lastframe = 0;
     }
     else if (client->netchan.outgoingSequence - client->deltaMessage >= (PACKET_BACKUP - 3))
     {
         // client hasn't gotten a good message through in a long time
         Com_DPrintf("%s: Delta request from out of date packet.\n", client->name);
         oldframe = NULL;
-        lastframe = 0;
+        *lastframe = 0;
     }
     else
     {
         // we have a valid snapshot to delta from
         oldframe = &client->frames[client->deltaMessage & PACKET_MASK];
-        lastframe = client->netchan.outgoingSequence - client->deltaMessage;
+        *lastframe = client->netchan.outgoingSequence - client->deltaMessage;
 
         // the snapshot's entities may still have rolled off the buffer, though
         if (oldframe->first_entity <= svs.nextSnapshotEntities - svs.numSnapshotEntities)
         {
             Com_DPrintf("%s: Delta request from out of date entities.\n", client->name);
             oldframe = NULL;
-            lastframe = 0;
+            *lastframe = 0;
         }
     }
 
+    return oldframe;
+}
+
+/*
+==================
+SV_WriteSnapshotToClient
+==================
+*/
+static void SV_WriteSnapshotToClient(client_t *client, clientSnapshot_t *oldframe, int lastframe, msg_t *msg)
+{
+    clientSnapshot_t *frame;
+    int i;
+    int snapFlags;
+
+    // this is the snapshot we are creating
+    frame = &client->frames[client->netchan.outgoingSequence & PACKET_MASK];
+
     MSG_WriteByte(msg, svc_snapshot);
 
     // NOTE, MRE: now sent at the start of every message from server to client
@@ -268,6 +422,7 @@ Build a client snapshot structure
 typedef struct {
     int numSnapshotEntities;
     int snapshotEntities[MAX_SNAPSHOT_ENTITIES];
+    byte added[MAX_GENTITIES / 8];  // prevents double adding from portal views
 } snapshotEntityNumbers_t;
 
 /*
@@ -282,11 +437,6 @@ static int QDECL SV_QsortEntityNumbers(const void *a, const void *b)
     ea = (int *)a;
     eb = (int *)b;
 
-    if (*ea == *eb)
-    {
-        Com_Error(ERR_DROP, "SV_QsortEntityStates: duplicated entity");
-    }
-
     if (*ea < *eb)
     {
         return -1;
@@ -300,14 +450,14 @@ static int QDECL SV_QsortEntityNumbers(const void *a, const void *b)
 SV_AddEntToSnapshot
 ===============
 */
-static void SV_AddEntToSnapshot(svEntity_t *svEnt, sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums)
+static void SV_AddEntToSnapshot(int entityNum, snapshotEntityNumbers_t *eNums)
 {
     // if we have already added this entity to this snapshot, don't add again
-    if (svEnt->snapshotCounter == sv.snapshotCounter)
+    if (eNums->added[entityNum >> 3] & (1 << (entityNum & 7)))
     {
         return;
     }
-    svEnt->snapshotCounter = sv.snapshotCounter;
+    eNums->added[entityNum >> 3] |= 1 << (entityNum & 7);
 
     // if we are full, silently discard entities
     if (eNums->numSnapshotEntities == MAX_SNAPSHOT_ENTITIES)
@@ -315,10 +465,64 @@ static void SV_AddEntToSnapshot(svEntity_t *svEnt, sharedEntity_t *gEnt, snapsho
         return;
     }
 
-    eNums->snapshotEntities[eNums->numSnapshotEntities] = gEnt->s.number;
+    eNums->snapshotEntities[eNums->numSnapshotEntities] = entityNum;
     eNums->numSnapshotEntities++;
 }
 
+#define SNAPSHOT_NEAR_DISTANCE 1500
+
+/*
+===============
+SV_MarkSnapshotCandidates
+
+Marks every entity that could pass the tests in
+SV_AddEntitiesVisibleFromPoint: the unculled entities, everything linked
+into a cluster in the viewer's PVS, and everything near the viewer.
+===============
+*/
+static void SV_MarkSnapshotCandidates(const vec3_t origin, const byte *clientpvs, byte *candidates)
+{
+    int touch[MAX_GENTITIES];
+    vec3_t mins, maxs;
+    clusterLink_t *link;
+    int c, i, num;
+
+    for (i = 0; i < sv.numUnculledEntities; i++)
+    {
+        candidates[sv.unculledEntities[i] >> 3] |= 1 << (sv.unculledEntities[i] & 7);
+    }
+
+    for (c = 0; c < sv.numClusters; c++)
+    {
+        if (!clientpvs[c >> 3])
+        {
+            c |= 7;
+            continue;
+        }
+        if (!(clientpvs[c >> 3] & (1 << (c & 7))))
+        {
+            continue;
+        }
+
+        for (link = sv.clusterEntities[c]; link; link = link->next)
+        {
+            candidates[link->entityNum >> 3] |= 1 << (link->entityNum & 7);
+        }
+    }
+
+    for (i = 0; i < 3; i++)
+    {
+        mins[i] = origin[i] - SNAPSHOT_NEAR_DISTANCE;
+        maxs[i] = origin[i] + SNAPSHOT_NEAR_DISTANCE;
+    }
+
+    num = SV_AreaEntities(mins, maxs, touch, MAX_GENTITIES);
+    for (i = 0; i < num; i++)
+    {
+        candidates[touch[i] >> 3] |= 1 << (touch[i] & 7);
+    }
+}
+
 /*
 ===============
 SV_AddEntitiesVisibleFromPoint
@@ -334,6 +538,7 @@ static void SV_AddEntitiesVisibleFromPoint(vec3_t origin, clientSnapshot_t *fram
     int leafnum;
     byte *clientpvs;
     byte *bitvector;
+    byte candidates[MAX_GENTITIES / 8];
 
     // during an error shutdown message we may need to transmit
     // the shutdown message after the server has shutdown, so
@@ -352,8 +557,23 @@ static void SV_AddEntitiesVisibleFromPoint(vec3_t origin, clientSnapshot_t *fram
 
     clientpvs = CM_ClusterPVS(clientcluster);
 
+    ::memset(candidates, 0, sizeof(candidates));
+    SV_MarkSnapshotCandidates(origin, clientpvs, candidates);
+
+    // walk the candidates in entity order, so a full snapshot keeps
+    // the same entities it would if every entity was tested
     for (e = 0; e < sv.num_entities; e++)
     {
+        if (!candidates[e >> 3])
+        {
+            e |= 7;
+            continue;
+        }
+        if (!(candidates[e >> 3] & (1 << (e & 7))))
+        {
+            continue;
+        }
+
         ent = SV_GentityNum(e);
 
         // never send entities that aren't linked in
@@ -362,12 +582,6 @@ static void SV_AddEntitiesVisibleFromPoint(vec3_t origin, clientSnapshot_t *fram
             continue;
         }
 
-        if (ent->s.number != e)
-        {
-            Com_DPrintf("FIXING ENT->S.NUMBER!!!\n");
-            ent->s.number = e;
-        }
-
         // entities can be flagged to explicitly not be sent to the client
         if (ent->r.svFlags & SVF_NOCLIENT)
         {
@@ -403,10 +617,10 @@ static void SV_AddEntitiesVisibleFromPoint(vec3_t origin, clientSnapshot_t *fram
             }
         }
 
-        svEnt = SV_SvEntityForGentity(ent);
+        svEnt = &sv.svEntities[e];
 
         // don't double add an entity through portals
-        if (svEnt->snapshotCounter == sv.snapshotCounter)
+        if (eNums->added[e >> 3] & (1 << (e & 7)))
         {
             continue;
         }
@@ -414,16 +628,16 @@ static void SV_AddEntitiesVisibleFromPoint(vec3_t origin, clientSnapshot_t *fram
         // broadcast entities are always sent
         if (ent->r.svFlags & SVF_BROADCAST)
         {
-            SV_AddEntToSnapshot(svEnt, ent, eNums);
+            SV_AddEntToSnapshot(e, eNums);
             continue;
         }
 
         // Doing this have two utility:
         // - Keep sound, alien sense, and range marker behave well
         // - Load builds progressivly on the client, avoiding short freeze on low end computer
-        if (Distance(origin, ent->r.currentOrigin) < 1500)
+        if (Distance(origin, ent->r.currentOrigin) < SNAPSHOT_NEAR_DISTANCE)
         {
-            SV_AddEntToSnapshot(svEnt, ent, eNums);
+            SV_AddEntToSnapshot(e, eNums);
             continue;
         }
 
@@ -481,7 +695,7 @@ static void SV_AddEntitiesVisibleFromPoint(vec3_t origin, clientSnapshot_t *fram
         }
 
         // add it
-        SV_AddEntToSnapshot(svEnt, ent, eNums);
+        SV_AddEntToSnapshot(e, eNums);
 
         // if it's a portal entity, add everything visible from its camera position
         if (ent->r.svFlags & SVF_PORTAL)
@@ -502,77 +716,80 @@ static void SV_AddEntitiesVisibleFromPoint(vec3_t origin, clientSnapshot_t *fram
 
 /*
 =============
-SV_BuildClientSnapshot
-
-Decides which entities are going to be visible to the client, and
-copies off the playerstate and areabits.
+SV_BeginClientSnapshot
 
-This properly handles multiple recursive portals, but the render
-currently doesn't.
-
-For viewing through other player's eyes, clent can be something other than client->gentity
+Clears the frame the snapshot is built into and copies off the playerstate.
+Returns false if the client has nothing to look through.
 =============
 */
-static void SV_BuildClientSnapshot(client_t *client)
+static bool SV_BeginClientSnapshot(client_t *client)
 {
-    vec3_t org;
     clientSnapshot_t *frame;
-    snapshotEntityNumbers_t entityNumbers;
-    int i;
-    sharedEntity_t *ent;
-    entityState_t *state;
-    svEntity_t *svEnt;
-    sharedEntity_t *clent;
     int clientNum;
-    playerState_t *ps;
-
-    // bump the counter used to prevent double adding
-    sv.snapshotCounter++;
 
     // this is the frame we are creating
     frame = &client->frames[client->netchan.outgoingSequence & PACKET_MASK];
 
     // clear everything in this snapshot
-    entityNumbers.numSnapshotEntities = 0;
     ::memset(frame->areabits, 0, sizeof(frame->areabits));
 
     // https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=62
     frame->num_entities = 0;
 
-    clent = client->gentity;
-    if (!clent || client->state == CS_ZOMBIE)
+    if (!client->gentity || client->state == CS_ZOMBIE)
     {
-        return;
+        return false;
     }
 
     // grab the current playerState_t
-    ps = SV_GameClientNum(client - svs.clients);
-    frame->ps = *ps;
+    frame->ps = *SV_GameClientNum(client - svs.clients);
 
-    // never send client's own entity, because it can
-    // be regenerated from the playerstate
     clientNum = frame->ps.clientNum;
     if (clientNum < 0 || clientNum >= MAX_GENTITIES)
     {
         Com_Error(ERR_DROP, "SV_SvEntityForGentity: bad gEnt");
     }
-    svEnt = &sv.svEntities[clientNum];
 
-    svEnt->snapshotCounter = sv.snapshotCounter;
+    return true;
+}
+
+/*
+=============
+SV_BuildSnapshotFrame
+
+Decides which entities are going to be visible from the playerstate of the
+frame, and ORs together the areabits of every viewpoint.
+
+This properly handles multiple recursive portals, but the render
+currently doesn't.
+=============
+*/
+static void SV_BuildSnapshotFrame(clientSnapshot_t *frame, snapshotEntityNumbers_t *eNums)
+{
+    vec3_t org;
+    int i;
+    int clientNum;
+
+    eNums->numSnapshotEntities = 0;
+    ::memset(eNums->added, 0, sizeof(eNums->added));
+
+    // never send client's own entity, because it can
+    // be regenerated from the playerstate
+    clientNum = frame->ps.clientNum;
+    eNums->added[clientNum >> 3] |= 1 << (clientNum & 7);
 
     // find the client's viewpoint
-    VectorCopy(ps->origin, org);
-    org[2] += ps->viewheight;
+    VectorCopy(frame->ps.origin, org);
+    org[2] += frame->ps.viewheight;
 
     // add all the entities directly visible to the eye, which
     // may include portal entities that merge other viewpoints
-    SV_AddEntitiesVisibleFromPoint(org, frame, &entityNumbers);
+    SV_AddEntitiesVisibleFromPoint(org, frame, eNums);
 
     // if there were portals visible, there may be out of order entities
     // in the list which will need to be resorted for the delta compression
-    // to work correctly.  This also catches the error condition
-    // of an entity being included twice.
-    qsort(entityNumbers.snapshotEntities, entityNumbers.numSnapshotEntities, sizeof(entityNumbers.snapshotEntities[0]),
+    // to work correctly.
+    qsort(eNums->snapshotEntities, eNums->numSnapshotEntities, sizeof(eNums->snapshotEntities[0]),
         SV_QsortEntityNumbers);
 
     // now that all viewpoint's areabits have been OR'd together, invert
@@ -581,22 +798,166 @@ static void SV_BuildClientSnapshot(client_t *client)
     {
         ((int *)frame->areabits)[i] = ((int *)frame->areabits)[i] ^ -1;
     }
+}
+
+/*
+=============
+SV_BuildClientSnapshot
+
+Only reads shared state, so the snapshots of several clients can be built
+at once after SV_BeginClientSnapshot.
+=============
+*/
+static void SV_BuildClientSnapshot(client_t *client, snapshotEntityNumbers_t *eNums)
+{
+    SV_BuildSnapshotFrame(&client->frames[client->netchan.outgoingSequence & PACKET_MASK], eNums);
+}
+
+/*
+=============
+SV_ReplaySnapshot
+
+Lists the entities a client with the playerstate ps would be sent, for
+snapshotreplay.  SV_PrepareSnapshotEntities has to have run since the
+entities last changed.  Returns the number of entities.
+=============
+*/
+int SV_ReplaySnapshot(const playerState_t *ps, int *entityNums)
+{
+    static clientSnapshot_t frame;
+    static snapshotEntityNumbers_t eNums;
+
+    ::memset(frame.areabits, 0, sizeof(frame.areabits));
+    frame.ps = *ps;
+
+    SV_BuildSnapshotFrame(&frame, &eNums);
+    ::memcpy(entityNums, eNums.snapshotEntities, eNums.numSnapshotEntities * sizeof(entityNums[0]));
+
+    return eNums.numSnapshotEntities;
+}
+
+/*
+=============
+SV_ReserveSnapshotEntities
+
+Claims a run of svs.snapshotEntities for the frame.  Reservations are made
+serially in client order, so the buffer is laid out exactly as if the
+snapshots had been built one after another.
+=============
+*/
+static void SV_ReserveSnapshotEntities(client_t *client, snapshotEntityNumbers_t *eNums)
+{
+    clientSnapshot_t *frame;
+
+    frame = &client->frames[client->netchan.outgoingSequence & PACKET_MASK];
 
-    // copy the entity states out
-    frame->num_entities = 0;
     frame->first_entity = svs.nextSnapshotEntities;
-    for (i = 0; i < entityNumbers.numSnapshotEntities; i++)
+    frame->num_entities = eNums->numSnapshotEntities;
+    frame->snapshotFrame = svs.snapshotFrame;
+
+    svs.nextSnapshotEntities += eNums->numSnapshotEntities;
+    // this should never hit, map should always be restarted first in SV_Frame
+    if (svs.nextSnapshotEntities >= 0x7FFFFFFE)
+    {
+        Com_Error(ERR_FATAL, "svs.nextSnapshotEntities wrapped");
+    }
+}
+
+/*
+=============
+SV_StoreSnapshotEntities
+
+Copies the entity states out into the run reserved for the frame.
+=============
+*/
+static void SV_StoreSnapshotEntities(client_t *client, snapshotEntityNumbers_t *eNums)
+{
+    clientSnapshot_t *frame;
+    int i;
+
+    frame = &client->frames[client->netchan.outgoingSequence & PACKET_MASK];
+
+    for (i = 0; i < frame->num_entities; i++)
+    {
+        svs.snapshotEntities[(frame->first_entity + i) % svs.numSnapshotEntities] =
+            SV_GentityNum(eNums->snapshotEntities[i])->s;
+    }
+}
+
+/*
+=============
+SV_PrepareSnapshotEntities
+
+Called once a frame before any snapshots are built.  Makes sure the game
+agrees on entity numbers, and collects the entities that the cluster lists
+and the area query in SV_AddEntitiesVisibleFromPoint can't find: broadcast
+entities, entities touching more clusters than clusternums holds, and
+entities whose origin is outside their bounds.
+=============
+*/
+void SV_PrepareSnapshotEntities(void)
+{
+    sharedEntity_t *ent;
+    svEntity_t *svEnt;
+    int e, i;
+
+    sv.numUnculledEntities = 0;
+
+    if (!sv.state)
     {
-        ent = SV_GentityNum(entityNumbers.snapshotEntities[i]);
-        state = &svs.snapshotEntities[svs.nextSnapshotEntities % svs.numSnapshotEntities];
-        *state = ent->s;
-        svs.nextSnapshotEntities++;
-        // this should never hit, map should always be restarted first in SV_Frame
-        if (svs.nextSnapshotEntities >= 0x7FFFFFFE)
+        return;
+    }
+
+    // only the gentities of linked entities are looked at
+    for (e = 0; e < sv.num_entities; e++)
+    {
+        if (!sv.linkedEntities[e >> 3])
+        {
+            e |= 7;
+            continue;
+        }
+        if (!(sv.linkedEntities[e >> 3] & (1 << (e & 7))))
+        {
+            continue;
+        }
+
+        ent = SV_GentityNum(e);
+
+        if (!ent->r.linked)
         {
-            Com_Error(ERR_FATAL, "svs.nextSnapshotEntities wrapped");
+            continue;
+        }
+
+        if (ent->s.number != e)
+        {
+            Com_DPrintf("FIXING ENT->S.NUMBER!!!\n");
+            ent->s.number = e;
+        }
+
+        if (ent->r.svFlags & SVF_NOCLIENT)
+        {
+            continue;
+        }
+
+        svEnt = &sv.svEntities[e];
+
+        if ((ent->r.svFlags & SVF_BROADCAST) || svEnt->lastCluster)
+        {
+            sv.unculledEntities[sv.numUnculledEntities++] = e;
+            continue;
+        }
+
+        for (i = 0; i < 3; i++)
+        {
+            if (ent->r.currentOrigin[i] < ent->r.absmin[i] || ent->r.currentOrigin[i] > ent->r.absmax[i])
+            {
+                break;
+            }
+        }
+        if (i != 3)
+        {
+            sv.unculledEntities[sv.numUnculledEntities++] = e;
         }
-        frame->num_entities++;
     }
 }
 
@@ -666,6 +1027,50 @@ void SV_SendMessageToClient(msg_t *msg, client_t *client)
     SV_Netchan_Transmit(client, msg);
 }
 
+/*
+=======================
+SV_WriteClientMessage
+
+Writes everything but VoIP into a new message for the client.
+=======================
+*/
+static void SV_WriteClientMessage(client_t *client, clientSnapshot_t *oldframe, int lastframe, msg_t *msg)
+{
+    // NOTE, MRE: all server->client messages now acknowledge
+    // let the client know which reliable clientCommands we have received
+    MSG_WriteLong(msg, client->lastClientCommand);
+
+    // (re)send any reliable server commands
+    SV_UpdateServerCommandsToClient(client, msg);
+
+    // send over all the relevant entityState_t
+    // and the playerState_t
+    SV_WriteSnapshotToClient(client, oldframe, lastframe, msg);
+}
+
+/*
+=======================
+SV_FinishClientMessage
+
+Called on the main thread, in client order, once the message is written.
+=======================
+*/
+static void SV_FinishClientMessage(client_t *client, msg_t *msg)
+{
+#ifdef USE_VOIP
+    SV_WriteVoipToClient(client, msg);
+#endif
+
+    // check for overflow
+    if (msg->overflowed)
+    {
+        Com_Printf("WARNING: msg overflowed for %s\n", client->name);
+        MSG_Clear(msg);
+    }
+
+    SV_SendMessageToClient(msg, client);
+}
+
 /*
 =======================
 SV_SendClientSnapshot
@@ -676,38 +1081,148 @@ Also called by SV_FinalMessage
 */
 void SV_SendClientSnapshot(client_t *client)
 {
+    static snapshotEntityNumbers_t entityNumbers;
     byte msg_buf[MAX_MSGLEN];
     msg_t msg;
+    clientSnapshot_t *oldframe;
+    int lastframe;
 
     // build the snapshot
-    SV_BuildClientSnapshot(client);
+    if (SV_BeginClientSnapshot(client))
+    {
+        svs.snapshotFrame++;
+        SV_PrepareSnapshotEntities();
+        SV_BuildClientSnapshot(client, &entityNumbers);
+        SV_ReserveSnapshotEntities(client, &entityNumbers);
+        SV_StoreSnapshotEntities(client, &entityNumbers);
+    }
 
     MSG_Init(&msg, msg_buf, sizeof(msg_buf));
     msg.allowoverflow = true;
 
-    // NOTE, MRE: all server->client messages now acknowledge
-    // let the client know which reliable clientCommands we have received
-    MSG_WriteLong(&msg, client->lastClientCommand);
+    oldframe = SV_SelectDeltaFrame(client, &lastframe);
+    SV_WriteClientMessage(client, oldframe, lastframe, &msg);
 
-    // (re)send any reliable server commands
-    SV_UpdateServerCommandsToClient(client, &msg);
+    SV_FinishClientMessage(client, &msg);
+}
 
-    // send over all the relevant entityState_t
-    // and the playerState_t
-    SV_WriteSnapshotToClient(client, &msg);
+/*
+=============================================================================
 
-#ifdef USE_VOIP
-    SV_WriteVoipToClient(client, &msg);
-#endif
+Parallel snapshots
 
-    // check for overflow
-    if (msg.overflowed)
+With sv_snapshotThreads above 1 the snapshots of all clients due this frame
+are built and encoded on the job pool.  Anything that touches the snapshot
+entity buffer layout, prints, or sends is kept on the main thread and done in
+client order, so the packets should be identical to the serial path.  Setting
+sv_snapshotCheck rebuilds every message serially and compares the bytes.
+
+=============================================================================
+*/
+
+typedef struct {
+    client_t *client;
+    bool build;
+    clientSnapshot_t *oldframe;
+    int lastframe;
+    int deltaHits, deltaMisses;
+    snapshotEntityNumbers_t entityNumbers;
+    msg_t msg;
+    byte msg_buf[MAX_MSGLEN];
+} snapshotJob_t;
+
+static snapshotJob_t snapshotJobs[MAX_CLIENTS];
+
+/*
+=======================
+SV_BuildSnapshotJob
+=======================
+*/
+static void SV_BuildSnapshotJob(void *data, int index, int thread)
+{
+    snapshotJob_t *job = &((snapshotJob_t *)data)[index];
+
+    if (job->build)
     {
-        Com_Printf("WARNING: msg overflowed for %s\n", client->name);
-        MSG_Clear(&msg);
+        SV_BuildClientSnapshot(job->client, &job->entityNumbers);
+    }
+}
+
+/*
+=======================
+SV_EncodeSnapshotJob
+=======================
+*/
+static void SV_EncodeSnapshotJob(void *data, int index, int thread)
+{
+    snapshotJob_t *job = &((snapshotJob_t *)data)[index];
+
+    if (job->build)
+    {
+        SV_StoreSnapshotEntities(job->client, &job->entityNumbers);
+    }
+
+    MSG_Init(&job->msg, job->msg_buf, sizeof(job->msg_buf));
+    job->msg.allowoverflow = true;
+
+    deltaCacheHits = 0;
+    deltaCacheMisses = 0;
+
+    SV_WriteClientMessage(job->client, job->oldframe, job->lastframe, &job->msg);
+
+    job->deltaHits = deltaCacheHits;
+    job->deltaMisses = deltaCacheMisses;
+}
+
+/*
+=======================
+SV_CheckSnapshotJob
+
+Builds and writes the message of a job again on the main thread, without the
+shared entity deltas, and warns if it differs from what the workers produced.
+=======================
+*/
+static void SV_CheckSnapshotJob(snapshotJob_t *job)
+{
+    static snapshotEntityNumbers_t entityNumbers;
+    static byte msg_buf[MAX_MSGLEN];
+    byte areabits[MAX_MAP_AREA_BYTES];
+    clientSnapshot_t *frame;
+    msg_t msg;
+    bool same = true;
+
+    frame = &job->client->frames[job->client->netchan.outgoingSequence & PACKET_MASK];
+
+    if (job->build)
+    {
+        // start again from the cleared areabits SV_BeginClientSnapshot left
+        ::memcpy(areabits, frame->areabits, sizeof(areabits));
+        ::memset(frame->areabits, 0, sizeof(frame->areabits));
+        SV_BuildClientSnapshot(job->client, &entityNumbers);
+
+        if (::memcmp(areabits, frame->areabits, sizeof(areabits)) ||
+            entityNumbers.numSnapshotEntities != job->entityNumbers.numSnapshotEntities ||
+            ::memcmp(entityNumbers.snapshotEntities, job->entityNumbers.snapshotEntities,
+                entityNumbers.numSnapshotEntities * sizeof(entityNumbers.snapshotEntities[0])))
+        {
+            same = false;
+        }
+    }
+
+    MSG_Init(&msg, msg_buf, sizeof(msg_buf));
+    msg.allowoverflow = true;
+    SV_WriteClientMessage(job->client, job->oldframe, job->lastframe, &msg);
+
+    if (msg.cursize != job->msg.cursize || msg.bit != job->msg.bit || msg.overflowed != job->msg.overflowed ||
+        ::memcmp(msg.data, job->msg.data, msg.cursize))
+    {
+        same = false;
     }
 
-    SV_SendMessageToClient(&msg, client);
+    if (!same)
+    {
+        Com_Printf("WARNING: threaded snapshot for %s differs from the serial one\n", job->client->name);
+    }
 }
 
 /*
@@ -718,9 +1233,12 @@ SV_SendClientMessages
 void SV_SendClientMessages(void)
 {
     int i;
+    int numJobs;
     client_t *c;
+    snapshotJob_t *job;
 
-    // send a message to each connected client
+    // pick the clients that get a message this frame
+    numJobs = 0;
     for (i = 0; i < sv_maxclients->integer; i++)
     {
         c = &svs.clients[i];
@@ -750,9 +1268,60 @@ void SV_SendClientMessages(void)
             }
         }
 
-        // generate and send a new message
-        SV_SendClientSnapshot(c);
-        c->lastSnapshotTime = svs.time;
-        c->rateDelayed = false;
+        job = &snapshotJobs[numJobs++];
+        job->client = c;
+        job->build = SV_BeginClientSnapshot(c);
+    }
+
+    if (!numJobs)
+    {
+        return;
+    }
+
+    // find out what everyone can see
+    svs.snapshotFrame++;
+    SV_PrepareSnapshotEntities();
+    Jobs_ParallelFor(sv_snapshotThreads->integer, numJobs, SV_BuildSnapshotJob, snapshotJobs);
+
+    // lay the entities out in client order, then pick delta frames against
+    // the final state of the buffer
+    for (i = 0; i < numJobs; i++)
+    {
+        job = &snapshotJobs[i];
+        if (job->build)
+        {
+            SV_ReserveSnapshotEntities(job->client, &job->entityNumbers);
+        }
+    }
+    for (i = 0; i < numJobs; i++)
+    {
+        job = &snapshotJobs[i];
+        job->oldframe = SV_SelectDeltaFrame(job->client, &job->lastframe);
+    }
+
+    // generate the new messages, sharing entity deltas between them
+    SV_ClearDeltaCache();
+    deltaCacheEnabled = true;
+    Jobs_ParallelFor(sv_snapshotThreads->integer, numJobs, SV_EncodeSnapshotJob, snapshotJobs);
+    deltaCacheEnabled = false;
+
+    if (sv_snapshotCheck->integer)
+    {
+        for (i = 0; i < numJobs; i++)
+        {
+            SV_CheckSnapshotJob(&snapshotJobs[i]);
+        }
+    }
+
+    // and send them
+    for (i = 0; i < numJobs; i++)
+    {
+        job = &snapshotJobs[i];
+        SV_FinishClientMessage(job->client, &job->msg);
+        job->client->lastSnapshotTime = svs.time;
+        job->client->rateDelayed = false;
+
+        svs.stats.deltaHits += job->deltaHits;
+        svs.stats.deltaMisses += job->deltaMisses;
     }
 }
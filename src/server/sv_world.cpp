@@ -26,6 +26,13 @@ along with Tremulous; if not, see <https://www.gnu.org/licenses/>
 
 #include "server.h"
 
+#include <atomic>
+#include <cfloat>
+
+#if idx64
+#include <emmintrin.h>
+#endif
+
 /*
 ================
 SV_ClipHandleForEntity
@@ -58,95 +65,525 @@ clipHandle_t SV_ClipHandleForEntity(const sharedEntity_t *ent)
 ENTITY CHECKING
 
 To avoid linearly searching through lists of entities during environment testing,
-the world is carved up with an evenly spaced, axially aligned bsp tree.  Entities
-are kept in chains either at the final leafs, or at the first node that splits
-them, which prevents having to deal with multiple fragments of a single entity.
+linked entities are kept in a dynamic bounding box tree.  Every entity is a leaf
+whose box is its absmin / absmax grown by AREA_MARGIN, and every interior node
+bounds its two children.  As long as a relinked entity still fits in its leaf
+box the tree is left alone, otherwise the leaf is removed and inserted again next
+to the sibling that grows the least, with rotations keeping the tree balanced.
 
 ===============================================================================
 */
 
-struct worldSector_t {
-    int axis;  // -1 = leaf node
-    float dist;
-    worldSector_t *children[2];
-    svEntity_t *entities;
+struct worldNode_t {
+    alignas(16) float mins[4];  // the fourth is 0, for SV_OutsideArea
+    alignas(16) float maxs[4];  // fattened for leafs
+    int height;  // 0 for leafs, -1 when free
+    worldNode_t *parent;  // next free node when free
+    worldNode_t *children[2];  // NULL for leafs
+    svEntity_t *entity;  // leafs only
 };
 
-#define AREA_DEPTH 4
-#define AREA_NODES 64
+#define AREA_MARGIN 16  // leaf boxes are grown this much on every side
+#define AREA_PREDICT_SCALE 2  // and stretched this much along the last move
+#define AREA_PREDICT 64.0f  // but never further than this
+#define AREA_IMBALANCE 2  // rotate by height past this, by area otherwise
+#define AREA_NODES (2 * MAX_GENTITIES)
+#define AREA_SWEEP 64  // moves longer than this are tested against the path, not just its bounds
+#define AREA_STACK 128  // the tree never gets much past 30 levels
+
+static worldNode_t sv_worldNodes[AREA_NODES];
+static worldNode_t *sv_worldRoot;
+static worldNode_t *sv_worldFree;
+
+// collected while sectorlist counting is on
+struct worldStats_t {
+    bool active;
+    std::atomic<int64_t> queries;
+    std::atomic<int64_t> nodes;  // nodes whose box was tested
+    std::atomic<int64_t> entities;  // entity boxes tested
+    std::atomic<int64_t> found;
+    int64_t frames;
+    int64_t links;
+    int64_t unchanged;  // links that kept everything from the last one
+    int64_t moves;  // links that had to reinsert the leaf
+};
 
-worldSector_t sv_worldSectors[AREA_NODES];
-int sv_numworldSectors;
+static worldStats_t sv_worldStats;
 
 /*
 ===============
-SV_SectorList_f
+SV_AllocWorldNode
 ===============
 */
-void SV_SectorList_f(void)
+static worldNode_t *SV_AllocWorldNode(void)
 {
-    int i, c;
-    worldSector_t *sec;
-    svEntity_t *ent;
+    worldNode_t *node;
 
-    for (i = 0; i < AREA_NODES; i++)
+    node = sv_worldFree;
+    if (!node)
+    {
+        Com_Error(ERR_DROP, "SV_AllocWorldNode: out of nodes");
+    }
+    sv_worldFree = node->parent;
+
+    node->parent = NULL;
+    node->children[0] = node->children[1] = NULL;
+    node->entity = NULL;
+    node->height = 0;
+    return node;
+}
+
+/*
+===============
+SV_FreeWorldNode
+===============
+*/
+static void SV_FreeWorldNode(worldNode_t *node)
+{
+    node->height = -1;
+    node->entity = NULL;
+    node->parent = sv_worldFree;
+    sv_worldFree = node;
+}
+
+/*
+===============
+SV_WorldNodeCost
+
+Half the surface area of a box, which is what a random query pays for it
+===============
+*/
+static ID_INLINE float SV_WorldNodeCost(const vec3_t mins, const vec3_t maxs)
+{
+    float dx = maxs[0] - mins[0];
+    float dy = maxs[1] - mins[1];
+    float dz = maxs[2] - mins[2];
+
+    return dx * dy + dy * dz + dz * dx;
+}
+
+/*
+===============
+SV_UnionBounds
+===============
+*/
+static ID_INLINE void SV_UnionBounds(
+    const worldNode_t *a, const worldNode_t *b, vec3_t mins, vec3_t maxs)
+{
+    int i;
+
+    for (i = 0; i < 3; i++)
+    {
+        mins[i] = MIN(a->mins[i], b->mins[i]);
+        maxs[i] = MAX(a->maxs[i], b->maxs[i]);
+    }
+}
+
+/*
+===============
+SV_RefitWorldNode
+===============
+*/
+static void SV_RefitWorldNode(worldNode_t *node)
+{
+    SV_UnionBounds(node->children[0], node->children[1], node->mins, node->maxs);
+    node->height = 1 + MAX(node->children[0]->height, node->children[1]->height);
+}
+
+/*
+===============
+SV_ReplaceWorldChild
+
+Points whatever referenced old at node instead
+===============
+*/
+static void SV_ReplaceWorldChild(worldNode_t *parent, worldNode_t *old, worldNode_t *node)
+{
+    node->parent = parent;
+    if (!parent)
     {
-        sec = &sv_worldSectors[i];
+        sv_worldRoot = node;
+    }
+    else if (parent->children[0] == old)
+    {
+        parent->children[0] = node;
+    }
+    else
+    {
+        parent->children[1] = node;
+    }
+}
+
+/*
+===============
+SV_BalanceWorldNode
+
+If one child of a is more than AREA_IMBALANCE levels taller than the other,
+rotates that child up into a's place and returns the new subtree root.
+===============
+*/
+static worldNode_t *SV_BalanceWorldNode(worldNode_t *a)
+{
+    worldNode_t *up, *taller, *shorter;
+    int side, balance;
+
+    if (!a->children[0] || a->height < 2)
+    {
+        return a;
+    }
+
+    balance = a->children[1]->height - a->children[0]->height;
+    if (balance >= -AREA_IMBALANCE && balance <= AREA_IMBALANCE)
+    {
+        return a;
+    }
+
+    side = balance > 0 ? 1 : 0;
+    up = a->children[side];
+
+    if (up->children[0]->height > up->children[1]->height)
+    {
+        taller = up->children[0];
+        shorter = up->children[1];
+    }
+    else
+    {
+        taller = up->children[1];
+        shorter = up->children[0];
+    }
 
-        c = 0;
-        for (ent = sec->entities; ent; ent = ent->nextEntityInWorldSector)
+    // up takes a's place, a keeps its other child and the shorter grandchild
+    SV_ReplaceWorldChild(a->parent, a, up);
+    up->children[0] = a;
+    up->children[1] = taller;
+    a->parent = up;
+    a->children[side] = shorter;
+    shorter->parent = a;
+
+    SV_RefitWorldNode(a);
+    SV_RefitWorldNode(up);
+
+    return up;
+}
+
+/*
+===============
+SV_RotateWorldNode
+
+Swaps a child of a with a grandchild under its other child when that shrinks
+the other child's box, which keeps big entities from bloating the nodes of
+small ones.  Swaps are skipped if they would leave that child unbalanced, or a
+more than twice as unbalanced as SV_BalanceWorldNode allows.
+===============
+*/
+static bool SV_RotateWorldNode(worldNode_t *a)
+{
+    worldNode_t *x, *y, *g, *keep, *bestX, *bestG;
+    vec3_t mins, maxs;
+    float gain, bestGain;
+    int i, j, height;
+
+    if (!a->children[0])
+    {
+        return false;
+    }
+
+    bestX = bestG = NULL;
+    bestGain = 0;
+    for (i = 0; i < 2; i++)
+    {
+        x = a->children[i];
+        y = a->children[i ^ 1];
+        if (!y->children[0])
         {
-            c++;
+            continue;
+        }
+
+        for (j = 0; j < 2; j++)
+        {
+            // after the swap y holds x and the grandchild that stays
+            g = y->children[j];
+            keep = y->children[j ^ 1];
+            height = 1 + MAX(x->height, keep->height);
+            if (abs(x->height - keep->height) > AREA_IMBALANCE || abs(height - g->height) > 2 * AREA_IMBALANCE)
+            {
+                continue;
+            }
+
+            SV_UnionBounds(x, keep, mins, maxs);
+            gain = SV_WorldNodeCost(y->mins, y->maxs) - SV_WorldNodeCost(mins, maxs);
+            if (gain > bestGain)
+            {
+                bestGain = gain;
+                bestX = x;
+                bestG = g;
+            }
         }
-        Com_Printf("sector %i: %i entities\n", i, c);
     }
+
+    if (!bestX)
+    {
+        return false;
+    }
+
+    y = bestG->parent;
+    a->children[a->children[1] == bestX] = bestG;
+    y->children[y->children[1] == bestG] = bestX;
+    bestG->parent = a;
+    bestX->parent = y;
+    SV_RefitWorldNode(y);
+    return true;
 }
 
 /*
 ===============
-SV_CreateworldSector
+SV_FixupWorldNodes
 
-Builds a uniformly subdivided tree for the given world size
+Rebalances and refits from node towards the root, stopping once a node comes
+out the same as it was, as nothing above it can change then
 ===============
 */
-static worldSector_t *SV_CreateworldSector(int depth, vec3_t mins, vec3_t maxs)
+static void SV_FixupWorldNodes(worldNode_t *node)
 {
-    worldSector_t *anode;
-    vec3_t size;
-    vec3_t mins1, maxs1, mins2, maxs2;
+    worldNode_t *balanced;
+    vec3_t mins, maxs;
+    int height;
+    bool rotated;
+
+    while (node)
+    {
+        VectorCopy(node->mins, mins);
+        VectorCopy(node->maxs, maxs);
+        height = node->height;
+
+        balanced = SV_BalanceWorldNode(node);
+        rotated = SV_RotateWorldNode(balanced);
+        SV_RefitWorldNode(balanced);
 
-    anode = &sv_worldSectors[sv_numworldSectors];
-    sv_numworldSectors++;
+        if (balanced == node && !rotated && height == node->height && VectorCompare(mins, node->mins) &&
+            VectorCompare(maxs, node->maxs))
+        {
+            break;
+        }
+        node = balanced->parent;
+    }
+}
 
-    if (depth == AREA_DEPTH)
+/*
+===============
+SV_InsertWorldLeaf
+===============
+*/
+static void SV_InsertWorldLeaf(worldNode_t *leaf)
+{
+    worldNode_t *node, *child, *parent;
+    vec3_t mins, maxs;
+    float cost, inherit, childCost[2];
+    int i;
+
+    if (!sv_worldRoot)
     {
-        anode->axis = -1;
-        anode->children[0] = anode->children[1] = NULL;
-        return anode;
+        sv_worldRoot = leaf;
+        leaf->parent = NULL;
+        return;
     }
 
-    VectorSubtract(maxs, mins, size);
-    if (size[0] > size[1])
+    // walk down towards the sibling that makes the tree grow the least
+    node = sv_worldRoot;
+    while (node->children[0])
     {
-        anode->axis = 0;
+        SV_UnionBounds(node, leaf, mins, maxs);
+        cost = SV_WorldNodeCost(mins, maxs);
+
+        // pairing with node itself
+        inherit = cost - SV_WorldNodeCost(node->mins, node->maxs);
+        cost *= 2;
+        inherit *= 2;
+
+        for (i = 0; i < 2; i++)
+        {
+            child = node->children[i];
+            SV_UnionBounds(child, leaf, mins, maxs);
+            childCost[i] = SV_WorldNodeCost(mins, maxs) + inherit;
+            if (child->children[0])
+            {
+                childCost[i] -= SV_WorldNodeCost(child->mins, child->maxs);
+            }
+        }
+
+        if (cost < childCost[0] && cost < childCost[1])
+        {
+            break;
+        }
+
+        node = node->children[childCost[1] < childCost[0]];
     }
-    else
+
+    // give the sibling and the leaf a new common parent
+    parent = SV_AllocWorldNode();
+    SV_ReplaceWorldChild(node->parent, node, parent);
+    parent->children[0] = node;
+    parent->children[1] = leaf;
+    node->parent = parent;
+    leaf->parent = parent;
+
+    SV_FixupWorldNodes(parent);
+}
+
+/*
+===============
+SV_RemoveWorldLeaf
+===============
+*/
+static void SV_RemoveWorldLeaf(worldNode_t *leaf)
+{
+    worldNode_t *parent, *grandParent, *sibling;
+
+    if (leaf == sv_worldRoot)
     {
-        anode->axis = 1;
+        sv_worldRoot = NULL;
+        return;
     }
 
-    anode->dist = 0.5 * (maxs[anode->axis] + mins[anode->axis]);
-    VectorCopy(mins, mins1);
-    VectorCopy(mins, mins2);
-    VectorCopy(maxs, maxs1);
-    VectorCopy(maxs, maxs2);
+    parent = leaf->parent;
+    grandParent = parent->parent;
+    sibling = parent->children[parent->children[0] == leaf];
 
-    maxs1[anode->axis] = mins2[anode->axis] = anode->dist;
+    SV_ReplaceWorldChild(grandParent, parent, sibling);
+    SV_FreeWorldNode(parent);
 
-    anode->children[0] = SV_CreateworldSector(depth + 1, mins2, maxs2);
-    anode->children[1] = SV_CreateworldSector(depth + 1, mins1, maxs1);
+    SV_FixupWorldNodes(grandParent);
+}
 
-    return anode;
+/*
+===============
+SV_WorldNodeDepth
+===============
+*/
+static int SV_WorldNodeDepth(const worldNode_t *node)
+{
+    int depth;
+
+    for (depth = 0; node->parent; node = node->parent)
+    {
+        depth++;
+    }
+    return depth;
+}
+
+/*
+===============
+SV_SectorList_f
+
+Prints the shape of the entity tree, "sectorlist ents" adds every entity and
+"sectorlist count" / "sectorlist stop" turn query and link counting on and off.
+===============
+*/
+void SV_SectorList_f(void)
+{
+    int depthCount[AREA_STACK];
+    int i, depth, maxDepth, leafs, nodes;
+    worldNode_t *node;
+    svEntity_t *ent;
+    bool listEnts;
+    int64_t queries, frames;
+
+    if (!Q_stricmp(Cmd_Argv(1), "count"))
+    {
+        sv_worldStats.queries = 0;
+        sv_worldStats.nodes = 0;
+        sv_worldStats.entities = 0;
+        sv_worldStats.found = 0;
+        sv_worldStats.frames = 0;
+        sv_worldStats.links = 0;
+        sv_worldStats.unchanged = 0;
+        sv_worldStats.moves = 0;
+        sv_worldStats.active = true;
+        Com_Printf("counting entity queries\n");
+        return;
+    }
+    if (!Q_stricmp(Cmd_Argv(1), "stop"))
+    {
+        sv_worldStats.active = false;
+        return;
+    }
+    listEnts = !Q_stricmp(Cmd_Argv(1), "ents");
+
+    ::memset(depthCount, 0, sizeof(depthCount));
+    leafs = nodes = maxDepth = 0;
+
+    for (i = 0; i < AREA_NODES; i++)
+    {
+        node = &sv_worldNodes[i];
+        if (node->height < 0)
+        {
+            continue;
+        }
+        if (!node->parent && node != sv_worldRoot)
+        {
+            continue;  // still zeroed, no map has been loaded yet
+        }
+
+        nodes++;
+        if (node->children[0])
+        {
+            continue;
+        }
+
+        leafs++;
+        depth = SV_WorldNodeDepth(node);
+        depthCount[MIN(depth, AREA_STACK - 1)]++;
+        maxDepth = MAX(maxDepth, depth);
+
+        if (listEnts)
+        {
+            ent = node->entity;
+            Com_Printf("entity %i: depth %i, (%i %i %i) to (%i %i %i)\n", (int)(ent - sv.svEntities), depth,
+                (int)node->mins[0], (int)node->mins[1], (int)node->mins[2], (int)node->maxs[0],
+                (int)node->maxs[1], (int)node->maxs[2]);
+        }
+    }
+
+    Com_Printf("%i entities in %i nodes, %i levels\n", leafs, nodes, sv_worldRoot ? sv_worldRoot->height + 1 : 0);
+    for (i = 0; i <= maxDepth && i < AREA_STACK; i++)
+    {
+        if (depthCount[i])
+        {
+            Com_Printf("depth %i: %i entities\n", i, depthCount[i]);
+        }
+    }
+
+    if (sv_worldStats.active)
+    {
+        queries = MAX(sv_worldStats.queries.load(), (int64_t)1);
+        Com_Printf("%lld queries, %.1f nodes, %.1f entity boxes tested, %.1f found per query\n",
+            (long long)sv_worldStats.queries.load(), (double)sv_worldStats.nodes.load() / queries,
+            (double)sv_worldStats.entities.load() / queries, (double)sv_worldStats.found.load() / queries);
+        frames = MAX(sv_worldStats.frames, (int64_t)1);
+        Com_Printf("%lld frames, %.1f links, %.1f unchanged, %.1f moved in the tree per frame\n",
+            (long long)sv_worldStats.frames, (double)sv_worldStats.links / frames,
+            (double)sv_worldStats.unchanged / frames, (double)sv_worldStats.moves / frames);
+    }
+}
+
+/*
+===============
+SV_WorldFrame
+
+Called after every game frame
+===============
+*/
+void SV_WorldFrame(void)
+{
+    if (sv_worldStats.active)
+    {
+        sv_worldStats.frames++;
+    }
+
+    if (SV_Capturing())
+    {
+        SV_CaptureFrame();
+    }
 }
 
 /*
@@ -157,16 +594,88 @@ SV_ClearWorld
 */
 void SV_ClearWorld(void)
 {
-    clipHandle_t h;
-    vec3_t mins, maxs;
+    sv.numClusters = CM_NumClusters();
+    sv.clusterEntities = (clusterLink_t **)Hunk_Alloc(sv.numClusters * sizeof(*sv.clusterEntities), h_high);
+
+    SV_ResetWorld();
+}
 
-    ::memset(sv_worldSectors, 0, sizeof(sv_worldSectors));
-    sv_numworldSectors = 0;
+/*
+===============
+SV_ResetWorld
 
-    // get world map bounds
-    h = CM_InlineModel(0);
-    CM_ModelBounds(h, mins, maxs);
-    SV_CreateworldSector(0, mins, maxs);
+Unlinks everything without touching the hunk, so it can be repeated on
+the same map
+===============
+*/
+void SV_ResetWorld(void)
+{
+    int i;
+
+    ::memset(sv_worldNodes, 0, sizeof(sv_worldNodes));
+    sv_worldRoot = NULL;
+    sv_worldFree = NULL;
+    for (i = AREA_NODES - 1; i >= 0; i--)
+    {
+        SV_FreeWorldNode(&sv_worldNodes[i]);
+    }
+
+    ::memset(sv.linkedEntities, 0, sizeof(sv.linkedEntities));
+    ::memset(sv.clusterEntities, 0, sv.numClusters * sizeof(*sv.clusterEntities));
+}
+
+/*
+===============
+SV_UnlinkClusters
+
+===============
+*/
+static void SV_UnlinkClusters(svEntity_t *ent)
+{
+    clusterLink_t *link;
+    int i;
+
+    for (i = 0; i < ent->numClusterLinks; i++)
+    {
+        link = &ent->clusterLinks[i];
+        *link->prevNext = link->next;
+        if (link->next)
+        {
+            link->next->prevNext = link->prevNext;
+        }
+    }
+    ent->numClusterLinks = 0;
+}
+
+/*
+===============
+SV_LinkClusters
+
+Adds the entity to the list of every cluster in clusternums, so snapshots
+can find it from the viewer's PVS without looking at every entity.
+===============
+*/
+static void SV_LinkClusters(svEntity_t *ent)
+{
+    clusterLink_t *link;
+    clusterLink_t **head;
+    int i;
+
+    for (i = 0; i < ent->numClusters; i++)
+    {
+        link = &ent->clusterLinks[i];
+        head = &sv.clusterEntities[ent->clusternums[i]];
+
+        link->entityNum = ent - sv.svEntities;
+        link->next = *head;
+        link->prevNext = head;
+        if (*head)
+        {
+            (*head)->prevNext = &link->next;
+        }
+        *head = link;
+    }
+    ent->numClusterLinks = ent->numClusters;
 }
 
 /*
@@ -178,36 +687,82 @@ SV_UnlinkEntity
 void SV_UnlinkEntity(sharedEntity_t *gEnt)
 {
     svEntity_t *ent;
-    svEntity_t *scan;
-    worldSector_t *ws;
+    int num;
 
     ent = SV_SvEntityForGentity(gEnt);
 
+    if (SV_Capturing())
+    {
+        SV_CaptureUnlink(gEnt);
+    }
+
     gEnt->r.linked = qfalse;
 
-    ws = ent->worldSector;
-    if (!ws)
+    num = ent - sv.svEntities;
+    sv.linkedEntities[num >> 3] &= ~(1 << (num & 7));
+
+    SV_UnlinkClusters(ent);
+
+    if (!ent->worldNode)
     {
         return;  // not linked in anywhere
     }
-    ent->worldSector = NULL;
 
-    if (ws->entities == ent)
-    {
-        ws->entities = ent->nextEntityInWorldSector;
-        return;
-    }
+    SV_RemoveWorldLeaf(ent->worldNode);
+    SV_FreeWorldNode(ent->worldNode);
+    ent->worldNode = NULL;
+}
 
-    for (scan = ws->entities; scan; scan = scan->nextEntityInWorldSector)
+/*
+===============
+SV_PlaceWorldLeaf
+
+Puts the entity's leaf around absmin / absmax, leaving the tree alone if the
+old leaf box still holds it
+===============
+*/
+static void SV_PlaceWorldLeaf(svEntity_t *ent, const vec3_t absmin, const vec3_t absmax)
+{
+    worldNode_t *leaf;
+    vec3_t move;
+    int i;
+
+    leaf = ent->worldNode;
+    VectorClear(move);
+
+    if (leaf)
     {
-        if (scan->nextEntityInWorldSector == ent)
+        if (leaf->mins[0] <= absmin[0] && leaf->mins[1] <= absmin[1] && leaf->mins[2] <= absmin[2] &&
+            leaf->maxs[0] >= absmax[0] && leaf->maxs[1] >= absmax[1] && leaf->maxs[2] >= absmax[2])
         {
-            scan->nextEntityInWorldSector = ent->nextEntityInWorldSector;
             return;
         }
+        SV_RemoveWorldLeaf(leaf);
+
+        // it left its box, so it is probably still moving that way
+        for (i = 0; i < 3; i++)
+        {
+            move[i] = 0.5f * (absmin[i] + absmax[i] - leaf->mins[i] - leaf->maxs[i]);
+            move[i] = Com_Clamp(-AREA_PREDICT, AREA_PREDICT, AREA_PREDICT_SCALE * move[i]);
+        }
+    }
+    else
+    {
+        leaf = ent->worldNode = SV_AllocWorldNode();
+        leaf->entity = ent;
     }
 
-    Com_Printf("WARNING: SV_UnlinkEntity: not found in worldSector\n");
+    if (sv_worldStats.active)
+    {
+        sv_worldStats.moves++;
+    }
+
+    for (i = 0; i < 3; i++)
+    {
+        leaf->mins[i] = absmin[i] - AREA_MARGIN + MIN(move[i], 0);
+        leaf->maxs[i] = absmax[i] + AREA_MARGIN + MAX(move[i], 0);
+    }
+    SV_InsertWorldLeaf(leaf);
 }
 
 /*
@@ -219,7 +774,6 @@ SV_LinkEntity
 #define MAX_TOTAL_ENT_LEAFS 128
 void SV_LinkEntity(sharedEntity_t *gEnt)
 {
-    worldSector_t *node;
     int leafs[MAX_TOTAL_ENT_LEAFS];
     int cluster;
     int num_leafs;
@@ -228,12 +782,18 @@ void SV_LinkEntity(sharedEntity_t *gEnt)
     int lastLeaf;
     float *origin, *angles;
     svEntity_t *ent;
+    int num;
 
     ent = SV_SvEntityForGentity(gEnt);
 
-    if (ent->worldSector)
+    if (sv_worldStats.active)
+    {
+        sv_worldStats.links++;
+    }
+
+    if (SV_Capturing())
     {
-        SV_UnlinkEntity(gEnt);  // unlink from old position
+        SV_CaptureLink(gEnt);
     }
 
     // encode the size into the entityState_t for client prediction
@@ -298,6 +858,21 @@ void SV_LinkEntity(sharedEntity_t *gEnt)
     gEnt->r.absmax[1] += 1;
     gEnt->r.absmax[2] += 1;
 
+    // the leafs only depend on the bounds, so if they didn't change since the
+    // last link the clusters, areas and tree leaf are all still right
+    if (ent->worldNode && gEnt->r.linked && VectorCompare(gEnt->r.absmin, ent->linkMins) &&
+        VectorCompare(gEnt->r.absmax, ent->linkMaxs))
+    {
+        if (sv_worldStats.active)
+        {
+            sv_worldStats.unchanged++;
+        }
+        gEnt->r.linkcount++;
+        return;
+    }
+
+    SV_UnlinkClusters(ent);
+
     // link to PVS leafs
     ent->numClusters = 0;
     ent->lastCluster = 0;
@@ -311,6 +886,7 @@ void SV_LinkEntity(sharedEntity_t *gEnt)
     // entity is outside the world and can be considered unlinked
     if (!num_leafs)
     {
+        SV_UnlinkEntity(gEnt);
         return;
     }
 
@@ -339,7 +915,6 @@ void SV_LinkEntity(sharedEntity_t *gEnt)
     }
 
     // store as many explicit clusters as we can
-    ent->numClusters = 0;
     for (i = 0; i < num_leafs; i++)
     {
         cluster = CM_LeafCluster(leafs[i]);
@@ -359,29 +934,17 @@ void SV_LinkEntity(sharedEntity_t *gEnt)
         ent->lastCluster = CM_LeafCluster(lastLeaf);
     }
 
-    gEnt->r.linkcount++;
-
-    // find the first world sector node that the ent's box crosses
-    node = sv_worldSectors;
-    for ( ;; )
-    {
-        if (node->axis == -1)
-            break;
+    SV_LinkClusters(ent);
 
-        if (gEnt->r.absmin[node->axis] > node->dist)
-            node = node->children[0];
-        else if (gEnt->r.absmax[node->axis] < node->dist)
-            node = node->children[1];
-        else
-            break;  // crosses the node
-    }
+    gEnt->r.linkcount++;
 
-    // link it in
-    ent->worldSector = node;
-    ent->nextEntityInWorldSector = node->entities;
-    node->entities = ent;
+    SV_PlaceWorldLeaf(ent, gEnt->r.absmin, gEnt->r.absmax);
+    VectorCopy(gEnt->r.absmin, ent->linkMins);
+    VectorCopy(gEnt->r.absmax, ent->linkMaxs);
 
     gEnt->r.linked = qtrue;
+    num = ent - sv.svEntities;
+    sv.linkedEntities[num >> 3] |= 1 << (num & 7);
 }
 
 /*
@@ -400,28 +963,160 @@ struct areaParms_t {
     int *list;
     int count;
     int maxcount;
+#if idx64
+    __m128 boxMins;  // mins with -FLT_MAX in the fourth lane
+    __m128 boxMaxs;  // maxs with FLT_MAX in the fourth lane
+#endif
+
+    // for moves, boxes are also checked against the swept path
+    bool move;
+    vec3_t moveLo;  // start + maxs of the moving object
+    vec3_t moveHi;  // start + mins of the moving object
+    vec3_t moveScale;  // 1 / (end - start), 0 when barely moving on an axis
+    float moveFraction;  // the part of the move left after the world clip
+#if idx64
+    __m128 moveLo4;
+    __m128 moveHi4;
+    __m128 moveScale4;  // 0 in the fourth lane
+    __m128 moveLeave;  // FLT_MAX for axes that are skipped, the fraction in the fourth lane
+#endif
 };
 
 /*
 ====================
-SV_AreaEntities_r
+SV_OutsideArea
+
+Six compare bounds reject.  With SSE mins and maxs are each compared in one
+go, so both must be 16 byte aligned float[4]; their zero fourth lane never
+gets past the FLT_MAX padding of the query box.
+====================
+*/
+static ID_INLINE bool SV_OutsideArea(const float *mins, const float *maxs, const areaParms_t *ap)
+{
+#if idx64
+    __m128 outside = _mm_or_ps(
+        _mm_cmpgt_ps(_mm_load_ps(mins), ap->boxMaxs), _mm_cmplt_ps(_mm_load_ps(maxs), ap->boxMins));
+
+    return _mm_movemask_ps(outside) != 0;
+#else
+    return mins[0] > ap->maxs[0] || mins[1] > ap->maxs[1] || mins[2] > ap->maxs[2] || maxs[0] < ap->mins[0] ||
+        maxs[1] < ap->mins[1] || maxs[2] < ap->mins[2];
+#endif
+}
+
+/*
+====================
+SV_OutsideMove
+
+Slab test of the swept path against a box grown by the size of the mover.
+Axes without movement are left to SV_OutsideArea.
+====================
+*/
+static ID_INLINE bool SV_OutsideMove(const float *mins, const float *maxs, const areaParms_t *ap)
+{
+#if idx64
+    const __m128 lanes = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    __m128 t1, t2, enter, leave;
+
+    // the same padded float[4] as SV_OutsideArea, the fourth lane is masked off
+    t1 = _mm_and_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(mins), ap->moveLo4), ap->moveScale4), lanes);
+    t2 = _mm_and_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(maxs), ap->moveHi4), ap->moveScale4), lanes);
+    enter = _mm_min_ps(t1, t2);
+    leave = _mm_max_ps(_mm_max_ps(t1, t2), ap->moveLeave);
+
+    enter = _mm_max_ps(enter, _mm_shuffle_ps(enter, enter, _MM_SHUFFLE(1, 0, 3, 2)));
+    enter = _mm_max_ps(enter, _mm_shuffle_ps(enter, enter, _MM_SHUFFLE(2, 3, 0, 1)));
+    leave = _mm_min_ps(leave, _mm_shuffle_ps(leave, leave, _MM_SHUFFLE(1, 0, 3, 2)));
+    leave = _mm_min_ps(leave, _mm_shuffle_ps(leave, leave, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    return _mm_comigt_ss(enter, leave) != 0;
+#else
+    float enter, leave, t1, t2;
+    int i;
+
+    enter = 0;
+    leave = ap->moveFraction;
+    for (i = 0; i < 3; i++)
+    {
+        if (!ap->moveScale[i])
+        {
+            continue;
+        }
+
+        t1 = (mins[i] - ap->moveLo[i]) * ap->moveScale[i];
+        t2 = (maxs[i] - ap->moveHi[i]) * ap->moveScale[i];
+        enter = MAX(enter, MIN(t1, t2));
+        leave = MIN(leave, MAX(t1, t2));
+    }
+
+    return enter > leave;
+#endif
+}
+
+/*
+====================
+SV_SetAreaBox
+====================
+*/
+static void SV_SetAreaBox(areaParms_t *ap, const float *mins, const float *maxs, int *entityList, int maxcount)
+{
+    ap->mins = mins;
+    ap->maxs = maxs;
+    ap->list = entityList;
+    ap->count = 0;
+    ap->maxcount = maxcount;
+#if idx64
+    ap->boxMins = _mm_setr_ps(mins[0], mins[1], mins[2], -FLT_MAX);
+    ap->boxMaxs = _mm_setr_ps(maxs[0], maxs[1], maxs[2], FLT_MAX);
+#endif
+    ap->move = false;
+}
 
+/*
+====================
+SV_AreaEntitiesInTree
+
+Walks the tree without recursing.  Only reads it, so it is safe to call from
+trace jobs.
 ====================
 */
-static void SV_AreaEntities_r(worldSector_t *node, areaParms_t *ap)
+static int SV_AreaEntitiesInTree(areaParms_t *ap)
 {
-    svEntity_t *check, *next;
-    sharedEntity_t *gcheck;
+    const worldNode_t *stack[AREA_STACK];
+    const worldNode_t *node;
+    int depth;
+    int numNodes, numEntities;
 
-    for (check = node->entities; check; check = next)
+    if (!sv_worldRoot)
     {
-        next = check->nextEntityInWorldSector;
+        return 0;
+    }
+
+    numNodes = numEntities = 0;
+    depth = 0;
+    stack[depth++] = sv_worldRoot;
 
-        gcheck = SV_GEntityForSvEntity(check);
+    while (depth)
+    {
+        node = stack[--depth];
+        numNodes++;
 
-        if (gcheck->r.absmin[0] > ap->maxs[0] || gcheck->r.absmin[1] > ap->maxs[1] ||
-            gcheck->r.absmin[2] > ap->maxs[2] || gcheck->r.absmax[0] < ap->mins[0] ||
-            gcheck->r.absmax[1] < ap->mins[1] || gcheck->r.absmax[2] < ap->mins[2])
+        if (SV_OutsideArea(node->mins, node->maxs, ap) || (ap->move && SV_OutsideMove(node->mins, node->maxs, ap)))
+        {
+            continue;
+        }
+
+        if (node->children[0])
+        {
+            stack[depth++] = node->children[1];
+            stack[depth++] = node->children[0];
+            continue;
+        }
+
+        // the leaf box is fattened, check the real one
+        numEntities++;
+        if (SV_OutsideArea(node->entity->linkMins, node->entity->linkMaxs, ap) ||
+            (ap->move && SV_OutsideMove(node->entity->linkMins, node->entity->linkMaxs, ap)))
         {
             continue;
         }
@@ -429,27 +1124,22 @@ static void SV_AreaEntities_r(worldSector_t *node, areaParms_t *ap)
         if (ap->count == ap->maxcount)
         {
             Com_Printf("SV_AreaEntities: MAXCOUNT\n");
-            return;
+            break;
         }
 
-        ap->list[ap->count] = check - sv.svEntities;
+        ap->list[ap->count] = node->entity - sv.svEntities;
         ap->count++;
     }
 
-    if (node->axis == -1)
+    if (sv_worldStats.active)
     {
-        return;  // terminal node
+        sv_worldStats.queries.fetch_add(1, std::memory_order_relaxed);
+        sv_worldStats.nodes.fetch_add(numNodes, std::memory_order_relaxed);
+        sv_worldStats.entities.fetch_add(numEntities, std::memory_order_relaxed);
+        sv_worldStats.found.fetch_add(ap->count, std::memory_order_relaxed);
     }
 
-    // recurse down both sides
-    if (ap->maxs[node->axis] > node->dist)
-    {
-        SV_AreaEntities_r(node->children[0], ap);
-    }
-    if (ap->mins[node->axis] < node->dist)
-    {
-        SV_AreaEntities_r(node->children[1], ap);
-    }
+    return ap->count;
 }
 
 /*
@@ -461,15 +1151,8 @@ int SV_AreaEntities(const vec3_t mins, const vec3_t maxs, int *entityList, int m
 {
     areaParms_t ap;
 
-    ap.mins = mins;
-    ap.maxs = maxs;
-    ap.list = entityList;
-    ap.count = 0;
-    ap.maxcount = maxcount;
-
-    SV_AreaEntities_r(sv_worldSectors, &ap);
-
-    return ap.count;
+    SV_SetAreaBox(&ap, mins, maxs, entityList, maxcount);
+    return SV_AreaEntitiesInTree(&ap);
 }
 
 //===========================================================================
@@ -487,6 +1170,47 @@ struct moveclip_t {
     traceType_t collisionType;
 };
 
+/*
+====================
+SV_MoveEntities
+
+Like SV_AreaEntities for the bounds of a move, but also drops entities the
+swept box can't reach before the world stopped it.  Long diagonal shots would
+otherwise clip against everything in their bounding box.
+====================
+*/
+static int SV_MoveEntities(const moveclip_t *clip, int *entityList, int maxcount)
+{
+    areaParms_t ap;
+    float delta;
+    int i;
+
+    SV_SetAreaBox(&ap, clip->boxmins, clip->boxmaxs, entityList, maxcount);
+
+    for (i = 0; i < 3; i++)
+    {
+        delta = clip->end[i] - clip->start[i];
+        ap.moveScale[i] = fabs(delta) > 0.001f ? 1.0f / delta : 0.0f;
+
+        // the same epsilon as the move bounds
+        ap.moveLo[i] = clip->start[i] + clip->maxs[i] + 1;
+        ap.moveHi[i] = clip->start[i] + clip->mins[i] - 1;
+    }
+    ap.moveFraction = clip->trace.fraction;
+#if idx64
+    ap.moveLo4 = _mm_setr_ps(ap.moveLo[0], ap.moveLo[1], ap.moveLo[2], 0);
+    ap.moveHi4 = _mm_setr_ps(ap.moveHi[0], ap.moveHi[1], ap.moveHi[2], 0);
+    ap.moveScale4 = _mm_setr_ps(ap.moveScale[0], ap.moveScale[1], ap.moveScale[2], 0);
+    ap.moveLeave = _mm_setr_ps(ap.moveScale[0] ? -FLT_MAX : FLT_MAX, ap.moveScale[1] ? -FLT_MAX : FLT_MAX,
+        ap.moveScale[2] ? -FLT_MAX : FLT_MAX, ap.moveFraction);
+#endif
+
+    // short moves are well enough described by their bounds
+    ap.move = Distance(clip->start, clip->end) * clip->trace.fraction > AREA_SWEEP;
+
+    return SV_AreaEntitiesInTree(&ap);
+}
+
 /*
 ====================
 SV_ClipToEntity
@@ -548,7 +1272,7 @@ static void SV_ClipMoveToEntities(moveclip_t *clip)
     clipHandle_t clipHandle;
     float *origin, *angles;
 
-    num = SV_AreaEntities(clip->boxmins, clip->boxmaxs, touchlist, MAX_GENTITIES);
+    num = SV_MoveEntities(clip, touchlist, MAX_GENTITIES);
 
     if (clip->passEntityNum != ENTITYNUM_NONE)
     {
@@ -636,14 +1360,14 @@ static void SV_ClipMoveToEntities(moveclip_t *clip)
 
 /*
 ==================
-SV_Trace
+SV_ClipMove
 
 Moves the given mins/maxs volume through the world from start to end.
 passEntityNum and entities owned by passEntityNum are explicitly not checked.
 ==================
 */
-void SV_Trace(trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum,
-    int contentmask, traceType_t type)
+static void SV_ClipMove(trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end,
+    int passEntityNum, int contentmask, traceType_t type)
 {
     moveclip_t clip;
     int i;
@@ -701,6 +1425,81 @@ void SV_Trace(trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, co
     *results = clip.trace;
 }
 
+/*
+==================
+SV_Trace
+==================
+*/
+void SV_Trace(trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum,
+    int contentmask, traceType_t type)
+{
+    if (SV_Capturing())
+    {
+        SV_CaptureTrace(start, mins, maxs, end, passEntityNum, contentmask, type);
+    }
+
+    SV_ClipMove(results, start, mins, maxs, end, passEntityNum, contentmask, type);
+}
+
+struct traceBatch_t {
+    trace_t *results;
+    const traceRequest_t *requests;
+};
+
+/*
+==================
+SV_TraceBatchJob
+==================
+*/
+static void SV_TraceBatchJob(void *data, int index, int thread)
+{
+    const traceBatch_t *batch = (const traceBatch_t *)data;
+    const traceRequest_t *req = &batch->requests[index];
+    vec3_t mins, maxs;
+
+    // the box trace takes its extents mutable, the requests stay read-only
+    VectorCopy(req->mins, mins);
+    VectorCopy(req->maxs, maxs);
+
+    SV_ClipMove(&batch->results[index], req->start, mins, maxs, req->end, req->passEntityNum,
+        req->contentmask, req->type == TT_CAPSULE ? TT_CAPSULE : TT_AABB);
+}
+
+/*
+==================
+SV_TraceBatch
+
+Runs a block of independent traces for the game in one system call.  Nothing
+is linked or moved while the batch runs, so the traces can be spread over
+sv_traceThreads threads; every result is the same as a lone SV_Trace.
+==================
+*/
+void SV_TraceBatch(trace_t *results, const traceRequest_t *requests, int numRequests)
+{
+    traceBatch_t batch;
+    int i;
+
+    if (numRequests < 0 || numRequests > MAX_TRACE_BATCH)
+    {
+        Com_Error(ERR_DROP, "SV_TraceBatch: bad request count %i", numRequests);
+    }
+
+    // captured here, the jobs can't write to the capture file
+    if (SV_Capturing())
+    {
+        for (i = 0; i < numRequests; i++)
+        {
+            SV_CaptureTrace(requests[i].start, requests[i].mins, requests[i].maxs, requests[i].end,
+                requests[i].passEntityNum, requests[i].contentmask,
+                requests[i].type == TT_CAPSULE ? TT_CAPSULE : TT_AABB);
+        }
+    }
+
+    batch.results = results;
+    batch.requests = requests;
+    Jobs_ParallelFor(sv_traceThreads->integer, numRequests, SV_TraceBatchJob, &batch);
+}
+
 /*
 =============
 SV_PointContents
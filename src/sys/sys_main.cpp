@@ -313,6 +313,14 @@ cpuFeatures_t Sys_GetProcessorFeatures( void )
     if( SDL_HasSSE( ) )        features |= CF_SSE;
     if( SDL_HasSSE2( ) )       features |= CF_SSE2;
     if( SDL_HasAltiVec( ) )    features |= CF_ALTIVEC;
+    if( SDL_HasAVX( ) )        features |= CF_AVX;
+#elif ( id386 || idx64 ) && defined( __GNUC__ )
+    // no SDL in the dedicated server, ask the compiler's cpuid wrapper
+    __builtin_cpu_init( );
+    if( __builtin_cpu_supports( "mmx" ) )   features |= CF_MMX;
+    if( __builtin_cpu_supports( "sse" ) )   features |= CF_SSE;
+    if( __builtin_cpu_supports( "sse2" ) )  features |= CF_SSE2;
+    if( __builtin_cpu_supports( "avx" ) )   features |= CF_AVX;
 #endif
 
     return features;
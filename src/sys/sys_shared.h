@@ -30,7 +30,8 @@ enum CPU_FEATURES {
   CF_3DNOW_EXT  = 1 << 4,
   CF_SSE        = 1 << 5,
   CF_SSE2       = 1 << 6,
-  CF_ALTIVEC    = 1 << 7
+  CF_ALTIVEC    = 1 << 7,
+  CF_AVX        = 1 << 8
 };
 
 struct netadr_t;
@@ -95,6 +96,12 @@ void Sys_Sleep(int msec);
 
 bool Sys_LowPhysicalMemory(void);
 
+// address space that is only backed by memory once it is committed,
+// hugePages is 0 for none, 1 for transparent and 2 for explicit ones
+void *Sys_ReserveMemory(size_t size, int hugePages);
+bool Sys_CommitMemory(void *ptr, size_t size);
+void Sys_ReleaseMemory(void *ptr, size_t size);  // stays committed, contents are lost
+
 void Sys_SetEnv(const char *name, const char *value);
 
 bool Sys_WritePIDFile(void);
@@ -180,6 +180,99 @@ bool Sys_LowPhysicalMemory( void )
 	return false;
 }
 
+/*
+==================
+Sys_ReserveMemory
+
+Reserves without any access, so that nothing counts against the commit
+limit until Sys_CommitMemory.  Huge pages want the block aligned to their
+size.
+==================
+*/
+void *Sys_ReserveMemory( size_t size, int hugePages )
+{
+#ifdef EMSCRIPTEN
+	return calloc( size, 1 );
+#else
+	const size_t hugePageSize = 2 * 1024 * 1024;
+	byte *base, *aligned;
+
+#ifdef MAP_HUGETLB
+	if ( hugePages == 2 ) {
+		// explicit huge pages come out of the pool, which reserves them up front
+		base = (byte *)mmap( NULL, PAD( size, hugePageSize ), PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+		if ( base != MAP_FAILED ) {
+			return base;
+		}
+		Com_Printf( "Sys_ReserveMemory: no explicit huge pages (%s), trying transparent ones\n", strerror( errno ) );
+	}
+#endif
+
+	base = (byte *)mmap( NULL, size + hugePageSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+	if ( base == MAP_FAILED ) {
+		return NULL;
+	}
+
+	aligned = (byte *)PAD( (intptr_t)base, hugePageSize );
+	if ( aligned > base ) {
+		munmap( base, aligned - base );
+	}
+	munmap( aligned + size, base + hugePageSize - aligned );
+
+#ifdef MADV_HUGEPAGE
+	if ( hugePages ) {
+		madvise( aligned, size, MADV_HUGEPAGE );
+	}
+#endif
+	return aligned;
+#endif
+}
+
+/*
+==================
+Sys_CommitMemory
+==================
+*/
+bool Sys_CommitMemory( void *ptr, size_t size )
+{
+#ifdef EMSCRIPTEN
+	return true;
+#else
+	return mprotect( ptr, size, PROT_READ | PROT_WRITE ) == 0;
+#endif
+}
+
+/*
+==================
+Sys_ReleaseMemory
+
+Gives the pages back to the system, they read as zero when touched again.
+Before Linux 5.18 madvise refuses explicit huge pages, mapping fresh ones
+over the old ones frees those instead.
+==================
+*/
+void Sys_ReleaseMemory( void *ptr, size_t size )
+{
+#ifndef EMSCRIPTEN
+	if ( !madvise( ptr, size, MADV_DONTNEED ) || errno != EINVAL ) {
+		return;
+	}
+
+#ifdef MAP_HUGETLB
+	if ( !size || ( ( (intptr_t)ptr | size ) & ( 2 * 1024 * 1024 - 1 ) ) ) {
+		return;  // not whole huge pages, so not what madvise refused
+	}
+
+	// a failed MAP_FIXED can leave a hole behind, which nothing could use
+	if ( mmap( ptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB,
+			-1, 0 ) == MAP_FAILED ) {
+		Com_Error( ERR_FATAL, "Sys_ReleaseMemory: couldn't replace huge pages (%s)", strerror( errno ) );
+	}
+#endif
+#endif
+}
+
 /*
 ==================
 Sys_Basename
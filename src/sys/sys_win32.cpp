@@ -170,6 +170,44 @@ bool Sys_LowPhysicalMemory( void )
 	return (stat.dwTotalPhys <= MEM_THRESHOLD) ? true : false;
 }
 
+/*
+==================
+Sys_ReserveMemory
+
+Large pages need SeLockMemoryPrivilege and can't be committed piecemeal,
+so they are not used
+==================
+*/
+void *Sys_ReserveMemory( size_t size, int hugePages )
+{
+	if ( hugePages )
+		Com_Printf( "Sys_ReserveMemory: huge pages are not supported on Windows\n" );
+
+	return VirtualAlloc( NULL, size, MEM_RESERVE, PAGE_NOACCESS );
+}
+
+/*
+==================
+Sys_CommitMemory
+==================
+*/
+bool Sys_CommitMemory( void *ptr, size_t size )
+{
+	return VirtualAlloc( ptr, size, MEM_COMMIT, PAGE_READWRITE ) != NULL;
+}
+
+/*
+==================
+Sys_ReleaseMemory
+
+Unlike on unix the contents are undefined afterwards, not zero
+==================
+*/
+void Sys_ReleaseMemory( void *ptr, size_t size )
+{
+	VirtualAlloc( ptr, size, MEM_RESET, PAGE_READWRITE );
+}
+
 /*
 ==============
 Sys_Basename